@@ -0,0 +1,198 @@
+/**
+ * @file BackendHarness.c
+ *
+ * Compares every inference backend to the reference rule engine on the same
+ * inputs and times them.
+ *
+ * > BackendHarness <model.fzm> [-n samples] [-t tolerance] [log]...
+ * runs random inputs, inputs at and next to every membership function
+ * breakpoint and, for models with the inputs temperature and temperature
+ * change like PeltierControl.fzm, the temperatures of controller logs. It
+ * prints the maximum and mean absolute error of every output per backend and
+ * fails if any error exceeds the tolerance. The rule backends also print how
+ * many rules they evaluate, the optimized one after FuzzyRuleOptimize(). The
+ * reordered one checks that FuzzyRuleReorder() keeps the outputs.
+ *
+ * The backends run under min/max, then those that support them under the
+ * product and Lukasiewicz operators, each family against its own reference.
+ */
+
+#include "fuzzyc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RANDOM_SAMPLES 100000
+#define NUM_BACKENDS 8
+#define NUM_FAMILIES 3
+
+// Append the temperatures of a controller log and their changes as samples
+int appendLog(const char *path, double **samples, int *numSamples) {
+    FuzzyPlantSample_t *log;
+    int numLog;
+    if (FuzzyPlantLoadLog(path, &log, &numLog)) {
+        return -1;
+    }
+
+    double *grown =
+        realloc(*samples, (*numSamples + numLog) * 2 * sizeof(double));
+    if (grown == NULL) {
+        free(log);
+        return -1;
+    }
+    for (int i = 0; i < numLog; i++) {
+        double *sample = &grown[(*numSamples + i) * 2];
+        sample[0] = log[i].temperature;
+        sample[1] = i > 0 ? log[i].temperature - log[i - 1].temperature : 0.0;
+    }
+    *samples = grown;
+    *numSamples += numLog;
+    free(log);
+    return 0;
+}
+
+// The backends compared under one operator family, the reference first
+typedef struct {
+    const char *name;
+    FuzzyOperators_e operators;
+    int numKinds;
+    FuzzyBackendKind_e kinds[NUM_BACKENDS];
+} Family_t;
+
+static const Family_t families[NUM_FAMILIES] = {
+    {"min/max",
+     FUZZY_MIN_MAX,
+     8,
+     {FUZZY_BACKEND_RULES, FUZZY_BACKEND_ENGINE, FUZZY_BACKEND_SPARSE,
+      FUZZY_BACKEND_MATRIX, FUZZY_BACKEND_MODEL, FUZZY_BACKEND_GRADIENT,
+      FUZZY_BACKEND_OPTIMIZED, FUZZY_BACKEND_REORDERED}},
+    {"product",
+     FUZZY_PRODUCT,
+     4,
+     {FUZZY_BACKEND_RULES, FUZZY_BACKEND_ENGINE, FUZZY_BACKEND_SPARSE,
+      FUZZY_BACKEND_MATRIX}},
+    {"lukasiewicz",
+     FUZZY_LUKASIEWICZ,
+     4,
+     {FUZZY_BACKEND_RULES, FUZZY_BACKEND_ENGINE, FUZZY_BACKEND_SPARSE,
+      FUZZY_BACKEND_MATRIX}}};
+
+// Compare the backends of a family and print their errors, returns the number
+// of failed backends or -1
+int runFamily(const Family_t *family, const FuzzyModel_t *model,
+              const double *samples, int numSamples, double tolerance) {
+    FuzzyBackend_t backends[NUM_BACKENDS];
+    int numBackends = 0;
+    printf("\n%s\n", family->name);
+    for (int i = 0; i < family->numKinds; i++) {
+        if (FuzzyBackendInitWith(&backends[numBackends], family->kinds[i],
+                                 model, family->operators)) {
+            printf("Backend %d does not support the model\n",
+                   family->kinds[i]);
+            continue;
+        }
+        backends[numBackends++].tolerance = tolerance;
+    }
+
+    FuzzyHarnessResult_t results[NUM_BACKENDS];
+    int failed =
+        FuzzyHarnessRun(backends, numBackends, model->numInputs,
+                        model->numOutputs, samples, numSamples, results);
+
+    printf("%-10s %6s %10s  %-20s %12s %12s %9s\n", "backend", "rules",
+           "ns/eval", "output", "max error", "mean error", "failures");
+    for (int b = 0; failed >= 0 && b < numBackends; b++) {
+        int output = 0;
+        for (int i = 0; i < model->numVariables; i++) {
+            if (model->variables[i].kind != FUZZY_MODEL_OUTPUT) {
+                continue;
+            }
+            char time[32] = "", rules[16] = "";
+            if (output == 0) {
+                snprintf(time, sizeof(time), "%.1f", results[b].nanoseconds);
+                if (backends[b].numRules > 0) {
+                    snprintf(rules, sizeof(rules), "%d", backends[b].numRules);
+                }
+            }
+            printf("%-10s %6s %10s  %-20s %12.3g %12.3g %9d\n",
+                   output ? "" : backends[b].name, rules, time,
+                   model->variables[i].name, results[b].maxError[output],
+                   results[b].meanError[output], results[b].failures);
+            output++;
+        }
+        if (results[b].failures > 0) {
+            const double *worst = &samples[results[b].worst * model->numInputs];
+            printf("%-10s worst at", "");
+            for (int k = 0; k < model->numInputs; k++) {
+                printf(" %.17g", worst[k]);
+            }
+            printf("\n");
+        }
+    }
+
+    for (int b = 0; b < numBackends; b++) {
+        FuzzyBackendFree(&backends[b]);
+    }
+    return failed;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <model.fzm> [-n samples] [-t tolerance] [log]...\n",
+               argv[0]);
+        return 1;
+    }
+
+    int numRandom = RANDOM_SAMPLES;
+    double tolerance = 1e-9;
+    int firstLog = 2;
+    while (firstLog + 1 < argc && argv[firstLog][0] == '-') {
+        if (strcmp(argv[firstLog], "-n") == 0) {
+            numRandom = atoi(argv[firstLog + 1]);
+        } else if (strcmp(argv[firstLog], "-t") == 0) {
+            tolerance = atof(argv[firstLog + 1]);
+        } else {
+            break;
+        }
+        firstLog += 2;
+    }
+
+    FuzzyModel_t model;
+    FuzzyModelError_t error = {0};
+    if (FuzzyModelLoad(&model, argv[1], &error)) {
+        printf("%s:%d: %s\n", argv[1], error.line, error.message);
+        return 1;
+    }
+
+    double *samples;
+    int numSamples;
+    if (FuzzyHarnessSamples(&model, numRandom, 42, &samples, &numSamples)) {
+        FuzzyModelFree(&model);
+        return 1;
+    }
+    int numGenerated = numSamples;
+    for (int i = firstLog; i < argc; i++) {
+        if (model.numInputs != 2 || appendLog(argv[i], &samples, &numSamples)) {
+            printf("Can not replay %s\n", argv[i]);
+        }
+    }
+
+    printf("%d samples (%d generated, %d replayed), tolerance %g\n",
+           numSamples, numGenerated, numSamples - numGenerated, tolerance);
+    int failed = 0;
+    for (int g = 0; g < NUM_FAMILIES && failed >= 0; g++) {
+        int result = runFamily(&families[g], &model, samples, numSamples,
+                               tolerance);
+        failed = result < 0 ? result : failed + result;
+    }
+
+    free(samples);
+    FuzzyModelFree(&model);
+
+    if (failed != 0) {
+        printf("FAILED\n");
+        return 1;
+    }
+    return 0;
+}
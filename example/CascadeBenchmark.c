@@ -0,0 +1,273 @@
+/**
+ * @file CascadeBenchmark.c
+ *
+ * Compares four ways to run a two stage fan controller: temperature and its
+ * change give a heat load, the load and the TEC power give the fan speed.
+ *
+ * > CascadeBenchmark [repetitions]
+ * times over a grid of inputs
+ * - round trip: the load is defuzzified and classified again for stage two
+ * - cascade: the fuzzy load is passed on as is
+ * - mapped: the load is mapped onto a finer set of five load terms
+ * - flat: one rule base over all three inputs
+ * and prints the time per evaluation, the rule count and the mean difference
+ * of the fan speed to the cascade.
+ */
+
+#include "fuzzyc.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define REPETITIONS 20
+#define MAX_RULES 32
+
+#define TemperatureTerms(X)                                                    \
+    X(TEMPERATURE_LOW, 0.0, 0.0, 15.0, 25.0, TRAPEZOIDAL)                      \
+    X(TEMPERATURE_MEDIUM, 15.0, 25.0, 35.0, 0.0, TRIANGULAR)                   \
+    X(TEMPERATURE_HIGH, 25.0, 35.0, 50.0, 50.0, TRAPEZOIDAL)
+DEFINE_FUZZY_MEMBERSHIP(TemperatureTerms)
+
+#define ChangeTerms(X)                                                         \
+    X(CHANGE_FALLING, -5.0, -5.0, -2.0, 0.0, TRAPEZOIDAL)                      \
+    X(CHANGE_STEADY, -2.0, 0.0, 2.0, 0.0, TRIANGULAR)                          \
+    X(CHANGE_RISING, 0.0, 2.0, 5.0, 5.0, TRAPEZOIDAL)
+DEFINE_FUZZY_MEMBERSHIP(ChangeTerms)
+
+#define LoadTerms(X)                                                           \
+    X(LOAD_LOW, 0.0, 0.0, 20.0, 50.0, TRAPEZOIDAL)                             \
+    X(LOAD_MEDIUM, 20.0, 50.0, 80.0, 0.0, TRIANGULAR)                          \
+    X(LOAD_HIGH, 50.0, 80.0, 100.0, 100.0, TRAPEZOIDAL)
+DEFINE_FUZZY_MEMBERSHIP(LoadTerms)
+
+#define FineLoadTerms(X)                                                       \
+    X(FINE_LOAD_VERY_LOW, -25.0, 0.0, 25.0, 0.0, TRIANGULAR)                   \
+    X(FINE_LOAD_LOW, 0.0, 25.0, 50.0, 0.0, TRIANGULAR)                         \
+    X(FINE_LOAD_MEDIUM, 25.0, 50.0, 75.0, 0.0, TRIANGULAR)                     \
+    X(FINE_LOAD_HIGH, 50.0, 75.0, 100.0, 0.0, TRIANGULAR)                      \
+    X(FINE_LOAD_VERY_HIGH, 75.0, 100.0, 125.0, 0.0, TRIANGULAR)
+DEFINE_FUZZY_MEMBERSHIP(FineLoadTerms)
+
+#define PowerTerms(X)                                                          \
+    X(POWER_LOW, 0.0, 0.0, 20.0, 50.0, TRAPEZOIDAL)                            \
+    X(POWER_MEDIUM, 20.0, 50.0, 80.0, 0.0, TRIANGULAR)                         \
+    X(POWER_HIGH, 50.0, 80.0, 100.0, 100.0, TRAPEZOIDAL)
+DEFINE_FUZZY_MEMBERSHIP(PowerTerms)
+
+#define FanTerms(X)                                                            \
+    X(FAN_OFF, -10.0, 0.0, 0.0, 10.0, TRAPEZOIDAL)                             \
+    X(FAN_SLOW, 0.0, 30.0, 60.0, 0.0, TRIANGULAR)                              \
+    X(FAN_FAST, 40.0, 70.0, 100.0, 100.0, TRAPEZOIDAL)
+DEFINE_FUZZY_MEMBERSHIP(FanTerms)
+
+// The consequents of every combination of terms
+const int loadTable[3][3] = {{LOAD_LOW, LOAD_LOW, LOAD_MEDIUM},
+                             {LOAD_LOW, LOAD_MEDIUM, LOAD_HIGH},
+                             {LOAD_MEDIUM, LOAD_HIGH, LOAD_HIGH}};
+const int fanTable[3][3] = {{FAN_OFF, FAN_OFF, FAN_SLOW},
+                            {FAN_OFF, FAN_SLOW, FAN_FAST},
+                            {FAN_SLOW, FAN_FAST, FAN_FAST}};
+const int fineFanTable[5][3] = {{FAN_OFF, FAN_OFF, FAN_SLOW},
+                                {FAN_OFF, FAN_OFF, FAN_SLOW},
+                                {FAN_OFF, FAN_SLOW, FAN_FAST},
+                                {FAN_SLOW, FAN_FAST, FAN_FAST},
+                                {FAN_SLOW, FAN_FAST, FAN_FAST}};
+
+// A rule base in which every rule is one ALL_OF group of literals
+typedef struct {
+    FuzzyRule_t rules[MAX_RULES];
+    FuzzyAntecedent_t antecedents[MAX_RULES];
+    FuzzyVariable_t variables[3 * MAX_RULES];
+    int numRules;
+    FuzzyEngine_t engine;
+} RuleBase_t;
+
+void addRule(RuleBase_t *base, FuzzyVariable_t *literals, int numLiterals,
+             FuzzyVariable_t consequent) {
+    int n = base->numRules++;
+    for (int i = 0; i < numLiterals; i++) {
+        base->variables[3 * n + i] = literals[i];
+    }
+    base->antecedents[n] =
+        (FuzzyAntecedent_t){.variables = &base->variables[3 * n],
+                            .num_variables = numLiterals,
+                            .fuzzy_operator = FUZZY_ALL_OF};
+    base->rules[n] = (FuzzyRule_t){.antecedent = &base->antecedents[n],
+                                   .num_antecedents = 1,
+                                   .consequent = consequent};
+}
+
+// One rule per combination of the terms of two sets
+void gridRules(RuleBase_t *base, FuzzySet_t *a, FuzzySet_t *b,
+               FuzzySet_t *output, const int *table) {
+    base->numRules = 0;
+    for (int i = 0; i < a->length; i++) {
+        for (int j = 0; j < b->length; j++) {
+            FuzzyVariable_t literals[] = {VAR(*a, i), VAR(*b, j)};
+            addRule(base, literals, 2,
+                    THEN(*output, table[i * b->length + j]));
+        }
+    }
+    FuzzyEngineInit(&base->engine, base->rules, base->numRules);
+}
+
+// Helper function to get a monotonic time in nanoseconds
+double nowNanoseconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+FuzzySet_t temperature, change, load, loadIn, fineLoad, power, fan;
+RuleBase_t loadRules, fanRules, roundTripRules, fineRules, flatRules;
+FuzzyCascade_t direct, mapped;
+// the cascades take their inputs in registration order
+int directOrder[3], mappedOrder[3];
+
+double evaluateCascade(const FuzzyCascade_t *cascade, const int *order,
+                       double t, double c, double p) {
+    double inputs[3], speed;
+    inputs[order[0]] = t;
+    inputs[order[1]] = c;
+    inputs[order[2]] = p;
+    FuzzyCascadeEvaluate(cascade, inputs, &speed);
+    return speed;
+}
+
+// The fan speed for one set of inputs, in one of the four ways
+double evaluate(int variant, double t, double c, double p) {
+    switch (variant) {
+    case 0:
+        FuzzyClassifier(t, &temperature);
+        FuzzyClassifier(c, &change);
+        FuzzyEngineInfer(&loadRules.engine);
+        FuzzyClassifier(defuzzification(&load), &loadIn);
+        FuzzyClassifier(p, &power);
+        FuzzyEngineInfer(&roundTripRules.engine);
+        return defuzzification(&fan);
+    case 1:
+        return evaluateCascade(&direct, directOrder, t, c, p);
+    case 2:
+        return evaluateCascade(&mapped, mappedOrder, t, c, p);
+    default:
+        FuzzyClassifier(t, &temperature);
+        FuzzyClassifier(c, &change);
+        FuzzyClassifier(p, &power);
+        FuzzyEngineInfer(&flatRules.engine);
+        return defuzzification(&fan);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int repetitions = argc > 1 ? atoi(argv[1]) : REPETITIONS;
+    if (repetitions < 1) {
+        printf("Usage: %s [repetitions]\n", argv[0]);
+        return 1;
+    }
+
+    FuzzySetInit(&temperature, TemperatureTerms,
+                 FUZZY_LENGTH(TemperatureTerms));
+    FuzzySetInit(&change, ChangeTerms, FUZZY_LENGTH(ChangeTerms));
+    FuzzySetInit(&load, LoadTerms, FUZZY_LENGTH(LoadTerms));
+    FuzzySetInit(&loadIn, LoadTerms, FUZZY_LENGTH(LoadTerms));
+    FuzzySetInit(&fineLoad, FineLoadTerms, FUZZY_LENGTH(FineLoadTerms));
+    FuzzySetInit(&power, PowerTerms, FUZZY_LENGTH(PowerTerms));
+    FuzzySetInit(&fan, FanTerms, FUZZY_LENGTH(FanTerms));
+
+    gridRules(&loadRules, &temperature, &change, &load, &loadTable[0][0]);
+    gridRules(&fanRules, &load, &power, &fan, &fanTable[0][0]);
+    gridRules(&roundTripRules, &loadIn, &power, &fan, &fanTable[0][0]);
+    gridRules(&fineRules, &fineLoad, &power, &fan, &fineFanTable[0][0]);
+
+    // the flat rule base needs a rule per combination of all three inputs
+    for (int t = 0; t < temperature.length; t++) {
+        for (int c = 0; c < change.length; c++) {
+            for (int p = 0; p < power.length; p++) {
+                FuzzyVariable_t literals[] = {VAR(temperature, t),
+                                              VAR(change, c), VAR(power, p)};
+                addRule(&flatRules, literals, 3,
+                        THEN(fan, fanTable[loadTable[t][c]][p]));
+            }
+        }
+    }
+    FuzzyEngineInit(&flatRules.engine, flatRules.rules, flatRules.numRules);
+
+    FuzzyCascadeInit(&direct);
+    FuzzyCascadeAddStage(&direct, &fanRules.engine, NULL);
+    FuzzyCascadeAddStage(&direct, &loadRules.engine, NULL);
+
+    double matrix[FUZZY_LENGTH(FineLoadTerms) * FUZZY_LENGTH(LoadTerms)];
+    FuzzyCascadeInit(&mapped);
+    FuzzyCascadeAddStage(&mapped, &loadRules.engine, NULL);
+    FuzzyCascadeAddStage(&mapped, &fineRules.engine, NULL);
+    if (FuzzyCascadeTermMatrix(&load, &fineLoad, matrix) ||
+        FuzzyCascadeLink(&mapped, &load, &fineLoad, matrix) ||
+        FuzzyCascadePrepare(&direct) || FuzzyCascadePrepare(&mapped)) {
+        printf("Can not prepare the cascades\n");
+        return 1;
+    }
+    FuzzySet_t *inputSets[] = {&temperature, &change, &power};
+    for (int i = 0; i < 3; i++) {
+        directOrder[i] = FuzzyCascadeInputIndex(&direct, inputSets[i]);
+        mappedOrder[i] = FuzzyCascadeInputIndex(&mapped, inputSets[i]);
+    }
+
+    const char *names[] = {"round trip", "cascade", "mapped", "flat"};
+    int numRules[] = {loadRules.numRules + roundTripRules.numRules,
+                      loadRules.numRules + fanRules.numRules,
+                      loadRules.numRules + fineRules.numRules,
+                      flatRules.numRules};
+    double elapsed[4] = {0}, difference[4] = {0};
+    long points = 0;
+    double sink = 0.0;
+
+    for (int v = 0; v < 4; v++) {
+        double start = nowNanoseconds();
+        for (int r = 0; r < repetitions; r++) {
+            for (double t = 0.0; t <= 50.0; t += 1.25) {
+                for (double c = -5.0; c <= 5.0; c += 0.5) {
+                    for (double p = 0.0; p <= 100.0; p += 5.0) {
+                        sink += evaluate(v, t, c, p);
+                    }
+                }
+            }
+        }
+        elapsed[v] = nowNanoseconds() - start;
+    }
+
+    for (double t = 0.0; t <= 50.0; t += 1.25) {
+        for (double c = -5.0; c <= 5.0; c += 0.5) {
+            for (double p = 0.0; p <= 100.0; p += 5.0) {
+                double cascade = evaluate(1, t, c, p);
+                for (int v = 0; v < 4; v++) {
+                    difference[v] += fabs(evaluate(v, t, c, p) - cascade);
+                }
+                points++;
+            }
+        }
+    }
+
+    printf("%ld evaluations, the cascade runs stages %d then %d\n",
+           points * repetitions, direct.order[0], direct.order[1]);
+    for (int v = 0; v < 4; v++) {
+        printf("%-10s %2d rules %7.1f ns/evaluation, mean difference %.3f\n",
+               names[v], numRules[v], elapsed[v] / (points * repetitions),
+               difference[v] / points);
+    }
+    if (sink == 0.0) {
+        printf("\n");
+    }
+
+    FuzzyCascadeFree(&direct);
+    FuzzyCascadeFree(&mapped);
+    FuzzySetFree(&temperature);
+    FuzzySetFree(&change);
+    FuzzySetFree(&load);
+    FuzzySetFree(&loadIn);
+    FuzzySetFree(&fineLoad);
+    FuzzySetFree(&power);
+    FuzzySetFree(&fan);
+    return 0;
+}
@@ -0,0 +1,105 @@
+/**
+ * @file FuzzyModelCompiler.c
+ *
+ * Compiles a text model description into a mappable binary image, and checks
+ * or evaluates compiled images.
+ */
+
+#include "fuzzyc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Print a short summary of a model
+void printModel(const FuzzyModel_t *model) {
+    printf("%d variables (%d inputs, %d outputs), %d terms, %d rules, "
+           "%zu bytes\n",
+           model->numVariables, model->numInputs, model->numOutputs,
+           model->numTerms, model->numRules, model->imageSize);
+
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+        printf("  %s %s:", v->kind == FUZZY_MODEL_INPUT ? "input" : "output",
+               v->name);
+        for (uint32_t j = 0; j < v->numTerms; j++) {
+            printf(" %s", model->terms[v->firstTerm + j].name);
+        }
+        printf("\n");
+    }
+}
+
+int main(int argc, char *argv[]) {
+    FuzzyModel_t model;
+    FuzzyModelError_t error = {0};
+
+    if (argc == 3 && strcmp(argv[1], "--check") == 0) {
+        // Map and verify a compiled image
+        if (FuzzyModelMapImage(&model, argv[2], FUZZY_MODEL_VERIFY_CHECKSUM,
+                               &error)) {
+            printf("%s: %s\n", argv[2], error.message);
+            return 1;
+        }
+        printModel(&model);
+        FuzzyModelFree(&model);
+        return 0;
+    }
+
+    if (argc >= 3 && strcmp(argv[1], "--eval") == 0) {
+        // Evaluate a compiled image with crisp inputs from the command line
+        if (FuzzyModelMapImage(&model, argv[2], 0, &error)) {
+            printf("%s: %s\n", argv[2], error.message);
+            return 1;
+        }
+        if (argc - 3 != model.numInputs) {
+            printf("%s expects %d inputs\n", argv[2], model.numInputs);
+            FuzzyModelFree(&model);
+            return 1;
+        }
+
+        FuzzyContext_t context;
+        double *inputs = malloc(model.numInputs * sizeof(double));
+        FuzzyContextInit(&context, &model);
+        for (int i = 0; i < model.numInputs; i++) {
+            inputs[i] = atof(argv[3 + i]);
+        }
+
+        FuzzyModelEvaluate(&model, &context, inputs, NULL);
+
+        int output = 0;
+        for (int i = 0; i < model.numVariables; i++) {
+            if (model.variables[i].kind == FUZZY_MODEL_OUTPUT) {
+                printf("%s: %.04f\n", model.variables[i].name,
+                       context.outputs[output++]);
+            }
+        }
+
+        free(inputs);
+        FuzzyContextFree(&context);
+        FuzzyModelFree(&model);
+        return 0;
+    }
+
+    if (argc != 3) {
+        printf("Usage: %s <model.fzm> <model.fzb>\n"
+               "       %s --check <model.fzb>\n"
+               "       %s --eval <model.fzb> <input>...\n",
+               argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    // Parse the text description and write the image
+    if (FuzzyModelLoad(&model, argv[1], &error)) {
+        printf("%s:%d: %s\n", argv[1], error.line, error.message);
+        return 1;
+    }
+    if (FuzzyModelWriteImage(&model, argv[2])) {
+        printf("Can not write %s\n", argv[2]);
+        FuzzyModelFree(&model);
+        return 1;
+    }
+    printModel(&model);
+    FuzzyModelFree(&model);
+
+    return 0;
+}
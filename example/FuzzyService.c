@@ -0,0 +1,114 @@
+/**
+ * @file FuzzyService.c
+ *
+ * Hosts models for the other processes of a machine, so they evaluate one
+ * shared copy instead of linking their own.
+ *
+ * > FuzzyService <socket> <name>=<model> [<name>=<model> ...] [-v]
+ * serves every model under its name on the UNIX socket until SIGINT or
+ * SIGTERM. A model is a compiled image (FuzzyModelCompiler) or a text
+ * description. With -v every request is logged with its latency; the totals
+ * are printed on exit. ServiceClient talks to it.
+ */
+
+#include "fuzzyc.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static volatile sig_atomic_t stop = 0;
+
+static void stopServer(int signal) {
+    (void)signal;
+    stop = 1;
+}
+
+// Maps a compiled image, or parses a description if the file is none
+static int loadModel(FuzzyModel_t *model, const char *path) {
+    FuzzyModelError_t error;
+    if (FuzzyModelMapImage(model, path, FUZZY_MODEL_VERIFY_CHECKSUM,
+                           &error) == 0) {
+        return 0;
+    }
+    if (FuzzyModelLoad(model, path, &error) == 0) {
+        return 0;
+    }
+    printf("%s:%d: %s\n", path, error.line, error.message);
+    return -1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("Usage: %s <socket> <name>=<model> [<name>=<model> ...] "
+               "[-v]\n",
+               argv[0]);
+        return 1;
+    }
+
+    static FuzzyServer_t server;
+    static FuzzyModel_t models[FUZZY_SERVICE_MAX_MODELS];
+    int numModels = 0;
+    if (FuzzyServerInit(&server, argv[1])) {
+        perror(argv[1]);
+        return 1;
+    }
+
+    int failed = 0;
+    for (int i = 2; i < argc && !failed; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            server.verbose = 1;
+            continue;
+        }
+        char *path = strchr(argv[i], '=');
+        if (path == NULL || numModels == FUZZY_SERVICE_MAX_MODELS) {
+            printf("Expected <name>=<model>: %s\n", argv[i]);
+            failed = 1;
+            break;
+        }
+        *path++ = '\0';
+        FuzzyModel_t *model = &models[numModels];
+        if (loadModel(model, path)) {
+            failed = 1;
+            break;
+        }
+        numModels++;
+        if (FuzzyServerAddModel(&server, argv[i], model)) {
+            printf("Can not host %s\n", argv[i]);
+            failed = 1;
+            break;
+        }
+        printf("%s: %d inputs, %d outputs, %d rules\n", argv[i],
+               model->numInputs, model->numOutputs, model->numRules);
+    }
+
+    if (!failed) {
+        struct sigaction action = {.sa_handler = stopServer};
+        sigaction(SIGINT, &action, NULL);
+        sigaction(SIGTERM, &action, NULL);
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        printf("Serving %d models on %s\n", numModels, argv[1]);
+        fflush(stdout);
+        failed = FuzzyServerRun(&server, &stop, &signals) != 0;
+
+        const FuzzyServerStats_t *stats = &server.stats;
+        printf("%llu requests, %llu rows, %llu errors, latency mean %.1f us "
+               "max %.1f us\n",
+               (unsigned long long)stats->requests,
+               (unsigned long long)stats->rows,
+               (unsigned long long)stats->errors,
+               stats->requests ? stats->totalLatency * 1e-3 / stats->requests
+                               : 0.0,
+               stats->maxLatency * 1e-3);
+    }
+
+    FuzzyServerFree(&server);
+    for (int i = 0; i < numModels; i++) {
+        FuzzyModelFree(&models[i]);
+    }
+    return failed;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file FuzzyTuner.c
+ *
+ * Tunes the membership functions of the Peltier controller model against the
+ * simulated water tank of plant.h and writes the best model and tables back
+ * out.
+ *
+ * The model must have the inputs temperature and temperature change and the
+ * outputs cooler and heater speed, in this order, like PeltierControl.fzm.
+ */
+
+#include "fuzzyc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SAMPLE_PERIOD 6.0
+#define AMBIENT 25.0
+#define TARGET 30.0
+#define STEPS 600
+#define EFFORT_WEIGHT 0.5
+
+// Start temperatures of the simulated runs
+const double startTemperatures[] = {15.0, 20.0, 25.0, 35.0, 40.0, 45.0};
+
+// Mean squared tracking error plus weighted actuator effort over every run
+double trackingCost(const FuzzyModel_t *model, FuzzyContext_t *context,
+                    void *user) {
+    const FuzzyPlantParameters_t *parameters = user;
+    double cost = 0.0;
+
+    for (size_t run = 0; run < FUZZY_LENGTH(startTemperatures); run++) {
+        FuzzyPlantScenario_t scenario = {.start = startTemperatures[run],
+                                         .ambient = AMBIENT,
+                                         .target = TARGET,
+                                         .period = SAMPLE_PERIOD,
+                                         .steps = STEPS,
+                                         .seed = run + 1};
+        FuzzyPlantResult_t result;
+        FuzzyPlantRun(model, context, parameters, &scenario, &result);
+        cost += result.meanSquaredError + EFFORT_WEIGHT * result.effort / 100.0;
+    }
+    return cost / FUZZY_LENGTH(startTemperatures);
+}
+
+// Print the membership functions as DEFINE_FUZZY_MEMBERSHIP tables
+void printTables(const FuzzyModel_t *model) {
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+        printf("#define %sMembershipFunctions(X)", v->name);
+        for (uint32_t j = 0; j < v->numTerms; j++) {
+            MembershipFunction_t mf =
+                FuzzyModelMembershipFunction(model, v->firstTerm + j);
+            printf(" \\\n    X(%s, %.3f, %.3f, %.3f, %.3f, %s)",
+                   model->terms[v->firstTerm + j].name, mf.a, mf.b, mf.c,
+                   mf.d, membershipFunctionName(mf.type));
+        }
+        printf("\nDEFINE_FUZZY_MEMBERSHIP(%sMembershipFunctions)\n\n",
+               v->name);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3 || argc > 5) {
+        printf("Usage: %s <model.fzm> <tuned.fzm> [generations] [threads]\n",
+               argv[0]);
+        return 1;
+    }
+
+    FuzzyModel_t model;
+    FuzzyModelError_t error = {0};
+    if (FuzzyModelLoad(&model, argv[1], &error)) {
+        printf("%s:%d: %s\n", argv[1], error.line, error.message);
+        return 1;
+    }
+    if (model.numInputs != 2 || model.numOutputs != 2) {
+        printf("%s needs 2 inputs and 2 outputs\n", argv[1]);
+        FuzzyModelFree(&model);
+        return 1;
+    }
+
+    FuzzyTunerOptions_t options;
+    FuzzyTunerDefaultOptions(&options);
+    if (argc > 3) {
+        options.generations = atoi(argv[3]);
+    }
+    if (argc > 4) {
+        options.numThreads = atoi(argv[4]);
+    }
+
+    FuzzyPlantParameters_t parameters;
+    FuzzyPlantDefaultParameters(&parameters);
+
+    FuzzyTunerReport_t report;
+    if (FuzzyTune(&model, trackingCost, &parameters, &options, &report)) {
+        printf("Tuning failed\n");
+        FuzzyModelFree(&model);
+        return 1;
+    }
+    printTunerReport(&report);
+    printTables(&model);
+
+    if (FuzzyModelWriteText(&model, argv[2])) {
+        printf("Can not write %s\n", argv[2]);
+        FuzzyModelFree(&model);
+        return 1;
+    }
+    FuzzyModelFree(&model);
+
+    return 0;
+}
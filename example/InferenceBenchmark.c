@@ -0,0 +1,240 @@
+/**
+ * @file InferenceBenchmark.c
+ *
+ * Times one inference cycle of a grid rule base for every operator family,
+ * scanning every rule and only the rules of the active terms, and the grid
+ * alone as rules and as a rule matrix. The original fuzzyInference(), which
+ * resets and normalizes the output once per rule, is timed as a reference
+ * and its outputs are compared with the min/max engine first.
+ *
+ * > InferenceBenchmark [terms]
+ */
+
+#include "fuzzyc.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define TERMS 7
+#define MAX_TERMS 64
+#define CYCLES 1000000L
+
+// Evenly spaced triangles over [0, 100]
+void createTerms(MembershipFunction_t *terms, int numTerms) {
+    double step = 100.0 / (numTerms - 1);
+    for (int i = 0; i < numTerms; i++) {
+        terms[i] = (MembershipFunction_t){
+            .a = (i - 1) * step, .b = i * step, .c = (i + 1) * step,
+            .type = TRIANGULAR};
+    }
+}
+
+// Helper function to get a monotonic time in nanoseconds
+double nowNanoseconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static double referenceMembership(const FuzzyVariable_t *v) {
+    double membership = v->variable->membershipValues[v->value];
+    return v->invert ? 1.0 - membership : membership;
+}
+
+// The inference before FuzzyEngine_t, kept as the baseline to compare with
+void referenceInference(const FuzzyRule_t *rules, int numRules) {
+    for (int i = 0; i < numRules; i++) {
+        rules[i]
+            .consequent.variable->membershipValues[rules[i].consequent.value] =
+            0.0;
+    }
+    for (int i = 0; i < numRules; i++) {
+        const FuzzyRule_t *rule = &rules[i];
+        double membership = 1.0;
+        for (int j = 0; j < rule->num_antecedents; j++) {
+            const FuzzyAntecedent_t *antecedent = &rule->antecedent[j];
+            bool any = antecedent->fuzzy_operator == FUZZY_ANY_OF;
+            double value = any ? 0.0 : 1.0;
+            for (int k = 0; k < antecedent->num_variables; k++) {
+                double m = referenceMembership(&antecedent->variables[k]);
+                value = any ? fmax(value, m) : fmin(value, m);
+            }
+            membership = fmin(membership, value);
+        }
+        double *out = &rule->consequent.variable
+                           ->membershipValues[rule->consequent.value];
+        *out = fmax(*out, membership);
+    }
+    for (int i = 0; i < numRules; i++) {
+        normalizeClass(rules[i].consequent.variable);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int numTerms = argc > 1 ? atoi(argv[1]) : TERMS;
+    if (numTerms < 2 || numTerms > MAX_TERMS) {
+        printf("Usage: %s [terms], 2 to %d terms\n", argv[0], MAX_TERMS);
+        return 1;
+    }
+
+    MembershipFunction_t terms[MAX_TERMS];
+    createTerms(terms, numTerms);
+
+    FuzzySet_t error, change, output;
+    FuzzySetInit(&error, terms, numTerms);
+    FuzzySetInit(&change, terms, numTerms);
+    FuzzySetInit(&output, terms, numTerms);
+
+    // One ALL_OF rule per grid cell plus one ANY_OF rule with a NOT per term
+    int numRules = numTerms * numTerms + numTerms;
+    FuzzyRule_t *rules = malloc(numRules * sizeof(FuzzyRule_t));
+    FuzzyAntecedent_t *antecedents =
+        malloc(numRules * sizeof(FuzzyAntecedent_t));
+    FuzzyVariable_t *variables = malloc(2 * numRules * sizeof(FuzzyVariable_t));
+
+    int n = 0;
+    for (int i = 0; i < numTerms; i++) {
+        for (int j = 0; j < numTerms + 1; j++) {
+            bool any = j == numTerms;
+            int consequent = any ? i : (i + j) / 2;
+            variables[2 * n] = VAR(error, i);
+            variables[2 * n + 1] = any ? NOT(change, i) : VAR(change, j);
+            antecedents[n] = (FuzzyAntecedent_t){
+                .variables = &variables[2 * n],
+                .num_variables = 2,
+                .fuzzy_operator = any ? FUZZY_ANY_OF : FUZZY_ALL_OF};
+            rules[n] = (FuzzyRule_t){.antecedent = &antecedents[n],
+                                     .num_antecedents = 1,
+                                     .consequent = THEN(output, consequent)};
+            n++;
+        }
+    }
+
+    const char *names[] = {"min/max", "product", "lukasiewicz"};
+    const FuzzyOperators_e families[] = {FUZZY_MIN_MAX, FUZZY_PRODUCT,
+                                         FUZZY_LUKASIEWICZ};
+
+    FuzzyEngine_t engine;
+    FuzzyEngineInit(&engine, rules, numRules);
+    FuzzyEngineIndex_t index;
+    FuzzyEngineIndexInit(&index, &engine);
+
+    printf("%d terms, %d rules, %ld cycles\n", numTerms, numRules, CYCLES);
+
+    // The engine must reproduce the reference for every input pair
+    engine.operators = FUZZY_MIN_MAX;
+    int mismatches = 0;
+    double maxDifference = 0.0;
+    double reference[MAX_TERMS];
+    for (int x = 0; x <= 100; x++) {
+        for (int y = 0; y <= 100; y++) {
+            FuzzyClassifier(x, &error);
+            FuzzyClassifier(y, &change);
+            referenceInference(rules, numRules);
+            memcpy(reference, output.membershipValues,
+                   numTerms * sizeof(double));
+            FuzzyEngineInfer(&engine);
+            int differs = 0;
+            for (int t = 0; t < numTerms; t++) {
+                double d = fabs(reference[t] - output.membershipValues[t]);
+                maxDifference = fmax(maxDifference, d);
+                differs |= d > 1e-12;
+            }
+            mismatches += differs;
+        }
+    }
+    // normalizing once per rule instead of once rounds differently
+    printf("reference    %d of %d outputs differ from min/max, "
+           "max difference %.1e\n",
+           mismatches, 101 * 101, maxDifference);
+
+    double checksum = 0.0;
+    double start = nowNanoseconds();
+    for (long cycle = 0; cycle < CYCLES; cycle++) {
+        FuzzyClassifier((cycle * 37) % 101, &error);
+        FuzzyClassifier((cycle * 53) % 101, &change);
+        referenceInference(rules, numRules);
+        checksum += output.membershipValues[cycle % numTerms];
+    }
+    printf("%-12s %-6s %8.1f ns/cycle (checksum %.3f)\n", "reference",
+           "dense", (nowNanoseconds() - start) / CYCLES, checksum);
+
+    for (int f = 0; f < 6; f++) {
+        bool sparse = f >= 3;
+        engine.operators = families[f % 3];
+
+        double checksum = 0.0;
+        double start = nowNanoseconds();
+        for (long cycle = 0; cycle < CYCLES; cycle++) {
+            FuzzyClassifier((cycle * 37) % 101, &error);
+            FuzzyClassifier((cycle * 53) % 101, &change);
+            if (sparse) {
+                FuzzyEngineInferSparse(&engine, &index);
+            } else {
+                FuzzyEngineInfer(&engine);
+            }
+            checksum += output.membershipValues[cycle % numTerms];
+        }
+        double elapsed = nowNanoseconds() - start;
+
+        printf("%-12s %-6s %8.1f ns/cycle (checksum %.3f)\n", names[f % 3],
+               sparse ? "sparse" : "dense", elapsed / CYCLES, checksum);
+    }
+
+    FuzzyEngineIndexFree(&index);
+
+    // The grid cells alone form a complete table, as rules and as a matrix
+    int numCells = numTerms * numTerms;
+    FuzzyRule_t *cellRules = malloc(numCells * sizeof(FuzzyRule_t));
+    int *cells = malloc(numCells * sizeof(int));
+    for (int i = 0, n = 0; i < numRules; i++) {
+        if (rules[i].antecedent->fuzzy_operator == FUZZY_ALL_OF) {
+            cells[n] = rules[i].consequent.value;
+            cellRules[n++] = rules[i];
+        }
+    }
+    FuzzyEngineInit(&engine, cellRules, numCells);
+    FuzzyEngineIndexInit(&index, &engine);
+    FuzzyRuleMatrix_t matrix;
+    FuzzyRuleMatrixInit(&matrix, (FuzzySet_t *[]){&error, &change}, 2,
+                        (FuzzySet_t *[]){&output}, 1, cells);
+
+    printf("\n%d cell table, min/max\n", numCells);
+    const char *methods[] = {"rules", "sparse", "matrix"};
+    for (int m = 0; m < 3; m++) {
+        double checksum = 0.0;
+        double start = nowNanoseconds();
+        for (long cycle = 0; cycle < CYCLES; cycle++) {
+            FuzzyClassifier((cycle * 37) % 101, &error);
+            FuzzyClassifier((cycle * 53) % 101, &change);
+            if (m == 0) {
+                FuzzyEngineInfer(&engine);
+            } else if (m == 1) {
+                FuzzyEngineInferSparse(&engine, &index);
+            } else {
+                FuzzyRuleMatrixInfer(&matrix);
+            }
+            checksum += output.membershipValues[cycle % numTerms];
+        }
+        double elapsed = nowNanoseconds() - start;
+
+        printf("%-12s %8.1f ns/cycle (checksum %.3f)\n", methods[m],
+               elapsed / CYCLES, checksum);
+    }
+
+    FuzzyRuleMatrixFree(&matrix);
+    FuzzyEngineIndexFree(&index);
+    free(cells);
+    free(cellRules);
+    free(variables);
+    free(antecedents);
+    free(rules);
+    FuzzySetFree(&output);
+    FuzzySetFree(&change);
+    FuzzySetFree(&error);
+
+    return 0;
+}
@@ -0,0 +1,151 @@
+/**
+ * @file ModelReload.c
+ *
+ * Runs a fixed rate control loop against a model handle while another thread
+ * reloads and publishes the model as fast as it can, and reports missed
+ * control deadlines.
+ */
+
+#include "fuzzyc.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NSEC_PER_SEC 1000000000L
+
+FuzzyModelHandle_t handle;
+atomic_int running = 1;
+const char *modelPath;
+
+// Helper function to add nanoseconds to a timespec
+void addNanoseconds(struct timespec *t, long ns) {
+    t->tv_nsec += ns;
+    while (t->tv_nsec >= NSEC_PER_SEC) {
+        t->tv_nsec -= NSEC_PER_SEC;
+        t->tv_sec++;
+    }
+}
+
+// Helper function to get the difference between two timespecs in nanoseconds
+long diffNanoseconds(const struct timespec *a, const struct timespec *b) {
+    return (a->tv_sec - b->tv_sec) * NSEC_PER_SEC + (a->tv_nsec - b->tv_nsec);
+}
+
+// Helper function to load a model into a malloc'ed FuzzyModel_t
+FuzzyModel_t *loadModel(const char *path) {
+    FuzzyModelError_t error;
+    FuzzyModel_t *model = malloc(sizeof(FuzzyModel_t));
+    if (model == NULL || FuzzyModelLoad(model, path, &error)) {
+        printf("%s: %s\n", path, error.message);
+        free(model);
+        return NULL;
+    }
+    return model;
+}
+
+// Reload and publish the model in a tight loop
+void *reloader(void *arg) {
+    long *reloads = arg;
+    while (atomic_load(&running)) {
+        FuzzyModel_t *model = loadModel(modelPath);
+        if (model == NULL) {
+            break;
+        }
+        if (FuzzyModelHandlePublish(&handle, model) == 0) {
+            (*reloads)++;
+        } else {
+            FuzzyModelFree(model);
+            free(model);
+        }
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc != 4) {
+        printf("Usage: %s <model.fzm> <period us> <seconds>\n", argv[0]);
+        return 1;
+    }
+    modelPath = argv[1];
+    long period = atol(argv[2]) * 1000L;
+    long cycles = atol(argv[3]) * NSEC_PER_SEC / period;
+
+    FuzzyModel_t *model = loadModel(modelPath);
+    if (model == NULL) {
+        return 1;
+    }
+    // Every model published from the same file fits this context
+    FuzzyContext_t context;
+    FuzzyContextInit(&context, model);
+
+    FuzzyModelHandleInit(&handle, model);
+    int reader = FuzzyModelHandleRegister(&handle);
+
+    // The control loop runs with real-time priority when allowed, like it
+    // would on the target; the reloader stays a normal thread
+    struct sched_param param = {.sched_priority = 50};
+    if (pthread_setschedparam(pthread_self(), SCHED_FIFO, &param) != 0) {
+        printf("Real-time priority not available, deadlines may be missed "
+               "because of scheduling\n");
+    }
+
+    long reloads = 0;
+    pthread_t thread;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    param.sched_priority = 0;
+    pthread_attr_setschedparam(&attr, &param);
+    if (pthread_create(&thread, &attr, reloader, &reloads) != 0) {
+        printf("Can not start the reloader\n");
+        return 1;
+    }
+    pthread_attr_destroy(&attr);
+
+    double inputs[8] = {0};
+    long missed = 0, worst = 0;
+    struct timespec deadline, now;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    for (long cycle = 0; cycle < cycles; cycle++) {
+        addNanoseconds(&deadline, period);
+
+        // One model pointer per control cycle
+        const FuzzyModel_t *current = FuzzyModelHandleAcquire(&handle, reader);
+        inputs[0] = 20.0 + 10.0 * (cycle % 100) / 100.0;
+        inputs[1] = -1.0 + 2.0 * (cycle % 7) / 7.0;
+        if (FuzzyContextFits(&context, current)) {
+            FuzzyModelEvaluate(current, &context, inputs, NULL);
+        }
+        FuzzyModelHandleRelease(&handle, reader);
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        long late = diffNanoseconds(&now, &deadline);
+        if (late > 0) {
+            missed++;
+        }
+        long busy = period + late;
+        if (busy > worst) {
+            worst = busy;
+        }
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+    }
+
+    atomic_store(&running, 0);
+    pthread_join(thread, NULL);
+
+    printf("cycles: %ld, reloads: %ld, reclaimed: %llu\n", cycles, reloads,
+           (unsigned long long)handle.numReclaimed);
+    printf("worst cycle: %.1f us of %.1f us, missed deadlines: %ld\n",
+           worst / 1000.0, period / 1000.0, missed);
+
+    FuzzyContextFree(&context);
+    FuzzyModelHandleDestroy(&handle);
+
+    return missed == 0 ? 0 : 1;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file MonitorView.c
+ *
+ * Watches the live state a controller publishes through a shared memory
+ * monitor, e.g. PeltierControl under /PeltierControl.
+ *
+ * > MonitorView <name> [-i milliseconds] [-n cycles] [-f bars|compact|json]
+ * polls the monitor every interval (100 ms) and prints every new cycle: its
+ * timing, the inputs and outputs with their active terms and the fired rules.
+ * Polling never makes a syscall and never blocks the controller.
+ */
+
+#include "fuzzyc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define INTERVAL_MS 100
+#define READ_ATTEMPTS 100
+#define RENDER_SIZE 8192
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <name> [-i milliseconds] [-n cycles] "
+               "[-f bars|compact|json]\n",
+               argv[0]);
+        return 1;
+    }
+
+    int interval = INTERVAL_MS;
+    long numCycles = 0;
+    FuzzyRenderFormat_e format = FUZZY_RENDER_COMPACT;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-i") == 0) {
+            interval = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-n") == 0) {
+            numCycles = atol(argv[i + 1]);
+        } else if (strcmp(argv[i], "-f") == 0) {
+            format = strcmp(argv[i + 1], "bars") == 0   ? FUZZY_RENDER_BARS
+                     : strcmp(argv[i + 1], "json") == 0 ? FUZZY_RENDER_JSON
+                                                        : FUZZY_RENDER_COMPACT;
+        }
+    }
+
+    FuzzyMonitorReader_t reader;
+    if (FuzzyMonitorOpen(&reader, argv[1])) {
+        printf("No monitor %s\n", argv[1]);
+        return 1;
+    }
+
+    // The renderer sees the names of the segment as a model and the snapshot
+    // as its context
+    FuzzyModel_t names = {.variables = reader.variables,
+                          .terms = reader.terms,
+                          .numVariables = reader.numVariables,
+                          .numTerms = reader.numTerms,
+                          .numInputs = reader.numInputs,
+                          .numOutputs = reader.numOutputs};
+    FuzzyContext_t snapshot = {.memberships = reader.memberships,
+                               .outputs = reader.outputs,
+                               .strengths = reader.strengths};
+    static char text[RENDER_SIZE];
+    FuzzyRender_t render;
+    FuzzyRenderInit(&render, text, sizeof(text), format, FUZZY_RENDER_ACTIVE);
+
+    uint64_t last = 0;
+    long printed = 0;
+    while (numCycles == 0 || printed < numCycles) {
+        if (FuzzyMonitorRead(&reader, READ_ATTEMPTS) == 0 &&
+            reader.cycle.cycle != last) {
+            last = reader.cycle.cycle;
+            printed++;
+
+            time_t seconds = (time_t)reader.cycle.time;
+            struct tm tm;
+            char stamp[32];
+            localtime_r(&seconds, &tm);
+            strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+            printf("cycle %llu [%s] evaluation %.1f us, next in %.0f s%s\n",
+                   (unsigned long long)reader.cycle.cycle, stamp,
+                   reader.cycle.evaluationTime * 1e6, reader.cycle.period,
+                   reader.cycle.fault ? ", SENSOR FAULT" : "");
+
+            FuzzyRenderBegin(&render);
+            FuzzyRenderModel(&render, &names, &snapshot, reader.inputs);
+            FuzzyRenderEnd(&render);
+            fputs(text, stdout);
+
+            printf("rules");
+            for (int r = 0; r < reader.numRules; r++) {
+                if (reader.strengths[r] > 0.0) {
+                    printf(" %d:%.3f", r, reader.strengths[r]);
+                }
+            }
+            printf("\n");
+            fflush(stdout);
+        }
+        usleep(interval * 1000);
+    }
+
+    FuzzyMonitorClose(&reader);
+    return 0;
+}
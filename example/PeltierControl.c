@@ -9,7 +9,10 @@
 #include "unistd.h"
 #include "wiringPi.h"
 
+#include <errno.h>
+#include <fcntl.h>
 #include <math.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,6 +22,8 @@
 #define PWM_RANGE 100
 #define COOLER_PIN 23
 #define HEATER_PIN 24
+// seconds between readings while the temperature is stable
+#define MAX_PERIOD 60.0
 #define SENSOR_PATH "/sys/bus/w1/devices/28-3ce1d4434496/w1_slave"
 
 // MQTT Broker
@@ -34,6 +39,32 @@
 #define TOPIC_ERROR "error"
 #define TOPIC_PELTIER_COOL "cooler"
 #define TOPIC_PELTIER_HEAT "heater"
+// One JSON document per published cycle, also appended to TELEMETRY_PATH
+#define TOPIC_TELEMETRY "telemetry"
+#define TELEMETRY_PATH "Fuzzy_telemetry.jsonl"
+#define TELEMETRY_SIZE 2048
+// Live state for local readers, MonitorView /PeltierControl
+#define MONITOR_NAME "/PeltierControl"
+
+// Diagnostics of every published cycle on stdout, see render.h
+#define DIAGNOSTICS_FORMAT FUZZY_RENDER_COMPACT
+#define DIAGNOSTICS_VERBOSITY FUZZY_RENDER_ACTIVE
+#define DIAGNOSTICS_SIZE 4096
+
+#ifdef FUZZY_TRACE
+// The last cycles are dumped to TRACE_PATH on SIGUSR1, the model they were
+// recorded with to TRACE_MODEL_PATH; TraceDecode prints them
+#define TRACE_PATH "Fuzzy_trace.bin"
+#define TRACE_MODEL_PATH "Fuzzy_trace.fzm"
+#define TRACE_RECORDS 65536
+
+FuzzyTrace_t trace;
+
+void dumpTrace(int signal) {
+    (void)signal;
+    FuzzyTraceDump(&trace, TRACE_PATH);
+}
+#endif
 
 // Define the labels for the fuzzy sets (only used for debugging)
 const char *tempLabels[] = {"VCool", "Cool", "Normal", "Hot"};
@@ -69,6 +100,31 @@ void writeLog(const char *message, float parameter) {
     fclose(f);
 }
 
+// Helper function to sleep a fractional period, resumed after signals
+void sleepSeconds(double seconds) {
+    struct timespec remaining = {
+        .tv_sec = (time_t)seconds,
+        .tv_nsec = (long)((seconds - (time_t)seconds) * 1e9)};
+    while (nanosleep(&remaining, &remaining) != 0 && errno == EINTR) {
+    }
+}
+
+// Helper function to write a buffer completely, resumed after signals
+int writeAll(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t written = write(fd, data, size);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return -1;
+        }
+        data += written;
+        size -= written;
+    }
+    return 0;
+}
+
 // Read sensor temperature
 double get_Temperature(const char *sensor_path) {
 
@@ -94,12 +150,6 @@ double get_Temperature(const char *sensor_path) {
     return temperature;
 }
 
-void setPeltierCoolPower(int coolerPower) {
-    softPwmWrite(COOLER_PIN, coolerPower);
-}
-void setPeltierHeatPower(int heaterPower) {
-    softPwmWrite(HEATER_PIN, heaterPower);
-}
 
 // Define the membership functions for the fuzzy sets
 /*
@@ -134,113 +184,6 @@ DEFINE_FUZZY_MEMBERSHIP(PeltierCoolerSpeedMembershipFunctions)
     X(PELTIER_HEATER_SPEED_MEDIUM, 50.0, 70.0, 80.0, 90.0, TRAPEZOIDAL)        \
     X(PELTIER_HEATER_SPEED_FAST, 85.0, 90.0, 100.0, 125.0, TRAPEZOIDAL)
 DEFINE_FUZZY_MEMBERSHIP(PeltierHeaterSpeedMembershipFunctions)
-// Define the fuzzy rules
-/*
-    >> NEED TO DEFINE THE RULES FOR THE SYSTEM <<
-*/
-FuzzyRule_t rules[] = {
-
-    // Rule 1:
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_VLOW),
-                            VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
-                THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_FAST)),
-
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_VLOW),
-                            VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
-                THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
-
-    // Rule 2:
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_VLOW),
-                            VAR(TempChangeState, TEMP_CHANGE_STABLE))),
-                THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_FAST)),
-
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_VLOW),
-                            VAR(TempChangeState, TEMP_CHANGE_STABLE))),
-                THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
-
-    // Rule 3:
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_VLOW),
-                            VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
-                THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_FAST)),
-
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_VLOW),
-                            VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
-                THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
-    // Rule 4:
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_LOW),
-                            VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
-                THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_FAST)),
-
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_LOW),
-                            VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
-                THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
-
-    // Rule 5:
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_LOW),
-                            VAR(TempChangeState, TEMP_CHANGE_STABLE))),
-                THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_FAST)),
-
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_LOW),
-                            VAR(TempChangeState, TEMP_CHANGE_STABLE))),
-                THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
-
-    // Rule 6:
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_LOW),
-                            VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
-                THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_FAST)),
-
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_LOW),
-                            VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
-                THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
-    // Rule 7:
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
-                            VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
-                THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_SLOW)),
-
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
-                            VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
-                THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
-    // Rule 8:
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
-                            VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
-                THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_OFF)),
-
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
-                            VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
-                THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_SLOW)),
-    // Rule 9:
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
-                            VAR(TempChangeState, TEMP_CHANGE_STABLE))),
-                THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_OFF)),
-
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
-                            VAR(TempChangeState, TEMP_CHANGE_STABLE))),
-                THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
-    // Rule 10:
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_HIGH),
-                            VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
-                THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_OFF)),
-
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_HIGH),
-                            VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
-                THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_MEDIUM)),
-    // Rule 11:
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_HIGH),
-                            VAR(TempChangeState, TEMP_CHANGE_STABLE))),
-                THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_OFF)),
-
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_HIGH),
-                            VAR(TempChangeState, TEMP_CHANGE_STABLE))),
-                THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_MEDIUM)),
-    // Rule 12:
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_HIGH),
-                            VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
-                THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_OFF)),
-
-    PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_HIGH),
-                            VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
-                THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_FAST)),
-};
 
 // Init the fuzzy classifiers
 void createClassifiers() {
@@ -264,6 +207,73 @@ void destroyClassifiers() {
     FuzzySetFree(&PelHeaterSpeed);
 }
 
+// The model outputs follow the first use of their sets in the rules, heater
+// before cooler
+const int actuatorPins[] = {HEATER_PIN, COOLER_PIN};
+const char *actuatorTopics[] = {TOPIC_PELTIER_HEAT, TOPIC_PELTIER_COOL};
+const char *actuatorNames[] = {"Heater Speed", "Cooler Speed"};
+
+// Last raw sensor reading, logged on sensor faults
+double lastReading = -1.0;
+
+// The inputs of the last published cycle, rendered and encoded after the step
+double cycleInputs[2];
+bool published = false;
+
+int readSensor(FuzzyControlIO_t *io, double *value) {
+    (void)io;
+    lastReading = get_Temperature(SENSOR_PATH);
+    *value = lastReading;
+    return lastReading == -1 ? -1 : 0;
+}
+
+void writeActuator(FuzzyControlIO_t *io, int actuator, double value) {
+    (void)io;
+    softPwmWrite(actuatorPins[actuator], value);
+}
+
+// Publish {"topic":value} on a topic
+void publishValue(MQTTClient client, const char *topic, double value) {
+    char msg[64] = "{\"";
+    size_t length = strlen(topic);
+    memcpy(&msg[2], topic, length);
+    length += 2;
+    memcpy(&msg[length], "\":", 2);
+    length += 2;
+    length += FuzzyFormatFixed(&msg[length], value, 2);
+    msg[length++] = '}';
+    MQTTClient_publish(client, topic, length, msg, QOS, 0, NULL);
+}
+
+void publishSignal(FuzzyControlIO_t *io, FuzzyControlSignal_e signal,
+                   int index, double value) {
+    MQTTClient client = io->user;
+
+    switch (signal) {
+    case FUZZY_SIGNAL_VALUE:
+        writeLog("Current Temperature", value);
+        cycleInputs[0] = value;
+        published = true;
+        publishValue(client, TOPIC_TEMP, value);
+        break;
+    case FUZZY_SIGNAL_CHANGE:
+        writeLog("Temperature Change", value);
+        cycleInputs[1] = value;
+        publishValue(client, TOPIC_TEMP_CHANGE, value);
+        break;
+    case FUZZY_SIGNAL_OUTPUT:
+        writeLog(actuatorNames[index], value);
+        publishValue(client, actuatorTopics[index], value);
+        break;
+    case FUZZY_SIGNAL_ERROR:
+        printf("Can not read a temperature sensor.\n");
+        writeLog("Error read a temperature sensor", lastReading);
+        MQTTClient_publish(client, TOPIC_ERROR, strlen("1"), "1", QOS, 0,
+                           NULL);
+        break;
+    }
+}
+
 int main() {
     // MQTT Client ID and credentials
     MQTTClient client;
@@ -291,97 +301,216 @@ int main() {
         printf("WiringPi setup failed!\n");
         return 1;
     }
-
-    int control_enabled = 1;
-    double currentTemperature, previousTemperature = -1.0;
-    double currentTemperatureChange;
     softPwmCreate(COOLER_PIN, 0, PWM_RANGE);
     softPwmCreate(HEATER_PIN, 0, PWM_RANGE);
 
+    // Define the fuzzy rules, they point into compound literals, which are
+    // only constant in function scope
+    /*
+        >> NEED TO DEFINE THE RULES FOR THE SYSTEM <<
+    */
+    FuzzyRule_t rules[] = {
+
+        // Rule 1:
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_VLOW),
+                                VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
+                    THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_FAST)),
+
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_VLOW),
+                                VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
+                    THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
+
+        // Rule 2:
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_VLOW),
+                                VAR(TempChangeState, TEMP_CHANGE_STABLE))),
+                    THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_FAST)),
+
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_VLOW),
+                                VAR(TempChangeState, TEMP_CHANGE_STABLE))),
+                    THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
+
+        // Rule 3:
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_VLOW),
+                                VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
+                    THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_FAST)),
+
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_VLOW),
+                                VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
+                    THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
+        // Rule 4:
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_LOW),
+                                VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
+                    THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_FAST)),
+
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_LOW),
+                                VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
+                    THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
+
+        // Rule 5:
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_LOW),
+                                VAR(TempChangeState, TEMP_CHANGE_STABLE))),
+                    THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_FAST)),
+
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_LOW),
+                                VAR(TempChangeState, TEMP_CHANGE_STABLE))),
+                    THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
+
+        // Rule 6:
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_LOW),
+                                VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
+                    THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_FAST)),
+
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_LOW),
+                                VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
+                    THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
+        // Rule 7:
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
+                                VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
+                    THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_SLOW)),
+
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
+                                VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
+                    THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
+        // Rule 8:
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
+                                VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
+                    THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_OFF)),
+
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
+                                VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
+                    THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_SLOW)),
+        // Rule 9:
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
+                                VAR(TempChangeState, TEMP_CHANGE_STABLE))),
+                    THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_OFF)),
+
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
+                                VAR(TempChangeState, TEMP_CHANGE_STABLE))),
+                    THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_OFF)),
+        // Rule 10:
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_HIGH),
+                                VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
+                    THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_OFF)),
+
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_HIGH),
+                                VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
+                    THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_MEDIUM)),
+        // Rule 11:
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_HIGH),
+                                VAR(TempChangeState, TEMP_CHANGE_STABLE))),
+                    THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_OFF)),
+
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_HIGH),
+                                VAR(TempChangeState, TEMP_CHANGE_STABLE))),
+                    THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_MEDIUM)),
+        // Rule 12:
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_HIGH),
+                                VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
+                    THEN(PelHeaterSpeed, PELTIER_HEATER_SPEED_OFF)),
+
+        PROPOSITION(WHEN(ALL_OF(VAR(TemperatureState, TEMPERATURE_HIGH),
+                                VAR(TempChangeState, TEMP_CHANGE_INCREASING))),
+                    THEN(PelCoolerSpeed, PELTIER_COOLER_SPEED_FAST)),
+    };
+
+    // Compile the rules into a model once, the loop only evaluates it
+    createClassifiers();
+    FuzzyModel_t model;
+    FuzzyModelError_t error = {0};
+    if (FuzzyModelFromRules(&model, rules, FUZZY_LENGTH(rules), &error)) {
+        printf("Can not build the model: %s\n", error.message);
+        return 1;
+    }
+    destroyClassifiers();
+
+    FuzzyContext_t context;
+    if (FuzzyContextInit(&context, &model)) {
+        printf("Can not allocate the context\n");
+        return 1;
+    }
+#ifdef FUZZY_TRACE
+    if (FuzzyTraceInit(&trace, TRACE_RECORDS) == 0 &&
+        FuzzyModelWriteText(&model, TRACE_MODEL_PATH) == 0) {
+        context.trace = &trace;
+        signal(SIGUSR1, dumpTrace);
+    }
+#endif
+
+    FuzzyControlIO_t io = {.read = readSensor,
+                           .write = writeActuator,
+                           .publish = publishSignal,
+                           .user = client};
+    FuzzyController_t controller;
+    if (FuzzyControllerInit(&controller, &model, &context, &io)) {
+        printf("The model does not fit the controller\n");
+        return 1;
+    }
+    // Slow down to one reading a minute while the tank holds its temperature
+    controller.maxPeriod = MAX_PERIOD;
+    controller.valueDeadband = 0.25;
+    controller.changeDeadband = 0.1;
+    controller.outputDeadband = 1.0;
+
+    FuzzyMonitor_t monitor;
+    if (FuzzyMonitorCreate(&monitor, MONITOR_NAME, &model) == 0) {
+        controller.monitor = &monitor;
+    } else {
+        printf("Can not create the monitor %s\n", MONITOR_NAME);
+    }
+
+    static char diagnostics[DIAGNOSTICS_SIZE];
+    FuzzyRender_t render;
+    FuzzyRenderInit(&render, diagnostics, sizeof(diagnostics),
+                    DIAGNOSTICS_FORMAT, DIAGNOSTICS_VERBOSITY);
+
+    // The publisher and the log share the encoded document
+    static char document[TELEMETRY_SIZE];
+    FuzzyTelemetry_t telemetry;
+    FuzzyTelemetryInit(&telemetry, document, sizeof(document),
+                       FUZZY_TELEMETRY_JSON, 2);
+    int telemetryLog =
+        open(TELEMETRY_PATH, O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (telemetryLog < 0) {
+        perror("Can not open " TELEMETRY_PATH);
+    }
+
     while (1) {
-        char temp_msg[50], temp_change_msg[50], cooler_msg[50], heater_msg[50];
-
-        currentTemperature = get_Temperature(SENSOR_PATH);
-        if (currentTemperature != -1 && currentTemperature < 70.0) {
-            control_enabled = 1;
-            writeLog("Current Temperature", currentTemperature);
-            if (previousTemperature != -1) {
-                currentTemperatureChange =
-                    currentTemperature - previousTemperature;
-                writeLog("Temperature Change", currentTemperatureChange);
-            } else {
-                currentTemperatureChange = 0.0;
-                writeLog("Temperature Change", currentTemperatureChange);
+        published = false;
+        FuzzyControllerStep(&controller);
+        if (published) {
+            // the whole cycle in one write
+            FuzzyRenderBegin(&render);
+            FuzzyRenderModel(&render, &model, &context, cycleInputs);
+            FuzzyRenderEnd(&render);
+            fflush(stdout);
+            FuzzyRenderWrite(&render, STDOUT_FILENO);
+
+            struct timespec now;
+            clock_gettime(CLOCK_REALTIME, &now);
+            if (FuzzyTelemetryEncode(&telemetry, &model, &context, cycleInputs,
+                                     now.tv_sec + now.tv_nsec * 1e-9) == 0) {
+                MQTTClient_publish(client, TOPIC_TELEMETRY, telemetry.length,
+                                   document, QOS, 0, NULL);
+                if (telemetryLog >= 0 &&
+                    writeAll(telemetryLog, document, telemetry.length)) {
+                    // stop before more lines land after a torn one
+                    perror("Can not write " TELEMETRY_PATH);
+                    close(telemetryLog);
+                    telemetryLog = -1;
+                }
             }
-            previousTemperature = currentTemperature;
-        } else {
-            control_enabled = 0;
-            printf("Can not read a temperature sensor.\n");
-            writeLog("Error read a temperature sensor", currentTemperature);
-
-            setPeltierCoolPower(0);
-            setPeltierHeatPower(0);
-            MQTTClient_publish(client, TOPIC_ERROR, strlen("1"), "1", QOS, 0,
-                               NULL);
         }
-        // allocate memory
-
-        if (control_enabled) {
-            createClassifiers();
-
-            // Set the input values for the fuzzy classifiers
-            FuzzyClassifier(currentTemperature, &TemperatureState);
-            FuzzyClassifier(currentTemperatureChange, &TempChangeState);
-
-            // Print the input values and their fuzzy membership values
-            printf("Temperature %0.2f degC\n", currentTemperature);
-            printf("Temp Change %0.2f degC/5s \n\n", currentTemperatureChange);
-
-            fuzzyInference(rules, (sizeof(rules) / sizeof(rules[0])));
-
-            printf("Cooler Speed Label \n");
-            printClassifier(&PelCoolerSpeed, peltierSpeedLabels);
-            printf("Heater Speed Label \n");
-            printClassifier(&PelHeaterSpeed, peltierSpeedLabels);
-
-            double output_cooler = defuzzification(&PelCoolerSpeed);
-            double output_heater = defuzzification(&PelHeaterSpeed);
-
-            setPeltierCoolPower(output_cooler);
-            printf("Cooler Speed: %0.2f: \n", output_cooler);
-            setPeltierHeatPower(output_heater);
-            printf("Heater Speed: %0.2f: \n", output_heater);
-
-            printf("\n====MQTT publisher====\n");
-
-            snprintf(temp_msg, sizeof(temp_msg), "{temperature:%.2f}", currentTemperature);
-            MQTTClient_publish(client, TOPIC_TEMP, strlen(temp_msg), temp_msg,
-                               QOS, 0, NULL);
-            printf("temperature: %s degC\n", temp_msg);
-
-            snprintf(temp_change_msg, sizeof(temp_change_msg), "{temperature_change:%.2f}",
-                     currentTemperatureChange);
-            MQTTClient_publish(client, TOPIC_TEMP_CHANGE,
-                               strlen(temp_change_msg), temp_change_msg, QOS, 0,
-                               NULL);
-            printf("temperature_change: %s degC\n", temp_change_msg);
-
-            snprintf(cooler_msg, sizeof(cooler_msg), "{%.2f}", output_cooler);
-            MQTTClient_publish(client, TOPIC_PELTIER_COOL, strlen(cooler_msg),
-                               cooler_msg, QOS, 0, NULL);
-            printf("cooler: %s %\n", cooler_msg);
-            snprintf(heater_msg, sizeof(heater_msg), "{%.2f}", output_heater);
-            MQTTClient_publish(client, TOPIC_PELTIER_HEAT, strlen(heater_msg),
-                               heater_msg, QOS, 0, NULL);
-            printf("heater: %s %\n", heater_msg);
-
-            destroyClassifiers();
-        }
-
-        sleep(5); // Sleep for 30 seconds before the next reading
+        sleepSeconds(controller.period);
+    }
 
+    if (telemetryLog >= 0) {
+        close(telemetryLog);
+    }
+    FuzzyMonitorFree(&monitor);
+    FuzzyContextFree(&context);
+    FuzzyModelFree(&model);
     MQTTClient_disconnect(client, 10000);
     MQTTClient_destroy(&client);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,240 @@
+/**
+ * @file PlantSimulator.c
+ *
+ * Runs the Peltier controller against the simulated water tank.
+ *
+ * > PlantSimulator <model.fzm> [scenarios] [dropout] [-s steps]
+ * >     [-m maxPeriod] [-v valueDeadband] [-c changeDeadband]
+ * >     [-o outputDeadband]
+ * runs random closed loop scenarios in a batch and reports the worst cases and
+ * how many cycles the controller ran. -m and the deadbands let the controller
+ * adapt its rate, -s sets the length of a scenario in sample periods,
+ * > PlantSimulator --fit <model.fzm> <log>...
+ * fits the plant parameters to controller logs. Logs without actuator powers
+ * get them by replaying the model on the logged temperatures.
+ *
+ * The model must have the inputs temperature and temperature change and the
+ * outputs cooler and heater speed, in this order, like PeltierControl.fzm.
+ */
+
+#include "fuzzyc.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define SAMPLE_PERIOD 5.0
+// one hour of control
+#define STEPS 720
+
+// Uniform in [low, high)
+double uniform(uint64_t *state, double low, double high) {
+    *state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return low + (high - low) * ((*state >> 11) * 0x1.0p-53);
+}
+
+// Fill in missing actuator powers with what the model would have set
+void replay(const FuzzyModel_t *model, FuzzyContext_t *context,
+            FuzzyPlantSample_t *samples, int numSamples) {
+    for (int i = 0; i < numSamples; i++) {
+        if (!isnan(samples[i].cooler) && !isnan(samples[i].heater)) {
+            continue;
+        }
+        double inputs[2] = {samples[i].temperature, 0.0};
+        if (i > 0) {
+            inputs[1] = samples[i].temperature - samples[i - 1].temperature;
+        }
+        FuzzyModelEvaluate(model, context, inputs, NULL);
+        samples[i].cooler = context->outputs[0];
+        samples[i].heater = context->outputs[1];
+    }
+}
+
+int fit(const FuzzyModel_t *model, FuzzyContext_t *context, int numLogs,
+        char *logs[]) {
+    FuzzyPlantSample_t *all = NULL;
+    int total = 0;
+
+    for (int i = 0; i < numLogs; i++) {
+        FuzzyPlantSample_t *samples;
+        int numSamples;
+        if (FuzzyPlantLoadLog(logs[i], &samples, &numSamples)) {
+            printf("Can not read %s\n", logs[i]);
+            free(all);
+            return 1;
+        }
+        replay(model, context, samples, numSamples);
+
+        FuzzyPlantSample_t *grown =
+            realloc(all, (total + numSamples) * sizeof(FuzzyPlantSample_t));
+        if (grown == NULL) {
+            free(samples);
+            free(all);
+            return 1;
+        }
+        all = grown;
+        memcpy(all + total, samples, numSamples * sizeof(FuzzyPlantSample_t));
+        total += numSamples;
+        free(samples);
+        printf("%s: %d samples\n", logs[i], numSamples);
+    }
+
+    FuzzyPlantParameters_t parameters;
+    FuzzyPlantDefaultParameters(&parameters);
+    int result = FuzzyPlantFit(&parameters, all, total);
+    free(all);
+    if (result) {
+        printf("The logs do not determine a stable plant\n");
+        return 1;
+    }
+
+    printf("ambient          %.3f\n", parameters.ambient);
+    printf("timeConstant     %.1f\n", parameters.timeConstant);
+    printf("heatingRate      %.5f\n", parameters.heatingRate);
+    printf("coolingRate      %.5f\n", parameters.coolingRate);
+    printf("jouleRate        %.5f\n", parameters.jouleRate);
+    return 0;
+}
+
+int batch(const FuzzyModel_t *model, FuzzyContext_t *context,
+          int numScenarios, double dropout,
+          const FuzzyPlantScenario_t *options) {
+    FuzzyPlantParameters_t parameters;
+    FuzzyPlantDefaultParameters(&parameters);
+    parameters.sensorDropout = dropout;
+
+    FuzzyPlantScenario_t *scenarios =
+        malloc(numScenarios * sizeof(FuzzyPlantScenario_t));
+    FuzzyPlantResult_t *results =
+        malloc(numScenarios * sizeof(FuzzyPlantResult_t));
+    if (scenarios == NULL || results == NULL) {
+        free(scenarios);
+        free(results);
+        return 1;
+    }
+
+    uint64_t state = 42;
+    for (int i = 0; i < numScenarios; i++) {
+        scenarios[i] = *options;
+        scenarios[i].start = uniform(&state, 5.0, 55.0);
+        scenarios[i].ambient = uniform(&state, 10.0, 40.0);
+        scenarios[i].seed = i + 1;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (FuzzyPlantRunBatch(model, context, &parameters, scenarios,
+                           numScenarios, results)) {
+        printf("The model does not fit the controller\n");
+        free(scenarios);
+        free(results);
+        return 1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    int worst = 0, faults = 0;
+    long cycles = 0, messages = 0;
+    double meanError = 0.0, effort = 0.0;
+    for (int i = 0; i < numScenarios; i++) {
+        if (results[i].meanSquaredError > results[worst].meanSquaredError) {
+            worst = i;
+        }
+        meanError += results[i].meanSquaredError;
+        effort += results[i].effort;
+        faults += results[i].sensorFaults;
+        cycles += results[i].cycles;
+        messages += results[i].messages;
+    }
+
+    printf("%d scenarios of %d steps in %.3f s (%.0f scenarios/s)\n",
+           numScenarios, options->steps, seconds, numScenarios / seconds);
+    printf("%.1f cycles and %.1f messages per scenario\n",
+           (double)cycles / numScenarios, (double)messages / numScenarios);
+    printf("mean squared error %.3f, mean effort %.2f %%, %d sensor faults\n",
+           meanError / numScenarios, effort / numScenarios, faults);
+    printf("worst: start %.2f ambient %.2f -> final %.2f range [%.2f, %.2f] "
+           "mse %.3f\n",
+           scenarios[worst].start, scenarios[worst].ambient,
+           results[worst].finalTemperature, results[worst].minimum,
+           results[worst].maximum, results[worst].meanSquaredError);
+
+    free(scenarios);
+    free(results);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    bool fitting = argc > 1 && strcmp(argv[1], "--fit") == 0;
+    FuzzyPlantScenario_t options = {
+        .target = 30.0, .period = SAMPLE_PERIOD, .steps = STEPS};
+    char *positional[2];
+    int numPositional = 0;
+    bool valid = fitting ? argc >= 4 : argc >= 2;
+    for (int i = 2; !fitting && valid && i < argc; i++) {
+        if (argv[i][0] != '-') {
+            valid = numPositional < 2;
+            if (valid) {
+                positional[numPositional++] = argv[i];
+            }
+            continue;
+        }
+        if (i + 1 >= argc) {
+            valid = false;
+        } else if (strcmp(argv[i], "-s") == 0) {
+            options.steps = atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "-m") == 0) {
+            options.maxPeriod = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "-v") == 0) {
+            options.valueDeadband = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "-c") == 0) {
+            options.changeDeadband = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "-o") == 0) {
+            options.outputDeadband = atof(argv[i + 1]);
+        } else {
+            valid = false;
+        }
+        i++;
+    }
+    if (!valid) {
+        printf("Usage: %s <model.fzm> [scenarios] [dropout] [-s steps] "
+               "[-m maxPeriod]\n"
+               "           [-v valueDeadband] [-c changeDeadband] "
+               "[-o outputDeadband]\n"
+               "       %s --fit <model.fzm> <log>...\n",
+               argv[0], argv[0]);
+        return 1;
+    }
+    const char *path = argv[fitting ? 2 : 1];
+
+    FuzzyModel_t model;
+    FuzzyModelError_t error = {0};
+    if (FuzzyModelLoad(&model, path, &error)) {
+        printf("%s:%d: %s\n", path, error.line, error.message);
+        return 1;
+    }
+    FuzzyContext_t context;
+    if (model.numInputs != 2 || model.numOutputs != 2 ||
+        FuzzyContextInit(&context, &model)) {
+        printf("%s needs 2 inputs and 2 outputs\n", path);
+        FuzzyModelFree(&model);
+        return 1;
+    }
+
+    int result;
+    if (fitting) {
+        result = fit(&model, &context, argc - 3, argv + 3);
+    } else {
+        result = batch(&model, &context,
+                       numPositional > 0 ? atoi(positional[0]) : 1000,
+                       numPositional > 1 ? atof(positional[1]) : 0.0,
+                       &options);
+    }
+
+    FuzzyContextFree(&context);
+    FuzzyModelFree(&model);
+    return result;
+}
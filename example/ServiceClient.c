@@ -0,0 +1,198 @@
+/**
+ * @file ServiceClient.c
+ *
+ * Load generator and check for FuzzyService.
+ *
+ * > ServiceClient <socket> <name> [-n batches] [-r rows] [-d depth] [-s]
+ * >               [-c model]
+ * sends batches of rows (1000) of random inputs to the model hosted under
+ * name, keeping up to depth (16) requests in flight, and prints the
+ * throughput and the latency distribution, both measured by the client and
+ * reported by the server. With -s the batches go through the shared memory
+ * ring instead of the socket. With -c every output is compared to a local
+ * evaluation of the same model.
+ */
+
+#include "fuzzyc.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define RING_SIZE (64u << 20)
+
+static int compareLatency(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+static void printLatency(const char *what, uint64_t *latencies, long n) {
+    qsort(latencies, n, sizeof(uint64_t), compareLatency);
+    printf("%s: p50 %.1f us, p99 %.1f us, max %.1f us\n", what,
+           latencies[n / 2] * 1e-3, latencies[n * 99 / 100] * 1e-3,
+           latencies[n - 1] * 1e-3);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3) {
+        printf("Usage: %s <socket> <name> [-n batches] [-r rows] [-d depth] "
+               "[-s] [-c model]\n",
+               argv[0]);
+        return 1;
+    }
+
+    long numBatches = 1000;
+    size_t rows = 1000;
+    uint32_t depth = 16;
+    int shared = 0;
+    const char *check = NULL;
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], "-s") == 0) {
+            shared = 1;
+        } else if (i + 1 < argc && strcmp(argv[i], "-n") == 0) {
+            numBatches = atol(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-r") == 0) {
+            rows = atol(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-d") == 0) {
+            depth = atoi(argv[++i]);
+        } else if (i + 1 < argc && strcmp(argv[i], "-c") == 0) {
+            check = argv[++i];
+        }
+    }
+    if (numBatches < 1 || rows < 1 || depth < 1 ||
+        depth > FUZZY_SERVICE_MAX_PENDING) {
+        printf("Invalid batches, rows or depth\n");
+        return 1;
+    }
+
+    static FuzzyServiceClient_t client;
+    FuzzyServiceModel_t info;
+    if (FuzzyServiceConnect(&client, argv[1], shared ? RING_SIZE : 0)) {
+        perror(argv[1]);
+        return 1;
+    }
+    if (FuzzyServiceOpen(&client, argv[2], &info)) {
+        perror(argv[2]);
+        FuzzyServiceClose(&client);
+        return 1;
+    }
+    printf("%s: %u inputs, %u outputs, %u rules\n", argv[2], info.numInputs,
+           info.numOutputs, info.numRules);
+
+    // one set of random rows, sent by every batch
+    double *inputs = malloc(rows * info.numInputs * sizeof(double));
+    double *outputs = malloc(rows * info.numOutputs * sizeof(double));
+    double *expected = NULL;
+    uint64_t *roundTrips = malloc(numBatches * sizeof(uint64_t));
+    uint64_t *latencies = malloc(numBatches * sizeof(uint64_t));
+    if (inputs == NULL || outputs == NULL || roundTrips == NULL ||
+        latencies == NULL) {
+        printf("Out of memory\n");
+        return 1;
+    }
+    srand(1);
+    for (size_t i = 0; i < rows * info.numInputs; i++) {
+        inputs[i] = -10.0 + 120.0 * rand() / RAND_MAX;
+    }
+
+    if (check != NULL) {
+        FuzzyModel_t model;
+        FuzzyContext_t context;
+        FuzzyModelError_t error;
+        if (FuzzyModelMapImage(&model, check, 0, &error) &&
+            FuzzyModelLoad(&model, check, &error)) {
+            printf("%s: %s\n", check, error.message);
+            return 1;
+        }
+        expected = malloc(rows * info.numOutputs * sizeof(double));
+        if (expected == NULL || FuzzyContextInit(&context, &model)) {
+            printf("Out of memory\n");
+            return 1;
+        }
+        for (size_t i = 0; i < rows; i++) {
+            FuzzyModelEvaluate(&model, &context, &inputs[i * info.numInputs],
+                               &expected[i * info.numOutputs]);
+        }
+        FuzzyContextFree(&context);
+        FuzzyModelFree(&model);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    long sent = 0, received = 0, errors = 0, mismatches = 0;
+    FuzzyServiceBatch_t batch;
+    int begun = 0;
+    while (received < numBatches) {
+        // keep the pipeline full, then wait for the oldest reply
+        if (sent < numBatches && sent - received < depth) {
+            int id;
+            if (shared) {
+                if (!begun) {
+                    if (FuzzyServiceBegin(&client, info.model, rows,
+                                          &batch) == 0) {
+                        memcpy(batch.inputs, inputs,
+                               rows * info.numInputs * sizeof(double));
+                        begun = 1;
+                    } else if (errno != EAGAIN) {
+                        perror("begin");
+                        return 1;
+                    }
+                }
+                id = begun ? FuzzyServiceSubmit(&client, &batch) : -1;
+                begun = begun && id < 0;
+            } else {
+                id = FuzzyServiceEvaluate(&client, info.model, inputs, rows);
+            }
+            if (id >= 0) {
+                sent++;
+                continue;
+            }
+            if (errno != EAGAIN) {
+                perror("send");
+                return 1;
+            }
+        }
+
+        FuzzyServiceReply_t reply;
+        if (FuzzyServiceReceive(&client, &reply, outputs,
+                                rows * info.numOutputs)) {
+            perror("receive");
+            return 1;
+        }
+        roundTrips[received] = reply.roundTrip;
+        latencies[received] = reply.latency;
+        received++;
+        if (reply.status != 0) {
+            errors++;
+        } else if (expected != NULL) {
+            const double *values = shared ? reply.outputs : outputs;
+            mismatches += memcmp(values, expected, rows * info.numOutputs *
+                                                       sizeof(double)) != 0;
+        }
+        FuzzyServiceRelease(&client, &reply);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double seconds =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    printf("%ld batches of %zu rows %s in %.3f s, %.0f rows/s, %ld errors",
+           numBatches, rows, shared ? "through the ring" : "inline", seconds,
+           numBatches * rows / seconds, errors);
+    if (expected != NULL) {
+        printf(", %ld mismatches", mismatches);
+    }
+    printf("\n");
+    printLatency("round trip", roundTrips, numBatches);
+    printLatency("server", latencies, numBatches);
+
+    free(inputs);
+    free(outputs);
+    free(expected);
+    free(roundTrips);
+    free(latencies);
+    FuzzyServiceClose(&client);
+    return errors != 0 || mismatches != 0;
+}
@@ -1,10 +1,35 @@
-
+/**
+ * @file TecFanControl.c
+ *
+ * Fan speed of a TEC cooled enclosure from its temperature, the temperature
+ * change, the TEC power and the current fan state.
+ *
+ * > TecFanControl <temperature> <change> <tecPower> <fan>
+ * evaluates one input vector and prints the memberships as bar charts.
+ *
+ * > TecFanControl --stream [-b] [-m] [file]
+ * evaluates every input vector of a file, mapped, or of stdin in one loop and
+ * writes the fan speeds as a column, with -m followed by the memberships of
+ * the fan speed terms. Vectors are CSV lines of four values (lines that are
+ * not, like a header, are skipped) or with -b packed native doubles. The
+ * throughput is reported on stderr.
+ */
 
 #include "fuzzyc.h"
 
+#include <fcntl.h>
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_INPUTS 4
+#define LINE_LENGTH 256
+#define OUTPUT_SIZE 65536
 
 // Define the labels for the fuzzy sets (only used for debugging)
 const char *lmhLabels[] = {"Low", "Medium", "High"};
@@ -52,67 +77,6 @@ DEFINE_FUZZY_MEMBERSHIP(FanStateMembershipFunctions)
     X(FAN_SPEED_FAST, 60.0, 65.0, 100.0, 100.0, TRAPEZOIDAL)
 DEFINE_FUZZY_MEMBERSHIP(FanSpeedMembershipFunctions)
 
-// Define the fuzzy rulesQ
-FuzzyRule_t rules[] = {
-    // Rule 1: Turn on the fan at high speed when it's off and the temperature
-    // is high or the TEC heat load is high
-    PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_OFF)),
-                     ANY_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
-                            VAR(TemperatureState, TEMPERATURE_HIGH),
-                            VAR(TECPowerState, TEC_POWER_HIGH))),
-                THEN(FanSpeed, FAN_SPEED_FAST)),
-
-    // Rule 2: Keep the fan off when it's already off and the temperature is low
-    // and stable or decreasing
-    PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_OFF),
-                            VAR(TemperatureState, TEMPERATURE_LOW)),
-                     ANY_OF(VAR(TempChangeState, TEMP_CHANGE_STABLE),
-                            VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
-                THEN(FanSpeed, FAN_SPEED_OFF)),
-
-    // Rule 3: Turn off the fan when it's on and the TEC power is low, and the
-    // temperature is stable or decreasing
-    PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_ON),
-                            VAR(TECPowerState, TEC_POWER_LOW)),
-                     ANY_OF(VAR(TempChangeState, TEMP_CHANGE_STABLE),
-                            VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
-                THEN(FanSpeed, FAN_SPEED_OFF)),
-
-    // Rule 4: Set the fan speed to medium when it's on and the temperature is
-    // medium, but the TEC power is not high
-    PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_ON),
-                            VAR(TemperatureState, TEMPERATURE_MEDIUM),
-                            NOT(TECPowerState, TEC_POWER_HIGH))),
-                THEN(FanSpeed, FAN_SPEED_MEDIUM)),
-
-    // Rule 5: Turn on the fan at high speed when it's on and the temperature is
-    // high, and the TEC power is not low
-    PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_ON),
-                            VAR(TemperatureState, TEMPERATURE_HIGH)),
-                     ANY_OF(VAR(TECPowerState, TEC_POWER_MEDIUM),
-                            VAR(TECPowerState, TEC_POWER_LOW))),
-                THEN(FanSpeed, FAN_SPEED_FAST)),
-
-    // Rule 6: Turn off the fan when it's on, the TEC power is low, and the
-    // temperature is low
-    PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_ON),
-                            VAR(TECPowerState, TEC_POWER_LOW),
-                            VAR(TemperatureState, TEMPERATURE_LOW))),
-                THEN(FanSpeed, FAN_SPEED_OFF)),
-
-    // Rule 7: Set the fan speed to medium when it's on and the TEC power is
-    // medium
-    PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_ON),
-                            VAR(TECPowerState, TEC_POWER_MEDIUM))),
-                THEN(FanSpeed, FAN_SPEED_MEDIUM)),
-
-    // Rule 8: Turn on the fan at high speed when it's on and the TEC power is
-    // high
-    PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_ON),
-                            VAR(TECPowerState, TEC_POWER_HIGH))),
-                THEN(FanSpeed, FAN_SPEED_FAST)),
-};
-
 // Helper function to create the fuzzy classifiers
 void createClassifiers() {
     FuzzySetInit(&TemperatureState, TemperatureMembershipFunctions,
@@ -144,56 +108,307 @@ double map_range(double value, double in_min, double in_max, double out_min,
     return fmin(fmax(mapped, out_min), out_max);
 }
 
+// Evaluate one input vector, returns the fan speed in percent
+double evaluate(const FuzzyEngine_t *engine, const double *inputs) {
+    FuzzyClassifier(inputs[0], &TemperatureState);
+    FuzzyClassifier(inputs[1], &TempChangeState);
+    FuzzyClassifier(inputs[2], &TECPowerState);
+    FuzzyClassifier(inputs[3], &FanState);
+
+    FuzzyEngineInfer(engine);
+
+    // extreme points (0, 100) can't be reached due to the centroid
+    // calculation
+    return map_range(defuzzification(&FanSpeed), 10.0, 80.0, 0.0, 100.0);
+}
+
+// Input vectors from a mapped file or a stream
+typedef struct {
+    FILE *stream;
+    const char *data;
+    size_t size;
+    size_t offset;
+    bool binary;
+    long skipped;
+} VectorSource_t;
+
+int openSource(VectorSource_t *source, const char *path, bool binary) {
+    memset(source, 0, sizeof(*source));
+    source->binary = binary;
+    if (path == NULL) {
+        source->stream = stdin;
+        return 0;
+    }
+
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    if (st.st_size > 0) {
+        source->data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (source->data == MAP_FAILED) {
+            close(fd);
+            return -1;
+        }
+        source->size = st.st_size;
+        madvise((void *)source->data, source->size, MADV_SEQUENTIAL);
+    }
+    close(fd);
+    return 0;
+}
+
+void closeSource(VectorSource_t *source) {
+    if (source->data != NULL) {
+        munmap((void *)source->data, source->size);
+    }
+}
+
+// Parse NUM_INPUTS numbers separated by commas, semicolons or blanks
+int parseVector(const char *line, double *vector) {
+    const char *p = line;
+    for (int i = 0; i < NUM_INPUTS; i++) {
+        while (*p == ',' || *p == ';' || *p == ' ' || *p == '\t') {
+            p++;
+        }
+        char *end;
+        vector[i] = strtod(p, &end);
+        if (end == p) {
+            return -1;
+        }
+        p = end;
+    }
+    return 0;
+}
+
+// Read the next line into line, returns 0 at the end of the input
+int nextLine(VectorSource_t *source, char *line) {
+    if (source->stream != NULL) {
+        return fgets(line, LINE_LENGTH, source->stream) != NULL;
+    }
+    if (source->offset >= source->size) {
+        return 0;
+    }
+    const char *start = source->data + source->offset;
+    size_t remaining = source->size - source->offset;
+    const char *newline = memchr(start, '\n', remaining);
+    size_t length = newline != NULL ? (size_t)(newline - start) + 1 : remaining;
+    source->offset += length;
+    if (length >= LINE_LENGTH) {
+        length = LINE_LENGTH - 1;
+    }
+    memcpy(line, start, length);
+    line[length] = '\0';
+    return 1;
+}
+
+// Read the next input vector, returns 0 at the end of the input
+int nextVector(VectorSource_t *source, double *vector) {
+    if (source->binary) {
+        size_t size = NUM_INPUTS * sizeof(double);
+        if (source->stream != NULL) {
+            return fread(vector, size, 1, source->stream) == 1;
+        }
+        if (source->offset + size > source->size) {
+            return 0;
+        }
+        memcpy(vector, source->data + source->offset, size);
+        source->offset += size;
+        return 1;
+    }
+
+    char line[LINE_LENGTH];
+    while (nextLine(source, line)) {
+        if (parseVector(line, vector) == 0) {
+            return 1;
+        }
+        if (line[strspn(line, " \t\r\n")] != '\0') {
+            source->skipped++;
+        }
+    }
+    return 0;
+}
+
+// Evaluate every vector of a source, write the speeds and report throughput
+int stream(const FuzzyEngine_t *engine, VectorSource_t *source,
+           bool memberships) {
+    static char output[OUTPUT_SIZE];
+    size_t length = 0;
+    long numVectors = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    double vector[NUM_INPUTS];
+    while (nextVector(source, vector)) {
+        double fanSpeed = evaluate(engine, vector);
+        numVectors++;
+
+        // room for the speed and every membership
+        if (length + (FanSpeed.length + 1) * FUZZY_FIXED_LENGTH > OUTPUT_SIZE) {
+            fwrite(output, 1, length, stdout);
+            length = 0;
+        }
+        length += FuzzyFormatFixed(&output[length], fanSpeed, 4);
+        for (int i = 0; memberships && i < FanSpeed.length; i++) {
+            output[length++] = ',';
+            length += FuzzyFormatFixed(&output[length],
+                                       FanSpeed.membershipValues[i], 4);
+        }
+        output[length++] = '\n';
+    }
+    fwrite(output, 1, length, stdout);
+    fflush(stdout);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) * 1e-9;
+    fprintf(stderr, "%ld vectors in %.3f s, %.0f vectors/s", numVectors,
+            seconds, seconds > 0.0 ? numVectors / seconds : 0.0);
+    if (source->skipped > 0) {
+        fprintf(stderr, ", %ld lines skipped", source->skipped);
+    }
+    fprintf(stderr, "\n");
+    return 0;
+}
+
 int main(int argc, char *argv[]) {
+    bool streaming = argc > 1 && strcmp(argv[1], "--stream") == 0;
     // Check if the correct number of command line arguments are provided
-    if (argc != 5) {
+    if (!streaming && argc != 5) {
         printf("Usage: %s <currentTemperature> <currentTemperatureChange> "
-               "<currentTECPower> <currentFan>\n",
-               argv[0]);
+               "<currentTECPower> <currentFan>\n"
+               "       %s --stream [-b] [-m] [file]\n",
+               argv[0], argv[0]);
         return 1;
     }
 
+    // The rules point into compound literals, which are only constant in
+    // function scope
+    FuzzyRule_t rules[] = {
+        // Rule 1: Turn on the fan at high speed when it's off and the
+        // temperature is high or the TEC heat load is high
+        PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_OFF)),
+                         ANY_OF(VAR(TemperatureState, TEMPERATURE_MEDIUM),
+                                VAR(TemperatureState, TEMPERATURE_HIGH),
+                                VAR(TECPowerState, TEC_POWER_HIGH))),
+                    THEN(FanSpeed, FAN_SPEED_FAST)),
+
+        // Rule 2: Keep the fan off when it's already off and the temperature is
+        // low and stable or decreasing
+        PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_OFF),
+                                VAR(TemperatureState, TEMPERATURE_LOW)),
+                         ANY_OF(VAR(TempChangeState, TEMP_CHANGE_STABLE),
+                                VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
+                    THEN(FanSpeed, FAN_SPEED_OFF)),
+
+        // Rule 3: Turn off the fan when it's on and the TEC power is low, and
+        // the temperature is stable or decreasing
+        PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_ON),
+                                VAR(TECPowerState, TEC_POWER_LOW)),
+                         ANY_OF(VAR(TempChangeState, TEMP_CHANGE_STABLE),
+                                VAR(TempChangeState, TEMP_CHANGE_DECREASING))),
+                    THEN(FanSpeed, FAN_SPEED_OFF)),
+
+        // Rule 4: Set the fan speed to medium when it's on and the temperature
+        // is medium, but the TEC power is not high
+        PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_ON),
+                                VAR(TemperatureState, TEMPERATURE_MEDIUM),
+                                NOT(TECPowerState, TEC_POWER_HIGH))),
+                    THEN(FanSpeed, FAN_SPEED_MEDIUM)),
+
+        // Rule 5: Turn on the fan at high speed when it's on and the
+        // temperature is high, and the TEC power is not low
+        PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_ON),
+                                VAR(TemperatureState, TEMPERATURE_HIGH)),
+                         ANY_OF(VAR(TECPowerState, TEC_POWER_MEDIUM),
+                                VAR(TECPowerState, TEC_POWER_LOW))),
+                    THEN(FanSpeed, FAN_SPEED_FAST)),
+
+        // Rule 6: Turn off the fan when it's on, the TEC power is low, and the
+        // temperature is low
+        PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_ON),
+                                VAR(TECPowerState, TEC_POWER_LOW),
+                                VAR(TemperatureState, TEMPERATURE_LOW))),
+                    THEN(FanSpeed, FAN_SPEED_OFF)),
+
+        // Rule 7: Set the fan speed to medium when it's on and the TEC power is
+        // medium
+        PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_ON),
+                                VAR(TECPowerState, TEC_POWER_MEDIUM))),
+                    THEN(FanSpeed, FAN_SPEED_MEDIUM)),
+
+        // Rule 8: Turn on the fan at high speed when it's on and the TEC power
+        // is high
+        PROPOSITION(WHEN(ALL_OF(VAR(FanState, FAN_STATE_ON),
+                                VAR(TECPowerState, TEC_POWER_HIGH))),
+                    THEN(FanSpeed, FAN_SPEED_FAST)),
+    };
+
+    // Allocate memory, the sets and the engine serve every evaluation
+    createClassifiers();
+    FuzzyEngine_t engine;
+    if (FuzzyEngineInit(&engine, rules, FUZZY_LENGTH(rules))) {
+        printf("Can not bind the rules\n");
+        destroyClassifiers();
+        return 1;
+    }
+
+    if (streaming) {
+        bool binary = false;
+        bool memberships = false;
+        const char *path = NULL;
+        for (int i = 2; i < argc; i++) {
+            if (strcmp(argv[i], "-b") == 0) {
+                binary = true;
+            } else if (strcmp(argv[i], "-m") == 0) {
+                memberships = true;
+            } else {
+                path = argv[i];
+            }
+        }
+
+        VectorSource_t source;
+        if (openSource(&source, path, binary)) {
+            printf("Can not open %s\n", path);
+            destroyClassifiers();
+            return 1;
+        }
+        int result = stream(&engine, &source, memberships);
+        closeSource(&source);
+        destroyClassifiers();
+        return result;
+    }
+
     // Convert command line arguments to double
     double currentTemperature = atof(argv[1]);
     double currentTemperatureChange = atof(argv[2]);
     double currentTECPower = atof(argv[3]);
     double currentFan = atof(argv[4]);
-
-    // Allocate memory
-    createClassifiers();
-
-    // Classify the inputs
-    FuzzyClassifier(currentTemperature, &TemperatureState);
-    FuzzyClassifier(currentTemperatureChange, &TempChangeState);
-    FuzzyClassifier(currentTECPower, &TECPowerState);
-    FuzzyClassifier(currentFan, &FanState);
-
-    // Print the input class memberships
-    printf("Temperature %.04f degC\n", currentTemperature);
-    printClassifier(&TemperatureState, lmhLabels);
-    printf("Temp Change %.04f degC/sec\n", currentTemperatureChange);
-    printClassifier(&TempChangeState, changeLabels);
-    printf("TEC Power %.04f W\n", currentTECPower);
-    printClassifier(&TECPowerState, lmhLabels);
-    printf("Fan State %.04f %%\n", currentFan);
-    printClassifier(&FanState, fanLabels);
-
-    // Perform fuzzy inference
-    fuzzyInference(rules, (sizeof(rules) / sizeof(rules[0])));
-
-    // Print the output class membership
-    printf("Fan Speed\n");
-    printClassifier(&FanSpeed, fanSpeedLabels);
-
-    // Defuzzify the output
-    double fanSpeed = defuzzification(&FanSpeed);
-    // extreme points (0, 100) can't be reached due to the centroid
-    // calculation
-    fanSpeed = map_range(fanSpeed, 10.0, 80.0, 0.0, 100.0);
-
-
-    // Print the result
-    printf("Fan Speed: %.04f %%\n", fanSpeed);
+    double inputs[NUM_INPUTS] = {currentTemperature, currentTemperatureChange,
+                                 currentTECPower, currentFan};
+
+    // Classify the inputs, perform fuzzy inference and defuzzify the output
+    double fanSpeed = evaluate(&engine, inputs);
+
+    // Print the class memberships and the result in one write
+    char diagnostics[4096];
+    FuzzyRender_t render;
+    FuzzyRenderInit(&render, diagnostics, sizeof(diagnostics),
+                    FUZZY_RENDER_BARS, FUZZY_RENDER_ALL);
+    FuzzyRenderBegin(&render);
+    FuzzyRenderSet(&render, "Temperature", currentTemperature,
+                   &TemperatureState, lmhLabels);
+    FuzzyRenderSet(&render, "Temp Change", currentTemperatureChange,
+                   &TempChangeState, changeLabels);
+    FuzzyRenderSet(&render, "TEC Power", currentTECPower, &TECPowerState,
+                   lmhLabels);
+    FuzzyRenderSet(&render, "Fan State", currentFan, &FanState, fanLabels);
+    FuzzyRenderSet(&render, "Fan Speed", fanSpeed, &FanSpeed, fanSpeedLabels);
+    FuzzyRenderEnd(&render);
+    FuzzyRenderWrite(&render, STDOUT_FILENO);
 
     // Cleanup memory
     destroyClassifiers();
@@ -0,0 +1,148 @@
+/**
+ * @file TelemetryBenchmark.c
+ *
+ * Times the telemetry of one control cycle: the per-topic snprintf payloads
+ * PeltierControl used to publish against one JSON and one CBOR document, and
+ * FuzzyFormatFixed() against snprintf("%.2f") for single values.
+ *
+ * > TelemetryBenchmark <model.fzm> [cycles]
+ * also counts the values FuzzyFormatFixed() formats differently from
+ * snprintf: negative values that round to zero, which printf writes as -0,
+ * and values exactly between two outputs.
+ */
+
+#include "fuzzyc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define CYCLES 1000000L
+#define NUM_CONTEXTS 256
+#define NUM_VALUES 4096
+#define DOCUMENT_SIZE 2048
+
+// Helper function to get a monotonic time in nanoseconds
+double nowNanoseconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+// One 50 byte payload per variable, "{name:%.2f}" like the MQTT topics
+size_t snprintfPayloads(const FuzzyModel_t *model,
+                        const FuzzyContext_t *context, const double *inputs) {
+    size_t total = 0;
+    int input = 0;
+    int output = 0;
+    for (int i = 0; i < model->numVariables; i++) {
+        double value = model->variables[i].kind == FUZZY_MODEL_INPUT
+                           ? inputs[input++]
+                           : context->outputs[output++];
+        char msg[50];
+        total += snprintf(msg, sizeof(msg), "{%s:%.2f}",
+                          model->variables[i].name, value);
+    }
+    return total;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <model.fzm> [cycles]\n", argv[0]);
+        return 1;
+    }
+    long cycles = argc > 2 ? atol(argv[2]) : CYCLES;
+
+    FuzzyModel_t model;
+    FuzzyModelError_t error = {0};
+    if (FuzzyModelLoad(&model, argv[1], &error)) {
+        printf("%s:%d: %s\n", argv[1], error.line, error.message);
+        return 1;
+    }
+
+    // Evaluated cycles to encode, random inputs over the universes
+    double *samples;
+    int numSamples;
+    if (FuzzyHarnessSamples(&model, NUM_CONTEXTS, 7, &samples, &numSamples)) {
+        FuzzyModelFree(&model);
+        return 1;
+    }
+    FuzzyContext_t contexts[NUM_CONTEXTS];
+    for (int i = 0; i < NUM_CONTEXTS; i++) {
+        if (FuzzyContextInit(&contexts[i], &model)) {
+            printf("Can not allocate the contexts\n");
+            return 1;
+        }
+        FuzzyModelEvaluate(&model, &contexts[i],
+                           &samples[(i % numSamples) * model.numInputs], NULL);
+    }
+
+    printf("%s, %ld cycles\n", argv[1], cycles);
+    const char *names[] = {"snprintf", "json", "cbor"};
+    for (int method = 0; method < 3; method++) {
+        char buffer[DOCUMENT_SIZE];
+        FuzzyTelemetry_t telemetry;
+        FuzzyTelemetryInit(&telemetry, buffer, sizeof(buffer),
+                           method == 2 ? FUZZY_TELEMETRY_CBOR
+                                       : FUZZY_TELEMETRY_JSON,
+                           2);
+
+        size_t bytes = 0;
+        double start = nowNanoseconds();
+        for (long c = 0; c < cycles; c++) {
+            int i = c % NUM_CONTEXTS;
+            const double *inputs = &samples[(i % numSamples) * model.numInputs];
+            if (method == 0) {
+                bytes += snprintfPayloads(&model, &contexts[i], inputs);
+            } else {
+                FuzzyTelemetryEncode(&telemetry, &model, &contexts[i], inputs,
+                                     1718000000.0 + c);
+                bytes += telemetry.length;
+            }
+        }
+        double elapsed = nowNanoseconds() - start;
+        printf("%-10s %8.1f ns/cycle %6.1f bytes/cycle\n", names[method],
+               elapsed / cycles, (double)bytes / cycles);
+    }
+
+    // Single values over the ranges a controller reports
+    double values[NUM_VALUES];
+    srand(11);
+    for (int i = 0; i < NUM_VALUES; i++) {
+        values[i] = (rand() / (double)RAND_MAX - 0.25) * 200.0;
+    }
+    for (int method = 0; method < 2; method++) {
+        size_t bytes = 0;
+        double start = nowNanoseconds();
+        for (long c = 0; c < cycles; c++) {
+            char text[FUZZY_FIXED_LENGTH];
+            double value = values[c % NUM_VALUES];
+            bytes += method == 0 ? snprintf(text, sizeof(text), "%.2f", value)
+                                 : FuzzyFormatFixed(text, value, 2);
+        }
+        double elapsed = nowNanoseconds() - start;
+        printf("%-10s %8.1f ns/value (%zu bytes)\n",
+               method == 0 ? "%.2f" : "fixed", elapsed / cycles, bytes);
+    }
+
+    int differences = 0;
+    for (int i = 0; i < NUM_VALUES; i++) {
+        for (int decimals = 0; decimals <= FUZZY_FIXED_MAX_DECIMALS;
+             decimals++) {
+            char expected[64], text[FUZZY_FIXED_LENGTH];
+            snprintf(expected, sizeof(expected), "%.*f", decimals, values[i]);
+            FuzzyFormatFixed(text, values[i], decimals);
+            differences += strcmp(expected, text) != 0;
+        }
+    }
+    printf("%d of %d values formatted differently from snprintf\n",
+           differences, NUM_VALUES * (FUZZY_FIXED_MAX_DECIMALS + 1));
+
+    for (int i = 0; i < NUM_CONTEXTS; i++) {
+        FuzzyContextFree(&contexts[i]);
+    }
+    free(samples);
+    FuzzyModelFree(&model);
+    return 0;
+}
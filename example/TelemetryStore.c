@@ -0,0 +1,274 @@
+/**
+ * @file TelemetryStore.c
+ *
+ * Imports the logs PeltierControl writes into a telemetry store and queries
+ * it by time range, series and value.
+ *
+ * > TelemetryStore import [-s segmentSize] <store> <log>...
+ * appends the "[YYYY-mm-dd HH:MM:SS] Label - value" lines of the logs, the
+ * label is the series. Logs must be imported in time order, earlier lines are
+ * skipped.
+ *
+ * > TelemetryStore query <store> [-from time] [-to time] [-series label]
+ * >     [-above x] [-below y] [-q]
+ * prints the matching records in the log format, times as
+ * "YYYY-mm-dd HH:MM:SS" local time, then what the query touched. -q prints
+ * only the summary.
+ *
+ * > TelemetryStore info <store>
+ * lists the series and segments.
+ */
+
+#define _GNU_SOURCE
+
+#include "fuzzyc.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Helper function to parse "YYYY-mm-dd HH:MM:SS" as local time
+int parseTime(const char *text, double *seconds) {
+    struct tm tm = {0};
+    char *end = strptime(text, "%Y-%m-%d %H:%M:%S", &tm);
+    if (end == NULL) {
+        return -1;
+    }
+    tm.tm_isdst = -1;
+    time_t t = mktime(&tm);
+    if (t == (time_t)-1) {
+        return -1;
+    }
+    *seconds = (double)t;
+    return 0;
+}
+
+void formatTime(double seconds, char *text, size_t size) {
+    time_t t = (time_t)seconds;
+    struct tm tm;
+    localtime_r(&t, &tm);
+    strftime(text, size, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+// Splits "[time] Label - value", the label may contain " - " itself
+int parseLine(char *line, double *time, char **label, double *value) {
+    line[strcspn(line, "\r\n")] = '\0';
+    char *close = strchr(line, ']');
+    if (line[0] != '[' || close == NULL) {
+        return -1;
+    }
+    *close = '\0';
+    if (parseTime(line + 1, time) != 0) {
+        return -1;
+    }
+    char *separator = NULL;
+    for (char *p = strstr(close + 1, " - "); p; p = strstr(p + 1, " - ")) {
+        separator = p;
+    }
+    if (separator == NULL) {
+        return -1;
+    }
+    *separator = '\0';
+    char *end;
+    *value = strtod(separator + 3, &end);
+    if (end == separator + 3) {
+        return -1;
+    }
+    *label = close + 1;
+    while (**label == ' ') {
+        (*label)++;
+    }
+    return **label ? 0 : -1;
+}
+
+int import(int argc, char *argv[]) {
+    size_t segmentSize = 0;
+    int arg = 0;
+    if (arg + 1 < argc && strcmp(argv[arg], "-s") == 0) {
+        segmentSize = strtoul(argv[arg + 1], NULL, 0);
+        arg += 2;
+    }
+    if (arg + 2 > argc) {
+        printf("Usage: TelemetryStore import [-s segmentSize] <store> "
+               "<log>...\n");
+        return 1;
+    }
+
+    FuzzyStore_t store;
+    if (FuzzyStoreOpen(&store, argv[arg], 1, segmentSize) != 0) {
+        printf("Can not open the store %s.\n", argv[arg]);
+        return 1;
+    }
+    long imported = 0, skipped = 0, malformed = 0;
+    for (arg++; arg < argc; arg++) {
+        FILE *f = fopen(argv[arg], "r");
+        if (f == NULL) {
+            printf("Can not open the log %s.\n", argv[arg]);
+            FuzzyStoreClose(&store);
+            return 1;
+        }
+        char line[256];
+        while (fgets(line, sizeof(line), f) != NULL) {
+            double time, value;
+            char *label;
+            if (parseLine(line, &time, &label, &value) != 0) {
+                malformed++;
+                continue;
+            }
+            int series = FuzzyStoreSeries(&store, label);
+            if (series < 0) {
+                printf("Can not add the series \"%s\".\n", label);
+                fclose(f);
+                FuzzyStoreClose(&store);
+                return 1;
+            }
+            if (FuzzyStoreAppend(&store, series, time, value) != 0) {
+                skipped++;
+                continue;
+            }
+            imported++;
+        }
+        fclose(f);
+    }
+    FuzzyStoreClose(&store);
+    printf("%ld records imported, %ld out of order, %ld malformed lines\n",
+           imported, skipped, malformed);
+    return 0;
+}
+
+int query(int argc, char *argv[]) {
+    if (argc < 1) {
+        printf("Usage: TelemetryStore query <store> [-from time] [-to time] "
+               "[-series label] [-above x] [-below y] [-q]\n");
+        return 1;
+    }
+    FuzzyStore_t store;
+    if (FuzzyStoreOpen(&store, argv[0], 0, 0) != 0) {
+        printf("Can not open the store %s.\n", argv[0]);
+        return 1;
+    }
+
+    FuzzyStoreFilter_t filter;
+    FuzzyStoreFilterAll(&filter);
+    const char *series = NULL;
+    int quiet = 0;
+    for (int i = 1; i < argc; i++) {
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        int failed = 0;
+        if (strcmp(argv[i], "-q") == 0) {
+            quiet = 1;
+            continue;
+        } else if (value == NULL) {
+            failed = 1;
+        } else if (strcmp(argv[i], "-from") == 0) {
+            failed = parseTime(value, &filter.from);
+        } else if (strcmp(argv[i], "-to") == 0) {
+            failed = parseTime(value, &filter.to);
+        } else if (strcmp(argv[i], "-series") == 0) {
+            series = value;
+        } else if (strcmp(argv[i], "-above") == 0) {
+            filter.lower = atof(value);
+        } else if (strcmp(argv[i], "-below") == 0) {
+            filter.upper = atof(value);
+        } else {
+            failed = 1;
+        }
+        if (failed) {
+            printf("Invalid argument %s.\n", argv[i]);
+            FuzzyStoreClose(&store);
+            return 1;
+        }
+        i++;
+    }
+    if (series != NULL &&
+        (filter.series = FuzzyStoreSeries(&store, series)) < 0) {
+        printf("There is no series \"%s\".\n", series);
+        FuzzyStoreClose(&store);
+        return 1;
+    }
+
+    FuzzyStoreQuery_t q;
+    if (FuzzyStoreQueryInit(&q, &store, &filter) != 0) {
+        printf("Can not read the store.\n");
+        FuzzyStoreClose(&store);
+        return 1;
+    }
+    FuzzyStoreRecord_t record;
+    long count = 0;
+    double sum = 0, min = DBL_MAX, max = -DBL_MAX;
+    int found;
+    while ((found = FuzzyStoreNext(&q, &record)) > 0) {
+        if (!quiet) {
+            char time[32];
+            formatTime(record.time, time, sizeof(time));
+            printf("[%s] %s - %.2f\n", time, store.series[record.series],
+                   record.value);
+        }
+        count++;
+        sum += record.value;
+        min = fmin(min, record.value);
+        max = fmax(max, record.value);
+    }
+    FuzzyStoreQueryFree(&q);
+    if (found < 0) {
+        printf("Can not read a segment.\n");
+    }
+    printf("%ld records", count);
+    if (count > 0) {
+        printf(", min %.2f, max %.2f, mean %.2f", min, max, sum / count);
+    }
+    printf("\n%d of %d segments visited, %d skipped, %llu records scanned\n",
+           q.segmentsVisited, store.numSegments, q.segmentsSkipped,
+           (unsigned long long)q.recordsScanned);
+    FuzzyStoreClose(&store);
+    return found < 0;
+}
+
+int info(int argc, char *argv[]) {
+    if (argc < 1) {
+        printf("Usage: TelemetryStore info <store>\n");
+        return 1;
+    }
+    FuzzyStore_t store;
+    if (FuzzyStoreOpen(&store, argv[0], 0, 0) != 0) {
+        printf("Can not open the store %s.\n", argv[0]);
+        return 1;
+    }
+    printf("%d series\n", store.numSeries);
+    for (int i = 0; i < store.numSeries; i++) {
+        printf("  %2d %s\n", i, store.series[i]);
+    }
+    unsigned long long records = 0;
+    printf("%d segments\n", store.numSegments);
+    for (int i = 0; i < store.numSegments; i++) {
+        const FuzzyStoreSegment_t *segment = &store.segments[i];
+        char first[32] = "-", last[32] = "-";
+        if (segment->count > 0) {
+            formatTime(segment->first, first, sizeof(first));
+            formatTime(segment->last, last, sizeof(last));
+        }
+        printf("  %08d %s .. %s %u/%u records\n", i, first, last,
+               segment->count, segment->capacity);
+        records += segment->count;
+    }
+    printf("%llu records\n", records);
+    FuzzyStoreClose(&store);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc >= 2 && strcmp(argv[1], "import") == 0) {
+        return import(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "query") == 0) {
+        return query(argc - 2, argv + 2);
+    }
+    if (argc >= 2 && strcmp(argv[1], "info") == 0) {
+        return info(argc - 2, argv + 2);
+    }
+    printf("Usage: %s import|query|info <store> ...\n", argv[0]);
+    return 1;
+}
@@ -0,0 +1,44 @@
+/**
+ * @file TraceDecode.c
+ *
+ * Prints a dumped evaluation trace as text, the fired rules with their rule
+ * text.
+ *
+ * > TraceDecode <model.fzm> <trace>
+ * The model must be the one the trace was recorded with, PeltierControl
+ * built with make TRACE=1 dumps its trace on SIGUSR1.
+ */
+
+#include "fuzzyc.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+int main(int argc, char *argv[]) {
+    if (argc != 3) {
+        printf("Usage: %s <model.fzm> <trace>\n", argv[0]);
+        return 1;
+    }
+
+    FuzzyModel_t model;
+    FuzzyModelError_t error = {0};
+    if (FuzzyModelLoad(&model, argv[1], &error)) {
+        printf("%s:%d: %s\n", argv[1], error.line, error.message);
+        return 1;
+    }
+
+    FuzzyTraceRecord_t *records;
+    int numRecords;
+    if (FuzzyTraceLoad(argv[2], &records, &numRecords)) {
+        printf("%s is not a trace\n", argv[2]);
+        FuzzyModelFree(&model);
+        return 1;
+    }
+
+    printf("%d records", numRecords);
+    FuzzyTracePrint(stdout, &model, records, numRecords);
+
+    free(records);
+    FuzzyModelFree(&model);
+    return 0;
+}
@@ -0,0 +1,90 @@
+/**
+ * @file cascade.h
+ * @brief Fuzzy Logic cascaded rule bases header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_CASCADE_H
+#define FUZZY_CASCADE_H
+#pragma once
+
+#include "class.h"
+#include "engine.h"
+
+#define FUZZY_CASCADE_MAX_STAGES 16
+#define FUZZY_CASCADE_MAX_LINKS 32
+#define FUZZY_CASCADE_MAX_SETS 32
+
+// A cascade chains engines, the stages, into a DAG: the fuzzy output of one
+// stage is an input of the next without a defuzzification and a
+// reclassification in between. Small stages replace one flat rule base whose
+// rules would cover every combination of all inputs.
+//
+// An output set used as an input set by a later stage is passed through as
+// is: the downstream rules read the (normalized) output memberships of the
+// upstream stage. An output set linked to a different input set is mapped
+// through a term to term relation, see FuzzyCascadeLink():
+// > to[i] = S_j T(from[j], matrix[i * from->length + j])
+// with the norms of the downstream stage.
+//
+// The inputs of the cascade are the input sets no stage produces, its outputs
+// the output sets nothing consumes.
+
+typedef struct {
+    FuzzyEngine_t *engine;
+    // inferred sparsely if set
+    FuzzyEngineIndex_t *index;
+} FuzzyCascadeStage_t;
+
+typedef struct {
+    FuzzySet_t *from;
+    FuzzySet_t *to;
+    // to->length rows of from->length relations, NULL to copy memberships
+    double *matrix;
+    // the stage producing from, the one consuming to
+    int producer;
+    int consumer;
+} FuzzyCascadeLink_t;
+
+typedef struct {
+    FuzzyCascadeStage_t stages[FUZZY_CASCADE_MAX_STAGES];
+    int numStages;
+    // the stages in topological order, after FuzzyCascadePrepare()
+    int order[FUZZY_CASCADE_MAX_STAGES];
+    // explicit links first, then the passed through sets
+    FuzzyCascadeLink_t links[FUZZY_CASCADE_MAX_LINKS];
+    int numLinks;
+    int numExplicitLinks;
+    FuzzySet_t *inputs[FUZZY_CASCADE_MAX_SETS];
+    int numInputs;
+    FuzzySet_t *outputs[FUZZY_CASCADE_MAX_SETS];
+    int numOutputs;
+} FuzzyCascade_t;
+
+void FuzzyCascadeInit(FuzzyCascade_t *cascade);
+void FuzzyCascadeFree(FuzzyCascade_t *cascade);
+
+int FuzzyCascadeAddStage(FuzzyCascade_t *cascade, FuzzyEngine_t *engine,
+                         FuzzyEngineIndex_t *index);
+int FuzzyCascadeLink(FuzzyCascade_t *cascade, FuzzySet_t *from,
+                     FuzzySet_t *to, const double *matrix);
+int FuzzyCascadeTermMatrix(const FuzzySet_t *from, const FuzzySet_t *to,
+                           double *matrix);
+int FuzzyCascadePrepare(FuzzyCascade_t *cascade);
+
+int FuzzyCascadeInputIndex(const FuzzyCascade_t *cascade,
+                           const FuzzySet_t *set);
+int FuzzyCascadeOutputIndex(const FuzzyCascade_t *cascade,
+                            const FuzzySet_t *set);
+
+void FuzzyCascadeInfer(const FuzzyCascade_t *cascade);
+void FuzzyCascadeDefuzzify(const FuzzyCascade_t *cascade, double *outputs);
+void FuzzyCascadeEvaluate(const FuzzyCascade_t *cascade, const double *inputs,
+                          double *outputs);
+
+#endif
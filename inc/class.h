@@ -15,16 +15,49 @@
 
 #include "membership_function.h"
 
+// Sorted breakpoint index over the supports of the terms of a set. Terms are
+// ordered by the lower end of their support and reach[i] is the highest upper
+// end among the first i + 1 of them, so the terms that overlap x are found by a
+// binary search and a short scan back instead of evaluating every term.
+typedef struct {
+    double *lower;
+    double *upper;
+    double *reach;
+    int *terms;
+} FuzzySetIndex_t;
+
+// Every set keeps values derived from its membership functions, one block per
+// term plus the range of the term centroids (the crisp output range) and the
+// universe covered by the supports, so classification and defuzzification
+// neither divide by flank widths nor recompute centroids. FuzzySetPrepare()
+// rebuilds them together with the index.
+//
+// Sets whose terms all have a bounded support are indexed. FuzzyClassifier()
+// then evaluates only the overlapping terms and clears only the terms it set
+// before, so the membership values of a classified set must not be written by
+// anything else. Every classification lists the terms with a non-zero
+// membership in activeTerms.
 typedef struct {
     double *membershipValues;
     MembershipFunction_t *membershipFunctions;
     int length;
+    FuzzySetIndex_t *index;
+    int *activeTerms;
+    int numActive;
+    MembershipFunctionData_t *termData;
+    double minOutput;
+    double maxOutput;
+    double universeLower;
+    double universeUpper;
 } FuzzySet_t;
 
 void FuzzySetInit(FuzzySet_t *set,
                   const MembershipFunction_t *membershipFunctions, int length);
 void FuzzySetFree(FuzzySet_t *set);
 
+int FuzzySetPrepare(FuzzySet_t *set);
+int FuzzySetBuildIndex(FuzzySet_t *set);
+
 void normalizeClass(FuzzySet_t *set);
 
 double getMinOutput(FuzzySet_t *set);
@@ -0,0 +1,49 @@
+/**
+ * @file context.h
+ * @brief Fuzzy Logic per-evaluation context header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_CONTEXT_H
+#define FUZZY_CONTEXT_H
+#pragma once
+
+#include "model.h"
+#include "trace.h"
+
+// A model is read-only; everything an evaluation writes lives in a context
+// owned by the caller. Any number of threads can evaluate the same model at
+// the same time, each with its own context. Context buffers are cache line
+// aligned and padded, so contexts of different threads never share a line.
+typedef struct {
+    // one membership value per model term, inputs and outputs alike
+    double *memberships;
+    // one crisp value per output variable
+    double *outputs;
+    // the firing strength of every model rule in the last inference
+    double *strengths;
+    int numTerms;
+    int numOutputs;
+    int numRules;
+    // records every evaluation if set, see trace.h
+    FuzzyTrace_t *trace;
+} FuzzyContext_t;
+
+int FuzzyContextInit(FuzzyContext_t *context, const FuzzyModel_t *model);
+void FuzzyContextFree(FuzzyContext_t *context);
+int FuzzyContextFits(const FuzzyContext_t *context, const FuzzyModel_t *model);
+
+void FuzzyModelClassify(const FuzzyModel_t *model, FuzzyContext_t *context,
+                        int variable, double x);
+void FuzzyModelInfer(const FuzzyModel_t *model, FuzzyContext_t *context);
+void FuzzyModelDefuzzify(const FuzzyModel_t *model, FuzzyContext_t *context);
+
+void FuzzyModelEvaluate(const FuzzyModel_t *model, FuzzyContext_t *context,
+                        const double *inputs, double *outputs);
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ * @file controller.h
+ * @brief Fuzzy Logic closed loop controller header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_CONTROLLER_H
+#define FUZZY_CONTROLLER_H
+#pragma once
+
+#include "context.h"
+#include "model.h"
+#include "monitor.h"
+
+#include <stdbool.h>
+
+// Sensors and actuators are reached through an IO, so the very same control
+// step drives real hardware (sensor file, PWM, MQTT) or a simulated plant.
+typedef enum {
+    FUZZY_SIGNAL_VALUE,
+    FUZZY_SIGNAL_CHANGE,
+    FUZZY_SIGNAL_OUTPUT,
+    FUZZY_SIGNAL_ERROR
+} FuzzyControlSignal_e;
+
+typedef struct FuzzyControlIO_s FuzzyControlIO_t;
+
+struct FuzzyControlIO_s {
+    // reads the sensor, returns 0 on success and -1 if it can not be read
+    int (*read)(FuzzyControlIO_t *io, double *value);
+    // sets an actuator, actuators are numbered like the model outputs
+    void (*write)(FuzzyControlIO_t *io, int actuator, double value);
+    // reports a signal (output signals carry the output index), may be NULL
+    void (*publish)(FuzzyControlIO_t *io, FuzzyControlSignal_e signal,
+                    int index, double value);
+    void *user;
+};
+
+#define FUZZY_CONTROLLER_MAX_OUTPUTS 8
+
+// The model has two inputs, the sensor value and its change since the last
+// valid reading, in this order. Readings outside [minValid, maxValid) count as
+// sensor faults, which switch every actuator off.
+//
+// The caller waits period seconds between cycles. While the value, its change
+// and every output stay within their deadbands of the cycle that started a
+// stable stretch, the period grows by periodGrowth per cycle up to maxPeriod;
+// any excursion or sensor fault snaps it back to minPeriod. The change is
+// scaled to minPeriod, so the model sees the same rate at every period.
+// Stable cycles below maxPeriod still write the actuators but do not publish.
+// With maxPeriod == minPeriod, the default, the rate is fixed.
+typedef struct {
+    const FuzzyModel_t *model;
+    FuzzyContext_t *context;
+    FuzzyControlIO_t *io;
+    double minValid;
+    double maxValid;
+    double previous;
+    bool hasPrevious;
+    double period;
+    double minPeriod;
+    double maxPeriod;
+    double periodGrowth;
+    double valueDeadband;
+    double changeDeadband;
+    double outputDeadband;
+    // the cycle that started the current stable stretch
+    double anchorValue;
+    double anchorOutputs[FUZZY_CONTROLLER_MAX_OUTPUTS];
+    bool hasAnchor;
+    // publishes every cycle, quiet ones included, if set
+    FuzzyMonitor_t *monitor;
+} FuzzyController_t;
+
+int FuzzyControllerInit(FuzzyController_t *controller,
+                        const FuzzyModel_t *model, FuzzyContext_t *context,
+                        FuzzyControlIO_t *io);
+
+int FuzzyControllerStep(FuzzyController_t *controller);
+
+#endif
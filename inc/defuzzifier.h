@@ -17,6 +17,8 @@
 #include "classifier.h"
 
 double calculateCentroid(MembershipFunction_t function, double membership);
+void calculateCentroidDerivatives(MembershipFunction_t function,
+                                  double derivatives[4]);
 
 double defuzzification(FuzzySet_t *set);
 
@@ -0,0 +1,75 @@
+/**
+ * @file engine.h
+ * @brief Fuzzy Logic inference engine context header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_ENGINE_H
+#define FUZZY_ENGINE_H
+#pragma once
+
+#include "class.h"
+#include "inference.h"
+
+#include <stdint.h>
+
+#define FUZZY_ENGINE_MAX_SETS 16
+
+// An engine binds a rule base to the distinct input and output sets it
+// references. They are found once in FuzzyEngineInit(), so every cycle resets,
+// normalizes and defuzzifies each output set exactly once, no matter how many
+// rules write to it.
+//
+// The operator family defaults to FUZZY_MIN_MAX, set operators after
+// FuzzyEngineInit() to use another one. It is dispatched once per cycle.
+typedef struct {
+    const FuzzyRule_t *rules;
+    int numRules;
+    FuzzySet_t *inputs[FUZZY_ENGINE_MAX_SETS];
+    int numInputs;
+    FuzzySet_t *outputs[FUZZY_ENGINE_MAX_SETS];
+    int numOutputs;
+    FuzzyOperators_e operators;
+} FuzzyEngine_t;
+
+// Maps every input term to the rules that can only fire while that term has a
+// non-zero membership: rules with a plain VAR() literal in an ALL_OF group (or
+// alone in an ANY_OF group) are zero whenever that literal is. Rules without
+// such a literal are always evaluated. FuzzyEngineInferSparse() then walks the
+// active terms of the inputs instead of every rule; the inputs must be
+// classified with FuzzyClassifier().
+typedef struct {
+    int numRules;
+    // rules guarded by term t of input i are
+    // rules[offsets[first[i] + t] .. offsets[first[i] + t + 1]]
+    int first[FUZZY_ENGINE_MAX_SETS];
+    int *offsets;
+    int *rules;
+    // bitmaps of the unguarded rules and of the rules of a cycle
+    uint64_t *always;
+    uint64_t *fired;
+    int *selected;
+} FuzzyEngineIndex_t;
+
+int FuzzyEngineInit(FuzzyEngine_t *engine, const FuzzyRule_t *rules,
+                    int numRules);
+
+int FuzzyEngineIndexInit(FuzzyEngineIndex_t *index,
+                         const FuzzyEngine_t *engine);
+void FuzzyEngineIndexFree(FuzzyEngineIndex_t *index);
+
+int FuzzyEngineInputIndex(const FuzzyEngine_t *engine, const FuzzySet_t *set);
+int FuzzyEngineOutputIndex(const FuzzyEngine_t *engine, const FuzzySet_t *set);
+
+void FuzzyEngineInfer(const FuzzyEngine_t *engine);
+void FuzzyEngineInferSparse(const FuzzyEngine_t *engine,
+                            FuzzyEngineIndex_t *index);
+
+void FuzzyEngineDefuzzify(const FuzzyEngine_t *engine, double *outputs);
+
+#endif
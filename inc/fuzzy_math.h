@@ -0,0 +1,180 @@
+/**
+ * @file fuzzy_math.h
+ * @brief Fuzzy Logic fast exp() and log() approximations header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_MATH_H
+#define FUZZY_MATH_H
+#pragma once
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+// Approximations used by the smooth membership functions, in a scalar form and
+// a vector form (GCC vector extensions, one SSE2 or NEON register) that
+// computes FUZZY_VECTOR_LENGTH lanes at once with the very same result.
+//
+// fuzzyExp(x) = 2^n * exp(r) with n = round(x / ln 2) and |r| <= ln(2) / 2.
+// exp(r) is the Taylor polynomial of degree 7, 2^n is written straight into
+// the exponent bits. The truncation error is below r^8 / 8! * exp(r) < 7.4e-9,
+// the relative error is below 1e-8 over the whole range. x is clamped to
+// [-708, 709], the result is never inf, NaN or denormal.
+//
+// fuzzyLog(x) = e * ln 2 + log(m) with x = 2^e * m and m in [sqrt(1/2),
+// sqrt(2)). log(m) is the series 2 * (s + s^3/3 + s^5/5 + s^7/7 + s^9/9) with
+// s = (m - 1) / (m + 1), |s| < 0.1716, the absolute error is below 1e-9. x
+// must be positive and normal.
+//
+// Define FUZZY_EXACT_EXP to use exp() and log() from libm instead, e.g. to
+// verify a controller against the exact shapes.
+
+#define FUZZY_VECTOR_LENGTH 2
+
+typedef double FuzzyVector_t
+    __attribute__((vector_size(FUZZY_VECTOR_LENGTH * sizeof(double))));
+typedef int64_t FuzzyVectorMask_t
+    __attribute__((vector_size(FUZZY_VECTOR_LENGTH * sizeof(int64_t))));
+
+#define FUZZY_EXP_MIN -708.0
+#define FUZZY_EXP_MAX 709.0
+#define FUZZY_LN2_HI 0x1.62e42fee00000p-1
+#define FUZZY_LN2_LO 0x1.a39ef35793c76p-33
+// adding and subtracting 1.5 * 2^52 rounds to the nearest integer, which is
+// then found in the low mantissa bits
+#define FUZZY_ROUND_SHIFT 0x1.8p52
+
+static inline double fuzzyExp(double x) {
+#ifdef FUZZY_EXACT_EXP
+    return exp(x);
+#else
+    x = x < FUZZY_EXP_MIN ? FUZZY_EXP_MIN : x;
+    x = x > FUZZY_EXP_MAX ? FUZZY_EXP_MAX : x;
+
+    double shifted = x * M_LOG2E + FUZZY_ROUND_SHIFT;
+    double n = shifted - FUZZY_ROUND_SHIFT;
+    double r = (x - n * FUZZY_LN2_HI) - n * FUZZY_LN2_LO;
+
+    double p = 1.0 / 5040.0;
+    p = p * r + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+
+    int64_t bits, roundBits;
+    double shift = FUZZY_ROUND_SHIFT, scale;
+    memcpy(&bits, &shifted, sizeof(bits));
+    memcpy(&roundBits, &shift, sizeof(roundBits));
+    bits = (bits - roundBits + 1023) << 52;
+    memcpy(&scale, &bits, sizeof(scale));
+
+    return p * scale;
+#endif
+}
+
+static inline double fuzzyLog(double x) {
+#ifdef FUZZY_EXACT_EXP
+    return log(x);
+#else
+    int64_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    int64_t e = (bits >> 52) - 1023;
+    bits = (bits & 0xfffffffffffffLL) | 0x3ff0000000000000LL;
+
+    double m;
+    memcpy(&m, &bits, sizeof(m));
+    if (m > M_SQRT2) {
+        m *= 0.5;
+        e++;
+    }
+
+    double s = (m - 1.0) / (m + 1.0);
+    double s2 = s * s;
+    double p = 1.0 / 9.0;
+    p = p * s2 + 1.0 / 7.0;
+    p = p * s2 + 1.0 / 5.0;
+    p = p * s2 + 1.0 / 3.0;
+    p = p * s2 + 1.0;
+
+    return e * M_LN2 + 2.0 * s * p;
+#endif
+}
+
+// Lane wise mask ? a : b
+static inline FuzzyVector_t fuzzyVectorSelect(FuzzyVectorMask_t mask,
+                                              FuzzyVector_t a,
+                                              FuzzyVector_t b) {
+    return (FuzzyVector_t)((mask & (FuzzyVectorMask_t)a) |
+                           (~mask & (FuzzyVectorMask_t)b));
+}
+
+static inline FuzzyVector_t fuzzyExpVector(FuzzyVector_t x) {
+#ifdef FUZZY_EXACT_EXP
+    for (int i = 0; i < FUZZY_VECTOR_LENGTH; i++) {
+        x[i] = exp(x[i]);
+    }
+    return x;
+#else
+    const FuzzyVector_t zero = {0};
+    x = fuzzyVectorSelect(x < FUZZY_EXP_MIN, zero + FUZZY_EXP_MIN, x);
+    x = fuzzyVectorSelect(x > FUZZY_EXP_MAX, zero + FUZZY_EXP_MAX, x);
+
+    FuzzyVector_t shifted = x * M_LOG2E + FUZZY_ROUND_SHIFT;
+    FuzzyVector_t n = shifted - FUZZY_ROUND_SHIFT;
+    FuzzyVector_t r = (x - n * FUZZY_LN2_HI) - n * FUZZY_LN2_LO;
+
+    FuzzyVector_t p = r * (1.0 / 5040.0) + 1.0 / 720.0;
+    p = p * r + 1.0 / 120.0;
+    p = p * r + 1.0 / 24.0;
+    p = p * r + 1.0 / 6.0;
+    p = p * r + 0.5;
+    p = p * r + 1.0;
+    p = p * r + 1.0;
+
+    FuzzyVectorMask_t bits =
+        ((FuzzyVectorMask_t)shifted -
+         (FuzzyVectorMask_t)(zero + FUZZY_ROUND_SHIFT) + 1023)
+        << 52;
+
+    return p * (FuzzyVector_t)bits;
+#endif
+}
+
+static inline FuzzyVector_t fuzzyLogVector(FuzzyVector_t x) {
+#ifdef FUZZY_EXACT_EXP
+    for (int i = 0; i < FUZZY_VECTOR_LENGTH; i++) {
+        x[i] = log(x[i]);
+    }
+    return x;
+#else
+    FuzzyVectorMask_t bits = (FuzzyVectorMask_t)x;
+    FuzzyVectorMask_t e = (bits >> 52) - 1023;
+    bits = (bits & 0xfffffffffffffLL) | 0x3ff0000000000000LL;
+
+    FuzzyVector_t m = (FuzzyVector_t)bits;
+    FuzzyVectorMask_t large = m > M_SQRT2;
+    m = fuzzyVectorSelect(large, m * 0.5, m);
+    // large lanes are -1
+    e -= large;
+
+    FuzzyVector_t s = (m - 1.0) / (m + 1.0);
+    FuzzyVector_t s2 = s * s;
+    FuzzyVector_t p = s2 * (1.0 / 9.0) + 1.0 / 7.0;
+    p = p * s2 + 1.0 / 5.0;
+    p = p * s2 + 1.0 / 3.0;
+    p = p * s2 + 1.0;
+
+    return __builtin_convertvector(e, FuzzyVector_t) * M_LN2 + 2.0 * s * p;
+#endif
+}
+
+#endif
@@ -13,11 +13,30 @@
 #define FUZZY_C_H
 #pragma once
 
+#include "cascade.h"
 #include "class.h"
 #include "classifier.h"
+#include "context.h"
+#include "controller.h"
 #include "defuzzifier.h"
+#include "engine.h"
+#include "fuzzy_math.h"
+#include "gradient.h"
+#include "harness.h"
 #include "inference.h"
 #include "membership_function.h"
+#include "model.h"
+#include "model_handle.h"
+#include "monitor.h"
+#include "plant.h"
+#include "render.h"
+#include "rule_matrix.h"
+#include "rule_optimizer.h"
+#include "service.h"
+#include "store.h"
+#include "telemetry.h"
+#include "trace.h"
+#include "tuner.h"
 
 #define FUZZY_LENGTH(x) (sizeof(x) / sizeof(x[0]))
 
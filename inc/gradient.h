@@ -0,0 +1,52 @@
+/**
+ * @file gradient.h
+ * @brief Fuzzy Logic model gradient header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_GRADIENT_H
+#define FUZZY_GRADIENT_H
+#pragma once
+
+#include "context.h"
+#include "model.h"
+
+// Derivatives of the crisp outputs of a model, computed in one forward pass
+// alongside an evaluation. Min and max pass the derivative of the argument they
+// select through, at ties the one selected first; the centroid
+// defuzzification is differentiated exactly.
+//
+// parameters[(output * numTerms + term) * 4 + k] is the derivative of an output
+// by parameter k (a, b, c, d) of a term, inputs[output * numInputs + input]
+// the derivative by an input. Outputs and inputs are counted in declaration
+// order, terms are model terms.
+typedef struct {
+    double *parameters;
+    double *inputs;
+    int numTerms;
+    int numInputs;
+    int numOutputs;
+    // per term: derivatives of the membership by a, b, c, d and the input
+    double *memberships;
+    // per term: the input literal the strength of an output term stems from,
+    // 2 * term + invert, or -1 for a constant
+    int *sources;
+    double *strengths;
+    // per variable: its position among the inputs
+    int *inputIndices;
+} FuzzyGradient_t;
+
+int FuzzyGradientInit(FuzzyGradient_t *gradient, const FuzzyModel_t *model);
+void FuzzyGradientFree(FuzzyGradient_t *gradient);
+
+void FuzzyModelEvaluateGradient(const FuzzyModel_t *model,
+                                FuzzyContext_t *context,
+                                FuzzyGradient_t *gradient,
+                                const double *inputs, double *outputs);
+
+#endif
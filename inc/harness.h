@@ -0,0 +1,85 @@
+/**
+ * @file harness.h
+ * @brief Fuzzy Logic backend comparison harness header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_HARNESS_H
+#define FUZZY_HARNESS_H
+#pragma once
+
+#include "inference.h"
+#include "model.h"
+
+#include <stdint.h>
+
+#define FUZZY_HARNESS_MAX_OUTPUTS 16
+
+// A backend evaluates a model one sample at a time, inputs and outputs in
+// declaration order. The harness runs every backend on the same samples and
+// compares it to the first one, the reference.
+typedef struct FuzzyBackend_s FuzzyBackend_t;
+
+struct FuzzyBackend_s {
+    const char *name;
+    void (*evaluate)(FuzzyBackend_t *backend, const double *inputs,
+                     double *outputs);
+    // releases user, may be NULL
+    void (*release)(FuzzyBackend_t *backend);
+    void *user;
+    // the largest absolute error per output that still passes
+    double tolerance;
+    // the rules the backend evaluates, 0 if it does not evaluate rules
+    int numRules;
+};
+
+// The backends of this library, FUZZY_BACKEND_RULES is the reference engine:
+// the model expanded to sets and rules, classified, inferred with
+// fuzzyInference() and defuzzified. FUZZY_BACKEND_OPTIMIZED infers the rules
+// after FuzzyRuleOptimize(), FUZZY_BACKEND_REORDERED after profiling them on
+// random samples and FuzzyRuleReorder(), FUZZY_BACKEND_MATRIX a
+// FuzzyRuleMatrix_t of models whose rules form a table.
+//
+// The rules, engine, sparse and matrix backends also run under the other
+// operator families, see FuzzyBackendInitWith(); compare them to the rules
+// backend of the same family.
+typedef enum {
+    FUZZY_BACKEND_RULES,
+    FUZZY_BACKEND_ENGINE,
+    FUZZY_BACKEND_SPARSE,
+    FUZZY_BACKEND_MODEL,
+    FUZZY_BACKEND_GRADIENT,
+    FUZZY_BACKEND_OPTIMIZED,
+    FUZZY_BACKEND_MATRIX,
+    FUZZY_BACKEND_REORDERED
+} FuzzyBackendKind_e;
+
+typedef struct {
+    double maxError[FUZZY_HARNESS_MAX_OUTPUTS];
+    double meanError[FUZZY_HARNESS_MAX_OUTPUTS];
+    double nanoseconds;
+    // the number of samples with an error above the tolerance and the sample
+    // with the largest error
+    int failures;
+    int worst;
+} FuzzyHarnessResult_t;
+
+int FuzzyBackendInit(FuzzyBackend_t *backend, FuzzyBackendKind_e kind,
+                     const FuzzyModel_t *model);
+int FuzzyBackendInitWith(FuzzyBackend_t *backend, FuzzyBackendKind_e kind,
+                         const FuzzyModel_t *model, FuzzyOperators_e operators);
+void FuzzyBackendFree(FuzzyBackend_t *backend);
+
+int FuzzyHarnessSamples(const FuzzyModel_t *model, int numRandom,
+                        uint64_t seed, double **samples, int *numSamples);
+
+int FuzzyHarnessRun(FuzzyBackend_t *backends, int numBackends, int numInputs,
+                    int numOutputs, const double *samples, int numSamples,
+                    FuzzyHarnessResult_t *results);
+
+#endif
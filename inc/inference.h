@@ -13,6 +13,7 @@
  #include "classifier.h"
  #include "membership_function.h"
  
+ #include <math.h>
  #include <stdbool.h>
 
  #ifndef FUZZY_INFERENCE_H
@@ -35,6 +36,26 @@
      Fuzzyfuzzy_operator_e fuzzy_operator;
  } FuzzyAntecedent_t;
  
+ // Operator families, chosen per rule base. ALL_OF groups and the groups of an
+ // antecedent use the t-norm, ANY_OF groups and the aggregation of rules into
+ // their consequents use the matching s-norm.
+ // > FUZZY_MIN_MAX      min(a, b)           max(a, b)
+ // > FUZZY_PRODUCT      a * b               a + b - a * b
+ // > FUZZY_LUKASIEWICZ  max(a + b - 1, 0)   min(a + b, 1)
+ typedef enum {
+     FUZZY_MIN_MAX,
+     FUZZY_PRODUCT,
+     FUZZY_LUKASIEWICZ
+ } FuzzyOperators_e;
+ 
+ // The norms of every family, expanded in place by the specialized kernels
+ #define FUZZY_TNORM_MIN_MAX(a, b) fmin(a, b)
+ #define FUZZY_SNORM_MIN_MAX(a, b) fmax(a, b)
+ #define FUZZY_TNORM_PRODUCT(a, b) ((a) * (b))
+ #define FUZZY_SNORM_PRODUCT(a, b) ((a) + (b) - (a) * (b))
+ #define FUZZY_TNORM_LUKASIEWICZ(a, b) fmax((a) + (b)-1.0, 0.0)
+ #define FUZZY_SNORM_LUKASIEWICZ(a, b) fmin((a) + (b), 1.0)
+ 
  // Define a type for a fuzzy rule
  typedef struct {
      FuzzyAntecedent_t *antecedent;
@@ -78,6 +99,18 @@
       .consequent = _consequent}
  
  
+ double fuzzyRuleMembership(const FuzzyRule_t *rule,
+                            FuzzyOperators_e operators);
+ 
+ void fuzzyAggregate(const FuzzyRule_t *rules, int numRules,
+                     FuzzyOperators_e operators);
+ 
+ void fuzzyAggregateSelected(const FuzzyRule_t *rules, const int *selected,
+                             int numSelected, FuzzyOperators_e operators);
+ 
  void fuzzyInference(const FuzzyRule_t *rules, int numRules);
  
+ void fuzzyInferenceWith(const FuzzyRule_t *rules, int numRules,
+                         FuzzyOperators_e operators);
+ 
  #endif
@@ -13,7 +13,14 @@
 #define FUZZY_MEMBERSHIP_FUNCTION_H
 #pragma once
 
-typedef enum { TRIANGULAR, TRAPEZOIDAL, RECTANGULAR } MembershipFunctionType_e;
+typedef enum {
+    TRIANGULAR,
+    TRAPEZOIDAL,
+    RECTANGULAR,
+    GAUSSIAN,
+    SIGMOID,
+    GENERALIZED_BELL
+} MembershipFunctionType_e;
 
 typedef struct {
     double a;
@@ -23,6 +30,20 @@ typedef struct {
     MembershipFunctionType_e type;
 } MembershipFunction_t;
 
+// Values derived once from a membership function so that classification
+// neither divides nor recomputes them (see membershipFunctionPrepare())
+typedef struct {
+    // reciprocal widths of the rising and falling flank, of the bell for the
+    // smooth shapes
+    double rise;
+    double fall;
+    // support, see membershipFunctionSupport()
+    double lower;
+    double upper;
+    double area;
+    double centroid;
+} MembershipFunctionData_t;
+
 #define FUZZY_LABEL(a, ...) a,
 #define FUZZY_VALUE(a, ...) {__VA_ARGS__},
 
@@ -37,11 +58,40 @@ typedef struct {
 // The X parameter and X() function can be any undefined Macro, the order of
 // arguments is: ENUM_LABEL, a, b, c, d, MembershipFunctionType_e the ENUM_LABEL
 // will be generated to aid with writing rules
+//
+// The smooth shapes take their parameters in this order:
+// > X(WARM, center, sigma, 0.0, 0.0, GAUSSIAN)
+// > X(HOT, slope, inflection, 0.0, 0.0, SIGMOID)
+// > X(MILD, width, slope, center, 0.0, GENERALIZED_BELL)
+// or, without the padding, with the shape macros below:
+// > X(WARM, FUZZY_GAUSSIAN(30.0, 5.0))
 
 #define DEFINE_FUZZY_MEMBERSHIP(name)                                          \
     enum { name(FUZZY_LABEL) };                                                \
     MembershipFunction_t name[] = {name(FUZZY_VALUE)};
 
+#define FUZZY_GAUSSIAN(_center, _sigma)                                        \
+    .a = (_center), .b = (_sigma), .type = GAUSSIAN
+#define FUZZY_SIGMOID(_slope, _inflection)                                     \
+    .a = (_slope), .b = (_inflection), .type = SIGMOID
+#define FUZZY_GENERALIZED_BELL(_width, _slope, _center)                        \
+    .a = (_width), .b = (_slope), .c = (_center), .type = GENERALIZED_BELL
+
 double membershipFunction(double x, MembershipFunction_t mf);
+double membershipFunctionDerivatives(double x, MembershipFunction_t mf,
+                                     double derivatives[5]);
+
+int membershipFunctionParameters(MembershipFunctionType_e type);
+const char *membershipFunctionName(MembershipFunctionType_e type);
+int membershipFunctionSupport(MembershipFunction_t mf, double *lower,
+                              double *upper);
+
+void membershipFunctionPrepare(MembershipFunction_t mf,
+                               MembershipFunctionData_t *data);
+double membershipFunctionPrepared(double x, MembershipFunction_t mf,
+                                  const MembershipFunctionData_t *data);
+
+void membershipFunctionBatch(const double *x, double *memberships, int n,
+                             MembershipFunction_t mf);
 
 #endif
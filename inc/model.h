@@ -0,0 +1,174 @@
+/**
+ * @file model.h
+ * @brief Fuzzy Logic runtime model header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_MODEL_H
+#define FUZZY_MODEL_H
+#pragma once
+
+#include "inference.h"
+#include "membership_function.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// A model is a single contiguous, position independent image. Every record
+// refers to other records by index, never by pointer, so the very same bytes
+// can live on the heap (after parsing a text description) or be mapped
+// read-only straight from a compiled binary file.
+//
+// The text description mirrors the macro syntax used in the examples:
+// > # comment
+// > input Temperature
+// >     term TEMPERATURE_LOW 10.0 15.0 25.0 30.0 TRAPEZOIDAL
+// >     term TEMPERATURE_MEDIUM 25.0 30.0 35.0 TRIANGULAR
+// >     term TEMPERATURE_WARM 30.0 5.0 GAUSSIAN
+// > output HeaterSpeed
+// >     term HEATER_SPEED_OFF -10.0 0.0 0.0 10.0 TRAPEZOIDAL
+// > rule WHEN ALL_OF(VAR(Temperature, TEMPERATURE_LOW),
+// >                  NOT(Temperature, TEMPERATURE_MEDIUM))
+// >      THEN(HeaterSpeed, HEATER_SPEED_OFF)
+// Missing membership function parameters default to 0.0, exactly like the
+// DEFINE_FUZZY_MEMBERSHIP tables.
+
+#define FUZZY_MODEL_MAGIC "FZMD"
+#define FUZZY_MODEL_VERSION 1
+#define FUZZY_MODEL_BYTE_ORDER 0x01020304u
+#define FUZZY_MODEL_NAME_LENGTH 32
+#define FUZZY_MODEL_ERROR_LENGTH 128
+#define FUZZY_CACHE_LINE 64
+
+// Flags for FuzzyModelMapImage() and FuzzyModelFromImage()
+#define FUZZY_MODEL_VERIFY_CHECKSUM 0x1
+
+typedef enum { FUZZY_MODEL_INPUT, FUZZY_MODEL_OUTPUT } FuzzyModelVariableKind_e;
+
+typedef enum {
+    FUZZY_MODEL_BORROWED,
+    FUZZY_MODEL_HEAP,
+    FUZZY_MODEL_MAPPED
+} FuzzyModelStorage_e;
+
+typedef struct {
+    uint32_t offset;
+    uint32_t count;
+} FuzzyModelSection_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t headerSize;
+    uint64_t imageSize;
+    // FNV-1a over every byte following the header
+    uint64_t checksum;
+    FuzzyModelSection_t variables;
+    FuzzyModelSection_t terms;
+    FuzzyModelSection_t rules;
+    FuzzyModelSection_t groups;
+    FuzzyModelSection_t literals;
+    uint32_t reserved;
+} FuzzyModelHeader_t;
+
+typedef struct {
+    char name[FUZZY_MODEL_NAME_LENGTH];
+    uint32_t kind;
+    uint32_t firstTerm;
+    uint32_t numTerms;
+    uint32_t reserved;
+} FuzzyModelVariable_t;
+
+typedef struct {
+    char name[FUZZY_MODEL_NAME_LENGTH];
+    double a;
+    double b;
+    double c;
+    double d;
+    uint32_t type;
+    uint32_t variable;
+} FuzzyModelTerm_t;
+
+// literal and consequent terms are indices into the model wide term table
+typedef struct {
+    uint32_t variable;
+    uint32_t term;
+    uint32_t invert;
+    uint32_t reserved;
+} FuzzyModelLiteral_t;
+
+typedef struct {
+    uint32_t fuzzy_operator;
+    uint32_t firstLiteral;
+    uint32_t numLiterals;
+    uint32_t reserved;
+} FuzzyModelGroup_t;
+
+typedef struct {
+    uint32_t firstGroup;
+    uint32_t numGroups;
+    uint32_t consequentVariable;
+    uint32_t consequentTerm;
+} FuzzyModelRule_t;
+
+typedef struct {
+    const FuzzyModelHeader_t *header;
+    const FuzzyModelVariable_t *variables;
+    const FuzzyModelTerm_t *terms;
+    const FuzzyModelRule_t *rules;
+    const FuzzyModelGroup_t *groups;
+    const FuzzyModelLiteral_t *literals;
+    int numVariables;
+    int numTerms;
+    int numRules;
+    int numGroups;
+    int numLiterals;
+    int numInputs;
+    int numOutputs;
+    void *image;
+    size_t imageSize;
+    FuzzyModelStorage_e storage;
+} FuzzyModel_t;
+
+typedef struct {
+    int line;
+    char message[FUZZY_MODEL_ERROR_LENGTH];
+} FuzzyModelError_t;
+
+int FuzzyModelParse(FuzzyModel_t *model, const char *text,
+                    FuzzyModelError_t *error);
+int FuzzyModelLoad(FuzzyModel_t *model, const char *path,
+                   FuzzyModelError_t *error);
+int FuzzyModelFromRules(FuzzyModel_t *model, const FuzzyRule_t *rules,
+                        int numRules, FuzzyModelError_t *error);
+
+int FuzzyModelFromImage(FuzzyModel_t *model, const void *image, size_t size,
+                        int flags, FuzzyModelError_t *error);
+int FuzzyModelMapImage(FuzzyModel_t *model, const char *path, int flags,
+                       FuzzyModelError_t *error);
+int FuzzyModelWriteImage(const FuzzyModel_t *model, const char *path);
+int FuzzyModelWriteText(const FuzzyModel_t *model, const char *path);
+void FuzzyModelPrintRule(FILE *f, const FuzzyModel_t *model, int rule);
+
+int FuzzyModelCopy(FuzzyModel_t *copy, const FuzzyModel_t *model,
+                   FuzzyModelError_t *error);
+int FuzzyModelSetMembershipFunction(FuzzyModel_t *model, int term,
+                                    MembershipFunction_t mf);
+
+void FuzzyModelFree(FuzzyModel_t *model);
+
+int FuzzyModelFindVariable(const FuzzyModel_t *model, const char *name);
+int FuzzyModelFindTerm(const FuzzyModel_t *model, int variable,
+                       const char *name);
+
+MembershipFunction_t FuzzyModelMembershipFunction(const FuzzyModel_t *model,
+                                                  int term);
+
+#endif
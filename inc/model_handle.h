@@ -0,0 +1,75 @@
+/**
+ * @file model_handle.h
+ * @brief Fuzzy Logic hot-swappable model handle header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_MODEL_HANDLE_H
+#define FUZZY_MODEL_HANDLE_H
+#pragma once
+
+#include "model.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdint.h>
+
+#define FUZZY_MODEL_HANDLE_MAX_READERS 16
+#define FUZZY_MODEL_HANDLE_MAX_RETIRED 16
+
+// A handle publishes the current model with an atomic pointer swap. Readers
+// (control loops) announce the epoch they entered in, grab the pointer once
+// per cycle and leave again; a replaced model is only freed once every reader
+// that could still see it has left. Readers never lock, never wait and never
+// allocate, publishing only ever takes the writer side lock.
+//
+// > int reader = FuzzyModelHandleRegister(&handle);
+// > while (1) {
+// >     const FuzzyModel_t *model = FuzzyModelHandleAcquire(&handle, reader);
+// >     FuzzyModelEvaluate(model, &context, inputs, outputs);
+// >     FuzzyModelHandleRelease(&handle, reader);
+// > }
+
+typedef struct {
+    // 0 while the reader is outside, otherwise the epoch it entered in
+    _Atomic uint64_t epoch;
+    char padding[FUZZY_CACHE_LINE - sizeof(uint64_t)];
+} FuzzyModelReader_t;
+
+typedef struct {
+    FuzzyModel_t *model;
+    uint64_t epoch;
+} FuzzyModelRetired_t;
+
+typedef struct {
+    _Atomic(FuzzyModel_t *) current;
+    _Atomic uint64_t epoch;
+    _Atomic int numReaders;
+    FuzzyModelReader_t readers[FUZZY_MODEL_HANDLE_MAX_READERS];
+
+    // writer side state, guarded by writerLock
+    pthread_mutex_t writerLock;
+    FuzzyModelRetired_t retired[FUZZY_MODEL_HANDLE_MAX_RETIRED];
+    int numRetired;
+    uint64_t numPublished;
+    uint64_t numReclaimed;
+} FuzzyModelHandle_t;
+
+void FuzzyModelHandleInit(FuzzyModelHandle_t *handle, FuzzyModel_t *model);
+void FuzzyModelHandleDestroy(FuzzyModelHandle_t *handle);
+
+int FuzzyModelHandleRegister(FuzzyModelHandle_t *handle);
+
+const FuzzyModel_t *FuzzyModelHandleAcquire(FuzzyModelHandle_t *handle,
+                                            int reader);
+void FuzzyModelHandleRelease(FuzzyModelHandle_t *handle, int reader);
+
+int FuzzyModelHandlePublish(FuzzyModelHandle_t *handle, FuzzyModel_t *model);
+int FuzzyModelHandleReclaim(FuzzyModelHandle_t *handle);
+
+#endif
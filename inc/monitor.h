@@ -0,0 +1,100 @@
+/**
+ * @file monitor.h
+ * @brief Fuzzy Logic shared memory monitor header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_MONITOR_H
+#define FUZZY_MONITOR_H
+#pragma once
+
+#include "context.h"
+#include "model.h"
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define FUZZY_MONITOR_NAME_LENGTH 64
+
+// The state of one published cycle
+typedef struct {
+    // counts the published cycles, starting at 1
+    uint64_t cycle;
+    // wall clock of the cycle in seconds
+    double time;
+    // seconds the evaluation took
+    double evaluationTime;
+    // seconds until the next cycle
+    double period;
+    // set on a sensor fault, the inputs are then NaN and the rest stale
+    uint32_t fault;
+    uint32_t reserved;
+} FuzzyMonitorCycle_t;
+
+// The start of a monitor segment. It is followed by the variables and terms
+// of the model, written once, and the live state: the inputs, the term
+// memberships, the rule strengths and the outputs.
+//
+// The live state and the cycle are guarded by a seqlock: the writer makes the
+// sequence odd, writes, and makes it even again; a reader copies them and
+// keeps the copy only if the sequence was even and unchanged throughout. The
+// writer never waits for readers and readers never make a syscall.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t numVariables;
+    uint32_t numTerms;
+    uint32_t numRules;
+    uint32_t numInputs;
+    uint32_t numOutputs;
+    _Atomic uint32_t sequence;
+    uint64_t size;
+    FuzzyMonitorCycle_t cycle;
+} FuzzyMonitorHeader_t;
+
+// The writer side, owned by the controller
+typedef struct {
+    char name[FUZZY_MONITOR_NAME_LENGTH];
+    FuzzyMonitorHeader_t *header;
+    double *inputs;
+    double *memberships;
+    double *strengths;
+    double *outputs;
+} FuzzyMonitor_t;
+
+// The reader side, the last consistent snapshot is copied into the reader
+typedef struct {
+    const FuzzyMonitorHeader_t *header;
+    const FuzzyModelVariable_t *variables;
+    const FuzzyModelTerm_t *terms;
+    int numVariables;
+    int numTerms;
+    int numRules;
+    int numInputs;
+    int numOutputs;
+    FuzzyMonitorCycle_t cycle;
+    double *inputs;
+    double *memberships;
+    double *strengths;
+    double *outputs;
+} FuzzyMonitorReader_t;
+
+int FuzzyMonitorCreate(FuzzyMonitor_t *monitor, const char *name,
+                       const FuzzyModel_t *model);
+void FuzzyMonitorFree(FuzzyMonitor_t *monitor);
+void FuzzyMonitorPublish(FuzzyMonitor_t *monitor,
+                         const FuzzyContext_t *context, const double *inputs,
+                         double evaluationTime, double period, bool fault);
+
+int FuzzyMonitorOpen(FuzzyMonitorReader_t *reader, const char *name);
+void FuzzyMonitorClose(FuzzyMonitorReader_t *reader);
+int FuzzyMonitorRead(FuzzyMonitorReader_t *reader, int attempts);
+
+#endif
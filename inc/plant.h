@@ -0,0 +1,112 @@
+/**
+ * @file plant.h
+ * @brief Fuzzy Logic thermal plant simulator header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_PLANT_H
+#define FUZZY_PLANT_H
+#pragma once
+
+#include "context.h"
+#include "controller.h"
+#include "model.h"
+
+#include <stdint.h>
+
+// Lumped thermal model of the Peltier water tank:
+// > dT/dt = (ambient - T) / timeConstant + heatingRate * heater
+// >         - coolingRate * cooler + jouleRate * (heater^2 + cooler^2)
+// with the actuator powers heater and cooler in [0, 1]. The powers are held
+// between control cycles, so every step is solved exactly and the step size
+// is only limited by the control period. The sensor quantizes like a DS18B20
+// and can be made to drop readings.
+typedef struct {
+    double ambient;
+    double timeConstant;
+    // K/s at full power
+    double heatingRate;
+    double coolingRate;
+    double jouleRate;
+    double sensorResolution;
+    // probability that a reading fails
+    double sensorDropout;
+} FuzzyPlantParameters_t;
+
+typedef struct {
+    FuzzyPlantParameters_t parameters;
+    double temperature;
+    // actuator powers in percent, actuator 0 is the cooler, 1 the heater
+    double cooler;
+    double heater;
+    uint64_t random;
+    // signals the controller published
+    long messages;
+} FuzzyPlant_t;
+
+// One line of a controller log, NAN where the log has no actuator powers
+typedef struct {
+    double time;
+    double temperature;
+    double cooler;
+    double heater;
+} FuzzyPlantSample_t;
+
+// The scenario runs for steps periods. With maxPeriod above period the
+// controller adapts its rate within its deadbands, see FuzzyController_t, and
+// runs fewer cycles than steps; 0.0 keeps the rate fixed.
+typedef struct {
+    double start;
+    double ambient;
+    double target;
+    // seconds between control cycles
+    double period;
+    int steps;
+    uint64_t seed;
+    double maxPeriod;
+    double valueDeadband;
+    double changeDeadband;
+    double outputDeadband;
+} FuzzyPlantScenario_t;
+
+typedef struct {
+    double finalTemperature;
+    double minimum;
+    double maximum;
+    // mean squared deviation from the target and mean power of both actuators
+    double meanSquaredError;
+    double effort;
+    int sensorFaults;
+    // control cycles run and signals published
+    int cycles;
+    long messages;
+} FuzzyPlantResult_t;
+
+void FuzzyPlantDefaultParameters(FuzzyPlantParameters_t *parameters);
+
+void FuzzyPlantInit(FuzzyPlant_t *plant,
+                    const FuzzyPlantParameters_t *parameters,
+                    double temperature, uint64_t seed);
+void FuzzyPlantStep(FuzzyPlant_t *plant, double seconds);
+void FuzzyPlantIO(FuzzyControlIO_t *io, FuzzyPlant_t *plant);
+
+int FuzzyPlantRun(const FuzzyModel_t *model, FuzzyContext_t *context,
+                  const FuzzyPlantParameters_t *parameters,
+                  const FuzzyPlantScenario_t *scenario,
+                  FuzzyPlantResult_t *result);
+int FuzzyPlantRunBatch(const FuzzyModel_t *model, FuzzyContext_t *context,
+                       const FuzzyPlantParameters_t *parameters,
+                       const FuzzyPlantScenario_t *scenarios,
+                       int numScenarios, FuzzyPlantResult_t *results);
+
+int FuzzyPlantLoadLog(const char *path, FuzzyPlantSample_t **samples,
+                      int *numSamples);
+int FuzzyPlantFit(FuzzyPlantParameters_t *parameters,
+                  const FuzzyPlantSample_t *samples, int numSamples);
+
+#endif
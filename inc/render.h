@@ -0,0 +1,72 @@
+/**
+ * @file render.h
+ * @brief Fuzzy Logic diagnostic renderer header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_RENDER_H
+#define FUZZY_RENDER_H
+#pragma once
+
+#include "class.h"
+#include "context.h"
+#include "model.h"
+
+#include <stddef.h>
+
+typedef enum {
+    // a bar per term under a line with the crisp value, like printClassifier()
+    FUZZY_RENDER_BARS,
+    // one line per cycle, name=value [term membership ...]
+    FUZZY_RENDER_COMPACT,
+    // one JSON object per cycle and line,
+    // {"name":{"value":v,"terms":{"term":m,...}},...}
+    FUZZY_RENDER_JSON
+} FuzzyRenderFormat_e;
+
+typedef enum {
+    // nothing is rendered
+    FUZZY_RENDER_QUIET,
+    // the crisp values only
+    FUZZY_RENDER_VALUES,
+    // the crisp values and the terms with a non-zero membership
+    FUZZY_RENDER_ACTIVE,
+    // the crisp values and every term
+    FUZZY_RENDER_ALL
+} FuzzyRenderVerbosity_e;
+
+// Formats the diagnostics of a whole cycle into a caller-provided buffer, so
+// a cycle is emitted with a single write instead of a stdio call per value or
+// bar character. A variable that does not fit is dropped as a whole and the
+// render is marked truncated; the cycle is still closed properly, JSON output
+// stays valid.
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t length;
+    FuzzyRenderFormat_e format;
+    FuzzyRenderVerbosity_e verbosity;
+    // variables rendered in the current cycle
+    int numItems;
+    int truncated;
+} FuzzyRender_t;
+
+int FuzzyRenderInit(FuzzyRender_t *render, char *buffer, size_t size,
+                    FuzzyRenderFormat_e format,
+                    FuzzyRenderVerbosity_e verbosity);
+
+void FuzzyRenderBegin(FuzzyRender_t *render);
+void FuzzyRenderSet(FuzzyRender_t *render, const char *name, double value,
+                    const FuzzySet_t *set, const char **labels);
+void FuzzyRenderModel(FuzzyRender_t *render, const FuzzyModel_t *model,
+                      const FuzzyContext_t *context, const double *inputs);
+size_t FuzzyRenderEnd(FuzzyRender_t *render);
+
+int FuzzyRenderWrite(const FuzzyRender_t *render, int fd);
+
+#endif
@@ -0,0 +1,54 @@
+/**
+ * @file rule_matrix.h
+ * @brief Fuzzy Logic rule matrix header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_RULE_MATRIX_H
+#define FUZZY_RULE_MATRIX_H
+#pragma once
+
+#include "class.h"
+#include "inference.h"
+
+#define FUZZY_MATRIX_MAX_INPUTS 8
+#define FUZZY_MATRIX_MAX_OUTPUTS 8
+// A cell that does not write to an output
+#define FUZZY_MATRIX_NONE -1
+
+// A complete rule table: every combination of one term per input, a cell,
+// holds one consequent term per output. The cells are stored row major with
+// the last input varying fastest, the outputs of a cell are adjacent. A cell
+// is equivalent to one rule per output
+// > PROPOSITION(WHEN(ALL_OF(VAR(input0, t0), VAR(input1, t1), ...)),
+// >             THEN(output, cell[output]))
+// and the table to these rules in cell order.
+//
+// Only the cells of the active terms of every input are visited, at most
+// 2^numInputs for partitions, instead of scanning a rule per cell. The inputs
+// must be classified with FuzzyClassifier().
+typedef struct {
+    FuzzySet_t *inputs[FUZZY_MATRIX_MAX_INPUTS];
+    int numInputs;
+    FuzzySet_t *outputs[FUZZY_MATRIX_MAX_OUTPUTS];
+    int numOutputs;
+    // cells of the first term of each input are this far apart
+    int strides[FUZZY_MATRIX_MAX_INPUTS];
+    int numCells;
+    int *cells;
+    FuzzyOperators_e operators;
+} FuzzyRuleMatrix_t;
+
+int FuzzyRuleMatrixInit(FuzzyRuleMatrix_t *matrix, FuzzySet_t *const *inputs,
+                        int numInputs, FuzzySet_t *const *outputs,
+                        int numOutputs, const int *cells);
+void FuzzyRuleMatrixFree(FuzzyRuleMatrix_t *matrix);
+
+void FuzzyRuleMatrixInfer(const FuzzyRuleMatrix_t *matrix);
+
+#endif
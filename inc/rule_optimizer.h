@@ -0,0 +1,78 @@
+/**
+ * @file rule_optimizer.h
+ * @brief Fuzzy Logic static rule base optimizer header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_RULE_OPTIMIZER_H
+#define FUZZY_RULE_OPTIMIZER_H
+#pragma once
+
+#include "inference.h"
+
+// A rule base produced by the optimizer. The rules point into the antecedent
+// and variable arrays owned by the rule base; rules that share an antecedent
+// are adjacent and point to the very same FuzzyAntecedent_t array, which
+// fuzzyInference() evaluates only once.
+typedef struct {
+    FuzzyRule_t *rules;
+    int numRules;
+    FuzzyAntecedent_t *antecedents;
+    int numAntecedents;
+    FuzzyVariable_t *variables;
+    int numVariables;
+} FuzzyRuleBase_t;
+
+typedef struct {
+    int inputRules;
+    int inputLiterals;
+    int deadRules;
+    int prunedLiterals;
+    int mergedRules;
+    int subsumedRules;
+    int foldedRules;
+    int outputRules;
+    // literals evaluated per cycle, shared antecedents count once
+    int outputLiterals;
+} FuzzyRuleOptimizerReport_t;
+
+// How often the literals, groups and rules of a rule base were 0.0 (and
+// literals 1.0) over a workload. Counters are laid out in rule, group and
+// literal order: the groups of rule i start at firstGroup[i], the literals of
+// group g at firstLiteral[g].
+typedef struct {
+    long samples;
+    long *literalZeros;
+    long *literalOnes;
+    long *groupZeros;
+    long *ruleZeros;
+    int *firstGroup;
+    int *firstLiteral;
+    int numRules;
+    int numGroups;
+    int numLiterals;
+} FuzzyRuleProfile_t;
+
+int FuzzyRuleOptimize(const FuzzyRule_t *rules, int numRules,
+                      FuzzyRuleBase_t *base,
+                      FuzzyRuleOptimizerReport_t *report);
+
+void FuzzyRuleBaseFree(FuzzyRuleBase_t *base);
+
+int FuzzyRuleProfileInit(FuzzyRuleProfile_t *profile, const FuzzyRule_t *rules,
+                         int numRules);
+void FuzzyRuleProfileRecord(FuzzyRuleProfile_t *profile,
+                            const FuzzyRule_t *rules, int numRules);
+void FuzzyRuleProfileFree(FuzzyRuleProfile_t *profile);
+
+int FuzzyRuleReorder(const FuzzyRule_t *rules, int numRules,
+                     const FuzzyRuleProfile_t *profile, FuzzyRuleBase_t *base);
+
+void printRuleOptimizerReport(const FuzzyRuleOptimizerReport_t *report);
+
+#endif
@@ -0,0 +1,184 @@
+/**
+ * @file service.h
+ * @brief Fuzzy Logic local inference service header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_SERVICE_H
+#define FUZZY_SERVICE_H
+#pragma once
+
+#include "context.h"
+#include "model.h"
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A server hosts models for the processes of one machine. Clients connect to
+// a UNIX SOCK_SEQPACKET socket, so every request and reply is one message.
+// A client can send many requests before it reads the replies; replies come
+// back in the order of the requests.
+//
+// Small batches travel inline: the rows of inputs follow the request and the
+// rows of outputs follow the reply. Large batches go through a ring, a shared
+// memory file the client passes to the server once, on connecting. The client
+// writes the inputs into the ring and the server writes the outputs next to
+// them; the messages only carry the offsets. The server only maps a ring
+// sealed against shrinking, so a client can not fault it by truncating one.
+
+#define FUZZY_SERVICE_MAX_MESSAGE 65536
+#define FUZZY_SERVICE_MAX_MODELS 16
+#define FUZZY_SERVICE_MAX_CLIENTS 64
+#define FUZZY_SERVICE_MAX_PENDING 256
+
+typedef enum {
+    // payload: the model name, reply payload: FuzzyServiceModel_t
+    FUZZY_SERVICE_OPEN,
+    // carries the ring memfd, sealed with F_SEAL_SHRINK, count is its size
+    FUZZY_SERVICE_ATTACH,
+    // payload: count rows of inputs, reply payload: count rows of outputs
+    FUZZY_SERVICE_EVALUATE,
+    // the rows are in the ring at input, the outputs go to output
+    FUZZY_SERVICE_EVALUATE_SHARED
+} FuzzyServiceRequest_e;
+
+typedef struct {
+    uint32_t type;
+    // chosen by the client, echoed by the reply
+    uint32_t id;
+    uint32_t model;
+    // of a reply, 0 or a negative errno
+    int32_t status;
+    uint64_t count;
+    uint64_t input;
+    uint64_t output;
+    // of a reply, nanoseconds from receiving the request to replying
+    uint64_t latency;
+} FuzzyServiceMessage_t;
+
+typedef struct {
+    uint32_t model;
+    uint32_t numInputs;
+    uint32_t numOutputs;
+    uint32_t numRules;
+} FuzzyServiceModel_t;
+
+// ---------------------------------------------------------------------------
+// Server
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    char name[FUZZY_MODEL_NAME_LENGTH];
+    const FuzzyModel_t *model;
+    FuzzyContext_t context;
+} FuzzyServerModel_t;
+
+typedef struct {
+    int fd;
+    char *ring;
+    size_t ringSize;
+    // a reply the socket did not take yet, no request is read meanwhile
+    size_t pending;
+    char *request;
+    char *reply;
+} FuzzyServerClient_t;
+
+typedef struct {
+    uint64_t requests;
+    uint64_t rows;
+    uint64_t errors;
+    uint64_t totalLatency;
+    uint64_t maxLatency;
+} FuzzyServerStats_t;
+
+typedef struct {
+    char path[108];
+    int listenFd;
+    int epollFd;
+    FuzzyServerModel_t models[FUZZY_SERVICE_MAX_MODELS];
+    int numModels;
+    FuzzyServerClient_t *clients[FUZZY_SERVICE_MAX_CLIENTS];
+    // prints every request to stderr if set
+    int verbose;
+    FuzzyServerStats_t stats;
+} FuzzyServer_t;
+
+int FuzzyServerInit(FuzzyServer_t *server, const char *path);
+void FuzzyServerFree(FuzzyServer_t *server);
+int FuzzyServerAddModel(FuzzyServer_t *server, const char *name,
+                        const FuzzyModel_t *model);
+int FuzzyServerRun(FuzzyServer_t *server, volatile sig_atomic_t *stop,
+                   const sigset_t *signals);
+
+// ---------------------------------------------------------------------------
+// Client
+// ---------------------------------------------------------------------------
+
+// A batch in the ring: the client fills inputs, the server fills outputs
+typedef struct {
+    uint32_t model;
+    size_t count;
+    double *inputs;
+    double *outputs;
+    // ring position after the batch
+    uint64_t end;
+} FuzzyServiceBatch_t;
+
+typedef struct {
+    uint32_t id;
+    int32_t status;
+    size_t count;
+    // the outputs of a ring batch, valid until it is released
+    const double *outputs;
+    // nanoseconds the server spent on the request
+    uint64_t latency;
+    // nanoseconds from sending the request to receiving the reply
+    uint64_t roundTrip;
+    // ring position after the batch, 0 for an inline request
+    uint64_t end;
+} FuzzyServiceReply_t;
+
+typedef struct {
+    uint64_t sent;
+    uint64_t end;
+} FuzzyServicePending_t;
+
+typedef struct {
+    int fd;
+    char *ring;
+    size_t ringSize;
+    // ring positions grow forever, offsets are taken modulo the ring size
+    uint64_t head;
+    uint64_t tail;
+    uint32_t nextId;
+    uint32_t numPending;
+    FuzzyServicePending_t pending[FUZZY_SERVICE_MAX_PENDING];
+    FuzzyServiceModel_t models[FUZZY_SERVICE_MAX_MODELS];
+    char *message;
+} FuzzyServiceClient_t;
+
+int FuzzyServiceConnect(FuzzyServiceClient_t *client, const char *path,
+                        size_t ringSize);
+void FuzzyServiceClose(FuzzyServiceClient_t *client);
+int FuzzyServiceOpen(FuzzyServiceClient_t *client, const char *name,
+                     FuzzyServiceModel_t *model);
+
+int FuzzyServiceEvaluate(FuzzyServiceClient_t *client, uint32_t model,
+                         const double *inputs, size_t count);
+int FuzzyServiceBegin(FuzzyServiceClient_t *client, uint32_t model,
+                      size_t count, FuzzyServiceBatch_t *batch);
+int FuzzyServiceSubmit(FuzzyServiceClient_t *client,
+                       const FuzzyServiceBatch_t *batch);
+int FuzzyServiceReceive(FuzzyServiceClient_t *client,
+                        FuzzyServiceReply_t *reply, double *outputs,
+                        size_t maxOutputs);
+void FuzzyServiceRelease(FuzzyServiceClient_t *client,
+                         const FuzzyServiceReply_t *reply);
+
+#endif
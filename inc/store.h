@@ -0,0 +1,135 @@
+/**
+ * @file store.h
+ * @brief Fuzzy Logic time indexed telemetry store header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_STORE_H
+#define FUZZY_STORE_H
+#pragma once
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// A store is a directory of fixed size segment files, segment-00000000.fzs
+// and on, and series.txt with the names of the series, one per line. A
+// segment is a header page followed by records in time order:
+//
+// - the header sums up the segment: its time range, the count, minimum and
+//   maximum of every series, and a sparse index holding the time of every
+//   FUZZY_STORE_INDEX_STRIDE-th record
+// - a query walks only the segments whose time range and summaries can match,
+//   maps them read-only and starts scanning at the index entry before the
+//   start of the range
+//
+// One process appends, any number query, also while it appends: the writer
+// publishes a record by raising the count after writing it and its summary.
+
+#define FUZZY_STORE_MAGIC "FZST"
+#define FUZZY_STORE_VERSION 1
+#define FUZZY_STORE_HEADER_SIZE 4096
+#define FUZZY_STORE_SEGMENT_SIZE (1u << 20)
+#define FUZZY_STORE_MAX_SERIES 64
+#define FUZZY_STORE_NAME_LENGTH 48
+#define FUZZY_STORE_PATH_LENGTH 256
+#define FUZZY_STORE_INDEX_STRIDE 256
+#define FUZZY_STORE_INDEX_LENGTH 300
+
+typedef struct {
+    // seconds since the epoch
+    double time;
+    uint32_t series;
+    uint32_t reserved;
+    double value;
+} FuzzyStoreRecord_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t reserved;
+    double min;
+    double max;
+} FuzzyStoreSummary_t;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    // the number of records the segment holds
+    uint32_t capacity;
+    _Atomic uint32_t count;
+    double first;
+    double last;
+    FuzzyStoreSummary_t series[FUZZY_STORE_MAX_SERIES];
+    // the time of record k * FUZZY_STORE_INDEX_STRIDE
+    double index[FUZZY_STORE_INDEX_LENGTH];
+} FuzzyStoreSegmentHeader_t;
+
+// The time range of a segment, kept in memory for every segment
+typedef struct {
+    double first;
+    double last;
+    uint32_t count;
+    uint32_t capacity;
+} FuzzyStoreSegment_t;
+
+typedef struct {
+    char path[FUZZY_STORE_PATH_LENGTH];
+    int writable;
+    // the capacity of new segments
+    uint32_t capacity;
+    FuzzyStoreSegment_t *segments;
+    int numSegments;
+    int maxSegments;
+    char series[FUZZY_STORE_MAX_SERIES][FUZZY_STORE_NAME_LENGTH];
+    int numSeries;
+    // the last segment, mapped for appending
+    FuzzyStoreSegmentHeader_t *current;
+    size_t currentSize;
+} FuzzyStore_t;
+
+// Records with from <= time < to, lower <= value <= upper and of the series,
+// every series if it is -1
+typedef struct {
+    double from;
+    double to;
+    int series;
+    double lower;
+    double upper;
+} FuzzyStoreFilter_t;
+
+typedef struct {
+    FuzzyStore_t *store;
+    FuzzyStoreFilter_t filter;
+    int segment;
+    const FuzzyStoreSegmentHeader_t *mapping;
+    size_t mappingSize;
+    uint32_t position;
+    uint32_t count;
+    // what the query touched
+    int segmentsVisited;
+    int segmentsSkipped;
+    uint64_t recordsScanned;
+} FuzzyStoreQuery_t;
+
+int FuzzyStoreOpen(FuzzyStore_t *store, const char *path, int writable,
+                   size_t segmentSize);
+void FuzzyStoreClose(FuzzyStore_t *store);
+int FuzzyStoreRefresh(FuzzyStore_t *store);
+int FuzzyStoreSync(FuzzyStore_t *store);
+
+int FuzzyStoreSeries(FuzzyStore_t *store, const char *name);
+int FuzzyStoreAppend(FuzzyStore_t *store, int series, double time,
+                     double value);
+
+void FuzzyStoreFilterAll(FuzzyStoreFilter_t *filter);
+int FuzzyStoreQueryInit(FuzzyStoreQuery_t *query, FuzzyStore_t *store,
+                        const FuzzyStoreFilter_t *filter);
+int FuzzyStoreNext(FuzzyStoreQuery_t *query, FuzzyStoreRecord_t *record);
+void FuzzyStoreQueryFree(FuzzyStoreQuery_t *query);
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * @file telemetry.h
+ * @brief Fuzzy Logic telemetry serializer header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_TELEMETRY_H
+#define FUZZY_TELEMETRY_H
+#pragma once
+
+#include "context.h"
+#include "model.h"
+
+#include <stddef.h>
+
+// The buffer size FuzzyFormatFixed() needs, text and terminating zero
+#define FUZZY_FIXED_LENGTH 32
+#define FUZZY_FIXED_MAX_DECIMALS 9
+
+typedef enum {
+    FUZZY_TELEMETRY_JSON,
+    FUZZY_TELEMETRY_CBOR
+} FuzzyTelemetryFormat_e;
+
+// Serializes one telemetry document per cycle into a fixed buffer, without
+// allocating and without printf-family formatting:
+//
+//   {"time":1718000000.123,
+//    "inputs":{"Temperature":27.30,...},
+//    "outputs":{"PelCoolerSpeed":15.96,...},
+//    "active":{"Temperature":{"TEMPERATURE_LOW":0.540,...},...}}
+//
+// on a single line. CBOR documents are a map with the same keys and
+// structure, all numbers as doubles. The buffer is plain bytes, so the
+// publisher and the logger can share one encoded cycle.
+typedef struct {
+    char *buffer;
+    size_t size;
+    size_t length;
+    FuzzyTelemetryFormat_e format;
+    // decimals of the inputs and outputs in JSON, memberships get three
+    int decimals;
+} FuzzyTelemetry_t;
+
+int FuzzyTelemetryInit(FuzzyTelemetry_t *telemetry, char *buffer, size_t size,
+                       FuzzyTelemetryFormat_e format, int decimals);
+
+int FuzzyTelemetryEncode(FuzzyTelemetry_t *telemetry,
+                         const FuzzyModel_t *model,
+                         const FuzzyContext_t *context, const double *inputs,
+                         double time);
+
+int FuzzyFormatFixed(char *buffer, double value, int decimals);
+
+#endif
@@ -0,0 +1,97 @@
+/**
+ * @file trace.h
+ * @brief Fuzzy Logic evaluation trace header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_TRACE_H
+#define FUZZY_TRACE_H
+#pragma once
+
+#include "model.h"
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    // index: the number of the cycle, value: the wall clock in seconds
+    FUZZY_TRACE_CYCLE,
+    // index: the input variable, value: the crisp input
+    FUZZY_TRACE_INPUT,
+    // index: the model term, value: its non-zero membership
+    FUZZY_TRACE_MEMBERSHIP,
+    // index: the model rule, value: its non-zero strength
+    FUZZY_TRACE_RULE,
+    // index: the output variable, value: the crisp output
+    FUZZY_TRACE_OUTPUT
+} FuzzyTraceKind_e;
+
+typedef struct {
+    uint32_t kind;
+    uint32_t index;
+    double value;
+} FuzzyTraceRecord_t;
+
+// A preallocated ring of the last records of model evaluations. A context
+// with a trace records every cycle of FuzzyModelEvaluate(): the inputs, the
+// non-zero input memberships, the fired rules and the outputs. The capacity is
+// a power of two, so a record costs three stores and an increment.
+//
+// Recording is compiled in with -DFUZZY_TRACE only, otherwise the hooks
+// expand to nothing.
+typedef struct {
+    FuzzyTraceRecord_t *records;
+    uint64_t mask;
+    // records written so far, the ring holds the last mask + 1 of them
+    uint64_t head;
+    uint64_t cycles;
+} FuzzyTrace_t;
+
+int FuzzyTraceInit(FuzzyTrace_t *trace, int capacity);
+void FuzzyTraceFree(FuzzyTrace_t *trace);
+
+void FuzzyTraceCycle(FuzzyTrace_t *trace);
+
+int FuzzyTraceDumpFd(const FuzzyTrace_t *trace, int fd);
+int FuzzyTraceDump(const FuzzyTrace_t *trace, const char *path);
+int FuzzyTraceLoad(const char *path, FuzzyTraceRecord_t **records,
+                   int *numRecords);
+void FuzzyTracePrint(FILE *f, const FuzzyModel_t *model,
+                     const FuzzyTraceRecord_t *records, int numRecords);
+
+static inline void fuzzyTraceRecord(FuzzyTrace_t *trace, uint32_t kind,
+                                    uint32_t index, double value) {
+    FuzzyTraceRecord_t *record = &trace->records[trace->head++ & trace->mask];
+    record->kind = kind;
+    record->index = index;
+    record->value = value;
+}
+
+#ifdef FUZZY_TRACE
+#define FUZZY_TRACE_RECORD(_trace, _kind, _index, _value)                      \
+    do {                                                                       \
+        if ((_trace) != NULL) {                                                \
+            fuzzyTraceRecord(_trace, _kind, _index, _value);                   \
+        }                                                                      \
+    } while (0)
+#define FUZZY_TRACE_BEGIN_CYCLE(_trace)                                        \
+    do {                                                                       \
+        if ((_trace) != NULL) {                                                \
+            FuzzyTraceCycle(_trace);                                           \
+        }                                                                      \
+    } while (0)
+#else
+#define FUZZY_TRACE_RECORD(_trace, _kind, _index, _value)                      \
+    do {                                                                       \
+    } while (0)
+#define FUZZY_TRACE_BEGIN_CYCLE(_trace)                                        \
+    do {                                                                       \
+    } while (0)
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+/**
+ * @file tuner.h
+ * @brief Fuzzy Logic membership function tuner header.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#ifndef FUZZY_TUNER_H
+#define FUZZY_TUNER_H
+#pragma once
+
+#include "context.h"
+#include "model.h"
+
+#include <stdint.h>
+
+// The tuner searches the membership function parameters of a model with
+// differential evolution (DE/rand/1/bin). Rules and membership function types
+// stay as they are. Every candidate is a private copy of the model, the cost
+// function is called from several threads at once, each with its own context,
+// so it must not write anything shared.
+//
+// Positions (a, b, c, d of the piecewise linear shapes, the center of a
+// gaussian or bell, the inflection of a sigmoid) may move within the range of
+// their variable widened by `margin` on both sides and are kept in order.
+// Widths and slopes may shrink or grow by a factor of 10 and keep their sign.
+typedef double (*FuzzyTunerCost_t)(const FuzzyModel_t *model,
+                                   FuzzyContext_t *context, void *user);
+
+typedef struct {
+    // candidates per generation, 0 for 10 per parameter (at least 16)
+    int populationSize;
+    int generations;
+    // differential weight F and crossover probability CR
+    double weight;
+    double crossover;
+    // range widening for positions, relative to the variable range
+    double margin;
+    // worker threads including the caller, 0 for one per online CPU
+    int numThreads;
+    uint64_t seed;
+} FuzzyTunerOptions_t;
+
+typedef struct {
+    int parameters;
+    int populationSize;
+    int numThreads;
+    int generations;
+    long evaluations;
+    double initialCost;
+    double bestCost;
+    double seconds;
+    double evaluationsPerSecond;
+} FuzzyTunerReport_t;
+
+void FuzzyTunerDefaultOptions(FuzzyTunerOptions_t *options);
+
+int FuzzyTune(FuzzyModel_t *model, FuzzyTunerCost_t cost, void *user,
+              const FuzzyTunerOptions_t *options, FuzzyTunerReport_t *report);
+
+void printTunerReport(const FuzzyTunerReport_t *report);
+
+#endif
@@ -0,0 +1,494 @@
+/**
+ * @file fuzzycmodule.c
+ * @brief Fuzzy Logic CPython extension.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ * Batch evaluation of a model on buffers of doubles, e.g. numpy arrays:
+ *
+ *   import fuzzyc, numpy as np
+ *   model = fuzzyc.Model("PeltierControl.fzm")
+ *   t, d = np.meshgrid(np.linspace(0, 50, 1000), np.linspace(-5, 5, 1000))
+ *   out = np.asarray(model.evaluate(t.ravel(), d.ravel()))
+ *
+ * Inputs and outputs are read and written in place through the buffer
+ * protocol, and the GIL is released while the C library evaluates, so any
+ * number of Python threads can evaluate the same model at once.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "fuzzyc.h"
+
+#include <string.h>
+
+typedef struct {
+    PyObject_HEAD FuzzyModel_t model;
+    int loaded;
+} ModelObject;
+
+// ---------------------------------------------------------------------------
+// Buffers
+// ---------------------------------------------------------------------------
+
+// Gets a C contiguous buffer of native doubles
+static int getDoubles(PyObject *object, Py_buffer *view, int writable,
+                      const char *what) {
+    int flags = PyBUF_STRIDES | PyBUF_C_CONTIGUOUS | PyBUF_FORMAT;
+    if (writable) {
+        flags |= PyBUF_WRITABLE;
+    }
+    if (PyObject_GetBuffer(object, view, flags) != 0) {
+        return -1;
+    }
+    const char *format = view->format != NULL ? view->format : "B";
+    if (format[0] == '@' || format[0] == '=' || format[0] == '<') {
+        format++;
+    }
+    if (strcmp(format, "d") != 0 || view->itemsize != sizeof(double)) {
+        PyErr_Format(PyExc_TypeError,
+                     "%s must be a contiguous buffer of float64", what);
+        PyBuffer_Release(view);
+        return -1;
+    }
+    return 0;
+}
+
+// Checks that a buffer is 1-D, or 2-D with the given number of columns if
+// columns > 0, releases it if not
+static int checkShape(Py_buffer *view, Py_ssize_t columns, const char *what) {
+    if (columns <= 0 && view->ndim != 1) {
+        PyErr_Format(PyExc_ValueError, "%s must be 1-D", what);
+    } else if (columns > 0 &&
+               (view->ndim != 2 || view->shape[1] != columns)) {
+        PyErr_Format(PyExc_ValueError, "%s must have the shape (n, %zd)", what,
+                     columns);
+    } else {
+        return 0;
+    }
+    PyBuffer_Release(view);
+    return -1;
+}
+
+// A new (rows, columns) float64 memoryview over a fresh bytearray
+static PyObject *newDoubles(Py_ssize_t rows, Py_ssize_t columns) {
+    PyObject *bytes =
+        PyByteArray_FromStringAndSize(NULL, rows * columns * sizeof(double));
+    if (bytes == NULL) {
+        return NULL;
+    }
+    PyObject *view = PyMemoryView_FromObject(bytes);
+    Py_DECREF(bytes);
+    if (view == NULL) {
+        return NULL;
+    }
+    PyObject *cast = PyObject_CallMethod(view, "cast", "s(nn)", "d", rows,
+                                         columns);
+    Py_DECREF(view);
+    return cast;
+}
+
+// The out buffer of a call, given or new, with room for rows * columns
+static PyObject *outBuffer(PyObject *given, Py_ssize_t rows,
+                           Py_ssize_t columns, Py_buffer *view,
+                           const char *what) {
+    PyObject *out = given;
+    if (out == NULL || out == Py_None) {
+        out = newDoubles(rows, columns);
+        if (out == NULL) {
+            return NULL;
+        }
+    } else {
+        Py_INCREF(out);
+    }
+    if (getDoubles(out, view, 1, what) != 0) {
+        Py_DECREF(out);
+        return NULL;
+    }
+    if (view->len / (Py_ssize_t)sizeof(double) != rows * columns) {
+        PyErr_Format(PyExc_ValueError, "%s must hold %zd values", what,
+                     rows * columns);
+        PyBuffer_Release(view);
+        Py_DECREF(out);
+        return NULL;
+    }
+    return out;
+}
+
+static int variableIndex(const FuzzyModel_t *model, PyObject *variable) {
+    if (PyUnicode_Check(variable)) {
+        const char *name = PyUnicode_AsUTF8(variable);
+        int index = name != NULL ? FuzzyModelFindVariable(model, name) : -1;
+        if (index < 0 && !PyErr_Occurred()) {
+            PyErr_Format(PyExc_KeyError, "no variable %s", name);
+        }
+        return index;
+    }
+    long index = PyLong_AsLong(variable);
+    if (index == -1 && PyErr_Occurred()) {
+        return -1;
+    }
+    if (index < 0 || index >= model->numVariables) {
+        PyErr_Format(PyExc_IndexError, "no variable %ld", index);
+        return -1;
+    }
+    return (int)index;
+}
+
+// ---------------------------------------------------------------------------
+// Model
+// ---------------------------------------------------------------------------
+
+// Whether a model can be evaluated, raises if it can not
+static int evaluable(const ModelObject *self) {
+    if (!self->loaded) {
+        PyErr_SetString(PyExc_ValueError, "the model is not loaded");
+        return 0;
+    }
+    if (self->model.numInputs == 0) {
+        PyErr_SetString(PyExc_ValueError, "the model has no inputs");
+        return 0;
+    }
+    return 1;
+}
+
+static int Model_init(ModelObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"path", "text", NULL};
+    const char *path = NULL;
+    const char *text = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|zz", keywords, &path,
+                                     &text)) {
+        return -1;
+    }
+    if ((path == NULL) == (text == NULL)) {
+        PyErr_SetString(PyExc_TypeError, "give either a path or a text");
+        return -1;
+    }
+    if (self->loaded) {
+        // other threads may be evaluating the model without the GIL
+        PyErr_SetString(PyExc_RuntimeError, "the model is already loaded");
+        return -1;
+    }
+
+    FuzzyModelError_t error = {0};
+    int failed = path != NULL ? FuzzyModelLoad(&self->model, path, &error)
+                              : FuzzyModelParse(&self->model, text, &error);
+    if (failed) {
+        PyErr_Format(PyExc_ValueError, "%s:%d: %s",
+                     path != NULL ? path : "<text>", error.line,
+                     error.message);
+        return -1;
+    }
+    self->loaded = 1;
+    return 0;
+}
+
+static void Model_dealloc(ModelObject *self) {
+    if (self->loaded) {
+        FuzzyModelFree(&self->model);
+    }
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *variableNames(const FuzzyModel_t *model, uint32_t kind) {
+    int count = kind == FUZZY_MODEL_INPUT ? model->numInputs
+                                          : model->numOutputs;
+    PyObject *names = PyTuple_New(count);
+    if (names == NULL) {
+        return NULL;
+    }
+    int n = 0;
+    for (int i = 0; i < model->numVariables; i++) {
+        if (model->variables[i].kind != kind) {
+            continue;
+        }
+        PyObject *name = PyUnicode_FromString(model->variables[i].name);
+        if (name == NULL) {
+            Py_DECREF(names);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(names, n++, name);
+    }
+    return names;
+}
+
+static PyObject *Model_getInputs(ModelObject *self, void *closure) {
+    (void)closure;
+    return variableNames(&self->model, FUZZY_MODEL_INPUT);
+}
+
+static PyObject *Model_getOutputs(ModelObject *self, void *closure) {
+    (void)closure;
+    return variableNames(&self->model, FUZZY_MODEL_OUTPUT);
+}
+
+static PyObject *Model_getNumRules(ModelObject *self, void *closure) {
+    (void)closure;
+    return PyLong_FromLong(self->model.numRules);
+}
+
+static PyObject *Model_terms(ModelObject *self, PyObject *variable) {
+    if (!evaluable(self)) {
+        return NULL;
+    }
+    int index = variableIndex(&self->model, variable);
+    if (index < 0) {
+        return NULL;
+    }
+    const FuzzyModelVariable_t *v = &self->model.variables[index];
+    PyObject *names = PyTuple_New(v->numTerms);
+    if (names == NULL) {
+        return NULL;
+    }
+    for (uint32_t t = 0; t < v->numTerms; t++) {
+        PyObject *name =
+            PyUnicode_FromString(self->model.terms[v->firstTerm + t].name);
+        if (name == NULL) {
+            Py_DECREF(names);
+            return NULL;
+        }
+        PyTuple_SET_ITEM(names, t, name);
+    }
+    return names;
+}
+
+static PyObject *Model_classify(ModelObject *self, PyObject *args,
+                                PyObject *kwargs) {
+    static char *keywords[] = {"variable", "x", "out", NULL};
+    PyObject *variable, *x, *given = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "OO|O", keywords,
+                                     &variable, &x, &given) ||
+        !evaluable(self)) {
+        return NULL;
+    }
+    const FuzzyModel_t *model = &self->model;
+    int index = variableIndex(model, variable);
+    if (index < 0) {
+        return NULL;
+    }
+    if (model->variables[index].kind != FUZZY_MODEL_INPUT) {
+        PyErr_SetString(PyExc_ValueError, "only inputs are classified");
+        return NULL;
+    }
+
+    Py_buffer xView, outView;
+    if (getDoubles(x, &xView, 0, "x") != 0 ||
+        checkShape(&xView, 0, "x") != 0) {
+        return NULL;
+    }
+    Py_ssize_t n = xView.len / (Py_ssize_t)sizeof(double);
+    const FuzzyModelVariable_t *v = &model->variables[index];
+    PyObject *out = outBuffer(given, n, v->numTerms, &outView, "out");
+    if (out == NULL) {
+        PyBuffer_Release(&xView);
+        return NULL;
+    }
+
+    FuzzyContext_t context;
+    if (FuzzyContextInit(&context, model) != 0) {
+        PyBuffer_Release(&xView);
+        PyBuffer_Release(&outView);
+        Py_DECREF(out);
+        return PyErr_NoMemory();
+    }
+
+    const double *values = xView.buf;
+    double *memberships = outView.buf;
+    Py_BEGIN_ALLOW_THREADS;
+    for (Py_ssize_t i = 0; i < n; i++) {
+        FuzzyModelClassify(model, &context, index, values[i]);
+        memcpy(&memberships[i * v->numTerms],
+               &context.memberships[v->firstTerm],
+               v->numTerms * sizeof(double));
+    }
+    Py_END_ALLOW_THREADS;
+
+    FuzzyContextFree(&context);
+    PyBuffer_Release(&xView);
+    PyBuffer_Release(&outView);
+    return out;
+}
+
+static PyObject *Model_evaluate(ModelObject *self, PyObject *args,
+                                PyObject *kwargs) {
+    if (!evaluable(self)) {
+        return NULL;
+    }
+    const FuzzyModel_t *model = &self->model;
+    int numInputs = model->numInputs;
+    int numOutputs = model->numOutputs;
+    Py_ssize_t numArgs = PyTuple_GET_SIZE(args);
+    if (numArgs != 1 && numArgs != numInputs) {
+        PyErr_Format(PyExc_TypeError,
+                     "evaluate takes one (n, %d) buffer or %d columns",
+                     numInputs, numInputs);
+        return NULL;
+    }
+
+    PyObject *given = NULL, *givenMemberships = NULL;
+    if (kwargs != NULL) {
+        given = PyDict_GetItemString(kwargs, "out");
+        givenMemberships = PyDict_GetItemString(kwargs, "memberships");
+        Py_ssize_t known = (given != NULL) + (givenMemberships != NULL);
+        if (PyDict_Size(kwargs) != known) {
+            PyErr_SetString(PyExc_TypeError,
+                            "evaluate only takes out and memberships");
+            return NULL;
+        }
+    }
+
+    // one interleaved buffer or one column per input
+    Py_buffer views[FUZZY_ENGINE_MAX_SETS];
+    const double *columns[FUZZY_ENGINE_MAX_SETS];
+    int stride = numArgs == 1 ? numInputs : 1;
+    Py_ssize_t n = -1;
+    if (numInputs > FUZZY_ENGINE_MAX_SETS) {
+        PyErr_SetString(PyExc_ValueError, "too many inputs");
+        return NULL;
+    }
+    for (Py_ssize_t a = 0; a < numArgs; a++) {
+        // a single input may also come as one column
+        if (getDoubles(PyTuple_GET_ITEM(args, a), &views[a], 0, "inputs") ||
+            checkShape(&views[a],
+                       numArgs == 1 && !(numInputs == 1 && views[a].ndim == 1)
+                           ? numInputs
+                           : 0,
+                       "inputs")) {
+            while (a-- > 0) {
+                PyBuffer_Release(&views[a]);
+            }
+            return NULL;
+        }
+        Py_ssize_t rows = views[a].len / (Py_ssize_t)sizeof(double) / stride;
+        if ((n >= 0 && rows != n) ||
+            rows * stride * (Py_ssize_t)sizeof(double) != views[a].len) {
+            PyErr_SetString(PyExc_ValueError, "the inputs do not line up");
+            for (; a >= 0; a--) {
+                PyBuffer_Release(&views[a]);
+            }
+            return NULL;
+        }
+        n = rows;
+    }
+    for (int k = 0; k < numInputs; k++) {
+        columns[k] = numArgs == 1 ? (const double *)views[0].buf + k
+                                  : (const double *)views[k].buf;
+    }
+
+    Py_buffer outView, membershipView;
+    PyObject *out = outBuffer(given, n, numOutputs, &outView, "out");
+    PyObject *memberships = NULL;
+    if (out != NULL && givenMemberships != NULL) {
+        memberships = outBuffer(givenMemberships, n, model->numTerms,
+                                &membershipView, "memberships");
+        if (memberships == NULL) {
+            PyBuffer_Release(&outView);
+            Py_CLEAR(out);
+        }
+    }
+
+    FuzzyContext_t context;
+    if (out != NULL && FuzzyContextInit(&context, model) != 0) {
+        PyBuffer_Release(&outView);
+        if (memberships != NULL) {
+            PyBuffer_Release(&membershipView);
+            Py_DECREF(memberships);
+        }
+        Py_CLEAR(out);
+        PyErr_NoMemory();
+    }
+
+    if (out != NULL) {
+        double *outputs = outView.buf;
+        double *allMemberships = memberships != NULL ? membershipView.buf
+                                                     : NULL;
+        Py_BEGIN_ALLOW_THREADS;
+        double inputs[FUZZY_ENGINE_MAX_SETS];
+        for (Py_ssize_t i = 0; i < n; i++) {
+            for (int k = 0; k < numInputs; k++) {
+                inputs[k] = columns[k][i * stride];
+            }
+            FuzzyModelEvaluate(model, &context, inputs,
+                               &outputs[i * numOutputs]);
+            if (allMemberships != NULL) {
+                memcpy(&allMemberships[i * model->numTerms],
+                       context.memberships, model->numTerms * sizeof(double));
+            }
+        }
+        Py_END_ALLOW_THREADS;
+
+        FuzzyContextFree(&context);
+        PyBuffer_Release(&outView);
+        if (memberships != NULL) {
+            PyBuffer_Release(&membershipView);
+            Py_DECREF(memberships);
+        }
+    }
+
+    for (Py_ssize_t a = 0; a < numArgs; a++) {
+        PyBuffer_Release(&views[a]);
+    }
+    return out;
+}
+
+static PyGetSetDef Model_getset[] = {
+    {"inputs", (getter)Model_getInputs, NULL, "names of the inputs", NULL},
+    {"outputs", (getter)Model_getOutputs, NULL, "names of the outputs", NULL},
+    {"num_rules", (getter)Model_getNumRules, NULL, "number of rules", NULL},
+    {NULL, NULL, NULL, NULL, NULL}};
+
+static PyMethodDef Model_methods[] = {
+    {"terms", (PyCFunction)Model_terms, METH_O,
+     "terms(variable) -> names of the terms of a variable, by name or index"},
+    {"classify", (PyCFunction)(void (*)(void))Model_classify,
+     METH_VARARGS | METH_KEYWORDS,
+     "classify(variable, x, out=None) -> (n, terms) float64 memberships of "
+     "an input for every value of x"},
+    {"evaluate", (PyCFunction)(void (*)(void))Model_evaluate,
+     METH_VARARGS | METH_KEYWORDS,
+     "evaluate(inputs | *columns, out=None, memberships=None) -> (n, outputs)"
+     " float64\n\n"
+     "Evaluates the model for every row of an (n, inputs) buffer or for one "
+     "column per input. out receives the outputs, memberships the (n, terms) "
+     "memberships of every model term if given."},
+    {NULL, NULL, 0, NULL}};
+
+static PyTypeObject ModelType = {
+    PyVarObject_HEAD_INIT(NULL, 0).tp_name = "fuzzyc.Model",
+    .tp_doc = "Model(path=None, text=None)\n\nA fuzzy model loaded from a "
+              "model description file or parsed from its text.",
+    .tp_basicsize = sizeof(ModelObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_new = PyType_GenericNew,
+    .tp_init = (initproc)Model_init,
+    .tp_dealloc = (destructor)Model_dealloc,
+    .tp_methods = Model_methods,
+    .tp_getset = Model_getset,
+};
+
+static struct PyModuleDef fuzzycModule = {
+    PyModuleDef_HEAD_INIT, .m_name = "fuzzyc",
+    .m_doc = "Batch evaluation of fuzzyc models on float64 buffers.",
+    .m_size = -1,
+};
+
+PyMODINIT_FUNC PyInit_fuzzyc(void) {
+    if (PyType_Ready(&ModelType) < 0) {
+        return NULL;
+    }
+    PyObject *module = PyModule_Create(&fuzzycModule);
+    if (module == NULL) {
+        return NULL;
+    }
+    Py_INCREF(&ModelType);
+    if (PyModule_AddObject(module, "Model", (PyObject *)&ModelType) < 0) {
+        Py_DECREF(&ModelType);
+        Py_DECREF(module);
+        return NULL;
+    }
+    return module;
+}
@@ -0,0 +1,455 @@
+/**
+ * @file cascade.c
+ * @brief Fuzzy Logic cascaded rule bases implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "cascade.h"
+
+#include "classifier.h"
+#include "defuzzifier.h"
+#include "inference.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CASCADE_SAMPLES 4096
+
+/**
+ * Initializes an empty cascade.
+ */
+void FuzzyCascadeInit(FuzzyCascade_t *cascade) {
+    memset(cascade, 0, sizeof(*cascade));
+}
+
+/**
+ * Releases the relations of the links. The stages stay with the caller.
+ */
+void FuzzyCascadeFree(FuzzyCascade_t *cascade) {
+    for (int i = 0; i < cascade->numExplicitLinks; i++) {
+        free(cascade->links[i].matrix);
+    }
+    memset(cascade, 0, sizeof(*cascade));
+}
+
+/**
+ * Adds an engine as a stage. The order of the stages does not matter, they
+ * are sorted by FuzzyCascadePrepare().
+ *
+ * @param cascade The cascade.
+ * @param engine The engine of the stage, referenced, not copied.
+ * @param index The rule index of the engine to infer sparsely, or NULL.
+ * @return The number of the stage, -1 if the cascade is full.
+ */
+int FuzzyCascadeAddStage(FuzzyCascade_t *cascade, FuzzyEngine_t *engine,
+                         FuzzyEngineIndex_t *index) {
+    if (cascade->numStages == FUZZY_CASCADE_MAX_STAGES) {
+        return -1;
+    }
+    FuzzyCascadeStage_t *stage = &cascade->stages[cascade->numStages];
+    stage->engine = engine;
+    stage->index = index;
+    return cascade->numStages++;
+}
+
+/**
+ * Links the output set of one stage to an input set of another one with
+ * different terms, e.g. a coarse intermediate variable to a finer one.
+ *
+ * @param cascade The cascade, before FuzzyCascadePrepare().
+ * @param from An output set of a stage.
+ * @param to An input set of a later stage, no stage may produce it.
+ * @param matrix to->length rows of from->length relations in [0, 1], copied,
+ * e.g. from FuzzyCascadeTermMatrix(). NULL copies the memberships of sets of
+ * the same length.
+ * @return 0 on success, -1 if the sets do not fit or the cascade is full.
+ */
+int FuzzyCascadeLink(FuzzyCascade_t *cascade, FuzzySet_t *from,
+                     FuzzySet_t *to, const double *matrix) {
+    if (cascade->numExplicitLinks == FUZZY_CASCADE_MAX_LINKS || from == to ||
+        (matrix == NULL && from->length != to->length)) {
+        return -1;
+    }
+    for (int i = 0; i < cascade->numExplicitLinks; i++) {
+        if (cascade->links[i].to == to) {
+            return -1;
+        }
+    }
+
+    FuzzyCascadeLink_t *link = &cascade->links[cascade->numExplicitLinks];
+    memset(link, 0, sizeof(*link));
+    if (matrix != NULL) {
+        size_t size = (size_t)to->length * from->length * sizeof(double);
+        link->matrix = malloc(size);
+        if (link->matrix == NULL) {
+            return -1;
+        }
+        memcpy(link->matrix, matrix, size);
+    }
+    link->from = from;
+    link->to = to;
+    cascade->numExplicitLinks++;
+    cascade->numLinks = cascade->numExplicitLinks;
+    return 0;
+}
+
+// The range a set is sampled over, widened past unbounded supports
+static void samplingRange(const FuzzySet_t *set, double *lower,
+                          double *upper) {
+    double spread = set->maxOutput - set->minOutput;
+    if (!(spread > 0.0)) {
+        spread = 1.0;
+    }
+    *lower = isfinite(set->universeLower) ? set->universeLower
+                                          : set->minOutput - spread;
+    *upper = isfinite(set->universeUpper) ? set->universeUpper
+                                          : set->maxOutput + spread;
+}
+
+// Raises the relations to the intersections of the terms at x
+static void relateAt(const FuzzySet_t *from, const FuzzySet_t *to, double x,
+                     double *matrix) {
+    for (int j = 0; j < from->length; j++) {
+        double a = membershipFunction(x, from->membershipFunctions[j]);
+        if (a <= 0.0) {
+            continue;
+        }
+        for (int i = 0; i < to->length; i++) {
+            double b = membershipFunction(x, to->membershipFunctions[i]);
+            double *relation = &matrix[i * from->length + j];
+            *relation = fmax(*relation, fmin(a, b));
+        }
+    }
+}
+
+/**
+ * Derives the relation between the terms of two sets over the same universe:
+ * the height of the intersection of every pair of terms,
+ * > matrix[i * from->length + j] = sup_x min(to_i(x), from_j(x))
+ * sampled at 4096 points and at the breakpoints of the terms. Overlapping
+ * cores relate with 1.0, terms that only touch with the height of their
+ * crossing.
+ *
+ * @param from The set the memberships come from.
+ * @param to The set the memberships go to.
+ * @param matrix Receives to->length rows of from->length relations.
+ * @return 0 on success, -1 if the sets share no sampling range.
+ */
+int FuzzyCascadeTermMatrix(const FuzzySet_t *from, const FuzzySet_t *to,
+                           double *matrix) {
+    double fromLower, fromUpper, toLower, toUpper;
+    samplingRange(from, &fromLower, &fromUpper);
+    samplingRange(to, &toLower, &toUpper);
+    double lower = fmin(fromLower, toLower);
+    double upper = fmax(fromUpper, toUpper);
+    if (!(upper > lower) || !isfinite(upper - lower)) {
+        return -1;
+    }
+
+    memset(matrix, 0, (size_t)to->length * from->length * sizeof(double));
+    double step = (upper - lower) / (CASCADE_SAMPLES - 1);
+    for (int k = 0; k < CASCADE_SAMPLES; k++) {
+        relateAt(from, to, lower + k * step, matrix);
+    }
+    // the peaks and shoulders of the terms, where a sample would miss 1.0
+    const FuzzySet_t *sets[] = {from, to};
+    for (int s = 0; s < 2; s++) {
+        for (int t = 0; t < sets[s]->length; t++) {
+            MembershipFunction_t mf = sets[s]->membershipFunctions[t];
+            double points[] = {mf.a, mf.b, mf.c, mf.d};
+            for (int k = 0; k < 4; k++) {
+                if (points[k] >= lower && points[k] <= upper) {
+                    relateAt(from, to, points[k], matrix);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// The stage whose engine outputs a set, -1 if none does, -2 if several do
+static int producerOf(const FuzzyCascade_t *cascade, const FuzzySet_t *set) {
+    int producer = -1;
+    for (int s = 0; s < cascade->numStages; s++) {
+        if (FuzzyEngineOutputIndex(cascade->stages[s].engine, set) >= 0) {
+            if (producer >= 0) {
+                return -2;
+            }
+            producer = s;
+        }
+    }
+    return producer;
+}
+
+// The first stage whose engine reads a set, -1 if none does
+static int consumerOf(const FuzzyCascade_t *cascade, const FuzzySet_t *set) {
+    for (int s = 0; s < cascade->numStages; s++) {
+        if (FuzzyEngineInputIndex(cascade->stages[s].engine, set) >= 0) {
+            return s;
+        }
+    }
+    return -1;
+}
+
+// The link feeding a set, NULL if the set is not fed by a stage
+static const FuzzyCascadeLink_t *linkTo(const FuzzyCascade_t *cascade,
+                                        const FuzzySet_t *set) {
+    for (int i = 0; i < cascade->numLinks; i++) {
+        if (cascade->links[i].to == set) {
+            return &cascade->links[i];
+        }
+    }
+    return NULL;
+}
+
+static bool linksFrom(const FuzzyCascade_t *cascade, const FuzzySet_t *set) {
+    for (int i = 0; i < cascade->numLinks; i++) {
+        if (cascade->links[i].from == set) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static int registerSet(FuzzySet_t **sets, int *numSets, FuzzySet_t *set) {
+    for (int i = 0; i < *numSets; i++) {
+        if (sets[i] == set) {
+            return 0;
+        }
+    }
+    if (*numSets == FUZZY_CASCADE_MAX_SETS) {
+        return -1;
+    }
+    sets[(*numSets)++] = set;
+    return 0;
+}
+
+/**
+ * Resolves the links, sorts the stages topologically and registers the
+ * inputs and outputs of the cascade. Call it again after adding stages or
+ * links.
+ *
+ * @param cascade The cascade.
+ * @return 0 on success, -1 if a set is output by several stages, a link
+ * does not connect two stages, the stages form a cycle or the cascade has
+ * more than FUZZY_CASCADE_MAX_SETS inputs or outputs.
+ */
+int FuzzyCascadePrepare(FuzzyCascade_t *cascade) {
+    cascade->numLinks = cascade->numExplicitLinks;
+    cascade->numInputs = 0;
+    cascade->numOutputs = 0;
+
+    for (int i = 0; i < cascade->numExplicitLinks; i++) {
+        FuzzyCascadeLink_t *link = &cascade->links[i];
+        link->producer = producerOf(cascade, link->from);
+        link->consumer = consumerOf(cascade, link->to);
+        if (link->producer < 0 || link->consumer < 0 ||
+            producerOf(cascade, link->to) != -1) {
+            return -1;
+        }
+    }
+
+    // output sets read by other stages are passed through
+    for (int s = 0; s < cascade->numStages; s++) {
+        const FuzzyEngine_t *engine = cascade->stages[s].engine;
+        for (int i = 0; i < engine->numInputs; i++) {
+            FuzzySet_t *set = engine->inputs[i];
+            int producer = producerOf(cascade, set);
+            if (producer == -2 || producer == s) {
+                return -1;
+            }
+            if (producer < 0 || linkTo(cascade, set) != NULL) {
+                continue;
+            }
+            if (cascade->numLinks == FUZZY_CASCADE_MAX_LINKS) {
+                return -1;
+            }
+            cascade->links[cascade->numLinks++] = (FuzzyCascadeLink_t){
+                .from = set, .to = set, .producer = producer, .consumer = s};
+        }
+    }
+
+    // stage b depends on stage a if a feeds one of its inputs
+    bool depends[FUZZY_CASCADE_MAX_STAGES][FUZZY_CASCADE_MAX_STAGES] = {0};
+    int numDependencies[FUZZY_CASCADE_MAX_STAGES] = {0};
+    for (int b = 0; b < cascade->numStages; b++) {
+        const FuzzyEngine_t *engine = cascade->stages[b].engine;
+        for (int i = 0; i < engine->numInputs; i++) {
+            const FuzzyCascadeLink_t *link = linkTo(cascade, engine->inputs[i]);
+            if (link != NULL && !depends[b][link->producer]) {
+                depends[b][link->producer] = true;
+                numDependencies[b]++;
+            }
+        }
+    }
+
+    bool placed[FUZZY_CASCADE_MAX_STAGES] = {0};
+    for (int n = 0; n < cascade->numStages; n++) {
+        int next = 0;
+        while (next < cascade->numStages &&
+               (placed[next] || numDependencies[next] > 0)) {
+            next++;
+        }
+        if (next == cascade->numStages) {
+            return -1;
+        }
+        placed[next] = true;
+        cascade->order[n] = next;
+        for (int b = 0; b < cascade->numStages; b++) {
+            if (depends[b][next]) {
+                numDependencies[b]--;
+            }
+        }
+    }
+
+    for (int s = 0; s < cascade->numStages; s++) {
+        const FuzzyEngine_t *engine = cascade->stages[s].engine;
+        for (int i = 0; i < engine->numInputs; i++) {
+            if (linkTo(cascade, engine->inputs[i]) == NULL &&
+                registerSet(cascade->inputs, &cascade->numInputs,
+                            engine->inputs[i])) {
+                return -1;
+            }
+        }
+        for (int i = 0; i < engine->numOutputs; i++) {
+            if (producerOf(cascade, engine->outputs[i]) == -2) {
+                return -1;
+            }
+            if (!linksFrom(cascade, engine->outputs[i]) &&
+                registerSet(cascade->outputs, &cascade->numOutputs,
+                            engine->outputs[i])) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/**
+ * Returns the index of an input set of the cascade, or -1.
+ */
+int FuzzyCascadeInputIndex(const FuzzyCascade_t *cascade,
+                           const FuzzySet_t *set) {
+    for (int i = 0; i < cascade->numInputs; i++) {
+        if (cascade->inputs[i] == set) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Returns the index of an output set of the cascade, or -1.
+ */
+int FuzzyCascadeOutputIndex(const FuzzyCascade_t *cascade,
+                            const FuzzySet_t *set) {
+    for (int i = 0; i < cascade->numOutputs; i++) {
+        if (cascade->outputs[i] == set) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#define CASCADE_COMPOSE(family)                                                \
+    for (int i = 0; i < to->length; i++) {                                     \
+        const double *row = &link->matrix[i * from->length];                   \
+        double membership = 0.0;                                               \
+        for (int j = 0; j < from->length; j++) {                               \
+            membership = FUZZY_SNORM_##family(                                 \
+                membership, FUZZY_TNORM_##family(from->membershipValues[j],   \
+                                                 row[j]));                     \
+        }                                                                      \
+        to->membershipValues[i] = membership;                                  \
+    }
+
+// Moves the memberships along a link and lists the active terms of its target
+static void applyLink(const FuzzyCascade_t *cascade,
+                      const FuzzyCascadeLink_t *link) {
+    const FuzzySet_t *from = link->from;
+    FuzzySet_t *to = link->to;
+    if (from != to && link->matrix == NULL) {
+        memcpy(to->membershipValues, from->membershipValues,
+               to->length * sizeof(double));
+    } else if (from != to) {
+        switch (cascade->stages[link->consumer].engine->operators) {
+        case FUZZY_PRODUCT:
+            CASCADE_COMPOSE(PRODUCT)
+            break;
+        case FUZZY_LUKASIEWICZ:
+            CASCADE_COMPOSE(LUKASIEWICZ)
+            break;
+        case FUZZY_MIN_MAX:
+        default:
+            CASCADE_COMPOSE(MIN_MAX)
+            break;
+        }
+    }
+
+    // sparse inference walks the active terms a classification would list
+    to->numActive = 0;
+    for (int i = 0; i < to->length; i++) {
+        if (to->membershipValues[i] > 0.0) {
+            to->activeTerms[to->numActive++] = i;
+        }
+    }
+}
+
+/**
+ * Runs every stage once, in topological order. The memberships of the
+ * outputs of a stage reach the stages they feed right after it ran. The
+ * inputs of the cascade must have been classified already.
+ *
+ * @param cascade The prepared cascade.
+ */
+void FuzzyCascadeInfer(const FuzzyCascade_t *cascade) {
+    for (int n = 0; n < cascade->numStages; n++) {
+        int s = cascade->order[n];
+        const FuzzyCascadeStage_t *stage = &cascade->stages[s];
+        if (stage->index != NULL) {
+            FuzzyEngineInferSparse(stage->engine, stage->index);
+        } else {
+            FuzzyEngineInfer(stage->engine);
+        }
+        for (int i = 0; i < cascade->numLinks; i++) {
+            if (cascade->links[i].producer == s) {
+                applyLink(cascade, &cascade->links[i]);
+            }
+        }
+    }
+}
+
+/**
+ * Defuzzifies every output of the cascade once.
+ *
+ * @param cascade The cascade whose outputs to defuzzify.
+ * @param outputs Receives one crisp value per output, in registration order.
+ */
+void FuzzyCascadeDefuzzify(const FuzzyCascade_t *cascade, double *outputs) {
+    for (int i = 0; i < cascade->numOutputs; i++) {
+        outputs[i] = defuzzification(cascade->outputs[i]);
+    }
+}
+
+/**
+ * Classifies the inputs, runs every stage and defuzzifies the outputs.
+ *
+ * @param cascade The prepared cascade.
+ * @param inputs One crisp value per input, in registration order.
+ * @param outputs Receives one crisp value per output, in registration order.
+ */
+void FuzzyCascadeEvaluate(const FuzzyCascade_t *cascade, const double *inputs,
+                          double *outputs) {
+    for (int i = 0; i < cascade->numInputs; i++) {
+        FuzzyClassifier(inputs[i], cascade->inputs[i]);
+    }
+    FuzzyCascadeInfer(cascade);
+    FuzzyCascadeDefuzzify(cascade, outputs);
+}
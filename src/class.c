@@ -13,16 +13,19 @@
 
 #include "membership_function.h"
 #include "defuzzifier.h"
+#include "render.h"
 
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 /**
  * Initializes a FuzzySet_t struct.
  *
  * This function allocates memory for the membership values in the FuzzySet_t
- * struct.
+ * struct. The membership values start out as 0.0, so terms that no rule ever
+ * writes to do not contribute to normalization or defuzzification.
  *
  * @param set The FuzzySet_t struct to initialize.
  * @param membershipFunctions The membership functions for this FuzzySet_t.
@@ -33,13 +36,107 @@ void FuzzySetInit(FuzzySet_t *set,
 
     set->length = length;
 
-    set->membershipValues = (double *)malloc(length * sizeof(double));
+    set->membershipValues = (double *)calloc(length, sizeof(double));
     set->membershipFunctions =
         (MembershipFunction_t *)malloc(length * sizeof(MembershipFunction_t));
+    set->activeTerms = (int *)malloc(length * sizeof(int));
+    set->numActive = 0;
+    set->index = NULL;
+    set->termData = (MembershipFunctionData_t *)malloc(
+        length * sizeof(MembershipFunctionData_t));
 
     for (int i = 0; i < length; i++) {
         set->membershipFunctions[i] = membershipFunctions[i];
     }
+
+    FuzzySetPrepare(set);
+}
+
+/**
+ * Derives the per term data and the breakpoint index of a set.
+ *
+ * FuzzySetInit() prepares a set already, call it again after changing the
+ * membership functions of a set.
+ *
+ * @param set The FuzzySet_t struct to prepare.
+ * @return 0 if the set is indexed, -1 if it can not be (see
+ * FuzzySetBuildIndex()).
+ */
+int FuzzySetPrepare(FuzzySet_t *set) {
+    set->minOutput = INFINITY;
+    set->maxOutput = -INFINITY;
+    set->universeLower = INFINITY;
+    set->universeUpper = -INFINITY;
+
+    for (int i = 0; i < set->length; i++) {
+        MembershipFunctionData_t *data = &set->termData[i];
+        membershipFunctionPrepare(set->membershipFunctions[i], data);
+        data->centroid = calculateCentroid(set->membershipFunctions[i], 1.0);
+
+        set->minOutput = fmin(set->minOutput, data->centroid);
+        set->maxOutput = fmax(set->maxOutput, data->centroid);
+        set->universeLower = fmin(set->universeLower, data->lower);
+        set->universeUpper = fmax(set->universeUpper, data->upper);
+    }
+
+    return FuzzySetBuildIndex(set);
+}
+
+/**
+ * Builds the breakpoint index of a set.
+ *
+ * FuzzySetPrepare() builds it already. Sets with a term of unbounded support (the
+ * smooth shapes) are not indexed and classify every term.
+ *
+ * @param set The FuzzySet_t struct to index.
+ * @return 0 if the set is indexed, -1 if it can not be.
+ */
+int FuzzySetBuildIndex(FuzzySet_t *set) {
+    free(set->index);
+    set->index = NULL;
+
+    // the membership values and active terms are rebuilt from scratch
+    memset(set->membershipValues, 0, set->length * sizeof(double));
+    set->numActive = 0;
+
+    int n = set->length;
+    FuzzySetIndex_t *index = malloc(sizeof(FuzzySetIndex_t) +
+                                    3 * n * sizeof(double) + n * sizeof(int));
+    if (index == NULL) {
+        return -1;
+    }
+    index->lower = (double *)(index + 1);
+    index->upper = index->lower + n;
+    index->reach = index->upper + n;
+    index->terms = (int *)(index->reach + n);
+
+    // insertion sort by the lower end of the support, sets are small and
+    // usually ordered already
+    for (int i = 0; i < n; i++) {
+        double lower = set->termData[i].lower;
+        double upper = set->termData[i].upper;
+        if (isinf(lower) || isinf(upper) || isnan(lower) || isnan(upper)) {
+            free(index);
+            return -1;
+        }
+        int j = i;
+        for (; j > 0 && index->lower[j - 1] > lower; j--) {
+            index->lower[j] = index->lower[j - 1];
+            index->upper[j] = index->upper[j - 1];
+            index->terms[j] = index->terms[j - 1];
+        }
+        index->lower[j] = lower;
+        index->upper[j] = upper;
+        index->terms[j] = i;
+    }
+
+    for (int i = 0; i < n; i++) {
+        index->reach[i] = i > 0 ? fmax(index->reach[i - 1], index->upper[i])
+                                : index->upper[i];
+    }
+
+    set->index = index;
+    return 0;
 }
 
 /**
@@ -53,6 +150,9 @@ void FuzzySetInit(FuzzySet_t *set,
 void FuzzySetFree(FuzzySet_t *set) {
     free(set->membershipValues);
     free(set->membershipFunctions);
+    free(set->activeTerms);
+    free(set->index);
+    free(set->termData);
 }
 
 /**
@@ -60,36 +160,14 @@ void FuzzySetFree(FuzzySet_t *set) {
  *
  * @param set The FuzzySet_t struct to evaluate.
  */
-double getMaxOutput(FuzzySet_t *set)    {
-    double max = -INFINITY;
-
-    for (int i = 0; i < set->length; i++) {
-        double membershipDegree = calculateCentroid(set->membershipFunctions[i], 1.0);
-        if (membershipDegree > max) {
-            max = membershipDegree;
-        }
-    }
-
-    return max;
-}
+double getMaxOutput(FuzzySet_t *set) { return set->maxOutput; }
 
 /**
  * Returns the minimum possible value of a FuzzySet_t struct.
  *
  * @param set The FuzzySet_t struct to evaluate.
  */
-double getMinOutput(FuzzySet_t *set)    {
-    double min = INFINITY;
-
-    for (int i = 0; i < set->length; i++) {
-        double membershipDegree = calculateCentroid(set->membershipFunctions[i], 1.0);
-        if (membershipDegree < min) {
-            min = membershipDegree;
-        }
-    }
-
-    return min;
-}
+double getMinOutput(FuzzySet_t *set) { return set->minOutput; }
 
 /**
  * Normalizes the membership values in a FuzzySet_t struct.
@@ -125,28 +203,49 @@ void normalizeClass(FuzzySet_t *set) {
  * Prints the classification results in a FuzzySet_t struct.
  *
  * This function prints the membership values in a FuzzySet_t struct along with
- * a bar chart representation.
+ * a bar chart representation, rendered into a buffer and written at once. A
+ * set that does not fit the stack buffer is rendered again into a larger one
+ * from the heap, or printed term by term without bars if that fails.
  *
  * @param set The FuzzySet_t struct to print.
  * @param labels The array of labels to use for the membership values.
  */
 void printClassifier(FuzzySet_t *set, const char **labels) {
-    for (int i = 0; i < set->length; i++) {
-        printf("%s", labels[i]);
-
-        printf("\t [");
-        const int bar_length = 24;
-        int threshold = round(set->membershipValues[i] * bar_length) - 1;
-        for (int i = 0; i < bar_length; i++) {
-            if (i < threshold) {
-                printf("=");
-            } else if (i == threshold) {
-                printf(">");
-            } else {
-                printf(" ");
+    char buffer[4096];
+    char *data = buffer;
+    size_t size = sizeof(buffer);
+    FuzzyRender_t render;
+
+    for (;;) {
+        FuzzyRenderInit(&render, data, size, FUZZY_RENDER_BARS,
+                        FUZZY_RENDER_ALL);
+        FuzzyRenderBegin(&render);
+        FuzzyRenderSet(&render, NULL, 0.0, set, labels);
+        size_t length = FuzzyRenderEnd(&render);
+        if (!render.truncated) {
+            fwrite(data, 1, length, stdout);
+            break;
+        }
+
+        size *= 2;
+        char *grown = realloc(data == buffer ? NULL : data, size);
+        if (grown == NULL) {
+            for (int i = 0; i < set->length; i++) {
+                if (labels != NULL) {
+                    printf("%s\t %6.2f %%\n", labels[i],
+                           set->membershipValues[i] * 100.0);
+                } else {
+                    printf("%d\t %6.2f %%\n", i,
+                           set->membershipValues[i] * 100.0);
+                }
             }
+            printf("\n");
+            break;
         }
-        printf("] %6.2f %%\n", set->membershipValues[i] * 100.0);
+        data = grown;
     }
-    printf("\n");
-}
\ No newline at end of file
+
+    if (data != buffer) {
+        free(data);
+    }
+}
@@ -23,12 +23,59 @@
  * arguments. It calculates the membership degree of the input value for each
  * membership function in the FuzzySet_t struct and stores the resulting values.
  *
+ * Indexed sets (see FuzzySetBuildIndex()) only evaluate the terms whose support
+ * contains x, found by a binary search over the sorted breakpoints; all other
+ * terms are 0.0. The terms with a non-zero membership are listed in
+ * set->activeTerms either way.
+ *
+ * The flanks are evaluated with the reciprocal widths prepared by
+ * FuzzySetPrepare(), see membershipFunctionPrepared().
+ *
  * @param x The input value to classify.
  * @param input The FuzzySet_t
  */
 void FuzzyClassifier(double x, FuzzySet_t *set) {
-    for (int i = 0; i < set->length; i++) {
-        set->membershipValues[i] =
-            membershipFunction(x, set->membershipFunctions[i]);
+    const FuzzySetIndex_t *index = set->index;
+
+    if (index == NULL || isnan(x)) {
+        set->numActive = 0;
+        for (int i = 0; i < set->length; i++) {
+            set->membershipValues[i] = membershipFunctionPrepared(
+                x, set->membershipFunctions[i], &set->termData[i]);
+            if (set->membershipValues[i] != 0.0) {
+                set->activeTerms[set->numActive++] = i;
+            }
+        }
+        return;
+    }
+
+    // the previous classification only set the active terms
+    for (int i = 0; i < set->numActive; i++) {
+        set->membershipValues[set->activeTerms[i]] = 0.0;
+    }
+    set->numActive = 0;
+
+    // first term whose support starts right of x
+    int low = 0, high = set->length;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (index->lower[middle] <= x) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    // scan back as long as some term further left still reaches x
+    for (int i = low - 1; i >= 0 && index->reach[i] >= x; i--) {
+        if (index->upper[i] >= x) {
+            int term = index->terms[i];
+            double membership = membershipFunctionPrepared(
+                x, set->membershipFunctions[term], &set->termData[term]);
+            if (membership != 0.0) {
+                set->membershipValues[term] = membership;
+                set->activeTerms[set->numActive++] = term;
+            }
+        }
     }
 }
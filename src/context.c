@@ -0,0 +1,246 @@
+/**
+ * @file context.c
+ * @brief Fuzzy Logic reentrant model evaluation implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "context.h"
+
+#include "defuzzifier.h"
+#include "inference.h"
+#include "membership_function.h"
+#include "model.h"
+#include "model_handle.h"
+#include "trace.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Initializes an evaluation context for a model.
+ *
+ * The buffers are allocated in one cache line aligned block whose size is
+ * rounded up to whole cache lines.
+ *
+ * @param context The context to initialize.
+ * @param model The model the context is used with.
+ * @return 0 on success, -1 if out of memory.
+ */
+int FuzzyContextInit(FuzzyContext_t *context, const FuzzyModel_t *model) {
+    size_t count = model->numTerms + model->numOutputs + model->numRules;
+    size_t size = count * sizeof(double);
+    size = (size + FUZZY_CACHE_LINE - 1) / FUZZY_CACHE_LINE * FUZZY_CACHE_LINE;
+    if (size == 0) {
+        size = FUZZY_CACHE_LINE;
+    }
+
+    double *block = aligned_alloc(FUZZY_CACHE_LINE, size);
+    if (block == NULL) {
+        memset(context, 0, sizeof(*context));
+        return -1;
+    }
+    memset(block, 0, size);
+
+    context->memberships = block;
+    context->outputs = block + model->numTerms;
+    context->strengths = context->outputs + model->numOutputs;
+    context->numTerms = model->numTerms;
+    context->numOutputs = model->numOutputs;
+    context->numRules = model->numRules;
+    context->trace = NULL;
+    return 0;
+}
+
+/**
+ * Releases the buffers of an evaluation context.
+ *
+ * @param context The context to release.
+ */
+void FuzzyContextFree(FuzzyContext_t *context) {
+    free(context->memberships);
+    memset(context, 0, sizeof(*context));
+}
+
+/**
+ * Checks whether a context is large enough for a model, e.g. after a new
+ * model was published to a FuzzyModelHandle_t.
+ *
+ * @return 1 if the context can be used with the model, 0 otherwise.
+ */
+int FuzzyContextFits(const FuzzyContext_t *context, const FuzzyModel_t *model) {
+    return context->numTerms >= model->numTerms &&
+           context->numOutputs >= model->numOutputs &&
+           context->numRules >= model->numRules;
+}
+
+/**
+ * Classifies a crisp value into the terms of an input variable.
+ *
+ * @param model The model to evaluate.
+ * @param context The caller owned evaluation context.
+ * @param variable The index of the input variable.
+ * @param x The crisp input value.
+ */
+void FuzzyModelClassify(const FuzzyModel_t *model, FuzzyContext_t *context,
+                        int variable, double x) {
+    const FuzzyModelVariable_t *v = &model->variables[variable];
+    for (uint32_t j = v->firstTerm; j < v->firstTerm + v->numTerms; j++) {
+        context->memberships[j] =
+            membershipFunction(x, FuzzyModelMembershipFunction(model, j));
+        if (context->memberships[j] != 0.0) {
+            FUZZY_TRACE_RECORD(context->trace, FUZZY_TRACE_MEMBERSHIP, j,
+                               context->memberships[j]);
+        }
+    }
+}
+
+/**
+ * Performs max-min inference on classified inputs.
+ *
+ * Every output is reset once, all rules are aggregated and every output is
+ * normalized once, exactly like FuzzyEngineInfer().
+ * The strength of every rule is kept in context->strengths.
+ *
+ * @param model The model to evaluate.
+ * @param context The caller owned evaluation context.
+ */
+void FuzzyModelInfer(const FuzzyModel_t *model, FuzzyContext_t *context) {
+    double *memberships = context->memberships;
+
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+        if (v->kind == FUZZY_MODEL_OUTPUT) {
+            memset(&memberships[v->firstTerm], 0,
+                   v->numTerms * sizeof(double));
+        }
+    }
+
+    for (int i = 0; i < model->numRules; i++) {
+        const FuzzyModelRule_t *rule = &model->rules[i];
+        double membership = 1.0;
+
+        for (uint32_t j = 0; j < rule->numGroups; j++) {
+            const FuzzyModelGroup_t *group =
+                &model->groups[rule->firstGroup + j];
+            double groupMembership =
+                group->fuzzy_operator == FUZZY_ALL_OF ? 1.0 : 0.0;
+
+            for (uint32_t k = 0; k < group->numLiterals; k++) {
+                const FuzzyModelLiteral_t *literal =
+                    &model->literals[group->firstLiteral + k];
+                double inputMembership = memberships[literal->term];
+                if (literal->invert) {
+                    inputMembership = 1.0 - inputMembership;
+                }
+                groupMembership = group->fuzzy_operator == FUZZY_ALL_OF
+                                      ? fmin(groupMembership, inputMembership)
+                                      : fmax(groupMembership, inputMembership);
+                // no further literal lowers an ALL_OF group at 0.0 or raises
+                // an ANY_OF group at 1.0
+                if (group->fuzzy_operator == FUZZY_ALL_OF
+                        ? groupMembership <= 0.0
+                        : groupMembership >= 1.0) {
+                    break;
+                }
+            }
+            membership = fmin(membership, groupMembership);
+            if (membership <= 0.0) {
+                break;
+            }
+        }
+        if (membership > 0.0) {
+            FUZZY_TRACE_RECORD(context->trace, FUZZY_TRACE_RULE, i, membership);
+        }
+        context->strengths[i] = membership;
+
+        memberships[rule->consequentTerm] =
+            fmax(memberships[rule->consequentTerm], membership);
+    }
+
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+        if (v->kind != FUZZY_MODEL_OUTPUT) {
+            continue;
+        }
+
+        double sum = 0.0;
+        for (uint32_t j = v->firstTerm; j < v->firstTerm + v->numTerms; j++) {
+            sum += memberships[j];
+        }
+        for (uint32_t j = v->firstTerm; j < v->firstTerm + v->numTerms; j++) {
+            memberships[j] = sum == 0.0 ? 0.0 : memberships[j] / sum;
+        }
+    }
+}
+
+/**
+ * Defuzzifies every output variable with the centroid method.
+ *
+ * @param model The model to evaluate.
+ * @param context The caller owned evaluation context, receives the crisp
+ * outputs in context->outputs.
+ */
+void FuzzyModelDefuzzify(const FuzzyModel_t *model, FuzzyContext_t *context) {
+    int output = 0;
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+        if (v->kind != FUZZY_MODEL_OUTPUT) {
+            continue;
+        }
+
+        double sum = 0.0;
+        double sumOfMemberships = 0.0;
+        for (uint32_t j = v->firstTerm; j < v->firstTerm + v->numTerms; j++) {
+            double membership = context->memberships[j];
+            sum += calculateCentroid(FuzzyModelMembershipFunction(model, j),
+                                     membership) *
+                   membership;
+            sumOfMemberships += membership;
+        }
+
+        context->outputs[output] =
+            sumOfMemberships == 0.0 ? 0.0 : sum / sumOfMemberships;
+        FUZZY_TRACE_RECORD(context->trace, FUZZY_TRACE_OUTPUT, i,
+                           context->outputs[output]);
+        output++;
+    }
+}
+
+/**
+ * Evaluates a model: classification, inference and defuzzification.
+ *
+ * The model is never written to, so one model (or a mapped image) can be
+ * evaluated by several threads at once, each with its own context. With
+ * -DFUZZY_TRACE a context with a trace records the cycle.
+ *
+ * @param model The model to evaluate.
+ * @param context The caller owned evaluation context.
+ * @param inputs One crisp value per input variable, in declaration order.
+ * @param outputs Receives one crisp value per output variable, in
+ * declaration order. May be NULL, the values are in context->outputs as well.
+ */
+void FuzzyModelEvaluate(const FuzzyModel_t *model, FuzzyContext_t *context,
+                        const double *inputs, double *outputs) {
+    FUZZY_TRACE_BEGIN_CYCLE(context->trace);
+    int input = 0;
+    for (int i = 0; i < model->numVariables; i++) {
+        if (model->variables[i].kind == FUZZY_MODEL_INPUT) {
+            FUZZY_TRACE_RECORD(context->trace, FUZZY_TRACE_INPUT, i,
+                               inputs[input]);
+            FuzzyModelClassify(model, context, i, inputs[input++]);
+        }
+    }
+
+    FuzzyModelInfer(model, context);
+    FuzzyModelDefuzzify(model, context);
+
+    if (outputs != NULL) {
+        memcpy(outputs, context->outputs, model->numOutputs * sizeof(double));
+    }
+}
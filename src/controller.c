@@ -0,0 +1,171 @@
+/**
+ * @file controller.c
+ * @brief Fuzzy Logic closed loop controller implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "controller.h"
+
+#include "context.h"
+#include "model.h"
+#include "monitor.h"
+
+#include <math.h>
+#include <time.h>
+
+/**
+ * Initializes a controller.
+ *
+ * The valid sensor range defaults to everything below 70.0, the limit of the
+ * Peltier water tank. The period is fixed at 5 seconds, the sample period of
+ * PeltierControl; raise maxPeriod and the deadbands for an adaptive rate.
+ *
+ * @param controller The controller to initialize.
+ * @param model The model, with the inputs value and change.
+ * @param context The evaluation context, it must fit the model.
+ * @param io The sensors and actuators.
+ * @return 0 on success, -1 if the model or context do not fit.
+ */
+int FuzzyControllerInit(FuzzyController_t *controller,
+                        const FuzzyModel_t *model, FuzzyContext_t *context,
+                        FuzzyControlIO_t *io) {
+    if (model->numInputs != 2 ||
+        model->numOutputs > FUZZY_CONTROLLER_MAX_OUTPUTS ||
+        !FuzzyContextFits(context, model)) {
+        return -1;
+    }
+    controller->model = model;
+    controller->context = context;
+    controller->io = io;
+    controller->minValid = -INFINITY;
+    controller->maxValid = 70.0;
+    controller->previous = 0.0;
+    controller->hasPrevious = false;
+    controller->period = 5.0;
+    controller->minPeriod = 5.0;
+    controller->maxPeriod = 5.0;
+    controller->periodGrowth = 2.0;
+    controller->valueDeadband = 0.0;
+    controller->changeDeadband = 0.0;
+    controller->outputDeadband = 0.0;
+    controller->hasAnchor = false;
+    controller->monitor = NULL;
+    return 0;
+}
+
+static void publish(FuzzyControlIO_t *io, FuzzyControlSignal_e signal,
+                    int index, double value) {
+    if (io->publish != NULL) {
+        io->publish(io, signal, index, value);
+    }
+}
+
+/**
+ * Tells whether a cycle stays within the deadbands of the anchor cycle.
+ */
+static bool isStable(const FuzzyController_t *controller, double value,
+                     double change, const double *outputs) {
+    if (!controller->hasAnchor ||
+        !(fabs(value - controller->anchorValue) <= controller->valueDeadband) ||
+        !(fabs(change) <= controller->changeDeadband)) {
+        return false;
+    }
+    for (int i = 0; i < controller->model->numOutputs; i++) {
+        if (!(fabs(outputs[i] - controller->anchorOutputs[i]) <=
+              controller->outputDeadband)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Performs one control cycle.
+ *
+ * The sensor is read, the model evaluated with the value and its change, and
+ * every output written to its actuator and published. If the sensor can not be
+ * read or reads an implausible value, every actuator is switched off and an
+ * error is published instead.
+ *
+ * Afterwards controller->period holds the time until the next cycle.
+ *
+ * @param controller The controller to step.
+ * @return 0 on success, -1 on a sensor fault.
+ */
+int FuzzyControllerStep(FuzzyController_t *controller) {
+    FuzzyControlIO_t *io = controller->io;
+    const FuzzyModel_t *model = controller->model;
+    FuzzyContext_t *context = controller->context;
+
+    double value;
+    if (io->read(io, &value) != 0 || !(value >= controller->minValid) ||
+        !(value < controller->maxValid)) {
+        for (int i = 0; i < model->numOutputs; i++) {
+            io->write(io, i, 0.0);
+        }
+        publish(io, FUZZY_SIGNAL_ERROR, 0, 1.0);
+        controller->period = controller->minPeriod;
+        controller->hasAnchor = false;
+        if (controller->monitor != NULL) {
+            FuzzyMonitorPublish(controller->monitor, context, NULL, 0.0,
+                                controller->period, true);
+        }
+        return -1;
+    }
+
+    double inputs[2] = {value, 0.0};
+    if (controller->hasPrevious) {
+        // the change over the last period, at the rate of minPeriod
+        inputs[1] = (value - controller->previous) *
+                    (controller->minPeriod / controller->period);
+    }
+    controller->previous = value;
+    controller->hasPrevious = true;
+
+    struct timespec start, end;
+    if (controller->monitor != NULL) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    }
+    FuzzyModelEvaluate(model, context, inputs, NULL);
+    if (controller->monitor != NULL) {
+        clock_gettime(CLOCK_MONOTONIC, &end);
+    }
+
+    bool stable = isStable(controller, inputs[0], inputs[1], context->outputs);
+    bool quiet = stable && controller->period < controller->maxPeriod;
+    if (stable) {
+        controller->period = fmin(controller->period * controller->periodGrowth,
+                                  controller->maxPeriod);
+    } else {
+        controller->period = controller->minPeriod;
+        controller->anchorValue = inputs[0];
+        for (int i = 0; i < model->numOutputs; i++) {
+            controller->anchorOutputs[i] = context->outputs[i];
+        }
+        controller->hasAnchor = true;
+    }
+
+    if (!quiet) {
+        publish(io, FUZZY_SIGNAL_VALUE, 0, inputs[0]);
+        publish(io, FUZZY_SIGNAL_CHANGE, 0, inputs[1]);
+    }
+    for (int i = 0; i < model->numOutputs; i++) {
+        io->write(io, i, context->outputs[i]);
+        if (!quiet) {
+            publish(io, FUZZY_SIGNAL_OUTPUT, i, context->outputs[i]);
+        }
+    }
+
+    if (controller->monitor != NULL) {
+        double evaluationTime = (end.tv_sec - start.tv_sec) +
+                                (end.tv_nsec - start.tv_nsec) * 1e-9;
+        FuzzyMonitorPublish(controller->monitor, context, inputs,
+                            evaluationTime, controller->period, false);
+    }
+    return 0;
+}
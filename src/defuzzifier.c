@@ -93,6 +93,33 @@ double calculateRectangularCentroid(MembershipFunction_t function,
     return centroid;
 }
 
+/**
+ * Calculate the centroid of a smooth membership function.
+ *
+ * Gaussian and generalized bell terms are symmetric around their center. A
+ * sigmoid is open ended, it is represented by its inflection point.
+ *
+ * @param function The smooth membership function to calculate the centroid
+ * for.
+ * @param membership The membership value of the function.
+ * @return The centroid of the smooth membership function.
+ */
+double calculateSmoothCentroid(MembershipFunction_t function,
+                               double membership) {
+    if (membership == 0.0) {
+        return 0.0;
+    }
+
+    switch (function.type) {
+    case GAUSSIAN:
+        return function.a;
+    case SIGMOID:
+        return function.b;
+    default:
+        return function.c;
+    }
+}
+
 /**
  * Calculate the centroid of a membership function.
  *
@@ -108,12 +135,60 @@ double calculateCentroid(MembershipFunction_t function, double membership) {
         return calculateTrapezoidalCentroid(function, membership);
     case RECTANGULAR:
         return calculateRectangularCentroid(function, membership);
+    case GAUSSIAN:
+    case SIGMOID:
+    case GENERALIZED_BELL:
+        return calculateSmoothCentroid(function, membership);
     default:
         // Handle unknown membership function type
         return 0.0;
     }
 }
 
+/**
+ * Calculate the derivatives of the centroid of a membership function, as
+ * calculateCentroid() computes it for a non-zero membership, by its parameters.
+ *
+ * @param function The membership function.
+ * @param derivatives Receives d/da, d/db, d/dc and d/dd.
+ */
+void calculateCentroidDerivatives(MembershipFunction_t function,
+                                  double derivatives[4]) {
+    double *d = derivatives;
+    d[0] = d[1] = d[2] = d[3] = 0.0;
+
+    switch (function.type) {
+    case TRIANGULAR:
+        if (function.a == function.b || function.c == function.b) {
+            d[1] = 1.0;
+        } else {
+            d[0] = d[1] = d[2] = 1.0 / 3.0;
+        }
+        break;
+    case TRAPEZOIDAL:
+        if (function.a == function.b && function.c == function.d) {
+            d[1] = d[2] = 0.5;
+        } else {
+            d[0] = d[1] = d[2] = d[3] = 0.25;
+        }
+        break;
+    case RECTANGULAR:
+        d[0] = d[1] = 0.5;
+        break;
+    case GAUSSIAN:
+        d[0] = 1.0;
+        break;
+    case SIGMOID:
+        d[1] = 1.0;
+        break;
+    case GENERALIZED_BELL:
+        d[2] = 1.0;
+        break;
+    default:
+        break;
+    }
+}
+
 /**
  * Calculate the centroid of a fuzzy class.
  *
@@ -124,11 +199,14 @@ double defuzzification(FuzzySet_t *set) {
     double sum = 0.0;
     double sumOfMemberships = 0.0;
 
+    // the centroids are prepared with the set, a term without membership
+    // does not contribute
     for (int i = 0; i < set->length; i++) {
         double membership = set->membershipValues[i];
-        double x = calculateCentroid(set->membershipFunctions[i], membership);
-        sum += x * membership;
-        sumOfMemberships += membership;
+        if (membership != 0.0) {
+            sum += set->termData[i].centroid * membership;
+            sumOfMemberships += membership;
+        }
     }
 
     if (sumOfMemberships == 0.0) {
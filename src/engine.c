@@ -0,0 +1,290 @@
+/**
+ * @file engine.c
+ * @brief Fuzzy Logic inference engine context implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "engine.h"
+
+#include "class.h"
+#include "defuzzifier.h"
+#include "inference.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Adds a set to a list of sets unless it is already part of it.
+ *
+ * @return 0 on success, -1 if the list is full.
+ */
+static int registerSet(FuzzySet_t **sets, int *numSets, FuzzySet_t *set) {
+    for (int i = 0; i < *numSets; i++) {
+        if (sets[i] == set) {
+            return 0;
+        }
+    }
+    if (*numSets == FUZZY_ENGINE_MAX_SETS) {
+        return -1;
+    }
+    sets[(*numSets)++] = set;
+    return 0;
+}
+
+/**
+ * Initializes an engine for a rule base.
+ *
+ * The distinct input sets (in order of their first use in an antecedent) and
+ * output sets (in order of their first use as a consequent) are registered.
+ * The rules are referenced, not copied.
+ *
+ * @param engine The engine to initialize.
+ * @param rules An array of fuzzy rules.
+ * @param numRules The number of fuzzy rules in the array.
+ * @return 0 on success, -1 if the rules use more than FUZZY_ENGINE_MAX_SETS
+ * input or output sets.
+ */
+int FuzzyEngineInit(FuzzyEngine_t *engine, const FuzzyRule_t *rules,
+                    int numRules) {
+    memset(engine, 0, sizeof(*engine));
+    engine->rules = rules;
+    engine->numRules = numRules;
+    engine->operators = FUZZY_MIN_MAX;
+
+    for (int i = 0; i < numRules; i++) {
+        const FuzzyRule_t *rule = &rules[i];
+        for (int j = 0; j < rule->num_antecedents; j++) {
+            const FuzzyAntecedent_t *antecedent = &rule->antecedent[j];
+            for (int k = 0; k < antecedent->num_variables; k++) {
+                if (registerSet(engine->inputs, &engine->numInputs,
+                                antecedent->variables[k].variable)) {
+                    return -1;
+                }
+            }
+        }
+        if (registerSet(engine->outputs, &engine->numOutputs,
+                        rule->consequent.variable)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Returns the index of a registered input set, or -1.
+ */
+int FuzzyEngineInputIndex(const FuzzyEngine_t *engine, const FuzzySet_t *set) {
+    for (int i = 0; i < engine->numInputs; i++) {
+        if (engine->inputs[i] == set) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Returns the index of a registered output set, or -1.
+ */
+int FuzzyEngineOutputIndex(const FuzzyEngine_t *engine,
+                           const FuzzySet_t *set) {
+    for (int i = 0; i < engine->numOutputs; i++) {
+        if (engine->outputs[i] == set) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Finds the literal that guards a rule, a plain literal of an input set that
+ * zeroes the rule while its membership is zero. The literal of the set with
+ * the most terms is preferred, its terms guard the fewest rules each.
+ *
+ * @return The guarding literal, NULL if the rule has none.
+ */
+static const FuzzyVariable_t *ruleGuard(const FuzzyEngine_t *engine,
+                                        const FuzzyRule_t *rule) {
+    const FuzzyVariable_t *guard = NULL;
+
+    for (int j = 0; j < rule->num_antecedents; j++) {
+        const FuzzyAntecedent_t *antecedent = &rule->antecedent[j];
+        if (antecedent->fuzzy_operator != FUZZY_ALL_OF &&
+            !(antecedent->fuzzy_operator == FUZZY_ANY_OF &&
+              antecedent->num_variables == 1)) {
+            continue;
+        }
+        for (int k = 0; k < antecedent->num_variables; k++) {
+            const FuzzyVariable_t *variable = &antecedent->variables[k];
+            // outputs of chained rules are not classified
+            if (variable->invert ||
+                FuzzyEngineOutputIndex(engine, variable->variable) >= 0) {
+                continue;
+            }
+            if (guard == NULL ||
+                variable->variable->length > guard->variable->length) {
+                guard = variable;
+            }
+        }
+    }
+    return guard;
+}
+
+/**
+ * Indexes the rules of an engine by the input terms that guard them.
+ *
+ * @param index The index to initialize.
+ * @param engine An initialized engine, its rules must not change while the
+ * index is in use.
+ * @return 0 on success, -1 if out of memory.
+ */
+int FuzzyEngineIndexInit(FuzzyEngineIndex_t *index,
+                         const FuzzyEngine_t *engine) {
+    memset(index, 0, sizeof(*index));
+    index->numRules = engine->numRules;
+
+    int numTerms = 0;
+    for (int i = 0; i < engine->numInputs; i++) {
+        index->first[i] = numTerms;
+        numTerms += engine->inputs[i]->length;
+    }
+    int numRules = engine->numRules;
+    int words = (numRules + 63) / 64;
+
+    index->offsets = calloc(numTerms + 1, sizeof(int));
+    index->rules = malloc((numRules + 1) * sizeof(int));
+    index->always = calloc(words + 1, sizeof(uint64_t));
+    index->fired = malloc((words + 1) * sizeof(uint64_t));
+    index->selected = malloc((numRules + 1) * sizeof(int));
+    if (index->offsets == NULL || index->rules == NULL ||
+        index->always == NULL || index->fired == NULL ||
+        index->selected == NULL) {
+        FuzzyEngineIndexFree(index);
+        return -1;
+    }
+
+    // count the rules per term, then place them in ascending order
+    for (int r = 0; r < numRules; r++) {
+        const FuzzyVariable_t *guard = ruleGuard(engine, &engine->rules[r]);
+        if (guard == NULL) {
+            index->always[r / 64] |= 1ULL << (r % 64);
+        } else {
+            int input = FuzzyEngineInputIndex(engine, guard->variable);
+            index->offsets[index->first[input] + guard->value + 1]++;
+        }
+    }
+    for (int t = 0; t < numTerms; t++) {
+        index->offsets[t + 1] += index->offsets[t];
+    }
+    for (int r = 0; r < numRules; r++) {
+        const FuzzyVariable_t *guard = ruleGuard(engine, &engine->rules[r]);
+        if (guard != NULL) {
+            int input = FuzzyEngineInputIndex(engine, guard->variable);
+            index->rules[index->offsets[index->first[input] + guard->value]++] =
+                r;
+        }
+    }
+    // placing advanced every offset to the start of the next term
+    memmove(index->offsets + 1, index->offsets, numTerms * sizeof(int));
+    index->offsets[0] = 0;
+    return 0;
+}
+
+/**
+ * Frees the memory allocated for an engine index.
+ */
+void FuzzyEngineIndexFree(FuzzyEngineIndex_t *index) {
+    free(index->offsets);
+    free(index->rules);
+    free(index->always);
+    free(index->fired);
+    free(index->selected);
+    memset(index, 0, sizeof(*index));
+}
+
+/**
+ * Performs one inference cycle.
+ *
+ * Every output set is reset once, all rules are aggregated with the engine's
+ * operator family and every output set is normalized once. The input sets must
+ * have been classified already.
+ *
+ * @param engine The engine to run.
+ */
+void FuzzyEngineInfer(const FuzzyEngine_t *engine) {
+    for (int i = 0; i < engine->numOutputs; i++) {
+        FuzzySet_t *set = engine->outputs[i];
+        memset(set->membershipValues, 0, set->length * sizeof(double));
+    }
+
+    fuzzyAggregate(engine->rules, engine->numRules, engine->operators);
+
+    for (int i = 0; i < engine->numOutputs; i++) {
+        normalizeClass(engine->outputs[i]);
+    }
+}
+
+/**
+ * Defuzzifies every output set exactly once.
+ *
+ * @param engine The engine whose outputs to defuzzify.
+ * @param outputs Receives one crisp value per output set, in registration
+ * order.
+ */
+void FuzzyEngineDefuzzify(const FuzzyEngine_t *engine, double *outputs) {
+    for (int i = 0; i < engine->numOutputs; i++) {
+        outputs[i] = defuzzification(engine->outputs[i]);
+    }
+}
+
+/**
+ * Performs one inference cycle, evaluating only the rules that can fire.
+ *
+ * The rules guarded by the active terms of the inputs and the unguarded rules
+ * are aggregated in their original order, the outputs are the same as
+ * FuzzyEngineInfer() computes. With high resolution sets only a handful of
+ * rules are evaluated per cycle instead of all of them.
+ *
+ * @param engine The engine to run.
+ * @param index The index of the engine's rules.
+ */
+void FuzzyEngineInferSparse(const FuzzyEngine_t *engine,
+                            FuzzyEngineIndex_t *index) {
+    int words = (index->numRules + 63) / 64;
+    memcpy(index->fired, index->always, words * sizeof(uint64_t));
+
+    for (int i = 0; i < engine->numInputs; i++) {
+        const FuzzySet_t *set = engine->inputs[i];
+        const int *offsets = index->offsets + index->first[i];
+        for (int k = 0; k < set->numActive; k++) {
+            int term = set->activeTerms[k];
+            for (int j = offsets[term]; j < offsets[term + 1]; j++) {
+                int r = index->rules[j];
+                index->fired[r / 64] |= 1ULL << (r % 64);
+            }
+        }
+    }
+
+    int numSelected = 0;
+    for (int w = 0; w < words; w++) {
+        for (uint64_t bits = index->fired[w]; bits != 0; bits &= bits - 1) {
+            index->selected[numSelected++] = w * 64 + __builtin_ctzll(bits);
+        }
+    }
+
+    for (int i = 0; i < engine->numOutputs; i++) {
+        FuzzySet_t *set = engine->outputs[i];
+        memset(set->membershipValues, 0, set->length * sizeof(double));
+    }
+
+    fuzzyAggregateSelected(engine->rules, index->selected, numSelected,
+                           engine->operators);
+
+    for (int i = 0; i < engine->numOutputs; i++) {
+        normalizeClass(engine->outputs[i]);
+    }
+}
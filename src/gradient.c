@@ -0,0 +1,221 @@
+/**
+ * @file gradient.c
+ * @brief Fuzzy Logic model gradient implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "gradient.h"
+
+#include "context.h"
+#include "defuzzifier.h"
+#include "inference.h"
+#include "membership_function.h"
+#include "model.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+// Marks a strength that does not depend on any literal
+#define SOURCE_CONSTANT -1
+
+/**
+ * Initializes the gradient buffers for a model.
+ *
+ * @param gradient The gradient to initialize.
+ * @param model The model the gradient is computed for.
+ * @return 0 on success, -1 if out of memory.
+ */
+int FuzzyGradientInit(FuzzyGradient_t *gradient, const FuzzyModel_t *model) {
+    memset(gradient, 0, sizeof(*gradient));
+    size_t terms = model->numTerms + 1;
+
+    gradient->parameters =
+        calloc(model->numOutputs * terms * 4 + 1, sizeof(double));
+    gradient->inputs =
+        calloc(model->numOutputs * model->numInputs + 1, sizeof(double));
+    gradient->memberships = calloc(terms * 5, sizeof(double));
+    gradient->sources = calloc(terms, sizeof(int));
+    gradient->strengths = calloc(terms, sizeof(double));
+    gradient->inputIndices = calloc(model->numVariables + 1, sizeof(int));
+    if (gradient->parameters == NULL || gradient->inputs == NULL ||
+        gradient->memberships == NULL || gradient->sources == NULL ||
+        gradient->strengths == NULL || gradient->inputIndices == NULL) {
+        FuzzyGradientFree(gradient);
+        return -1;
+    }
+
+    gradient->numTerms = model->numTerms;
+    gradient->numInputs = model->numInputs;
+    gradient->numOutputs = model->numOutputs;
+    return 0;
+}
+
+/**
+ * Releases the buffers of a gradient.
+ */
+void FuzzyGradientFree(FuzzyGradient_t *gradient) {
+    free(gradient->parameters);
+    free(gradient->inputs);
+    free(gradient->memberships);
+    free(gradient->sources);
+    free(gradient->strengths);
+    free(gradient->inputIndices);
+    memset(gradient, 0, sizeof(*gradient));
+}
+
+/**
+ * Aggregates the rules like FuzzyModelInfer() does, before normalization, and
+ * records which literal every output term strength stems from.
+ */
+static void traceRules(const FuzzyModel_t *model, const double *memberships,
+                       FuzzyGradient_t *gradient) {
+    double *strengths = gradient->strengths;
+    int *sources = gradient->sources;
+
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+        if (v->kind == FUZZY_MODEL_OUTPUT) {
+            for (uint32_t j = v->firstTerm; j < v->firstTerm + v->numTerms;
+                 j++) {
+                strengths[j] = 0.0;
+                sources[j] = SOURCE_CONSTANT;
+            }
+        }
+    }
+
+    for (int i = 0; i < model->numRules; i++) {
+        const FuzzyModelRule_t *rule = &model->rules[i];
+        double membership = 1.0;
+        int source = SOURCE_CONSTANT;
+
+        for (uint32_t j = 0; j < rule->numGroups; j++) {
+            const FuzzyModelGroup_t *group =
+                &model->groups[rule->firstGroup + j];
+            bool all = group->fuzzy_operator == FUZZY_ALL_OF;
+            double groupMembership = all ? 1.0 : 0.0;
+            int groupSource = SOURCE_CONSTANT;
+
+            for (uint32_t k = 0; k < group->numLiterals; k++) {
+                const FuzzyModelLiteral_t *literal =
+                    &model->literals[group->firstLiteral + k];
+                double inputMembership = memberships[literal->term];
+                if (literal->invert) {
+                    inputMembership = 1.0 - inputMembership;
+                }
+                if (all ? inputMembership < groupMembership
+                        : inputMembership > groupMembership) {
+                    groupMembership = inputMembership;
+                    groupSource = 2 * literal->term + (literal->invert != 0);
+                }
+            }
+            if (groupMembership < membership) {
+                membership = groupMembership;
+                source = groupSource;
+            }
+        }
+
+        if (membership > strengths[rule->consequentTerm]) {
+            strengths[rule->consequentTerm] = membership;
+            sources[rule->consequentTerm] = source;
+        }
+    }
+}
+
+/**
+ * Evaluates a model and the derivatives of its outputs by every membership
+ * function parameter and every input, in one pass.
+ *
+ * The outputs are exactly those of FuzzyModelEvaluate(), the derivatives cost
+ * about one more evaluation. Only max-min inference (the operators of
+ * FuzzyModelInfer()) is differentiated.
+ *
+ * @param model The model to evaluate.
+ * @param context The caller owned evaluation context.
+ * @param gradient Receives the derivatives, initialized for the model.
+ * @param inputs One crisp value per input variable, in declaration order.
+ * @param outputs Receives one crisp value per output variable, may be NULL.
+ */
+void FuzzyModelEvaluateGradient(const FuzzyModel_t *model,
+                                FuzzyContext_t *context,
+                                FuzzyGradient_t *gradient,
+                                const double *inputs, double *outputs) {
+    // classification with the membership derivatives
+    int input = 0;
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+        if (v->kind != FUZZY_MODEL_INPUT) {
+            continue;
+        }
+        for (uint32_t j = v->firstTerm; j < v->firstTerm + v->numTerms; j++) {
+            context->memberships[j] = membershipFunctionDerivatives(
+                inputs[input], FuzzyModelMembershipFunction(model, j),
+                &gradient->memberships[5 * j]);
+        }
+        gradient->inputIndices[i] = input++;
+    }
+
+    traceRules(model, context->memberships, gradient);
+    FuzzyModelInfer(model, context);
+    FuzzyModelDefuzzify(model, context);
+
+    int numTerms = model->numTerms;
+    memset(gradient->parameters, 0,
+           model->numOutputs * numTerms * 4 * sizeof(double));
+    memset(gradient->inputs, 0,
+           model->numOutputs * model->numInputs * sizeof(double));
+
+    int output = 0;
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+        if (v->kind != FUZZY_MODEL_OUTPUT) {
+            continue;
+        }
+
+        double sum = 0.0;
+        for (uint32_t j = v->firstTerm; j < v->firstTerm + v->numTerms; j++) {
+            sum += gradient->strengths[j];
+        }
+        double crisp = context->outputs[output];
+        double *parameters = &gradient->parameters[output * numTerms * 4];
+        double *inputDerivatives = &gradient->inputs[output * model->numInputs];
+
+        // d crisp = (sum_j r_j d c_j + sum_j (c_j - crisp) d r_j) / sum_j r_j
+        for (uint32_t j = v->firstTerm;
+             sum != 0.0 && j < v->firstTerm + v->numTerms; j++) {
+            double strength = gradient->strengths[j];
+            MembershipFunction_t mf = FuzzyModelMembershipFunction(model, j);
+
+            double centroid[4];
+            calculateCentroidDerivatives(mf, centroid);
+            for (int k = 0; k < 4; k++) {
+                parameters[4 * j + k] += strength * centroid[k] / sum;
+            }
+
+            int source = gradient->sources[j];
+            if (source == SOURCE_CONSTANT) {
+                continue;
+            }
+            int term = source / 2;
+            double weight = (calculateCentroid(mf, 1.0) - crisp) / sum;
+            if (source % 2) {
+                weight = -weight;
+            }
+            const double *d = &gradient->memberships[5 * term];
+            for (int k = 0; k < 4; k++) {
+                parameters[4 * term + k] += weight * d[k];
+            }
+            int variable = model->terms[term].variable;
+            inputDerivatives[gradient->inputIndices[variable]] += weight * d[4];
+        }
+        output++;
+    }
+
+    if (outputs != NULL) {
+        memcpy(outputs, context->outputs, model->numOutputs * sizeof(double));
+    }
+}
@@ -0,0 +1,714 @@
+/**
+ * @file harness.c
+ * @brief Fuzzy Logic backend comparison harness implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "harness.h"
+
+#include "class.h"
+#include "classifier.h"
+#include "context.h"
+#include "defuzzifier.h"
+#include "engine.h"
+#include "gradient.h"
+#include "inference.h"
+#include "membership_function.h"
+#include "model.h"
+#include "rule_matrix.h"
+#include "rule_optimizer.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Every backend is timed over at least this long
+#define HARNESS_MIN_SECONDS 0.05
+// Random inputs reach this fraction of the span of the breakpoints beyond
+// either end
+#define HARNESS_MARGIN 0.1
+
+// Random samples the reordered backend profiles, seeded apart from the
+// samples it is compared on
+#define HARNESS_PROFILE_SAMPLES 10000
+#define HARNESS_PROFILE_SEED 7
+
+// The state of the backends of this library. The rule based backends expand
+// the model to one set per variable and one rule per model rule.
+typedef struct {
+    const FuzzyModel_t *model;
+    FuzzySet_t *sets;
+    FuzzyRule_t *rules;
+    FuzzyAntecedent_t *antecedents;
+    FuzzyVariable_t *variables;
+    int *inputs;
+    int *outputs;
+    FuzzyEngine_t engine;
+    FuzzyEngineIndex_t index;
+    FuzzyContext_t context;
+    FuzzyGradient_t gradient;
+    FuzzyRuleBase_t base;
+    FuzzyRuleMatrix_t matrix;
+    FuzzyOperators_e operators;
+} BackendState_t;
+
+// ---------------------------------------------------------------------------
+// random numbers
+// ---------------------------------------------------------------------------
+
+static uint64_t nextRandom(uint64_t *state) {
+    // xorshift64*
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+static double uniform(uint64_t *state, double low, double high) {
+    return low + (high - low) * ((nextRandom(state) >> 11) * 0x1.0p-53);
+}
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// ---------------------------------------------------------------------------
+// backends
+// ---------------------------------------------------------------------------
+
+/**
+ * Classifies the inputs of an expanded model.
+ */
+static void classifyInputs(BackendState_t *state, const double *inputs) {
+    for (int i = 0; i < state->model->numInputs; i++) {
+        FuzzyClassifier(inputs[i], &state->sets[state->inputs[i]]);
+    }
+}
+
+/**
+ * Defuzzifies the outputs of an expanded model.
+ */
+static void defuzzifyOutputs(BackendState_t *state, double *outputs) {
+    for (int o = 0; o < state->model->numOutputs; o++) {
+        outputs[o] = defuzzification(&state->sets[state->outputs[o]]);
+    }
+}
+
+static void evaluateRules(FuzzyBackend_t *backend, const double *inputs,
+                          double *outputs) {
+    BackendState_t *state = backend->user;
+    classifyInputs(state, inputs);
+    fuzzyInferenceWith(state->rules, state->model->numRules, state->operators);
+    defuzzifyOutputs(state, outputs);
+}
+
+static void evaluateEngine(FuzzyBackend_t *backend, const double *inputs,
+                           double *outputs) {
+    BackendState_t *state = backend->user;
+    classifyInputs(state, inputs);
+    FuzzyEngineInfer(&state->engine);
+    defuzzifyOutputs(state, outputs);
+}
+
+static void evaluateSparse(FuzzyBackend_t *backend, const double *inputs,
+                           double *outputs) {
+    BackendState_t *state = backend->user;
+    classifyInputs(state, inputs);
+    FuzzyEngineInferSparse(&state->engine, &state->index);
+    defuzzifyOutputs(state, outputs);
+}
+
+static void evaluateBase(FuzzyBackend_t *backend, const double *inputs,
+                         double *outputs) {
+    BackendState_t *state = backend->user;
+    classifyInputs(state, inputs);
+    fuzzyInference(state->base.rules, state->base.numRules);
+    defuzzifyOutputs(state, outputs);
+}
+
+static void evaluateMatrix(FuzzyBackend_t *backend, const double *inputs,
+                           double *outputs) {
+    BackendState_t *state = backend->user;
+    classifyInputs(state, inputs);
+    FuzzyRuleMatrixInfer(&state->matrix);
+    defuzzifyOutputs(state, outputs);
+}
+
+static void evaluateModel(FuzzyBackend_t *backend, const double *inputs,
+                          double *outputs) {
+    BackendState_t *state = backend->user;
+    FuzzyModelEvaluate(state->model, &state->context, inputs, outputs);
+}
+
+static void evaluateGradient(FuzzyBackend_t *backend, const double *inputs,
+                             double *outputs) {
+    BackendState_t *state = backend->user;
+    FuzzyModelEvaluateGradient(state->model, &state->context,
+                               &state->gradient, inputs, outputs);
+}
+
+static void releaseState(FuzzyBackend_t *backend) {
+    BackendState_t *state = backend->user;
+    if (state->sets != NULL) {
+        for (int i = 0; i < state->model->numVariables; i++) {
+            FuzzySetFree(&state->sets[i]);
+        }
+    }
+    free(state->sets);
+    free(state->rules);
+    free(state->antecedents);
+    free(state->variables);
+    free(state->inputs);
+    free(state->outputs);
+    FuzzyEngineIndexFree(&state->index);
+    FuzzyContextFree(&state->context);
+    FuzzyGradientFree(&state->gradient);
+    FuzzyRuleBaseFree(&state->base);
+    FuzzyRuleMatrixFree(&state->matrix);
+    free(state);
+    backend->user = NULL;
+}
+
+/**
+ * Expands a model to one set per variable and one rule per model rule.
+ *
+ * @return 0 on success, -1 if out of memory.
+ */
+static int expandModel(BackendState_t *state) {
+    const FuzzyModel_t *model = state->model;
+
+    state->sets = calloc(model->numVariables + 1, sizeof(FuzzySet_t));
+    state->rules = calloc(model->numRules + 1, sizeof(FuzzyRule_t));
+    state->antecedents =
+        calloc(model->numGroups + 1, sizeof(FuzzyAntecedent_t));
+    state->variables = calloc(model->numLiterals + 1, sizeof(FuzzyVariable_t));
+    state->inputs = calloc(model->numInputs + 1, sizeof(int));
+    state->outputs = calloc(model->numOutputs + 1, sizeof(int));
+    if (state->sets == NULL || state->rules == NULL ||
+        state->antecedents == NULL || state->variables == NULL ||
+        state->inputs == NULL || state->outputs == NULL) {
+        return -1;
+    }
+
+    int numInputs = 0, numOutputs = 0;
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+        MembershipFunction_t mfs[v->numTerms + 1];
+        for (uint32_t j = 0; j < v->numTerms; j++) {
+            mfs[j] = FuzzyModelMembershipFunction(model, v->firstTerm + j);
+        }
+        FuzzySetInit(&state->sets[i], mfs, v->numTerms);
+        if (v->kind == FUZZY_MODEL_INPUT) {
+            state->inputs[numInputs++] = i;
+        } else {
+            state->outputs[numOutputs++] = i;
+        }
+    }
+
+    for (int i = 0; i < model->numLiterals; i++) {
+        const FuzzyModelLiteral_t *literal = &model->literals[i];
+        const FuzzyModelVariable_t *v = &model->variables[literal->variable];
+        state->variables[i] = (FuzzyVariable_t){
+            .variable = &state->sets[literal->variable],
+            .value = literal->term - v->firstTerm,
+            .invert = literal->invert != 0};
+    }
+    for (int i = 0; i < model->numGroups; i++) {
+        const FuzzyModelGroup_t *group = &model->groups[i];
+        state->antecedents[i] = (FuzzyAntecedent_t){
+            .variables = &state->variables[group->firstLiteral],
+            .num_variables = group->numLiterals,
+            .fuzzy_operator = group->fuzzy_operator};
+    }
+    for (int i = 0; i < model->numRules; i++) {
+        const FuzzyModelRule_t *rule = &model->rules[i];
+        const FuzzyModelVariable_t *v =
+            &model->variables[rule->consequentVariable];
+        state->rules[i] = (FuzzyRule_t){
+            .antecedent = &state->antecedents[rule->firstGroup],
+            .num_antecedents = rule->numGroups,
+            .consequent = {
+                .variable = &state->sets[rule->consequentVariable],
+                .value = rule->consequentTerm - v->firstTerm}};
+    }
+    return 0;
+}
+
+/**
+ * Profiles the rules of an expanded model over random samples and reorders
+ * them into the rule base.
+ *
+ * @return 0 on success, -1 if out of memory.
+ */
+static int reorderModel(BackendState_t *state) {
+    const FuzzyModel_t *model = state->model;
+    double *samples;
+    int numSamples;
+    if (FuzzyHarnessSamples(model, HARNESS_PROFILE_SAMPLES,
+                            HARNESS_PROFILE_SEED, &samples, &numSamples)) {
+        return -1;
+    }
+    FuzzyRuleProfile_t profile;
+    if (FuzzyRuleProfileInit(&profile, state->rules, model->numRules)) {
+        free(samples);
+        return -1;
+    }
+    for (int i = 0; i < numSamples; i++) {
+        classifyInputs(state, &samples[i * model->numInputs]);
+        FuzzyRuleProfileRecord(&profile, state->rules, model->numRules);
+    }
+    int result =
+        FuzzyRuleReorder(state->rules, model->numRules, &profile, &state->base);
+    FuzzyRuleProfileFree(&profile);
+    free(samples);
+    return result;
+}
+
+/**
+ * Builds the rule matrix of an expanded model whose rules form a table: one
+ * ALL_OF group per rule with one plain literal per input, and at most one
+ * rule per cell and output.
+ *
+ * @return 0 on success, -1 if the rules are no table or out of memory.
+ */
+static int expandMatrix(BackendState_t *state) {
+    const FuzzyModel_t *model = state->model;
+    int numInputs = model->numInputs, numOutputs = model->numOutputs;
+    if (numInputs > FUZZY_MATRIX_MAX_INPUTS ||
+        numOutputs > FUZZY_MATRIX_MAX_OUTPUTS) {
+        return -1;
+    }
+
+    // the input or output position of every variable, cells of the first
+    // term of every input are strides[input] apart
+    int position[model->numVariables + 1];
+    int strides[numInputs + 1];
+    FuzzySet_t *inputs[numInputs + 1], *outputs[numOutputs + 1];
+    int numCells = 1;
+    for (int k = numInputs - 1; k >= 0; k--) {
+        strides[k] = numCells;
+        numCells *= model->variables[state->inputs[k]].numTerms;
+        position[state->inputs[k]] = k;
+        inputs[k] = &state->sets[state->inputs[k]];
+    }
+    for (int o = 0; o < numOutputs; o++) {
+        position[state->outputs[o]] = o;
+        outputs[o] = &state->sets[state->outputs[o]];
+    }
+
+    int *cells = malloc((numCells * numOutputs + 1) * sizeof(int));
+    if (cells == NULL) {
+        return -1;
+    }
+    for (int c = 0; c < numCells * numOutputs; c++) {
+        cells[c] = FUZZY_MATRIX_NONE;
+    }
+
+    int result = 0;
+    for (int i = 0; i < model->numRules && result == 0; i++) {
+        const FuzzyModelRule_t *rule = &model->rules[i];
+        const FuzzyModelGroup_t *group = &model->groups[rule->firstGroup];
+        if (rule->numGroups != 1 || group->fuzzy_operator != FUZZY_ALL_OF ||
+            group->numLiterals != (uint32_t)numInputs) {
+            result = -1;
+            break;
+        }
+        int cell = 0, seen = 0;
+        for (uint32_t l = 0; l < group->numLiterals; l++) {
+            const FuzzyModelLiteral_t *literal =
+                &model->literals[group->firstLiteral + l];
+            int k = position[literal->variable];
+            if (literal->invert || (seen & (1 << k)) ||
+                model->variables[literal->variable].kind != FUZZY_MODEL_INPUT) {
+                result = -1;
+                break;
+            }
+            seen |= 1 << k;
+            cell += (literal->term - model->variables[literal->variable]
+                                         .firstTerm) *
+                    strides[k];
+        }
+        int *consequent = &cells[cell * numOutputs +
+                                 position[rule->consequentVariable]];
+        if (result == 0 && *consequent != FUZZY_MATRIX_NONE) {
+            result = -1;
+        } else if (result == 0) {
+            *consequent = rule->consequentTerm -
+                          model->variables[rule->consequentVariable].firstTerm;
+        }
+    }
+
+    if (result == 0) {
+        result = FuzzyRuleMatrixInit(&state->matrix, inputs, numInputs,
+                                     outputs, numOutputs, cells);
+    }
+    free(cells);
+    return result;
+}
+
+/**
+ * Initializes one of the backends of this library for a model, under
+ * min/max.
+ *
+ * @see FuzzyBackendInitWith()
+ */
+int FuzzyBackendInit(FuzzyBackend_t *backend, FuzzyBackendKind_e kind,
+                     const FuzzyModel_t *model) {
+    return FuzzyBackendInitWith(backend, kind, model, FUZZY_MIN_MAX);
+}
+
+/**
+ * Initializes one of the backends of this library for a model.
+ *
+ * The model must outlive the backend. The tolerance starts out at 1e-9.
+ *
+ * @param backend The backend to initialize.
+ * @param kind The backend.
+ * @param model The model to evaluate.
+ * @param operators The operator family, the model, gradient, optimized and
+ * reordered backends only support FUZZY_MIN_MAX.
+ * @return 0 on success, -1 if the model has too many sets for an engine, is
+ * no table for a matrix, the backend does not support the operators
+ * or out of memory.
+ */
+int FuzzyBackendInitWith(FuzzyBackend_t *backend, FuzzyBackendKind_e kind,
+                         const FuzzyModel_t *model,
+                         FuzzyOperators_e operators) {
+    memset(backend, 0, sizeof(*backend));
+    bool minMaxOnly = kind == FUZZY_BACKEND_MODEL ||
+                      kind == FUZZY_BACKEND_GRADIENT ||
+                      kind == FUZZY_BACKEND_OPTIMIZED;
+    if (minMaxOnly && operators != FUZZY_MIN_MAX) {
+        return -1;
+    }
+    BackendState_t *state = calloc(1, sizeof(BackendState_t));
+    if (state == NULL) {
+        return -1;
+    }
+    state->model = model;
+    state->operators = operators;
+    backend->user = state;
+    backend->release = releaseState;
+    backend->tolerance = 1e-9;
+
+    int result = 0;
+    switch (kind) {
+    case FUZZY_BACKEND_RULES:
+        backend->name = "rules";
+        backend->evaluate = evaluateRules;
+        result = expandModel(state);
+        break;
+    case FUZZY_BACKEND_ENGINE:
+        backend->name = "engine";
+        backend->evaluate = evaluateEngine;
+        result = expandModel(state) ||
+                 FuzzyEngineInit(&state->engine, state->rules,
+                                 model->numRules);
+        state->engine.operators = operators;
+        break;
+    case FUZZY_BACKEND_SPARSE:
+        backend->name = "sparse";
+        backend->evaluate = evaluateSparse;
+        result = expandModel(state) ||
+                 FuzzyEngineInit(&state->engine, state->rules,
+                                 model->numRules) ||
+                 FuzzyEngineIndexInit(&state->index, &state->engine);
+        state->engine.operators = operators;
+        break;
+    case FUZZY_BACKEND_MODEL:
+        backend->name = "model";
+        backend->evaluate = evaluateModel;
+        result = FuzzyContextInit(&state->context, model);
+        break;
+    case FUZZY_BACKEND_GRADIENT:
+        backend->name = "gradient";
+        backend->evaluate = evaluateGradient;
+        result = FuzzyContextInit(&state->context, model) ||
+                 FuzzyGradientInit(&state->gradient, model);
+        break;
+    case FUZZY_BACKEND_OPTIMIZED:
+        backend->name = "optimized";
+        backend->evaluate = evaluateBase;
+        result = expandModel(state) ||
+                 FuzzyRuleOptimize(state->rules, model->numRules,
+                                   &state->base, NULL);
+        backend->numRules = state->base.numRules;
+        break;
+    case FUZZY_BACKEND_REORDERED:
+        backend->name = "reordered";
+        backend->evaluate = evaluateBase;
+        result = expandModel(state) || reorderModel(state);
+        break;
+    case FUZZY_BACKEND_MATRIX:
+        backend->name = "matrix";
+        backend->evaluate = evaluateMatrix;
+        result = expandModel(state) || expandMatrix(state);
+        state->matrix.operators = operators;
+        break;
+    default:
+        result = -1;
+        break;
+    }
+
+    if (result) {
+        FuzzyBackendFree(backend);
+        return -1;
+    }
+    if (backend->numRules == 0 && state->rules != NULL) {
+        backend->numRules = model->numRules;
+    }
+    return 0;
+}
+
+/**
+ * Releases a backend.
+ */
+void FuzzyBackendFree(FuzzyBackend_t *backend) {
+    if (backend->release != NULL && backend->user != NULL) {
+        backend->release(backend);
+    }
+    backend->user = NULL;
+}
+
+// ---------------------------------------------------------------------------
+// samples
+// ---------------------------------------------------------------------------
+
+/**
+ * Lists the points of a term where its membership function changes shape.
+ *
+ * @return The number of breakpoints, at most 4.
+ */
+static int termBreakpoints(MembershipFunction_t mf, double *points) {
+    switch (mf.type) {
+    case TRIANGULAR:
+        points[0] = mf.a;
+        points[1] = mf.b;
+        points[2] = mf.c;
+        return 3;
+    case TRAPEZOIDAL:
+        points[0] = mf.a;
+        points[1] = mf.b;
+        points[2] = mf.c;
+        points[3] = mf.d;
+        return 4;
+    case RECTANGULAR:
+        points[0] = mf.a;
+        points[1] = mf.b;
+        return 2;
+    case GAUSSIAN:
+        points[0] = mf.a - mf.b;
+        points[1] = mf.a;
+        points[2] = mf.a + mf.b;
+        return 3;
+    case SIGMOID:
+        points[0] = mf.b;
+        return 1;
+    case GENERALIZED_BELL:
+        points[0] = mf.c - mf.a;
+        points[1] = mf.c;
+        points[2] = mf.c + mf.a;
+        return 3;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Generates the inputs of a comparison: random samples spread over the
+ * breakpoints of every input, a little beyond either end, and for every
+ * breakpoint of every input the breakpoint itself and its neighbouring
+ * doubles, the other inputs random.
+ *
+ * @param model The model to generate inputs for.
+ * @param numRandom The number of random samples.
+ * @param seed Seeds the random inputs.
+ * @param samples Receives numInputs values per sample, free() them.
+ * @param numSamples Receives the number of samples.
+ * @return 0 on success, -1 if out of memory.
+ */
+int FuzzyHarnessSamples(const FuzzyModel_t *model, int numRandom,
+                        uint64_t seed, double **samples, int *numSamples) {
+    int numInputs = model->numInputs;
+    double lower[numInputs + 1], upper[numInputs + 1];
+    int numBreakpoints = 0;
+
+    int input = 0;
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+        if (v->kind != FUZZY_MODEL_INPUT) {
+            continue;
+        }
+        lower[input] = INFINITY;
+        upper[input] = -INFINITY;
+        for (uint32_t j = v->firstTerm; j < v->firstTerm + v->numTerms; j++) {
+            double points[4];
+            int n = termBreakpoints(FuzzyModelMembershipFunction(model, j),
+                                    points);
+            for (int k = 0; k < n; k++) {
+                lower[input] = fmin(lower[input], points[k]);
+                upper[input] = fmax(upper[input], points[k]);
+            }
+            numBreakpoints += n;
+        }
+        if (lower[input] > upper[input]) {
+            lower[input] = upper[input] = 0.0;
+        }
+        double margin = (upper[input] - lower[input]) * HARNESS_MARGIN;
+        margin = margin > 0.0 ? margin : 1.0;
+        lower[input] -= margin;
+        upper[input] += margin;
+        input++;
+    }
+
+    int total = numRandom + 3 * numBreakpoints;
+    double *data = malloc((total * numInputs + 1) * sizeof(double));
+    if (data == NULL) {
+        return -1;
+    }
+
+    uint64_t state = seed ? seed : 1;
+    for (int s = 0; s < total; s++) {
+        for (int k = 0; k < numInputs; k++) {
+            data[s * numInputs + k] = uniform(&state, lower[k], upper[k]);
+        }
+    }
+
+    int s = numRandom;
+    input = 0;
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+        if (v->kind != FUZZY_MODEL_INPUT) {
+            continue;
+        }
+        for (uint32_t j = v->firstTerm; j < v->firstTerm + v->numTerms; j++) {
+            double points[4];
+            int n = termBreakpoints(FuzzyModelMembershipFunction(model, j),
+                                    points);
+            for (int k = 0; k < n; k++) {
+                data[s++ * numInputs + input] = nextafter(points[k], -INFINITY);
+                data[s++ * numInputs + input] = points[k];
+                data[s++ * numInputs + input] = nextafter(points[k], INFINITY);
+            }
+        }
+        input++;
+    }
+
+    *samples = data;
+    *numSamples = total;
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// comparison
+// ---------------------------------------------------------------------------
+
+/**
+ * Evaluates every sample with a backend, repeatedly until it took at least
+ * HARNESS_MIN_SECONDS.
+ *
+ * @return The time per evaluation in nanoseconds.
+ */
+static double evaluateAll(FuzzyBackend_t *backend, int numInputs,
+                          int numOutputs, const double *samples,
+                          int numSamples, double *outputs) {
+    long evaluations = 0;
+    double start = nowSeconds(), elapsed;
+    do {
+        for (int s = 0; s < numSamples; s++) {
+            backend->evaluate(backend, &samples[s * numInputs],
+                              &outputs[s * numOutputs]);
+        }
+        evaluations += numSamples;
+        elapsed = nowSeconds() - start;
+    } while (numSamples > 0 && elapsed < HARNESS_MIN_SECONDS);
+
+    return evaluations > 0 ? elapsed * 1e9 / evaluations : 0.0;
+}
+
+/**
+ * The absolute difference of two outputs, 0.0 if both are NaN and infinite if
+ * only one is.
+ */
+static double outputError(double reference, double value) {
+    if (isnan(reference) || isnan(value)) {
+        return isnan(reference) && isnan(value) ? 0.0 : INFINITY;
+    }
+    return fabs(value - reference);
+}
+
+/**
+ * Runs every backend on the same samples and compares their outputs to those
+ * of the first backend, the reference.
+ *
+ * @param backends The backends, the reference first.
+ * @param numBackends The number of backends.
+ * @param numInputs The number of inputs per sample.
+ * @param numOutputs The number of outputs per sample, at most
+ * FUZZY_HARNESS_MAX_OUTPUTS.
+ * @param samples numInputs values per sample.
+ * @param numSamples The number of samples.
+ * @param results Receives one result per backend, the reference's errors are
+ * 0.0.
+ * @return The number of backends with an error above their tolerance, -1 if
+ * there are too many outputs or out of memory.
+ */
+int FuzzyHarnessRun(FuzzyBackend_t *backends, int numBackends, int numInputs,
+                    int numOutputs, const double *samples, int numSamples,
+                    FuzzyHarnessResult_t *results) {
+    if (numBackends < 1 || numOutputs > FUZZY_HARNESS_MAX_OUTPUTS) {
+        return -1;
+    }
+    double *reference = malloc((numSamples * numOutputs + 1) * sizeof(double));
+    double *outputs = malloc((numSamples * numOutputs + 1) * sizeof(double));
+    if (reference == NULL || outputs == NULL) {
+        free(reference);
+        free(outputs);
+        return -1;
+    }
+
+    int failed = 0;
+    for (int b = 0; b < numBackends; b++) {
+        FuzzyHarnessResult_t *result = &results[b];
+        memset(result, 0, sizeof(*result));
+        result->nanoseconds =
+            evaluateAll(&backends[b], numInputs, numOutputs, samples,
+                        numSamples, b == 0 ? reference : outputs);
+        if (b == 0) {
+            continue;
+        }
+
+        double largest = -1.0;
+        for (int s = 0; s < numSamples; s++) {
+            bool fails = false;
+            for (int o = 0; o < numOutputs; o++) {
+                double error = outputError(reference[s * numOutputs + o],
+                                           outputs[s * numOutputs + o]);
+                result->maxError[o] = fmax(result->maxError[o], error);
+                result->meanError[o] += error / numSamples;
+                fails = fails || !(error <= backends[b].tolerance);
+                if (error > largest) {
+                    largest = error;
+                    result->worst = s;
+                }
+            }
+            result->failures += fails;
+        }
+        failed += result->failures > 0;
+    }
+
+    free(reference);
+    free(outputs);
+    return failed;
+}
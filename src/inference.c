@@ -11,7 +11,9 @@
 
  #include "inference.h"
 
+ #include "class.h"
  #include "classifier.h"
+ #include "engine.h"
  #include "membership_function.h"
  
  #include <math.h>
@@ -20,119 +22,222 @@
  #include <stdio.h>
  
  /**
-  * Performs fuzzy inference on a set of fuzzy rules.
+  * Calculates the membership of a single literal, the complement if the
+  * variable is inverted (i.e., the NOT() macro is used).
+  */
+ static inline double literalMembership(const FuzzyVariable_t *variable) {
+     double membership = variable->variable->membershipValues[variable->value];
+     return variable->invert ? 1.0 - membership : membership;
+ }
+ 
+ // Instantiates the rule membership and aggregation kernels of one operator
+ // family. The norms are expanded in place, so every family compiles to the
+ // same straight line code as the min/max kernel, without a call per literal.
+ //
+ // Groups and rules stop at the value no further literal can change: 0.0 for
+ // the t-norm of every family, 1.0 for the s-norms that keep it exactly
+ // (_saturates; 1 + b - b of the product s-norm may round below 1.0).
+ #define DEFINE_FUZZY_KERNELS(_name, _tnorm, _snorm, _saturates)                \
+     static inline double ruleMembership##_name(const FuzzyRule_t *rule) {      \
+         double membership = 1.0;                                               \
+         for (int j = 0; j < rule->num_antecedents; j++) {                      \
+             const FuzzyAntecedent_t *antecedent = &rule->antecedent[j];        \
+             if (antecedent->fuzzy_operator == FUZZY_ANY_OF) {                  \
+                 double orMembership = 0.0;                                     \
+                 for (int k = 0; k < antecedent->num_variables; k++) {          \
+                     orMembership =                                             \
+                         _snorm(orMembership,                                   \
+                                literalMembership(&antecedent->variables[k]));  \
+                     if (_saturates && orMembership >= 1.0) {                   \
+                         break;                                                 \
+                     }                                                          \
+                 }                                                              \
+                 membership = _tnorm(membership, orMembership);                 \
+             } else if (antecedent->fuzzy_operator == FUZZY_ALL_OF) {           \
+                 double andMembership = 1.0;                                    \
+                 for (int k = 0; k < antecedent->num_variables; k++) {          \
+                     andMembership =                                            \
+                         _tnorm(andMembership,                                  \
+                                literalMembership(&antecedent->variables[k]));  \
+                     if (andMembership <= 0.0) {                                \
+                         break;                                                 \
+                     }                                                          \
+                 }                                                              \
+                 membership = _tnorm(membership, andMembership);                \
+             }                                                                  \
+             if (membership <= 0.0) {                                           \
+                 break;                                                         \
+             }                                                                  \
+         }                                                                      \
+         return membership;                                                     \
+     }                                                                          \
+                                                                                \
+     static inline void aggregate##_name(const FuzzyRule_t *rules,              \
+                                         int numRules) {                        \
+         double membership = 0.0;                                               \
+         for (int i = 0; i < numRules; i++) {                                   \
+             const FuzzyRule_t *rule = &rules[i];                               \
+             if (i == 0 || rule->antecedent != rules[i - 1].antecedent ||       \
+                 rule->num_antecedents != rules[i - 1].num_antecedents) {       \
+                 membership = ruleMembership##_name(rule);                      \
+             }                                                                  \
+             double *output = &rule->consequent.variable                        \
+                                   ->membershipValues[rule->consequent.value];  \
+             *output = _snorm(*output, membership);                             \
+         }                                                                      \
+     }                                                                          \
+                                                                                \
+     static inline void aggregateSelected##_name(                               \
+         const FuzzyRule_t *rules, const int *selected, int numSelected) {      \
+         double membership = 0.0;                                               \
+         const FuzzyRule_t *previous = NULL;                                    \
+         for (int i = 0; i < numSelected; i++) {                                \
+             const FuzzyRule_t *rule = &rules[selected[i]];                     \
+             if (previous == NULL || rule->antecedent != previous->antecedent || \
+                 rule->num_antecedents != previous->num_antecedents) {          \
+                 membership = ruleMembership##_name(rule);                      \
+             }                                                                  \
+             double *output = &rule->consequent.variable                        \
+                                   ->membershipValues[rule->consequent.value];  \
+             *output = _snorm(*output, membership);                             \
+             previous = rule;                                                   \
+         }                                                                      \
+     }
+ 
+ DEFINE_FUZZY_KERNELS(MinMax, FUZZY_TNORM_MIN_MAX, FUZZY_SNORM_MIN_MAX, 1)
+ DEFINE_FUZZY_KERNELS(Product, FUZZY_TNORM_PRODUCT, FUZZY_SNORM_PRODUCT, 0)
+ DEFINE_FUZZY_KERNELS(Lukasiewicz, FUZZY_TNORM_LUKASIEWICZ,
+                      FUZZY_SNORM_LUKASIEWICZ, 1)
+ 
+ /**
+  * Calculates the firing strength of a single fuzzy rule.
   *
-  * This function takes a set of fuzzy rules and calculates the output
-  * memberships for each rule. It iterates over each rule, calculates the
-  * minimum membership of the inputs, and updates the output memberships
-  * accordingly.
+  * ALL_OF groups take the t-norm and ANY_OF groups the s-norm of their
+  * variables, the groups of the antecedent are combined with the t-norm.
+  * Evaluation stops as soon as a group or the rule reaches 0.0, or an ANY_OF
+  * group 1.0, so the most selective literals and groups should come first
+  * (see FuzzyRuleReorder()).
+  *
+  * @param rule The fuzzy rule to evaluate.
+  * @param operators The operator family.
+  * @return The membership of the rule's antecedent.
+  */
+ double fuzzyRuleMembership(const FuzzyRule_t *rule,
+                            FuzzyOperators_e operators) {
+     switch (operators) {
+     case FUZZY_PRODUCT:
+         return ruleMembershipProduct(rule);
+     case FUZZY_LUKASIEWICZ:
+         return ruleMembershipLukasiewicz(rule);
+     default:
+         return ruleMembershipMinMax(rule);
+     }
+ }
+ 
+ /**
+  * Aggregates a set of fuzzy rules into their consequents.
+  *
+  * Every consequent membership is combined with the strength of its rule by
+  * the s-norm, output memberships are neither reset nor normalized. Rules that
+  * share their antecedent with the previous rule (see FuzzyRuleOptimize())
+  * reuse its membership.
+  *
+  * The operator family is dispatched once per call, each family has its own
+  * specialized kernel.
   *
   * @param rules An array of fuzzy rules.
   * @param numRules The number of fuzzy rules in the array.
+  * @param operators The operator family.
   */
- void fuzzyInference(const FuzzyRule_t *rules, int numRules) {
-     // Initialize the output memberships of the consequent to 0
-     for (int i = 0; i < numRules; i++) {
-         rules[i]
-             .consequent.variable->membershipValues[rules[i].consequent.value] =
-             0.0;
+ void fuzzyAggregate(const FuzzyRule_t *rules, int numRules,
+                     FuzzyOperators_e operators) {
+     switch (operators) {
+     case FUZZY_PRODUCT:
+         aggregateProduct(rules, numRules);
+         break;
+     case FUZZY_LUKASIEWICZ:
+         aggregateLukasiewicz(rules, numRules);
+         break;
+     default:
+         aggregateMinMax(rules, numRules);
+         break;
      }
+ }
  
-     // Iterate over each rule
-     for (int i = 0; i < numRules; i++) {
-         const FuzzyRule_t *rule = &rules[i];
- 
-         // Calculate the membership of the inputs
-         double membership = 1.0; // Initialize membership to 1.0 (maximum)
- 
-         // Iterate over each antecedent in the rule
-         for (int j = 0; j < rule->num_antecedents; j++) {
-             const FuzzyAntecedent_t *antecedent = &rule->antecedent[j];
- 
-             // Check if the antecedent is an ANY_OF fuzzy_operator
-             if (antecedent->fuzzy_operator== FUZZY_ANY_OF) {
-                 // Calculate the maximum membership of the variables in the
-                 // ANY_OF fuzzy_operator
-                 double orMembership = 0.0;
-                 for (int k = 0; k < antecedent->num_variables; k++) {
-                     double inputMembership;
- 
-                     // Check if the variable is inverted (i.e., NOT() macro is
-                     // used)
-                     if (antecedent->variables[k].invert) {
-                         // If the variable is inverted, calculate the membership
-                         // of the complement (i.e., 1 - membership) This is
-                         // because the NOT() macro inverts the membership of the
-                         // variable
-                         inputMembership =
-                             1.0 -
-                             antecedent->variables[k].variable->membershipValues
-                                 [antecedent->variables[k].value];
-                     } else {
-                         // If the variable is not inverted, calculate the
-                         // membership as usual
-                         inputMembership =
-                             antecedent->variables[k].variable->membershipValues
-                                 [antecedent->variables[k].value];
-                     }
- 
-                     // Update the maximum membership of the variables in the
-                     // ANY_OF fuzzy_operator
-                     orMembership = fmax(orMembership, inputMembership);
-                 }
- 
-                 // Update the membership with the minimum of the current
-                 // membership and the ANY_OF membership
-                 membership = fmin(membership, orMembership);
-             } else if (antecedent->fuzzy_operator== FUZZY_ALL_OF) {
-                 // Calculate the minimum membership of the variables in the
-                 // ALL_OF fuzzy_operator
-                 double andMembership = 1.0;
-                 for (int k = 0; k < antecedent->num_variables; k++) {
-                     double inputMembership;
- 
-                     // Check if the variable is inverted (i.e., NOT() macro is
-                     // used)
-                     if (antecedent->variables[k].invert) {
-                         // If the variable is inverted, calculate the membership
-                         // of the complement (i.e., 1 - membership) This is
-                         // because the NOT() macro inverts the membership of the
-                         // variable
-                         inputMembership =
-                             1.0 -
-                             antecedent->variables[k].variable->membershipValues
-                                 [antecedent->variables[k].value];
-                     } else {
-                         // If the variable is not inverted, calculate the
-                         // membership as usual
-                         inputMembership =
-                             antecedent->variables[k].variable->membershipValues
-                                 [antecedent->variables[k].value];
-                     }
- 
-                     // Update the minimum membership of the variables in the
-                     // ALL_OF fuzzy_operator
-                     andMembership = fmin(andMembership, inputMembership);
-                 }
+ /**
+  * Aggregates a subset of fuzzy rules into their consequents.
+  *
+  * Like fuzzyAggregate(), but only the rules at the given indices are
+  * evaluated, in the given order. Skipping rules that can not fire leaves the
+  * consequents exactly as aggregating them would, the s-norm of x and 0 is x
+  * for every operator family.
+  *
+  * @param rules An array of fuzzy rules.
+  * @param selected The indices of the rules to aggregate, ascending.
+  * @param numSelected The number of indices.
+  * @param operators The operator family.
+  */
+ void fuzzyAggregateSelected(const FuzzyRule_t *rules, const int *selected,
+                             int numSelected, FuzzyOperators_e operators) {
+     switch (operators) {
+     case FUZZY_PRODUCT:
+         aggregateSelectedProduct(rules, selected, numSelected);
+         break;
+     case FUZZY_LUKASIEWICZ:
+         aggregateSelectedLukasiewicz(rules, selected, numSelected);
+         break;
+     default:
+         aggregateSelectedMinMax(rules, selected, numSelected);
+         break;
+     }
+ }
  
-                 // Update the membership with the minimum of the current
-                 // membership and the ALL_OF membership
-                 membership = fmin(membership, andMembership);
-             }
-         }
+ /**
+  * Performs fuzzy inference on a set of fuzzy rules with an operator family.
+  *
+  * Every output set is reset and normalized exactly once. Control loops that
+  * evaluate the same rules every cycle should keep a FuzzyEngine_t around
+  * instead, which finds the output sets only once.
+  *
+  * @param rules An array of fuzzy rules.
+  * @param numRules The number of fuzzy rules in the array.
+  * @param operators The operator family.
+  */
+ void fuzzyInferenceWith(const FuzzyRule_t *rules, int numRules,
+                         FuzzyOperators_e operators) {
+     FuzzyEngine_t engine;
+     if (FuzzyEngineInit(&engine, rules, numRules) == 0) {
+         engine.operators = operators;
+         FuzzyEngineInfer(&engine);
+         return;
+     }
  
-         // Update the output membership with the maximum of the current
-         // membership and the calculated membership
+     // More sets than an engine can track, reset and normalize per rule
+     for (int i = 0; i < numRules; i++) {
          rules[i]
              .consequent.variable->membershipValues[rules[i].consequent.value] =
-             fmax(rules[i]
-                      .consequent.variable
-                      ->membershipValues[rules[i].consequent.value],
-                  membership);
+             0.0;
      }
  
+     fuzzyAggregate(rules, numRules, operators);
+ 
      // Normalize the output membership
      for (int i = 0; i < numRules; i++) {
          normalizeClass(rules[i].consequent.variable);
      }
+ }
+ 
+ /**
+  * Performs fuzzy inference on a set of fuzzy rules.
+  *
+  * This function takes a set of fuzzy rules and calculates the output
+  * memberships for each rule. It iterates over each rule, calculates the
+  * minimum membership of the inputs, and updates the output memberships
+  * with the maximum.
+  *
+  * @param rules An array of fuzzy rules.
+  * @param numRules The number of fuzzy rules in the array.
+  */
+ void fuzzyInference(const FuzzyRule_t *rules, int numRules) {
+     fuzzyInferenceWith(rules, numRules, FUZZY_MIN_MAX);
  }
\ No newline at end of file
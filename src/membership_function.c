@@ -11,6 +11,12 @@
 
 #include "membership_function.h"
 
+#include "fuzzy_math.h"
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+
 /**
  * Calculates the membership degree of a triangular membership function.
  *
@@ -103,14 +109,64 @@ double rectangularMembershipFunction(double x, double a, double b) {
     }
 }
 
+/**
+ * Calculates the membership degree of a gaussian membership function.
+ *
+ * @param x The input value to calculate the membership degree for.
+ * @param center The center of the bell.
+ * @param sigma The standard deviation of the bell.
+ * @return The membership degree of the input value.
+ */
+double gaussianMembershipFunction(double x, double center, double sigma) {
+    // A zero width bell degenerates to a singleton
+    if (sigma == 0.0) {
+        return x == center ? 1.0 : 0.0;
+    }
+    double z = (x - center) / sigma;
+    return fuzzyExp(-0.5 * z * z);
+}
+
+/**
+ * Calculates the membership degree of a sigmoid membership function.
+ *
+ * A positive slope opens to the right, a negative slope to the left.
+ *
+ * @param x The input value to calculate the membership degree for.
+ * @param slope The slope at the inflection point, times 4.
+ * @param inflection The input value with a membership degree of 0.5.
+ * @return The membership degree of the input value.
+ */
+double sigmoidMembershipFunction(double x, double slope, double inflection) {
+    return 1.0 / (1.0 + fuzzyExp(-slope * (x - inflection)));
+}
+
+/**
+ * Calculates the membership degree of a generalized bell membership function,
+ * 1 / (1 + |(x - center) / width|^(2 * slope)).
+ *
+ * @param x The input value to calculate the membership degree for.
+ * @param width The half width of the bell at a membership degree of 0.5.
+ * @param slope The steepness of the flanks.
+ * @param center The center of the bell.
+ * @return The membership degree of the input value.
+ */
+double generalizedBellMembershipFunction(double x, double width, double slope,
+                                         double center) {
+    double t = fabs((x - center) / width);
+    if (t < DBL_MIN) {
+        return 1.0;
+    }
+    return 1.0 / (1.0 + fuzzyExp(2.0 * slope * fuzzyLog(t)));
+}
+
 /**
  * Calculates the membership degree of a generic membership function.
  *
  * This function takes an input x and a MembershipFunction_t struct as
  * arguments. The MembershipFunction_t struct is not defined in this code
  * snippet, but it is assumed to have a type field that indicates the type of
- * membership function to use (either TRIANGULAR or TRAPEZOIDAL) and fields a,
- * b, c, and d that represent the parameters of the membership function.
+ * membership function to use and fields a, b, c, and d that represent the
+ * parameters of the membership function.
  *
  * @param x The input value to calculate the membership degree for.
  * @param mf The MembershipFunction_t struct that defines the membership
@@ -133,9 +189,342 @@ double membershipFunction(double x, MembershipFunction_t mf) {
         // Call the rectangular membership function with the input x and the
         // membership function parameters
         return rectangularMembershipFunction(x, mf.a, mf.b);
+    case GAUSSIAN:
+        return gaussianMembershipFunction(x, mf.a, mf.b);
+    case SIGMOID:
+        return sigmoidMembershipFunction(x, mf.a, mf.b);
+    case GENERALIZED_BELL:
+        return generalizedBellMembershipFunction(x, mf.a, mf.b, mf.c);
     default:
         // If the membership function type is not recognized, return 0 (no
         // membership)
         return 0.0;
     }
 }
+
+/**
+ * Derives the values membershipFunctionPrepared() needs from a membership
+ * function, together with its support and area.
+ *
+ * The centroid is left at 0.0, it is the defuzzifier's business.
+ *
+ * @param mf The membership function.
+ * @param data Receives the derived values.
+ */
+void membershipFunctionPrepare(MembershipFunction_t mf,
+                               MembershipFunctionData_t *data) {
+    data->rise = data->fall = 0.0;
+    data->area = INFINITY;
+    data->centroid = 0.0;
+    membershipFunctionSupport(mf, &data->lower, &data->upper);
+
+    switch (mf.type) {
+    case TRIANGULAR:
+        data->rise = 1.0 / (mf.b - mf.a);
+        data->fall = 1.0 / (mf.c - mf.b);
+        data->area = (mf.c - mf.a) / 2.0;
+        break;
+    case TRAPEZOIDAL:
+        data->rise = 1.0 / (mf.b - mf.a);
+        data->fall = 1.0 / (mf.d - mf.c);
+        data->area = (mf.d - mf.a + mf.c - mf.b) / 2.0;
+        break;
+    case RECTANGULAR:
+        data->area = mf.b - mf.a;
+        break;
+    case GAUSSIAN:
+        // the reciprocal width of the bell
+        data->rise = 1.0 / mf.b;
+        data->area = fabs(mf.b) * sqrt(2.0 * M_PI);
+        break;
+    case GENERALIZED_BELL:
+        data->rise = 1.0 / mf.a;
+        if (mf.b > 0.5) {
+            double q = M_PI / (2.0 * mf.b);
+            data->area = 2.0 * fabs(mf.a) * q / sin(q);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Calculates the membership degree of a prepared membership function.
+ *
+ * Like membershipFunction(), but the flanks multiply by the reciprocal widths
+ * from membershipFunctionPrepare() instead of dividing by the widths. Peaks
+ * and shoulders are exactly 1.0, the flanks may differ from
+ * membershipFunction() in the last bit.
+ *
+ * @param x The input value to calculate the membership degree for.
+ * @param mf The membership function.
+ * @param data The values derived from mf.
+ * @return The membership degree of the input value.
+ */
+double membershipFunctionPrepared(double x, MembershipFunction_t mf,
+                                  const MembershipFunctionData_t *data) {
+    switch (mf.type) {
+    case TRIANGULAR:
+        if (x < mf.a || x > mf.c) {
+            return 0.0;
+        } else if (x < mf.b) {
+            return (x - mf.a) * data->rise;
+        } else if (x == mf.b) {
+            return 1.0;
+        }
+        return (mf.c - x) * data->fall;
+    case TRAPEZOIDAL:
+        if (x <= mf.a || x >= mf.d) {
+            return 0.0;
+        } else if (x < mf.b) {
+            return (x - mf.a) * data->rise;
+        } else if (x > mf.c) {
+            return (mf.d - x) * data->fall;
+        }
+        return 1.0;
+    case GAUSSIAN:
+        if (mf.b != 0.0) {
+            double z = (x - mf.a) * data->rise;
+            return fuzzyExp(-0.5 * z * z);
+        }
+        return membershipFunction(x, mf);
+    case GENERALIZED_BELL:
+        if (mf.a != 0.0) {
+            double t = fabs((x - mf.c) * data->rise);
+            if (t < DBL_MIN) {
+                return 1.0;
+            }
+            return 1.0 / (1.0 + fuzzyExp(2.0 * mf.b * fuzzyLog(t)));
+        }
+        return membershipFunction(x, mf);
+    default:
+        return membershipFunction(x, mf);
+    }
+}
+
+/**
+ * Calculates the membership degree of a generic membership function together
+ * with its derivatives by the parameters a, b, c, d and the input value.
+ *
+ * The piecewise linear shapes use one sided derivatives at their breakpoints,
+ * the side is the one membershipFunction() evaluates there. The jumps of a
+ * rectangle have no derivative and count as 0.
+ *
+ * @param x The input value to calculate the membership degree for.
+ * @param mf The membership function.
+ * @param derivatives Receives d/da, d/db, d/dc, d/dd and d/dx.
+ * @return The membership degree of the input value, the same as
+ * membershipFunction() returns.
+ */
+double membershipFunctionDerivatives(double x, MembershipFunction_t mf,
+                                     double derivatives[5]) {
+    double *d = derivatives;
+    d[0] = d[1] = d[2] = d[3] = d[4] = 0.0;
+    double membership = membershipFunction(x, mf);
+
+    switch (mf.type) {
+    case TRIANGULAR:
+        if (x < mf.a || x > mf.c || (x <= mf.b && mf.b - mf.a == 0)) {
+            break;
+        }
+        if (x <= mf.b) {
+            double width = mf.b - mf.a;
+            d[0] = (x - mf.b) / (width * width);
+            d[1] = -(x - mf.a) / (width * width);
+            d[4] = 1.0 / width;
+        } else {
+            double width = mf.c - mf.b;
+            d[1] = (mf.c - x) / (width * width);
+            d[2] = (x - mf.b) / (width * width);
+            d[4] = -1.0 / width;
+        }
+        break;
+    case TRAPEZOIDAL:
+        if (x <= mf.a || x >= mf.d) {
+            break;
+        }
+        if (x <= mf.b) {
+            double width = mf.b - mf.a;
+            d[0] = (x - mf.b) / (width * width);
+            d[1] = -(x - mf.a) / (width * width);
+            d[4] = 1.0 / width;
+        } else if (x >= mf.c) {
+            double width = mf.d - mf.c;
+            d[2] = (mf.d - x) / (width * width);
+            d[3] = (x - mf.c) / (width * width);
+            d[4] = -1.0 / width;
+        }
+        break;
+    case GAUSSIAN:
+        if (mf.b != 0.0) {
+            double z = (x - mf.a) / mf.b;
+            d[0] = membership * z / mf.b;
+            d[1] = membership * z * z / mf.b;
+            d[4] = -d[0];
+        }
+        break;
+    case SIGMOID: {
+        double slope = membership * (1.0 - membership);
+        d[0] = slope * (x - mf.b);
+        d[1] = -slope * mf.a;
+        d[4] = slope * mf.a;
+        break;
+    }
+    case GENERALIZED_BELL: {
+        double t = fabs((x - mf.c) / mf.a);
+        if (t < DBL_MIN) {
+            break;
+        }
+        // membership = 1 / (1 + g), g = t^(2 * slope)
+        double g = fuzzyExp(2.0 * mf.b * fuzzyLog(t));
+        double dg = -membership * membership;
+        double dt = dg * 2.0 * mf.b * g / t;
+        double sign = x > mf.c ? 1.0 : -1.0;
+        d[0] = dt * -t / mf.a;
+        d[1] = dg * 2.0 * g * fuzzyLog(t);
+        d[2] = dt * -sign / fabs(mf.a);
+        d[4] = dt * sign / fabs(mf.a);
+        break;
+    }
+    default:
+        break;
+    }
+    return membership;
+}
+
+/**
+ * Returns how many of the parameters a, b, c and d a membership function type
+ * uses, the remaining ones are ignored.
+ *
+ * @param type The membership function type.
+ * @return The number of parameters, 0 for an unknown type.
+ */
+int membershipFunctionParameters(MembershipFunctionType_e type) {
+    switch (type) {
+    case TRAPEZOIDAL:
+        return 4;
+    case TRIANGULAR:
+    case GENERALIZED_BELL:
+        return 3;
+    case RECTANGULAR:
+    case GAUSSIAN:
+    case SIGMOID:
+        return 2;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * Finds the interval outside of which a membership function is zero.
+ *
+ * The interval is closed and may be wider than the true support, e.g. a
+ * trapezoid is zero at its feet. The smooth shapes never reach zero.
+ *
+ * @param mf The membership function.
+ * @param lower Receives the lower end of the support.
+ * @param upper Receives the upper end of the support.
+ * @return 0 if the support is bounded, -1 if it is not.
+ */
+int membershipFunctionSupport(MembershipFunction_t mf, double *lower,
+                              double *upper) {
+    switch (mf.type) {
+    case TRIANGULAR:
+        *lower = mf.a;
+        *upper = mf.c;
+        return 0;
+    case TRAPEZOIDAL:
+        *lower = mf.a;
+        *upper = mf.d;
+        return 0;
+    case RECTANGULAR:
+        *lower = mf.a;
+        *upper = mf.b;
+        return 0;
+    case GAUSSIAN:
+        // only a zero width bell is bounded
+        *lower = mf.b == 0.0 ? mf.a : -INFINITY;
+        *upper = mf.b == 0.0 ? mf.a : INFINITY;
+        return mf.b == 0.0 ? 0 : -1;
+    default:
+        *lower = -INFINITY;
+        *upper = INFINITY;
+        return -1;
+    }
+}
+
+/**
+ * Returns the name of a membership function type as used in the
+ * DEFINE_FUZZY_MEMBERSHIP tables.
+ *
+ * @param type The membership function type.
+ * @return The name, "UNKNOWN" for an unknown type.
+ */
+const char *membershipFunctionName(MembershipFunctionType_e type) {
+    switch (type) {
+    case TRIANGULAR:
+        return "TRIANGULAR";
+    case TRAPEZOIDAL:
+        return "TRAPEZOIDAL";
+    case RECTANGULAR:
+        return "RECTANGULAR";
+    case GAUSSIAN:
+        return "GAUSSIAN";
+    case SIGMOID:
+        return "SIGMOID";
+    case GENERALIZED_BELL:
+        return "GENERALIZED_BELL";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+/**
+ * Calculates the membership degrees of many input values for one membership
+ * function.
+ *
+ * The smooth shapes are evaluated FUZZY_VECTOR_LENGTH values at a time with
+ * the vector approximations, the results are the same as membershipFunction()
+ * returns for every single value.
+ *
+ * @param x The input values.
+ * @param memberships Receives one membership degree per input value.
+ * @param n The number of input values.
+ * @param mf The membership function.
+ */
+void membershipFunctionBatch(const double *x, double *memberships, int n,
+                             MembershipFunction_t mf) {
+    int i = 0;
+
+    if ((mf.type == GAUSSIAN && mf.b != 0.0) || mf.type == SIGMOID ||
+        mf.type == GENERALIZED_BELL) {
+        for (; i + FUZZY_VECTOR_LENGTH <= n; i += FUZZY_VECTOR_LENGTH) {
+            FuzzyVector_t v, result;
+            memcpy(&v, &x[i], sizeof(v));
+
+            if (mf.type == GAUSSIAN) {
+                FuzzyVector_t z = (v - mf.a) / mf.b;
+                result = fuzzyExpVector(-0.5 * z * z);
+            } else if (mf.type == SIGMOID) {
+                result = 1.0 / (1.0 + fuzzyExpVector(-mf.a * (v - mf.b)));
+            } else {
+                FuzzyVector_t t = (v - mf.c) / mf.a;
+                t = fuzzyVectorSelect(t < 0.0, -t, t);
+                // centers keep a membership of exactly 1
+                FuzzyVectorMask_t center = t < DBL_MIN;
+                const FuzzyVector_t zero = {0};
+                t = fuzzyVectorSelect(center, zero + 1.0, t);
+                result = 1.0 / (1.0 + fuzzyExpVector(2.0 * mf.b *
+                                                     fuzzyLogVector(t)));
+                result = fuzzyVectorSelect(center, zero + 1.0, result);
+            }
+
+            memcpy(&memberships[i], &result, sizeof(result));
+        }
+    }
+
+    for (; i < n; i++) {
+        memberships[i] = membershipFunction(x[i], mf);
+    }
+}
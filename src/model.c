@@ -0,0 +1,1206 @@
+/**
+ * @file model.c
+ * @brief Fuzzy Logic runtime model loader and binary image implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "model.h"
+
+#include "class.h"
+#include "inference.h"
+#include "membership_function.h"
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const struct {
+    const char *name;
+    MembershipFunctionType_e type;
+} membershipTypeNames[] = {
+    {"TRIANGULAR", TRIANGULAR},
+    {"TRAPEZOIDAL", TRAPEZOIDAL},
+    {"RECTANGULAR", RECTANGULAR},
+    {"GAUSSIAN", GAUSSIAN},
+    {"SIGMOID", SIGMOID},
+    {"GENERALIZED_BELL", GENERALIZED_BELL},
+};
+
+/**
+ * Fills in a model error and returns -1 so callers can `return modelError()`.
+ *
+ * @param error The error to fill in, may be NULL.
+ * @param line The line of the text description, 0 if not applicable.
+ * @param format printf-style format of the message.
+ * @return Always -1.
+ */
+static int modelError(FuzzyModelError_t *error, int line, const char *format,
+                      ...) {
+    if (error != NULL) {
+        va_list args;
+        va_start(args, format);
+        error->line = line;
+        vsnprintf(error->message, sizeof(error->message), format, args);
+        va_end(args);
+    }
+    return -1;
+}
+
+/**
+ * FNV-1a hash used as the image checksum.
+ *
+ * @param data The bytes to hash.
+ * @param length The number of bytes to hash.
+ * @return The 64 bit FNV-1a hash.
+ */
+static uint64_t modelChecksum(const unsigned char *data, size_t length) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// ---------------------------------------------------------------------------
+// text description parser
+// ---------------------------------------------------------------------------
+
+typedef struct {
+    void *data;
+    int count;
+    int capacity;
+    size_t elementSize;
+} ModelArray_t;
+
+typedef struct {
+    ModelArray_t variables;
+    ModelArray_t terms;
+    ModelArray_t rules;
+    ModelArray_t groups;
+    ModelArray_t literals;
+} ModelBuilder_t;
+
+typedef enum {
+    TOKEN_END,
+    TOKEN_IDENTIFIER,
+    TOKEN_NUMBER,
+    TOKEN_PUNCTUATION
+} ModelTokenType_e;
+
+typedef struct {
+    ModelTokenType_e type;
+    char text[FUZZY_MODEL_NAME_LENGTH * 2];
+    double number;
+    int line;
+} ModelToken_t;
+
+typedef struct {
+    const char *cursor;
+    int line;
+    ModelToken_t token;
+    FuzzyModelError_t *error;
+} ModelParser_t;
+
+static void *arrayPush(ModelArray_t *array) {
+    if (array->count == array->capacity) {
+        int capacity = array->capacity ? array->capacity * 2 : 16;
+        void *data = realloc(array->data, capacity * array->elementSize);
+        if (data == NULL) {
+            return NULL;
+        }
+        array->data = data;
+        array->capacity = capacity;
+    }
+    void *element = (char *)array->data + array->count * array->elementSize;
+    memset(element, 0, array->elementSize);
+    array->count++;
+    return element;
+}
+
+/**
+ * Advances the parser to the next token, skipping whitespace and comments.
+ *
+ * @param parser The parser to advance.
+ * @return 0 on success, -1 on a malformed token.
+ */
+static int nextToken(ModelParser_t *parser) {
+    const char *p = parser->cursor;
+    ModelToken_t *token = &parser->token;
+
+    for (;;) {
+        while (*p != '\0' && isspace((unsigned char)*p)) {
+            if (*p == '\n') {
+                parser->line++;
+            }
+            p++;
+        }
+        if (*p != '#') {
+            break;
+        }
+        while (*p != '\0' && *p != '\n') {
+            p++;
+        }
+    }
+
+    token->line = parser->line;
+    token->text[0] = '\0';
+
+    if (*p == '\0') {
+        token->type = TOKEN_END;
+    } else if (isalpha((unsigned char)*p) || *p == '_') {
+        size_t length = 0;
+        while (isalnum((unsigned char)*p) || *p == '_') {
+            if (length + 1 >= sizeof(token->text)) {
+                return modelError(parser->error, parser->line,
+                                  "identifier too long");
+            }
+            token->text[length++] = *p++;
+        }
+        token->text[length] = '\0';
+        token->type = TOKEN_IDENTIFIER;
+    } else if (isdigit((unsigned char)*p) || *p == '-' || *p == '+' ||
+               *p == '.') {
+        char *end;
+        token->number = strtod(p, &end);
+        if (end == p) {
+            return modelError(parser->error, parser->line,
+                              "malformed number");
+        }
+        p = end;
+        token->type = TOKEN_NUMBER;
+    } else {
+        token->text[0] = *p++;
+        token->text[1] = '\0';
+        token->type = TOKEN_PUNCTUATION;
+    }
+
+    parser->cursor = p;
+    return 0;
+}
+
+static int expectPunctuation(ModelParser_t *parser, char punctuation) {
+    if (parser->token.type != TOKEN_PUNCTUATION ||
+        parser->token.text[0] != punctuation) {
+        return modelError(parser->error, parser->token.line,
+                          "expected '%c'", punctuation);
+    }
+    return nextToken(parser);
+}
+
+static int expectIdentifier(ModelParser_t *parser, char *out, size_t size) {
+    if (parser->token.type != TOKEN_IDENTIFIER) {
+        return modelError(parser->error, parser->token.line,
+                          "expected identifier");
+    }
+    if (strlen(parser->token.text) >= size) {
+        return modelError(parser->error, parser->token.line,
+                          "name '%s' is longer than %d characters",
+                          parser->token.text, (int)size - 1);
+    }
+    strcpy(out, parser->token.text);
+    return nextToken(parser);
+}
+
+static int builderFindVariable(const ModelBuilder_t *builder,
+                               const char *name) {
+    const FuzzyModelVariable_t *variables = builder->variables.data;
+    for (int i = 0; i < builder->variables.count; i++) {
+        if (strcmp(variables[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static int builderFindTerm(const ModelBuilder_t *builder, int variable,
+                           const char *name) {
+    const FuzzyModelVariable_t *v =
+        &((const FuzzyModelVariable_t *)builder->variables.data)[variable];
+    const FuzzyModelTerm_t *terms = builder->terms.data;
+    for (uint32_t i = 0; i < v->numTerms; i++) {
+        if (strcmp(terms[v->firstTerm + i].name, name) == 0) {
+            return (int)(v->firstTerm + i);
+        }
+    }
+    return -1;
+}
+
+/**
+ * Parses `(Variable, TERM)` and resolves it to a variable and term index.
+ */
+static int parseReference(ModelParser_t *parser, ModelBuilder_t *builder,
+                          FuzzyModelVariableKind_e kind, uint32_t *variable,
+                          uint32_t *term) {
+    char variableName[FUZZY_MODEL_NAME_LENGTH];
+    char termName[FUZZY_MODEL_NAME_LENGTH];
+    int line = parser->token.line;
+
+    if (expectPunctuation(parser, '(') ||
+        expectIdentifier(parser, variableName, sizeof(variableName)) ||
+        expectPunctuation(parser, ',') ||
+        expectIdentifier(parser, termName, sizeof(termName)) ||
+        expectPunctuation(parser, ')')) {
+        return -1;
+    }
+
+    int v = builderFindVariable(builder, variableName);
+    if (v < 0) {
+        return modelError(parser->error, line, "unknown variable '%s'",
+                          variableName);
+    }
+    if (((FuzzyModelVariable_t *)builder->variables.data)[v].kind != kind) {
+        return modelError(parser->error, line,
+                          kind == FUZZY_MODEL_INPUT
+                              ? "'%s' is not an input variable"
+                              : "'%s' is not an output variable",
+                          variableName);
+    }
+    int t = builderFindTerm(builder, v, termName);
+    if (t < 0) {
+        return modelError(parser->error, line, "unknown term '%s' of '%s'",
+                          termName, variableName);
+    }
+
+    *variable = (uint32_t)v;
+    *term = (uint32_t)t;
+    return 0;
+}
+
+static int parseVariable(ModelParser_t *parser, ModelBuilder_t *builder,
+                         FuzzyModelVariableKind_e kind) {
+    char name[FUZZY_MODEL_NAME_LENGTH];
+    int line = parser->token.line;
+
+    if (nextToken(parser) || expectIdentifier(parser, name, sizeof(name))) {
+        return -1;
+    }
+    if (builderFindVariable(builder, name) >= 0) {
+        return modelError(parser->error, line, "duplicate variable '%s'",
+                          name);
+    }
+
+    FuzzyModelVariable_t *variable = arrayPush(&builder->variables);
+    if (variable == NULL) {
+        return modelError(parser->error, line, "out of memory");
+    }
+    strcpy(variable->name, name);
+    variable->kind = kind;
+    variable->firstTerm = builder->terms.count;
+    return 0;
+}
+
+static int parseTerm(ModelParser_t *parser, ModelBuilder_t *builder) {
+    char name[FUZZY_MODEL_NAME_LENGTH];
+    double parameters[4] = {0.0, 0.0, 0.0, 0.0};
+    int numParameters = 0;
+    int line = parser->token.line;
+
+    if (builder->variables.count == 0) {
+        return modelError(parser->error, line,
+                          "term declared before any variable");
+    }
+    if (nextToken(parser) || expectIdentifier(parser, name, sizeof(name))) {
+        return -1;
+    }
+
+    while (parser->token.type == TOKEN_NUMBER) {
+        if (numParameters == 4) {
+            return modelError(parser->error, line,
+                              "too many membership function parameters");
+        }
+        parameters[numParameters++] = parser->token.number;
+        if (nextToken(parser)) {
+            return -1;
+        }
+    }
+
+    if (parser->token.type != TOKEN_IDENTIFIER) {
+        return modelError(parser->error, line,
+                          "expected membership function type");
+    }
+    int type = -1;
+    for (size_t i = 0; i < sizeof(membershipTypeNames) /
+                               sizeof(membershipTypeNames[0]);
+         i++) {
+        if (strcmp(parser->token.text, membershipTypeNames[i].name) == 0) {
+            type = membershipTypeNames[i].type;
+        }
+    }
+    if (type < 0) {
+        return modelError(parser->error, line,
+                          "unknown membership function type '%s'",
+                          parser->token.text);
+    }
+
+    int variableIndex = builder->variables.count - 1;
+    if (builderFindTerm(builder, variableIndex, name) >= 0) {
+        return modelError(parser->error, line, "duplicate term '%s'", name);
+    }
+
+    FuzzyModelTerm_t *term = arrayPush(&builder->terms);
+    if (term == NULL) {
+        return modelError(parser->error, line, "out of memory");
+    }
+    strcpy(term->name, name);
+    term->a = parameters[0];
+    term->b = parameters[1];
+    term->c = parameters[2];
+    term->d = parameters[3];
+    term->type = (uint32_t)type;
+    term->variable = (uint32_t)variableIndex;
+    ((FuzzyModelVariable_t *)builder->variables.data)[variableIndex]
+        .numTerms++;
+
+    return nextToken(parser);
+}
+
+static int parseGroup(ModelParser_t *parser, ModelBuilder_t *builder) {
+    int line = parser->token.line;
+    FuzzyModelGroup_t group = {0};
+
+    if (strcmp(parser->token.text, "ALL_OF") == 0) {
+        group.fuzzy_operator = FUZZY_ALL_OF;
+    } else if (strcmp(parser->token.text, "ANY_OF") == 0) {
+        group.fuzzy_operator = FUZZY_ANY_OF;
+    } else {
+        return modelError(parser->error, line, "expected ALL_OF or ANY_OF");
+    }
+    group.firstLiteral = builder->literals.count;
+
+    if (nextToken(parser) || expectPunctuation(parser, '(')) {
+        return -1;
+    }
+    for (;;) {
+        FuzzyModelLiteral_t literal = {0};
+        if (parser->token.type != TOKEN_IDENTIFIER ||
+            (strcmp(parser->token.text, "VAR") != 0 &&
+             strcmp(parser->token.text, "NOT") != 0)) {
+            return modelError(parser->error, parser->token.line,
+                              "expected VAR or NOT");
+        }
+        literal.invert = strcmp(parser->token.text, "NOT") == 0;
+        if (nextToken(parser) ||
+            parseReference(parser, builder, FUZZY_MODEL_INPUT,
+                           &literal.variable, &literal.term)) {
+            return -1;
+        }
+
+        FuzzyModelLiteral_t *slot = arrayPush(&builder->literals);
+        if (slot == NULL) {
+            return modelError(parser->error, line, "out of memory");
+        }
+        *slot = literal;
+        group.numLiterals++;
+
+        if (parser->token.type == TOKEN_PUNCTUATION &&
+            parser->token.text[0] == ',') {
+            if (nextToken(parser)) {
+                return -1;
+            }
+            continue;
+        }
+        break;
+    }
+    if (expectPunctuation(parser, ')')) {
+        return -1;
+    }
+
+    FuzzyModelGroup_t *slot = arrayPush(&builder->groups);
+    if (slot == NULL) {
+        return modelError(parser->error, line, "out of memory");
+    }
+    *slot = group;
+    return 0;
+}
+
+static int parseRule(ModelParser_t *parser, ModelBuilder_t *builder) {
+    int line = parser->token.line;
+    FuzzyModelRule_t rule = {0};
+
+    if (nextToken(parser)) {
+        return -1;
+    }
+    if (parser->token.type != TOKEN_IDENTIFIER ||
+        strcmp(parser->token.text, "WHEN") != 0) {
+        return modelError(parser->error, parser->token.line, "expected WHEN");
+    }
+    if (nextToken(parser)) {
+        return -1;
+    }
+
+    rule.firstGroup = builder->groups.count;
+    while (parser->token.type == TOKEN_IDENTIFIER &&
+           strcmp(parser->token.text, "THEN") != 0) {
+        if (parseGroup(parser, builder)) {
+            return -1;
+        }
+        rule.numGroups++;
+    }
+    if (rule.numGroups == 0) {
+        return modelError(parser->error, line, "rule without antecedent");
+    }
+    if (parser->token.type != TOKEN_IDENTIFIER) {
+        return modelError(parser->error, parser->token.line, "expected THEN");
+    }
+    if (nextToken(parser) ||
+        parseReference(parser, builder, FUZZY_MODEL_OUTPUT,
+                       &rule.consequentVariable, &rule.consequentTerm)) {
+        return -1;
+    }
+
+    FuzzyModelRule_t *slot = arrayPush(&builder->rules);
+    if (slot == NULL) {
+        return modelError(parser->error, line, "out of memory");
+    }
+    *slot = rule;
+    return 0;
+}
+
+static size_t alignSection(size_t offset) { return (offset + 7) & ~(size_t)7; }
+
+/**
+ * Serializes the parsed records into one contiguous image.
+ */
+static int builderCompile(const ModelBuilder_t *builder, FuzzyModel_t *model,
+                          FuzzyModelError_t *error) {
+    const ModelArray_t *arrays[] = {&builder->variables, &builder->terms,
+                                    &builder->rules, &builder->groups,
+                                    &builder->literals};
+    FuzzyModelSection_t sections[5];
+    size_t size = alignSection(sizeof(FuzzyModelHeader_t));
+
+    for (int i = 0; i < 5; i++) {
+        sections[i].offset = (uint32_t)size;
+        sections[i].count = (uint32_t)arrays[i]->count;
+        size = alignSection(size + arrays[i]->count * arrays[i]->elementSize);
+    }
+
+    unsigned char *image = calloc(1, size);
+    if (image == NULL) {
+        return modelError(error, 0, "out of memory");
+    }
+
+    FuzzyModelHeader_t *header = (FuzzyModelHeader_t *)image;
+    memcpy(header->magic, FUZZY_MODEL_MAGIC, 4);
+    header->version = FUZZY_MODEL_VERSION;
+    header->byteOrder = FUZZY_MODEL_BYTE_ORDER;
+    header->headerSize = sizeof(FuzzyModelHeader_t);
+    header->imageSize = size;
+    header->variables = sections[0];
+    header->terms = sections[1];
+    header->rules = sections[2];
+    header->groups = sections[3];
+    header->literals = sections[4];
+
+    for (int i = 0; i < 5; i++) {
+        if (arrays[i]->count > 0) {
+            memcpy(image + sections[i].offset, arrays[i]->data,
+                   arrays[i]->count * arrays[i]->elementSize);
+        }
+    }
+    header->checksum = modelChecksum(image + header->headerSize,
+                                     size - header->headerSize);
+
+    if (FuzzyModelFromImage(model, image, size, 0, error)) {
+        free(image);
+        return -1;
+    }
+    model->storage = FUZZY_MODEL_HEAP;
+    return 0;
+}
+
+/**
+ * Parses a human-editable model description.
+ *
+ * The resulting model owns a heap allocated image, which can be written to a
+ * file with FuzzyModelWriteImage() and mapped later on.
+ *
+ * @param model The model to initialize.
+ * @param text The NUL terminated model description.
+ * @param error Receives the line and reason of a failure, may be NULL.
+ * @return 0 on success, -1 on failure.
+ */
+int FuzzyModelParse(FuzzyModel_t *model, const char *text,
+                    FuzzyModelError_t *error) {
+    ModelBuilder_t builder = {
+        .variables = {.elementSize = sizeof(FuzzyModelVariable_t)},
+        .terms = {.elementSize = sizeof(FuzzyModelTerm_t)},
+        .rules = {.elementSize = sizeof(FuzzyModelRule_t)},
+        .groups = {.elementSize = sizeof(FuzzyModelGroup_t)},
+        .literals = {.elementSize = sizeof(FuzzyModelLiteral_t)},
+    };
+    ModelParser_t parser = {.cursor = text, .line = 1, .error = error};
+    int result = nextToken(&parser);
+
+    while (result == 0 && parser.token.type != TOKEN_END) {
+        if (parser.token.type != TOKEN_IDENTIFIER) {
+            result = modelError(error, parser.token.line,
+                                "expected input, output, term or rule");
+        } else if (strcmp(parser.token.text, "input") == 0) {
+            result = parseVariable(&parser, &builder, FUZZY_MODEL_INPUT);
+        } else if (strcmp(parser.token.text, "output") == 0) {
+            result = parseVariable(&parser, &builder, FUZZY_MODEL_OUTPUT);
+        } else if (strcmp(parser.token.text, "term") == 0) {
+            result = parseTerm(&parser, &builder);
+        } else if (strcmp(parser.token.text, "rule") == 0) {
+            result = parseRule(&parser, &builder);
+        } else {
+            result = modelError(error, parser.token.line,
+                                "unexpected '%s'", parser.token.text);
+        }
+    }
+
+    if (result == 0) {
+        result = builderCompile(&builder, model, error);
+    }
+
+    free(builder.variables.data);
+    free(builder.terms.data);
+    free(builder.rules.data);
+    free(builder.groups.data);
+    free(builder.literals.data);
+    return result;
+}
+
+/**
+ * Reads and parses a model description file.
+ *
+ * @param model The model to initialize.
+ * @param path The path of the text description.
+ * @param error Receives the line and reason of a failure, may be NULL.
+ * @return 0 on success, -1 on failure.
+ */
+int FuzzyModelLoad(FuzzyModel_t *model, const char *path,
+                   FuzzyModelError_t *error) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return modelError(error, 0, "can not open '%s'", path);
+    }
+
+    long length = -1;
+#if !defined(_WIN32)
+    // pipes have no length and directories report a bogus one
+    struct stat st;
+    if (fstat(fileno(f), &st) != 0 || !S_ISREG(st.st_mode)) {
+        fclose(f);
+        return modelError(error, 0, "can not read '%s', not a regular file",
+                          path);
+    }
+#endif
+    if (fseek(f, 0, SEEK_END) == 0) {
+        length = ftell(f);
+    }
+    if (length < 0 || fseek(f, 0, SEEK_SET) != 0) {
+        fclose(f);
+        return modelError(error, 0, "can not read '%s', not a regular file",
+                          path);
+    }
+
+    char *text = malloc(length + 1);
+    if (text == NULL) {
+        fclose(f);
+        return modelError(error, 0, "out of memory");
+    }
+    size_t read = fread(text, 1, length, f);
+    int failed = read != (size_t)length || ferror(f);
+    fclose(f);
+    if (failed) {
+        free(text);
+        return modelError(error, 0, "can not read '%s'", path);
+    }
+    text[read] = '\0';
+
+    int result = FuzzyModelParse(model, text, error);
+    free(text);
+    return result;
+}
+
+/**
+ * Finds the model variable a FuzzySet_t was registered as, registering it
+ * together with its terms if it is new.
+ */
+static int builderAddSet(ModelBuilder_t *builder, FuzzySet_t **sets,
+                         FuzzySet_t *set, FuzzyModelVariableKind_e kind,
+                         FuzzyModelError_t *error) {
+    FuzzyModelVariable_t *variables = builder->variables.data;
+    for (int i = 0; i < builder->variables.count; i++) {
+        if (sets[i] == set) {
+            if (variables[i].kind != kind) {
+                return modelError(error, 0,
+                                  "set is used as input and as output");
+            }
+            return i;
+        }
+    }
+
+    int index = builder->variables.count;
+    FuzzyModelVariable_t *variable = arrayPush(&builder->variables);
+    if (variable == NULL) {
+        return modelError(error, 0, "out of memory");
+    }
+    snprintf(variable->name, sizeof(variable->name), "%s%d",
+             kind == FUZZY_MODEL_INPUT ? "input" : "output", index);
+    variable->kind = kind;
+    variable->firstTerm = builder->terms.count;
+    variable->numTerms = set->length;
+    sets[index] = set;
+
+    for (int i = 0; i < set->length; i++) {
+        FuzzyModelTerm_t *term = arrayPush(&builder->terms);
+        if (term == NULL) {
+            return modelError(error, 0, "out of memory");
+        }
+        MembershipFunction_t mf = set->membershipFunctions[i];
+        snprintf(term->name, sizeof(term->name), "T%d", i);
+        term->a = mf.a;
+        term->b = mf.b;
+        term->c = mf.c;
+        term->d = mf.d;
+        term->type = mf.type;
+        term->variable = (uint32_t)index;
+    }
+    return index;
+}
+
+/**
+ * Compiles a FuzzyRule_t table into a model.
+ *
+ * Every FuzzySet_t referenced by the rules becomes a variable: input sets in
+ * order of their first use in an antecedent, followed by the output sets in
+ * order of their first use as a consequent. Variables are named after their
+ * index (input0, input1, output2, ...), terms after their position in the
+ * membership function table (T0, T1, ...). The membership functions of the
+ * sets must be initialized.
+ *
+ * @param model The model to initialize.
+ * @param rules An array of fuzzy rules.
+ * @param numRules The number of fuzzy rules in the array.
+ * @param error Receives the reason of a failure, may be NULL.
+ * @return 0 on success, -1 on failure.
+ */
+int FuzzyModelFromRules(FuzzyModel_t *model, const FuzzyRule_t *rules,
+                        int numRules, FuzzyModelError_t *error) {
+    ModelBuilder_t builder = {
+        .variables = {.elementSize = sizeof(FuzzyModelVariable_t)},
+        .terms = {.elementSize = sizeof(FuzzyModelTerm_t)},
+        .rules = {.elementSize = sizeof(FuzzyModelRule_t)},
+        .groups = {.elementSize = sizeof(FuzzyModelGroup_t)},
+        .literals = {.elementSize = sizeof(FuzzyModelLiteral_t)},
+    };
+    int numLiterals = 0;
+    for (int i = 0; i < numRules; i++) {
+        for (int j = 0; j < rules[i].num_antecedents; j++) {
+            numLiterals += rules[i].antecedent[j].num_variables;
+        }
+    }
+    FuzzySet_t **sets = malloc((numLiterals + numRules + 1) *
+                               sizeof(FuzzySet_t *));
+    int result = sets == NULL ? modelError(error, 0, "out of memory") : 0;
+
+    // Inputs first, so the variables are grouped by kind
+    for (int i = 0; i < numRules && result == 0; i++) {
+        for (int j = 0; j < rules[i].num_antecedents && result == 0; j++) {
+            const FuzzyAntecedent_t *antecedent = &rules[i].antecedent[j];
+            for (int k = 0; k < antecedent->num_variables && result == 0;
+                 k++) {
+                if (builderAddSet(&builder, sets,
+                                  antecedent->variables[k].variable,
+                                  FUZZY_MODEL_INPUT, error) < 0) {
+                    result = -1;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < numRules && result == 0; i++) {
+        if (builderAddSet(&builder, sets, rules[i].consequent.variable,
+                          FUZZY_MODEL_OUTPUT, error) < 0) {
+            result = -1;
+        }
+    }
+
+    for (int i = 0; i < numRules && result == 0; i++) {
+        const FuzzyRule_t *rule = &rules[i];
+        FuzzyModelRule_t *out = arrayPush(&builder.rules);
+        if (out == NULL) {
+            result = modelError(error, 0, "out of memory");
+            break;
+        }
+        int consequent = builderAddSet(&builder, sets,
+                                       rule->consequent.variable,
+                                       FUZZY_MODEL_OUTPUT, error);
+        const FuzzyModelVariable_t *variables = builder.variables.data;
+        out->firstGroup = builder.groups.count;
+        out->numGroups = rule->num_antecedents;
+        out->consequentVariable = consequent;
+        out->consequentTerm =
+            variables[consequent].firstTerm + rule->consequent.value;
+
+        for (int j = 0; j < rule->num_antecedents && result == 0; j++) {
+            const FuzzyAntecedent_t *antecedent = &rule->antecedent[j];
+            FuzzyModelGroup_t *group = arrayPush(&builder.groups);
+            if (group == NULL) {
+                result = modelError(error, 0, "out of memory");
+                break;
+            }
+            group->fuzzy_operator = antecedent->fuzzy_operator;
+            group->firstLiteral = builder.literals.count;
+            group->numLiterals = antecedent->num_variables;
+
+            for (int k = 0; k < antecedent->num_variables; k++) {
+                const FuzzyVariable_t *variable = &antecedent->variables[k];
+                FuzzyModelLiteral_t *literal = arrayPush(&builder.literals);
+                if (literal == NULL) {
+                    result = modelError(error, 0, "out of memory");
+                    break;
+                }
+                int v = builderAddSet(&builder, sets, variable->variable,
+                                      FUZZY_MODEL_INPUT, error);
+                literal->variable = v;
+                literal->term = ((const FuzzyModelVariable_t *)
+                                     builder.variables.data)[v]
+                                    .firstTerm +
+                                variable->value;
+                literal->invert = variable->invert;
+            }
+        }
+    }
+
+    if (result == 0) {
+        result = builderCompile(&builder, model, error);
+    }
+
+    free(sets);
+    free(builder.variables.data);
+    free(builder.terms.data);
+    free(builder.rules.data);
+    free(builder.groups.data);
+    free(builder.literals.data);
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// binary image
+// ---------------------------------------------------------------------------
+
+static int sectionValid(const FuzzyModelSection_t *section, size_t recordSize,
+                        size_t imageSize) {
+    return (section->offset & 7) == 0 &&
+           section->offset + (uint64_t)section->count * recordSize <=
+               imageSize;
+}
+
+/**
+ * Attaches a model to an image in memory without copying or parsing it.
+ *
+ * Only the header and the record indices are validated, so the call is
+ * proportional to the number of records and never allocates. The image must
+ * stay alive and 8 byte aligned for as long as the model is used.
+ *
+ * @param model The model to attach.
+ * @param image The compiled model image.
+ * @param size The size of the image in bytes.
+ * @param flags FUZZY_MODEL_VERIFY_CHECKSUM to also verify the checksum.
+ * @param error Receives the reason of a failure, may be NULL.
+ * @return 0 on success, -1 on failure.
+ */
+int FuzzyModelFromImage(FuzzyModel_t *model, const void *image, size_t size,
+                        int flags, FuzzyModelError_t *error) {
+    const unsigned char *bytes = image;
+    const FuzzyModelHeader_t *header = image;
+
+    if (size < sizeof(FuzzyModelHeader_t) || ((uintptr_t)image & 7) != 0) {
+        return modelError(error, 0, "image is truncated or misaligned");
+    }
+    if (memcmp(header->magic, FUZZY_MODEL_MAGIC, 4) != 0) {
+        return modelError(error, 0, "not a fuzzy model image");
+    }
+    if (header->version != FUZZY_MODEL_VERSION) {
+        return modelError(error, 0, "unsupported image version %u",
+                          (unsigned)header->version);
+    }
+    if (header->byteOrder != FUZZY_MODEL_BYTE_ORDER ||
+        header->headerSize != sizeof(FuzzyModelHeader_t) ||
+        header->imageSize < header->headerSize || header->imageSize > size) {
+        return modelError(error, 0, "incompatible image header");
+    }
+    if ((flags & FUZZY_MODEL_VERIFY_CHECKSUM) &&
+        modelChecksum(bytes + header->headerSize,
+                      header->imageSize - header->headerSize) !=
+            header->checksum) {
+        return modelError(error, 0, "image checksum mismatch");
+    }
+    if (!sectionValid(&header->variables, sizeof(FuzzyModelVariable_t),
+                      header->imageSize) ||
+        !sectionValid(&header->terms, sizeof(FuzzyModelTerm_t),
+                      header->imageSize) ||
+        !sectionValid(&header->rules, sizeof(FuzzyModelRule_t),
+                      header->imageSize) ||
+        !sectionValid(&header->groups, sizeof(FuzzyModelGroup_t),
+                      header->imageSize) ||
+        !sectionValid(&header->literals, sizeof(FuzzyModelLiteral_t),
+                      header->imageSize)) {
+        return modelError(error, 0, "image section out of bounds");
+    }
+
+    FuzzyModel_t m = {
+        .header = header,
+        .variables = (const void *)(bytes + header->variables.offset),
+        .terms = (const void *)(bytes + header->terms.offset),
+        .rules = (const void *)(bytes + header->rules.offset),
+        .groups = (const void *)(bytes + header->groups.offset),
+        .literals = (const void *)(bytes + header->literals.offset),
+        .numVariables = (int)header->variables.count,
+        .numTerms = (int)header->terms.count,
+        .numRules = (int)header->rules.count,
+        .numGroups = (int)header->groups.count,
+        .numLiterals = (int)header->literals.count,
+        .image = (void *)image,
+        .imageSize = (size_t)header->imageSize,
+        .storage = FUZZY_MODEL_BORROWED,
+    };
+
+    // Validate every index once so evaluation never has to
+    for (int i = 0; i < m.numVariables; i++) {
+        const FuzzyModelVariable_t *v = &m.variables[i];
+        if (v->firstTerm + (uint64_t)v->numTerms > (uint64_t)m.numTerms ||
+            v->kind > FUZZY_MODEL_OUTPUT ||
+            memchr(v->name, '\0', sizeof(v->name)) == NULL) {
+            return modelError(error, 0, "corrupt variable %d", i);
+        }
+        if (v->kind == FUZZY_MODEL_INPUT) {
+            m.numInputs++;
+        } else {
+            m.numOutputs++;
+        }
+    }
+    for (int i = 0; i < m.numTerms; i++) {
+        if (m.terms[i].variable >= (uint32_t)m.numVariables ||
+            memchr(m.terms[i].name, '\0', sizeof(m.terms[i].name)) == NULL) {
+            return modelError(error, 0, "corrupt term %d", i);
+        }
+    }
+    for (int i = 0; i < m.numLiterals; i++) {
+        const FuzzyModelLiteral_t *l = &m.literals[i];
+        if (l->term >= (uint32_t)m.numTerms ||
+            m.terms[l->term].variable != l->variable ||
+            m.variables[l->variable].kind != FUZZY_MODEL_INPUT) {
+            return modelError(error, 0, "corrupt literal %d", i);
+        }
+    }
+    for (int i = 0; i < m.numGroups; i++) {
+        const FuzzyModelGroup_t *g = &m.groups[i];
+        if (g->firstLiteral + (uint64_t)g->numLiterals >
+                (uint64_t)m.numLiterals ||
+            g->fuzzy_operator > FUZZY_ALL_OF) {
+            return modelError(error, 0, "corrupt group %d", i);
+        }
+    }
+    for (int i = 0; i < m.numRules; i++) {
+        const FuzzyModelRule_t *r = &m.rules[i];
+        if (r->firstGroup + (uint64_t)r->numGroups > (uint64_t)m.numGroups ||
+            r->consequentTerm >= (uint32_t)m.numTerms ||
+            m.terms[r->consequentTerm].variable != r->consequentVariable ||
+            m.variables[r->consequentVariable].kind != FUZZY_MODEL_OUTPUT) {
+            return modelError(error, 0, "corrupt rule %d", i);
+        }
+    }
+
+    *model = m;
+    return 0;
+}
+
+/**
+ * Maps a compiled model image read-only and uses it in place.
+ *
+ * Startup is a single mmap plus the index validation done by
+ * FuzzyModelFromImage(); pages are only faulted in when they are touched.
+ *
+ * @param model The model to attach.
+ * @param path The path of the compiled image.
+ * @param flags FUZZY_MODEL_VERIFY_CHECKSUM to also verify the checksum.
+ * @param error Receives the reason of a failure, may be NULL.
+ * @return 0 on success, -1 on failure.
+ */
+int FuzzyModelMapImage(FuzzyModel_t *model, const char *path, int flags,
+                       FuzzyModelError_t *error) {
+#if defined(_WIN32)
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return modelError(error, 0, "can not open '%s'", path);
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+
+    void *image = malloc(size > 0 ? size : 1);
+    if (image == NULL || fread(image, 1, size, f) != (size_t)size) {
+        free(image);
+        fclose(f);
+        return modelError(error, 0, "can not read '%s'", path);
+    }
+    fclose(f);
+
+    if (FuzzyModelFromImage(model, image, size, flags, error)) {
+        free(image);
+        return -1;
+    }
+    model->storage = FUZZY_MODEL_HEAP;
+    return 0;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return modelError(error, 0, "can not open '%s'", path);
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return modelError(error, 0, "can not stat '%s'", path);
+    }
+
+    void *image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) {
+        return modelError(error, 0, "can not map '%s'", path);
+    }
+
+    if (FuzzyModelFromImage(model, image, st.st_size, flags, error)) {
+        munmap(image, st.st_size);
+        return -1;
+    }
+    model->imageSize = st.st_size;
+    model->storage = FUZZY_MODEL_MAPPED;
+    return 0;
+#endif
+}
+
+/**
+ * Writes the image of a model to a file.
+ *
+ * @param model The model to write.
+ * @param path The destination path.
+ * @return 0 on success, -1 on failure.
+ */
+int FuzzyModelWriteImage(const FuzzyModel_t *model, const char *path) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        return -1;
+    }
+    size_t size = (size_t)model->header->imageSize;
+    size_t written = fwrite(model->image, 1, size, f);
+    if (fclose(f) != 0 || written != size) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Writes a model as a text description that FuzzyModelLoad() reads back.
+ *
+ * @param model The model to write.
+ * @param path The file to write.
+ * @return 0 on success, -1 on failure.
+ */
+int FuzzyModelWriteText(const FuzzyModel_t *model, const char *path) {
+    FILE *f = fopen(path, "w");
+    if (f == NULL) {
+        return -1;
+    }
+
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+        fprintf(f, "%s %s\n",
+                v->kind == FUZZY_MODEL_INPUT ? "input" : "output", v->name);
+        for (uint32_t j = 0; j < v->numTerms; j++) {
+            const FuzzyModelTerm_t *t = &model->terms[v->firstTerm + j];
+            MembershipFunctionType_e type = (MembershipFunctionType_e)t->type;
+            const double parameters[] = {t->a, t->b, t->c, t->d};
+            fprintf(f, "    term %s", t->name);
+            for (int k = 0; k < membershipFunctionParameters(type); k++) {
+                fprintf(f, " %.17g", parameters[k]);
+            }
+            fprintf(f, " %s\n", membershipFunctionName(type));
+        }
+        fprintf(f, "\n");
+    }
+
+    for (int i = 0; i < model->numRules; i++) {
+        fprintf(f, "rule ");
+        FuzzyModelPrintRule(f, model, i);
+        fprintf(f, "\n");
+    }
+
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+/**
+ * Prints a rule of a model in the text format, without the rule keyword and
+ * the final newline.
+ *
+ * @param f The stream to print to.
+ * @param model The model.
+ * @param rule The index of the rule.
+ */
+void FuzzyModelPrintRule(FILE *f, const FuzzyModel_t *model, int rule) {
+    const FuzzyModelRule_t *r = &model->rules[rule];
+    fprintf(f, "WHEN");
+    for (uint32_t j = 0; j < r->numGroups; j++) {
+        const FuzzyModelGroup_t *g = &model->groups[r->firstGroup + j];
+        fprintf(f, " %s(", g->fuzzy_operator == FUZZY_ANY_OF ? "ANY_OF"
+                                                             : "ALL_OF");
+        for (uint32_t k = 0; k < g->numLiterals; k++) {
+            const FuzzyModelLiteral_t *l =
+                &model->literals[g->firstLiteral + k];
+            fprintf(f, "%s%s(%s, %s)", k > 0 ? ", " : "",
+                    l->invert ? "NOT" : "VAR",
+                    model->variables[l->variable].name,
+                    model->terms[l->term].name);
+        }
+        fprintf(f, ")");
+    }
+    fprintf(f, "\n     THEN(%s, %s)",
+            model->variables[r->consequentVariable].name,
+            model->terms[r->consequentTerm].name);
+}
+
+/**
+ * Copies a model into a heap allocated image owned by the copy.
+ *
+ * @param copy The model to initialize.
+ * @param model The model to copy.
+ * @param error Receives the reason of a failure, may be NULL.
+ * @return 0 on success, -1 on failure.
+ */
+int FuzzyModelCopy(FuzzyModel_t *copy, const FuzzyModel_t *model,
+                   FuzzyModelError_t *error) {
+    void *image = malloc(model->imageSize);
+    if (image == NULL) {
+        return modelError(error, 0, "out of memory");
+    }
+    memcpy(image, model->image, model->imageSize);
+
+    if (FuzzyModelFromImage(copy, image, model->imageSize, 0, error)) {
+        free(image);
+        return -1;
+    }
+    copy->storage = FUZZY_MODEL_HEAP;
+    return 0;
+}
+
+/**
+ * Replaces the membership function of a term and updates the image checksum.
+ *
+ * Only models owning a heap image can be changed, mapped and borrowed images
+ * are read-only.
+ *
+ * @param model The model owning the term.
+ * @param term The model wide index of the term.
+ * @param mf The new membership function.
+ * @return 0 on success, -1 if the model can not be changed.
+ */
+int FuzzyModelSetMembershipFunction(FuzzyModel_t *model, int term,
+                                    MembershipFunction_t mf) {
+    if (model->storage != FUZZY_MODEL_HEAP || term < 0 ||
+        term >= model->numTerms) {
+        return -1;
+    }
+
+    unsigned char *image = model->image;
+    FuzzyModelHeader_t *header = model->image;
+    FuzzyModelTerm_t *t =
+        (FuzzyModelTerm_t *)(image + header->terms.offset) + term;
+    t->a = mf.a;
+    t->b = mf.b;
+    t->c = mf.c;
+    t->d = mf.d;
+    t->type = mf.type;
+
+    header->checksum = modelChecksum(image + header->headerSize,
+                                     header->imageSize - header->headerSize);
+    return 0;
+}
+
+/**
+ * Releases the image owned by a model.
+ *
+ * Borrowed images are left untouched.
+ *
+ * @param model The model to release.
+ */
+void FuzzyModelFree(FuzzyModel_t *model) {
+    switch (model->storage) {
+    case FUZZY_MODEL_HEAP:
+        free(model->image);
+        break;
+    case FUZZY_MODEL_MAPPED:
+#if !defined(_WIN32)
+        munmap(model->image, model->imageSize);
+#endif
+        break;
+    default:
+        break;
+    }
+    memset(model, 0, sizeof(*model));
+}
+
+// ---------------------------------------------------------------------------
+// lookup
+// ---------------------------------------------------------------------------
+
+/**
+ * Returns the index of a variable by name, or -1 if it does not exist.
+ */
+int FuzzyModelFindVariable(const FuzzyModel_t *model, const char *name) {
+    for (int i = 0; i < model->numVariables; i++) {
+        if (strncmp(model->variables[i].name, name,
+                    FUZZY_MODEL_NAME_LENGTH) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Returns the model wide index of a term of a variable by name, or -1 if it
+ * does not exist.
+ */
+int FuzzyModelFindTerm(const FuzzyModel_t *model, int variable,
+                       const char *name) {
+    const FuzzyModelVariable_t *v = &model->variables[variable];
+    for (uint32_t i = 0; i < v->numTerms; i++) {
+        if (strncmp(model->terms[v->firstTerm + i].name, name,
+                    FUZZY_MODEL_NAME_LENGTH) == 0) {
+            return (int)(v->firstTerm + i);
+        }
+    }
+    return -1;
+}
+
+/**
+ * Returns the membership function of a term in the classic representation.
+ *
+ * @param model The model owning the term.
+ * @param term The model wide index of the term.
+ */
+MembershipFunction_t FuzzyModelMembershipFunction(const FuzzyModel_t *model,
+                                                  int term) {
+    const FuzzyModelTerm_t *t = &model->terms[term];
+    MembershipFunction_t mf = {t->a, t->b, t->c, t->d,
+                               (MembershipFunctionType_e)t->type};
+    return mf;
+}
@@ -0,0 +1,203 @@
+/**
+ * @file model_handle.c
+ * @brief Fuzzy Logic hot-swappable model handle implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "model_handle.h"
+
+#include "model.h"
+
+#include <stdlib.h>
+
+/**
+ * Releases a model that was handed over to a handle.
+ */
+static void destroyModel(FuzzyModel_t *model) {
+    if (model != NULL) {
+        FuzzyModelFree(model);
+        free(model);
+    }
+}
+
+/**
+ * Initializes a model handle.
+ *
+ * The handle takes ownership of the model, which must have been allocated
+ * with malloc().
+ *
+ * @param handle The handle to initialize.
+ * @param model The initial model, may be NULL.
+ */
+void FuzzyModelHandleInit(FuzzyModelHandle_t *handle, FuzzyModel_t *model) {
+    atomic_init(&handle->current, model);
+    // epoch 0 is reserved for readers that are outside
+    atomic_init(&handle->epoch, 1);
+    atomic_init(&handle->numReaders, 0);
+    for (int i = 0; i < FUZZY_MODEL_HANDLE_MAX_READERS; i++) {
+        atomic_init(&handle->readers[i].epoch, 0);
+    }
+
+    pthread_mutex_init(&handle->writerLock, NULL);
+    handle->numRetired = 0;
+    handle->numPublished = 0;
+    handle->numReclaimed = 0;
+}
+
+/**
+ * Destroys a model handle and every model it still owns.
+ *
+ * No reader may be inside the handle anymore.
+ *
+ * @param handle The handle to destroy.
+ */
+void FuzzyModelHandleDestroy(FuzzyModelHandle_t *handle) {
+    for (int i = 0; i < handle->numRetired; i++) {
+        destroyModel(handle->retired[i].model);
+    }
+    handle->numRetired = 0;
+
+    destroyModel(atomic_exchange(&handle->current, NULL));
+    pthread_mutex_destroy(&handle->writerLock);
+}
+
+/**
+ * Registers a reader, typically once per control loop thread.
+ *
+ * @param handle The handle to read from.
+ * @return The reader slot, or -1 if all slots are taken.
+ */
+int FuzzyModelHandleRegister(FuzzyModelHandle_t *handle) {
+    int reader = atomic_fetch_add(&handle->numReaders, 1);
+    if (reader >= FUZZY_MODEL_HANDLE_MAX_READERS) {
+        atomic_fetch_sub(&handle->numReaders, 1);
+        return -1;
+    }
+    return reader;
+}
+
+/**
+ * Enters the handle and returns the current model.
+ *
+ * The model stays valid until FuzzyModelHandleRelease() is called with the
+ * same reader slot. This is wait-free: one store and two loads.
+ *
+ * @param handle The handle to read from.
+ * @param reader The slot returned by FuzzyModelHandleRegister().
+ * @return The current model.
+ */
+const FuzzyModel_t *FuzzyModelHandleAcquire(FuzzyModelHandle_t *handle,
+                                            int reader) {
+    // The announcement must be visible before the pointer is read, otherwise
+    // a writer could miss this reader and free the model it is about to use.
+    // Both are sequentially consistent for exactly that reason.
+    atomic_store(&handle->readers[reader].epoch, atomic_load(&handle->epoch));
+    return atomic_load(&handle->current);
+}
+
+/**
+ * Leaves the handle, the model returned by the matching
+ * FuzzyModelHandleAcquire() must not be used anymore.
+ *
+ * @param handle The handle to leave.
+ * @param reader The slot returned by FuzzyModelHandleRegister().
+ */
+void FuzzyModelHandleRelease(FuzzyModelHandle_t *handle, int reader) {
+    atomic_store_explicit(&handle->readers[reader].epoch, 0,
+                          memory_order_release);
+}
+
+/**
+ * Frees every retired model that no reader can still hold.
+ *
+ * Must be called with the writer lock held.
+ */
+static int reclaimLocked(FuzzyModelHandle_t *handle) {
+    // The oldest epoch any reader is still inside of
+    uint64_t oldest = UINT64_MAX;
+    int numReaders = atomic_load(&handle->numReaders);
+    if (numReaders > FUZZY_MODEL_HANDLE_MAX_READERS) {
+        numReaders = FUZZY_MODEL_HANDLE_MAX_READERS;
+    }
+    for (int i = 0; i < numReaders; i++) {
+        uint64_t epoch = atomic_load(&handle->readers[i].epoch);
+        if (epoch != 0 && epoch < oldest) {
+            oldest = epoch;
+        }
+    }
+
+    // A model retired in epoch e was unpublished before e began, so readers
+    // that entered in e or later can not have seen it
+    int kept = 0;
+    int reclaimed = 0;
+    for (int i = 0; i < handle->numRetired; i++) {
+        if (handle->retired[i].epoch <= oldest) {
+            destroyModel(handle->retired[i].model);
+            reclaimed++;
+        } else {
+            handle->retired[kept++] = handle->retired[i];
+        }
+    }
+    handle->numRetired = kept;
+    handle->numReclaimed += reclaimed;
+    return reclaimed;
+}
+
+/**
+ * Publishes a new model.
+ *
+ * Readers pick the new model up on their next FuzzyModelHandleAcquire(), the
+ * previous model is retired and freed as soon as the last reader that might
+ * hold it has left. Neither readers nor the publisher ever wait for each
+ * other; if too many retired models are still in use the publish is refused
+ * instead.
+ *
+ * @param handle The handle to publish to.
+ * @param model The new model, allocated with malloc(). The handle takes
+ * ownership on success.
+ * @return 0 on success, -1 if the retire list is full.
+ */
+int FuzzyModelHandlePublish(FuzzyModelHandle_t *handle, FuzzyModel_t *model) {
+    pthread_mutex_lock(&handle->writerLock);
+
+    if (handle->numRetired == FUZZY_MODEL_HANDLE_MAX_RETIRED &&
+        reclaimLocked(handle) == 0) {
+        pthread_mutex_unlock(&handle->writerLock);
+        return -1;
+    }
+
+    FuzzyModel_t *previous = atomic_exchange(&handle->current, model);
+    uint64_t epoch = atomic_fetch_add(&handle->epoch, 1) + 1;
+    handle->numPublished++;
+
+    if (previous != NULL) {
+        handle->retired[handle->numRetired].model = previous;
+        handle->retired[handle->numRetired].epoch = epoch;
+        handle->numRetired++;
+    }
+    reclaimLocked(handle);
+
+    pthread_mutex_unlock(&handle->writerLock);
+    return 0;
+}
+
+/**
+ * Frees retired models whose readers have left.
+ *
+ * Publishing reclaims as well, this is for writers that want to release
+ * memory without publishing.
+ *
+ * @param handle The handle to reclaim from.
+ * @return The number of models freed.
+ */
+int FuzzyModelHandleReclaim(FuzzyModelHandle_t *handle) {
+    pthread_mutex_lock(&handle->writerLock);
+    int reclaimed = reclaimLocked(handle);
+    pthread_mutex_unlock(&handle->writerLock);
+    return reclaimed;
+}
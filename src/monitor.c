@@ -0,0 +1,299 @@
+/**
+ * @file monitor.c
+ * @brief Fuzzy Logic shared memory monitor implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "monitor.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MONITOR_MAGIC "FZMN"
+#define MONITOR_VERSION 1
+
+// Byte offsets of the parts of a segment, every part is a multiple of 8 bytes
+typedef struct {
+    size_t variables;
+    size_t terms;
+    size_t inputs;
+    size_t memberships;
+    size_t strengths;
+    size_t outputs;
+    size_t size;
+} MonitorLayout_t;
+
+static void monitorLayout(MonitorLayout_t *layout, uint32_t numVariables,
+                          uint32_t numTerms, uint32_t numRules,
+                          uint32_t numInputs, uint32_t numOutputs) {
+    layout->variables = sizeof(FuzzyMonitorHeader_t);
+    layout->terms =
+        layout->variables + numVariables * sizeof(FuzzyModelVariable_t);
+    layout->inputs = layout->terms + numTerms * sizeof(FuzzyModelTerm_t);
+    layout->memberships = layout->inputs + numInputs * sizeof(double);
+    layout->strengths = layout->memberships + numTerms * sizeof(double);
+    layout->outputs = layout->strengths + numRules * sizeof(double);
+    layout->size = layout->outputs + numOutputs * sizeof(double);
+}
+
+static void headerLayout(MonitorLayout_t *layout,
+                         const FuzzyMonitorHeader_t *header) {
+    monitorLayout(layout, header->numVariables, header->numTerms,
+                  header->numRules, header->numInputs, header->numOutputs);
+}
+
+// ---------------------------------------------------------------------------
+// Writer
+// ---------------------------------------------------------------------------
+
+/**
+ * Creates the POSIX shared memory segment a model is monitored through.
+ *
+ * A segment left by an earlier run is unlinked first; its readers keep the
+ * old segment and have to open the name again.
+ *
+ * @param monitor The monitor to create.
+ * @param name The shared memory name, e.g. "/PeltierControl".
+ * @param model The model whose evaluations are published.
+ * @return 0 on success, -1 if the segment can not be created.
+ */
+int FuzzyMonitorCreate(FuzzyMonitor_t *monitor, const char *name,
+                       const FuzzyModel_t *model) {
+    memset(monitor, 0, sizeof(*monitor));
+    if (strlen(name) >= FUZZY_MONITOR_NAME_LENGTH) {
+        return -1;
+    }
+
+    MonitorLayout_t layout;
+    monitorLayout(&layout, model->numVariables, model->numTerms,
+                  model->numRules, model->numInputs, model->numOutputs);
+
+    shm_unlink(name);
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (ftruncate(fd, layout.size) != 0) {
+        close(fd);
+        shm_unlink(name);
+        return -1;
+    }
+    char *segment =
+        mmap(NULL, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        shm_unlink(name);
+        return -1;
+    }
+
+    // the segment starts out zeroed
+    FuzzyMonitorHeader_t *header = (FuzzyMonitorHeader_t *)segment;
+    header->version = MONITOR_VERSION;
+    header->numVariables = model->numVariables;
+    header->numTerms = model->numTerms;
+    header->numRules = model->numRules;
+    header->numInputs = model->numInputs;
+    header->numOutputs = model->numOutputs;
+    header->size = layout.size;
+    atomic_init(&header->sequence, 0);
+    memcpy(segment + layout.variables, model->variables,
+           model->numVariables * sizeof(FuzzyModelVariable_t));
+    memcpy(segment + layout.terms, model->terms,
+           model->numTerms * sizeof(FuzzyModelTerm_t));
+
+    strcpy(monitor->name, name);
+    monitor->header = header;
+    monitor->inputs = (double *)(segment + layout.inputs);
+    monitor->memberships = (double *)(segment + layout.memberships);
+    monitor->strengths = (double *)(segment + layout.strengths);
+    monitor->outputs = (double *)(segment + layout.outputs);
+
+    // readers accept the segment once the magic is in place
+    atomic_thread_fence(memory_order_release);
+    memcpy(header->magic, MONITOR_MAGIC, sizeof(header->magic));
+    return 0;
+}
+
+/**
+ * Unmaps and unlinks the segment of a monitor. Open readers keep their
+ * mapping, it just stops changing.
+ */
+void FuzzyMonitorFree(FuzzyMonitor_t *monitor) {
+    if (monitor->header != NULL) {
+        munmap(monitor->header, monitor->header->size);
+        shm_unlink(monitor->name);
+    }
+    memset(monitor, 0, sizeof(*monitor));
+}
+
+/**
+ * Publishes an evaluated cycle. The writer never waits: readers that copy
+ * while the cycle is being written see the sequence change and retry.
+ *
+ * @param monitor The monitor, created for the model the context evaluated.
+ * @param context The context the model was evaluated with.
+ * @param inputs The inputs of the evaluation, NULL on a sensor fault.
+ * @param evaluationTime The seconds the evaluation took.
+ * @param period The seconds until the next cycle.
+ * @param fault Whether the cycle ended in a sensor fault.
+ */
+void FuzzyMonitorPublish(FuzzyMonitor_t *monitor,
+                         const FuzzyContext_t *context, const double *inputs,
+                         double evaluationTime, double period, bool fault) {
+    FuzzyMonitorHeader_t *header = monitor->header;
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+
+    uint32_t sequence =
+        atomic_load_explicit(&header->sequence, memory_order_relaxed);
+    atomic_store_explicit(&header->sequence, sequence + 1,
+                          memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    header->cycle.cycle++;
+    header->cycle.time = now.tv_sec + now.tv_nsec * 1e-9;
+    header->cycle.evaluationTime = evaluationTime;
+    header->cycle.period = period;
+    header->cycle.fault = fault;
+    for (uint32_t i = 0; i < header->numInputs; i++) {
+        monitor->inputs[i] = fault || inputs == NULL ? NAN : inputs[i];
+    }
+    memcpy(monitor->memberships, context->memberships,
+           header->numTerms * sizeof(double));
+    memcpy(monitor->strengths, context->strengths,
+           header->numRules * sizeof(double));
+    memcpy(monitor->outputs, context->outputs,
+           header->numOutputs * sizeof(double));
+
+    atomic_store_explicit(&header->sequence, sequence + 2,
+                          memory_order_release);
+}
+
+// ---------------------------------------------------------------------------
+// Reader
+// ---------------------------------------------------------------------------
+
+/**
+ * Opens the monitor segment of a running controller for reading.
+ *
+ * @param reader The reader to open.
+ * @param name The shared memory name the controller created.
+ * @return 0 on success, -1 if there is no monitor under the name.
+ */
+int FuzzyMonitorOpen(FuzzyMonitorReader_t *reader, const char *name) {
+    memset(reader, 0, sizeof(*reader));
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 ||
+        (size_t)st.st_size < sizeof(FuzzyMonitorHeader_t)) {
+        close(fd);
+        return -1;
+    }
+    const char *segment = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == MAP_FAILED) {
+        return -1;
+    }
+
+    const FuzzyMonitorHeader_t *header = (const FuzzyMonitorHeader_t *)segment;
+    int valid =
+        memcmp(header->magic, MONITOR_MAGIC, sizeof(header->magic)) == 0;
+    atomic_thread_fence(memory_order_acquire);
+    MonitorLayout_t layout;
+    headerLayout(&layout, header);
+    if (!valid || header->version != MONITOR_VERSION ||
+        header->size != (uint64_t)st.st_size || layout.size != header->size) {
+        munmap((void *)segment, st.st_size);
+        return -1;
+    }
+
+    size_t count = header->numInputs + header->numTerms + header->numRules +
+                   header->numOutputs;
+    double *values = calloc(count + 1, sizeof(double));
+    if (values == NULL) {
+        munmap((void *)segment, st.st_size);
+        return -1;
+    }
+
+    reader->header = header;
+    reader->variables =
+        (const FuzzyModelVariable_t *)(segment + layout.variables);
+    reader->terms = (const FuzzyModelTerm_t *)(segment + layout.terms);
+    reader->numVariables = header->numVariables;
+    reader->numTerms = header->numTerms;
+    reader->numRules = header->numRules;
+    reader->numInputs = header->numInputs;
+    reader->numOutputs = header->numOutputs;
+    reader->inputs = values;
+    reader->memberships = reader->inputs + reader->numInputs;
+    reader->strengths = reader->memberships + reader->numTerms;
+    reader->outputs = reader->strengths + reader->numRules;
+    return 0;
+}
+
+/**
+ * Unmaps the segment and releases the snapshot of a reader.
+ */
+void FuzzyMonitorClose(FuzzyMonitorReader_t *reader) {
+    if (reader->header != NULL) {
+        munmap((void *)reader->header, reader->header->size);
+        free(reader->inputs);
+    }
+    memset(reader, 0, sizeof(*reader));
+}
+
+/**
+ * Copies the latest published cycle into the reader, without a syscall and
+ * without blocking the writer.
+ *
+ * @param reader The reader.
+ * @param attempts How often to try while the writer is publishing.
+ * @return 0 if reader->cycle and the values hold a consistent snapshot, -1 if
+ * every attempt overlapped a write; the snapshot is then undefined.
+ */
+int FuzzyMonitorRead(FuzzyMonitorReader_t *reader, int attempts) {
+    const FuzzyMonitorHeader_t *header = reader->header;
+    const char *segment = (const char *)header;
+    MonitorLayout_t layout;
+    headerLayout(&layout, header);
+
+    for (int attempt = 0; attempt < attempts; attempt++) {
+        uint32_t before = atomic_load_explicit(
+            (_Atomic uint32_t *)&header->sequence, memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+
+        reader->cycle = header->cycle;
+        memcpy(reader->inputs, segment + layout.inputs,
+               reader->numInputs * sizeof(double));
+        memcpy(reader->memberships, segment + layout.memberships,
+               reader->numTerms * sizeof(double));
+        memcpy(reader->strengths, segment + layout.strengths,
+               reader->numRules * sizeof(double));
+        memcpy(reader->outputs, segment + layout.outputs,
+               reader->numOutputs * sizeof(double));
+
+        atomic_thread_fence(memory_order_acquire);
+        uint32_t after = atomic_load_explicit(
+            (_Atomic uint32_t *)&header->sequence, memory_order_relaxed);
+        if (before == after) {
+            return 0;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,469 @@
+/**
+ * @file plant.c
+ * @brief Fuzzy Logic thermal plant simulator implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "plant.h"
+
+#include "context.h"
+#include "controller.h"
+#include "model.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Readings further apart than this belong to different runs of a log
+#define PLANT_MAX_GAP 120.0
+#define PLANT_FEATURES 5
+#define PLANT_PRIOR_WEIGHT 0.1
+
+/**
+ * Fills in parameters fitted to the logs in example/Fuzzy_Report_*.txt with
+ * FuzzyPlantFit(), the actuator powers replayed from PeltierControl.fzm.
+ *
+ * @param parameters The parameters to initialize.
+ */
+void FuzzyPlantDefaultParameters(FuzzyPlantParameters_t *parameters) {
+    parameters->ambient = 33.0;
+    parameters->timeConstant = 2400.0;
+    parameters->heatingRate = 0.0028;
+    parameters->coolingRate = 0.0017;
+    parameters->jouleRate = 0.0;
+    parameters->sensorResolution = 0.0625;
+    parameters->sensorDropout = 0.0;
+}
+
+/**
+ * Initializes a plant with both actuators off.
+ *
+ * @param plant The plant to initialize.
+ * @param parameters The plant parameters.
+ * @param temperature The initial temperature.
+ * @param seed Seeds the sensor dropouts.
+ */
+void FuzzyPlantInit(FuzzyPlant_t *plant,
+                    const FuzzyPlantParameters_t *parameters,
+                    double temperature, uint64_t seed) {
+    plant->parameters = *parameters;
+    plant->temperature = temperature;
+    plant->cooler = 0.0;
+    plant->heater = 0.0;
+    plant->random = seed ? seed : 1;
+    plant->messages = 0;
+}
+
+/**
+ * Advances the plant with the current actuator powers held.
+ *
+ * @param plant The plant to advance.
+ * @param seconds The length of the step.
+ */
+void FuzzyPlantStep(FuzzyPlant_t *plant, double seconds) {
+    const FuzzyPlantParameters_t *p = &plant->parameters;
+    double heater = plant->heater / 100.0;
+    double cooler = plant->cooler / 100.0;
+    double rate = p->heatingRate * heater - p->coolingRate * cooler +
+                  p->jouleRate * (heater * heater + cooler * cooler);
+
+    if (p->timeConstant > 0.0) {
+        // exponential approach to the steady state temperature
+        double steady = p->ambient + p->timeConstant * rate;
+        plant->temperature =
+            steady + (plant->temperature - steady) *
+                         exp(-seconds / p->timeConstant);
+    } else {
+        plant->temperature += rate * seconds;
+    }
+}
+
+static int plantRead(FuzzyControlIO_t *io, double *value) {
+    FuzzyPlant_t *plant = io->user;
+    const FuzzyPlantParameters_t *p = &plant->parameters;
+
+    if (p->sensorDropout > 0.0) {
+        // xorshift64*
+        uint64_t x = plant->random;
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        plant->random = x;
+        if (((x * 0x2545f4914f6cdd1dULL) >> 11) * 0x1.0p-53 <
+            p->sensorDropout) {
+            return -1;
+        }
+    }
+
+    *value = plant->temperature;
+    if (p->sensorResolution > 0.0) {
+        *value = round(*value / p->sensorResolution) * p->sensorResolution;
+    }
+    return 0;
+}
+
+static void plantWrite(FuzzyControlIO_t *io, int actuator, double value) {
+    FuzzyPlant_t *plant = io->user;
+    // PWM range
+    value = fmin(fmax(value, 0.0), 100.0);
+    if (actuator == 0) {
+        plant->cooler = value;
+    } else if (actuator == 1) {
+        plant->heater = value;
+    }
+}
+
+static void plantPublish(FuzzyControlIO_t *io, FuzzyControlSignal_e signal,
+                         int index, double value) {
+    (void)signal;
+    (void)index;
+    (void)value;
+    FuzzyPlant_t *plant = io->user;
+    plant->messages++;
+}
+
+/**
+ * Connects a plant to a controller IO: the sensor reads the plant temperature,
+ * actuator 0 is the cooler and actuator 1 the heater, published signals are
+ * only counted.
+ *
+ * @param io The IO to initialize.
+ * @param plant The plant behind the IO.
+ */
+void FuzzyPlantIO(FuzzyControlIO_t *io, FuzzyPlant_t *plant) {
+    io->read = plantRead;
+    io->write = plantWrite;
+    io->publish = plantPublish;
+    io->user = plant;
+}
+
+/**
+ * Runs one closed loop scenario.
+ *
+ * Every cycle the controller reads the sensor and sets the actuators, then the
+ * plant advances by the controller period until steps periods have passed.
+ * The errors and effort are averaged over time, so runs at an adaptive rate
+ * compare to runs at a fixed one.
+ *
+ * @param model The controller model, outputs cooler and heater.
+ * @param context The evaluation context, it must fit the model.
+ * @param parameters The plant parameters, the ambient temperature is taken
+ * from the scenario.
+ * @param scenario The scenario to run.
+ * @param result Receives the metrics of the run.
+ * @return 0 on success, -1 if the model does not fit a controller.
+ */
+int FuzzyPlantRun(const FuzzyModel_t *model, FuzzyContext_t *context,
+                  const FuzzyPlantParameters_t *parameters,
+                  const FuzzyPlantScenario_t *scenario,
+                  FuzzyPlantResult_t *result) {
+    FuzzyPlantParameters_t p = *parameters;
+    p.ambient = scenario->ambient;
+
+    FuzzyPlant_t plant;
+    FuzzyControlIO_t io;
+    FuzzyController_t controller;
+    FuzzyPlantInit(&plant, &p, scenario->start, scenario->seed);
+    FuzzyPlantIO(&io, &plant);
+    if (FuzzyControllerInit(&controller, model, context, &io)) {
+        return -1;
+    }
+    controller.period = scenario->period;
+    controller.minPeriod = scenario->period;
+    controller.maxPeriod = fmax(scenario->maxPeriod, scenario->period);
+    controller.valueDeadband = scenario->valueDeadband;
+    controller.changeDeadband = scenario->changeDeadband;
+    controller.outputDeadband = scenario->outputDeadband;
+
+    double squaredError = 0.0, effort = 0.0;
+    double minimum = plant.temperature, maximum = plant.temperature;
+    int faults = 0, cycles = 0;
+
+    double duration = scenario->steps * scenario->period, elapsed = 0.0;
+    while (duration - elapsed > 1e-9 * scenario->period) {
+        if (FuzzyControllerStep(&controller)) {
+            faults++;
+        }
+        double seconds = fmin(controller.period, duration - elapsed);
+        FuzzyPlantStep(&plant, seconds);
+        elapsed += seconds;
+        cycles++;
+
+        double error = plant.temperature - scenario->target;
+        squaredError += error * error * seconds;
+        effort += (plant.cooler + plant.heater) * seconds;
+        minimum = fmin(minimum, plant.temperature);
+        maximum = fmax(maximum, plant.temperature);
+    }
+
+    double time = elapsed > 0.0 ? elapsed : 1.0;
+    result->finalTemperature = plant.temperature;
+    result->minimum = minimum;
+    result->maximum = maximum;
+    result->meanSquaredError = squaredError / time;
+    result->effort = effort / time;
+    result->sensorFaults = faults;
+    result->cycles = cycles;
+    result->messages = plant.messages;
+    return 0;
+}
+
+/**
+ * Runs many closed loop scenarios with one model and context.
+ *
+ * @return 0 on success, -1 if the model does not fit a controller.
+ */
+int FuzzyPlantRunBatch(const FuzzyModel_t *model, FuzzyContext_t *context,
+                       const FuzzyPlantParameters_t *parameters,
+                       const FuzzyPlantScenario_t *scenarios,
+                       int numScenarios, FuzzyPlantResult_t *results) {
+    for (int i = 0; i < numScenarios; i++) {
+        if (FuzzyPlantRun(model, context, parameters, &scenarios[i],
+                          &results[i])) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// logs
+// ---------------------------------------------------------------------------
+
+/**
+ * Counts the days from 1970-01-01 to a civil date.
+ */
+static long daysFromCivil(int year, int month, int day) {
+    year -= month <= 2;
+    long era = (year >= 0 ? year : year - 399) / 400;
+    long yearOfEra = year - era * 400;
+    long dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    long dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 +
+                    dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+/**
+ * Reads a controller log as written by PeltierControl.c:
+ * > [2025-06-18 15:52:11] Current Temperature - 26.44
+ * > [2025-06-18 15:52:11] Temperature Change - 0.00
+ * > [2025-06-18 15:52:11] Cooler Speed - 0.00
+ * > [2025-06-18 15:52:11] Heater Speed - 26.19
+ * Every "Current Temperature" line starts a sample, the speeds that follow
+ * belong to it. Other lines are ignored.
+ *
+ * @param path The log file.
+ * @param samples Receives a malloc'ed array of samples.
+ * @param numSamples Receives the number of samples.
+ * @return 0 on success, -1 if the file can not be read.
+ */
+int FuzzyPlantLoadLog(const char *path, FuzzyPlantSample_t **samples,
+                      int *numSamples) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return -1;
+    }
+
+    int count = 0, capacity = 256;
+    FuzzyPlantSample_t *data = malloc(capacity * sizeof(FuzzyPlantSample_t));
+    char line[256];
+
+    while (data != NULL && fgets(line, sizeof(line), f) != NULL) {
+        int year, month, day, hour, minute, second;
+        char name[64];
+        double value;
+        if (sscanf(line, "[%d-%d-%d %d:%d:%d] %63[^-]- %lf", &year, &month,
+                   &day, &hour, &minute, &second, name, &value) != 8) {
+            continue;
+        }
+        double time = daysFromCivil(year, month, day) * 86400.0 +
+                      hour * 3600.0 + minute * 60.0 + second;
+
+        if (strncmp(name, "Current Temperature", 19) == 0) {
+            if (count == capacity) {
+                capacity *= 2;
+                FuzzyPlantSample_t *grown =
+                    realloc(data, capacity * sizeof(FuzzyPlantSample_t));
+                if (grown == NULL) {
+                    free(data);
+                    data = NULL;
+                    break;
+                }
+                data = grown;
+            }
+            data[count++] = (FuzzyPlantSample_t){
+                .time = time, .temperature = value, .cooler = NAN,
+                .heater = NAN};
+        } else if (count > 0 && strncmp(name, "Cooler Speed", 12) == 0) {
+            data[count - 1].cooler = value;
+        } else if (count > 0 && strncmp(name, "Heater Speed", 12) == 0) {
+            data[count - 1].heater = value;
+        }
+    }
+    fclose(f);
+
+    if (data == NULL) {
+        return -1;
+    }
+    *samples = data;
+    *numSamples = count;
+    return 0;
+}
+
+/**
+ * Solves the normal equations in place by Gauss-Jordan elimination.
+ *
+ * @return 0 on success, -1 if they are singular.
+ */
+static int solve(double a[PLANT_FEATURES][PLANT_FEATURES + 1], int n) {
+    for (int col = 0; col < n; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < n; row++) {
+            if (fabs(a[row][col]) > fabs(a[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (fabs(a[pivot][col]) < 1e-12) {
+            return -1;
+        }
+        for (int k = 0; k <= n; k++) {
+            double t = a[col][k];
+            a[col][k] = a[pivot][k];
+            a[pivot][k] = t;
+        }
+        for (int row = 0; row < n; row++) {
+            if (row != col) {
+                double factor = a[row][col] / a[col][col];
+                for (int k = col; k <= n; k++) {
+                    a[row][k] -= factor * a[col][k];
+                }
+            }
+        }
+    }
+    for (int row = 0; row < n; row++) {
+        a[row][n] /= a[row][row];
+    }
+    return 0;
+}
+
+/**
+ * Fits the thermal parameters to logged samples by linear least squares on
+ * the temperature slope between consecutive readings.
+ *
+ * The ambient temperature and time constant are always fitted. The actuator
+ * rates are only fitted if the samples carry actuator powers, otherwise they
+ * keep their value. Pairs of readings more than two minutes apart or
+ * implausible readings are skipped.
+ *
+ * @param parameters The parameters to update.
+ * @param samples The samples, in time order.
+ * @param numSamples The number of samples.
+ * @return 0 on success, -1 if the samples do not determine a stable plant.
+ */
+int FuzzyPlantFit(FuzzyPlantParameters_t *parameters,
+                  const FuzzyPlantSample_t *samples, int numSamples) {
+    // features: 1, T, heater, cooler, heater^2 + cooler^2
+    bool active[PLANT_FEATURES] = {true, true, false, false, false};
+    for (int i = 0; i < numSamples; i++) {
+        double heater = samples[i].heater / 100.0;
+        double cooler = samples[i].cooler / 100.0;
+        active[2] = active[2] || heater > 0.0;
+        active[3] = active[3] || cooler > 0.0;
+        // only partial powers tell joule heating from the linear rates, and
+        // only if the caller asks for it by starting from a nonzero rate
+        active[4] = active[4] || (parameters->jouleRate != 0.0 &&
+                                  ((heater > 0.0 && heater < 1.0) ||
+                                   (cooler > 0.0 && cooler < 1.0)));
+    }
+
+    int index[PLANT_FEATURES], n = 0;
+    for (int k = 0; k < PLANT_FEATURES; k++) {
+        if (active[k]) {
+            index[n++] = k;
+        }
+    }
+
+    double a[PLANT_FEATURES][PLANT_FEATURES + 1] = {{0}};
+    int pairs = 0;
+    for (int i = 0; i + 1 < numSamples; i++) {
+        const FuzzyPlantSample_t *s = &samples[i];
+        double dt = samples[i + 1].time - s->time;
+        if (dt <= 0.0 || dt > PLANT_MAX_GAP || s->temperature <= -50.0 ||
+            s->temperature >= 70.0 || samples[i + 1].temperature <= -50.0 ||
+            samples[i + 1].temperature >= 70.0) {
+            continue;
+        }
+
+        double heater = fmin(fmax(s->heater, 0.0), 100.0) / 100.0;
+        double cooler = fmin(fmax(s->cooler, 0.0), 100.0) / 100.0;
+        if ((active[2] && isnan(s->heater)) ||
+            (active[3] && isnan(s->cooler))) {
+            continue;
+        }
+        heater = isnan(heater) ? 0.0 : heater;
+        cooler = isnan(cooler) ? 0.0 : cooler;
+
+        double all[PLANT_FEATURES] = {1.0, s->temperature, heater, cooler,
+                                      heater * heater + cooler * cooler};
+        double x[PLANT_FEATURES];
+        for (int k = 0; k < n; k++) {
+            x[k] = all[index[k]];
+        }
+        double y = (samples[i + 1].temperature - s->temperature) / dt;
+
+        for (int r = 0; r < n; r++) {
+            for (int c = 0; c < n; c++) {
+                a[r][c] += x[r] * x[c];
+            }
+            a[r][n] += x[r] * y;
+        }
+        pairs++;
+    }
+
+    if (pairs <= n) {
+        return -1;
+    }
+
+    // Logged temperatures are quantized and noisy, so every coefficient is
+    // pulled towards the given parameters in proportion to its own scale
+    double prior[PLANT_FEATURES] = {
+        parameters->ambient / parameters->timeConstant,
+        -1.0 / parameters->timeConstant, parameters->heatingRate,
+        -parameters->coolingRate, parameters->jouleRate};
+    for (int k = 0; k < n; k++) {
+        double weight = PLANT_PRIOR_WEIGHT * a[k][k];
+        a[k][k] += weight;
+        a[k][n] += weight * prior[index[k]];
+    }
+    if (solve(a, n)) {
+        return -1;
+    }
+
+    double theta[PLANT_FEATURES] = {0};
+    for (int k = 0; k < n; k++) {
+        theta[index[k]] = a[k][n];
+    }
+    // dT/dt = ambient / timeConstant - T / timeConstant + ...
+    if (theta[1] >= 0.0) {
+        return -1;
+    }
+    parameters->timeConstant = -1.0 / theta[1];
+    parameters->ambient = theta[0] * parameters->timeConstant;
+    if (active[2]) {
+        parameters->heatingRate = theta[2];
+    }
+    if (active[3]) {
+        parameters->coolingRate = -theta[3];
+    }
+    if (active[4]) {
+        parameters->jouleRate = theta[4];
+    }
+    return 0;
+}
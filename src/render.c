@@ -0,0 +1,365 @@
+/**
+ * @file render.c
+ * @brief Fuzzy Logic diagnostic renderer implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "render.h"
+
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BAR_LENGTH 24
+// kept free for closing a cycle, "}\n" and the terminating zero
+#define CLOSE_RESERVE 3
+
+// Returns the label of a term of a set or a model
+typedef const char *(*TermLabel_t)(const void *labels, int term);
+
+static const char *setLabel(const void *labels, int term) {
+    return ((const char *const *)labels)[term];
+}
+
+static const char *modelLabel(const void *terms, int term) {
+    return ((const FuzzyModelTerm_t *)terms)[term].name;
+}
+
+// ---------------------------------------------------------------------------
+// Appending to the buffer, every append fails instead of overflowing
+// ---------------------------------------------------------------------------
+
+static int append(FuzzyRender_t *render, const char *data, size_t length) {
+    if (render->length + length > render->size - CLOSE_RESERVE) {
+        return -1;
+    }
+    memcpy(&render->buffer[render->length], data, length);
+    render->length += length;
+    return 0;
+}
+
+static int appendText(FuzzyRender_t *render, const char *text) {
+    return append(render, text, strlen(text));
+}
+
+static int appendFormat(FuzzyRender_t *render, const char *format, ...) {
+    size_t space = render->size - CLOSE_RESERVE - render->length;
+    va_list args;
+    va_start(args, format);
+    int length =
+        vsnprintf(&render->buffer[render->length], space + 1, format, args);
+    va_end(args);
+    if (length < 0 || (size_t)length > space) {
+        return -1;
+    }
+    render->length += length;
+    return 0;
+}
+
+static int appendJsonString(FuzzyRender_t *render, const char *text) {
+    if (append(render, "\"", 1)) {
+        return -1;
+    }
+    for (const char *c = text; *c != '\0'; c++) {
+        int failed;
+        if (*c == '"' || *c == '\\') {
+            char escaped[2] = {'\\', *c};
+            failed = append(render, escaped, 2);
+        } else if ((unsigned char)*c < 0x20) {
+            failed = appendFormat(render, "\\u%04x", (unsigned char)*c);
+        } else {
+            failed = append(render, c, 1);
+        }
+        if (failed) {
+            return -1;
+        }
+    }
+    return append(render, "\"", 1);
+}
+
+static int appendJsonNumber(FuzzyRender_t *render, double value) {
+    if (!isfinite(value)) {
+        return appendText(render, "null");
+    }
+    return appendFormat(render, "%.6g", value);
+}
+
+// A bar of BAR_LENGTH characters, =====>   for the membership
+static int appendBar(FuzzyRender_t *render, double membership) {
+    char bar[BAR_LENGTH];
+    int threshold = (int)round(membership * BAR_LENGTH) - 1;
+    for (int i = 0; i < BAR_LENGTH; i++) {
+        bar[i] = i < threshold ? '=' : i == threshold ? '>' : ' ';
+    }
+    return append(render, bar, BAR_LENGTH);
+}
+
+// ---------------------------------------------------------------------------
+// Formatters, each renders one variable and returns -1 if it does not fit
+// ---------------------------------------------------------------------------
+
+static const char *termLabel(TermLabel_t label, const void *labels, int term,
+                             char *number, size_t size) {
+    if (labels != NULL) {
+        return label(labels, term);
+    }
+    snprintf(number, size, "%d", term);
+    return number;
+}
+
+static int renderBars(FuzzyRender_t *render, const char *name, double value,
+                      const double *memberships, int numTerms,
+                      TermLabel_t label, const void *labels) {
+    if (name != NULL && appendFormat(render, "%s %.4f\n", name, value)) {
+        return -1;
+    }
+    if (render->verbosity < FUZZY_RENDER_ACTIVE) {
+        return 0;
+    }
+
+    for (int i = 0; i < numTerms; i++) {
+        if (render->verbosity == FUZZY_RENDER_ACTIVE && memberships[i] <= 0.0) {
+            continue;
+        }
+        char number[16];
+        if (appendText(render, termLabel(label, labels, i, number,
+                                         sizeof(number))) ||
+            appendText(render, "\t [") || appendBar(render, memberships[i]) ||
+            appendFormat(render, "] %6.2f %%\n", memberships[i] * 100.0)) {
+            return -1;
+        }
+    }
+    return append(render, "\n", 1);
+}
+
+static int renderCompact(FuzzyRender_t *render, const char *name,
+                         double value, const double *memberships, int numTerms,
+                         TermLabel_t label, const void *labels) {
+    if ((render->numItems > 0 && append(render, " ", 1)) ||
+        appendFormat(render, "%s=%.4f", name != NULL ? name : "", value)) {
+        return -1;
+    }
+    if (render->verbosity < FUZZY_RENDER_ACTIVE) {
+        return 0;
+    }
+
+    int numShown = 0;
+    for (int i = 0; i < numTerms; i++) {
+        if (render->verbosity == FUZZY_RENDER_ACTIVE && memberships[i] <= 0.0) {
+            continue;
+        }
+        char number[16];
+        if (appendText(render, numShown++ > 0 ? " " : " [") ||
+            appendText(render, termLabel(label, labels, i, number,
+                                         sizeof(number))) ||
+            appendFormat(render, " %.3f", memberships[i])) {
+            return -1;
+        }
+    }
+    return numShown > 0 ? append(render, "]", 1) : 0;
+}
+
+static int renderJson(FuzzyRender_t *render, const char *name, double value,
+                      const double *memberships, int numTerms,
+                      TermLabel_t label, const void *labels) {
+    if ((render->numItems > 0 && append(render, ",", 1)) ||
+        appendJsonString(render, name != NULL ? name : "") ||
+        appendText(render, ":{\"value\":") ||
+        appendJsonNumber(render, value)) {
+        return -1;
+    }
+
+    if (render->verbosity >= FUZZY_RENDER_ACTIVE) {
+        if (appendText(render, ",\"terms\":{")) {
+            return -1;
+        }
+        int numShown = 0;
+        for (int i = 0; i < numTerms; i++) {
+            if (render->verbosity == FUZZY_RENDER_ACTIVE &&
+                memberships[i] <= 0.0) {
+                continue;
+            }
+            char number[16];
+            if ((numShown++ > 0 && append(render, ",", 1)) ||
+                appendJsonString(render, termLabel(label, labels, i, number,
+                                                   sizeof(number))) ||
+                append(render, ":", 1) ||
+                appendJsonNumber(render, memberships[i])) {
+                return -1;
+            }
+        }
+        if (append(render, "}", 1)) {
+            return -1;
+        }
+    }
+    return append(render, "}", 1);
+}
+
+// Renders one variable, or drops it as a whole if it does not fit
+static void renderItem(FuzzyRender_t *render, const char *name, double value,
+                       const double *memberships, int numTerms,
+                       TermLabel_t label, const void *labels) {
+    if (render->verbosity == FUZZY_RENDER_QUIET || render->truncated) {
+        return;
+    }
+
+    size_t start = render->length;
+    int failed;
+    switch (render->format) {
+    case FUZZY_RENDER_COMPACT:
+        failed = renderCompact(render, name, value, memberships, numTerms,
+                               label, labels);
+        break;
+    case FUZZY_RENDER_JSON:
+        failed = renderJson(render, name, value, memberships, numTerms, label,
+                            labels);
+        break;
+    default:
+        failed = renderBars(render, name, value, memberships, numTerms, label,
+                            labels);
+        break;
+    }
+
+    if (failed) {
+        render->length = start;
+        render->truncated = 1;
+        return;
+    }
+    render->numItems++;
+}
+
+// ---------------------------------------------------------------------------
+// Public interface
+// ---------------------------------------------------------------------------
+
+/**
+ * Initializes a renderer on a caller-provided buffer.
+ *
+ * @param render The renderer to initialize.
+ * @param buffer The buffer a cycle is rendered into.
+ * @param size The size of the buffer in bytes.
+ * @param format The output format.
+ * @param verbosity What is rendered of every variable.
+ * @return 0 on success, -1 if the buffer is too small to hold anything.
+ */
+int FuzzyRenderInit(FuzzyRender_t *render, char *buffer, size_t size,
+                    FuzzyRenderFormat_e format,
+                    FuzzyRenderVerbosity_e verbosity) {
+    memset(render, 0, sizeof(*render));
+    if (buffer == NULL || size <= CLOSE_RESERVE + 1) {
+        return -1;
+    }
+    render->buffer = buffer;
+    render->size = size;
+    render->format = format;
+    render->verbosity = verbosity;
+    return 0;
+}
+
+/**
+ * Starts a new cycle, discarding the previous one.
+ */
+void FuzzyRenderBegin(FuzzyRender_t *render) {
+    render->length = 0;
+    render->numItems = 0;
+    render->truncated = 0;
+    if (render->verbosity != FUZZY_RENDER_QUIET &&
+        render->format == FUZZY_RENDER_JSON) {
+        append(render, "{", 1);
+    }
+}
+
+/**
+ * Renders the classification of a set and its crisp value.
+ *
+ * @param render The renderer.
+ * @param name The name of the variable, NULL renders the bars of the terms
+ * only (only the bar format omits the value).
+ * @param value The crisp value of the variable.
+ * @param set The classified set.
+ * @param labels One label per term, NULL numbers the terms.
+ */
+void FuzzyRenderSet(FuzzyRender_t *render, const char *name, double value,
+                    const FuzzySet_t *set, const char **labels) {
+    renderItem(render, name, value, set->membershipValues, set->length,
+               setLabel, labels);
+}
+
+/**
+ * Renders every variable of an evaluated model, inputs and outputs in model
+ * order, with the term memberships of the context.
+ *
+ * @param render The renderer.
+ * @param model The model.
+ * @param context The context the model was evaluated with.
+ * @param inputs The inputs of the evaluation, NULL renders them as unknown.
+ */
+void FuzzyRenderModel(FuzzyRender_t *render, const FuzzyModel_t *model,
+                      const FuzzyContext_t *context, const double *inputs) {
+    int input = 0;
+    int output = 0;
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *variable = &model->variables[i];
+        double value;
+        if (variable->kind == FUZZY_MODEL_INPUT) {
+            value = inputs != NULL ? inputs[input] : NAN;
+            input++;
+        } else {
+            value = context->outputs[output++];
+        }
+        renderItem(render, variable->name, value,
+                   &context->memberships[variable->firstTerm],
+                   variable->numTerms, modelLabel,
+                   &model->terms[variable->firstTerm]);
+    }
+}
+
+/**
+ * Closes the cycle. The buffer then holds the rendered text, zero terminated.
+ *
+ * @param render The renderer.
+ * @return The length of the rendered text.
+ */
+size_t FuzzyRenderEnd(FuzzyRender_t *render) {
+    if (render->verbosity != FUZZY_RENDER_QUIET) {
+        if (render->format == FUZZY_RENDER_JSON) {
+            memcpy(&render->buffer[render->length], "}\n", 2);
+            render->length += 2;
+        } else if (render->format == FUZZY_RENDER_COMPACT &&
+                   render->numItems > 0) {
+            render->buffer[render->length++] = '\n';
+        }
+    }
+    render->buffer[render->length] = '\0';
+    return render->length;
+}
+
+/**
+ * Writes the rendered cycle to a file descriptor with a single write() as long
+ * as the descriptor takes it whole. Output does not go through stdio, flush a
+ * stream on the same descriptor first.
+ *
+ * @param render The renderer, after FuzzyRenderEnd().
+ * @param fd The file descriptor to write to.
+ * @return 0 on success, -1 if a write failed.
+ */
+int FuzzyRenderWrite(const FuzzyRender_t *render, int fd) {
+    const char *p = render->buffer;
+    size_t size = render->length;
+    while (size > 0) {
+        ssize_t written = write(fd, p, size);
+        if (written <= 0) {
+            return -1;
+        }
+        p += written;
+        size -= written;
+    }
+    return 0;
+}
@@ -0,0 +1,178 @@
+/**
+ * @file rule_matrix.c
+ * @brief Fuzzy Logic rule matrix implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "rule_matrix.h"
+
+#include "class.h"
+#include "inference.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Initializes a rule matrix.
+ *
+ * The table of cells is copied, it has one entry per output for every
+ * combination of input terms (see FuzzyRuleMatrix_t).
+ *
+ * @param matrix The matrix to initialize.
+ * @param inputs The input sets, the first one selects the slowest varying
+ * index of the table.
+ * @param numInputs The number of inputs.
+ * @param outputs The output sets.
+ * @param numOutputs The number of outputs.
+ * @param cells The consequent terms, FUZZY_MATRIX_NONE where a cell does not
+ * write to an output.
+ * @return 0 on success, -1 if there are too many sets, a consequent term is
+ * out of range or out of memory.
+ */
+int FuzzyRuleMatrixInit(FuzzyRuleMatrix_t *matrix, FuzzySet_t *const *inputs,
+                        int numInputs, FuzzySet_t *const *outputs,
+                        int numOutputs, const int *cells) {
+    memset(matrix, 0, sizeof(*matrix));
+    if (numInputs < 1 || numInputs > FUZZY_MATRIX_MAX_INPUTS ||
+        numOutputs < 1 || numOutputs > FUZZY_MATRIX_MAX_OUTPUTS) {
+        return -1;
+    }
+
+    int numCells = 1;
+    for (int k = numInputs - 1; k >= 0; k--) {
+        matrix->inputs[k] = inputs[k];
+        matrix->strides[k] = numCells;
+        numCells *= inputs[k]->length;
+    }
+    for (int o = 0; o < numOutputs; o++) {
+        matrix->outputs[o] = outputs[o];
+    }
+    for (int i = 0; i < numCells * numOutputs; i++) {
+        int term = cells[i];
+        if (term != FUZZY_MATRIX_NONE &&
+            (term < 0 || term >= outputs[i % numOutputs]->length)) {
+            return -1;
+        }
+    }
+
+    matrix->cells = malloc((numCells * numOutputs + 1) * sizeof(int));
+    if (matrix->cells == NULL) {
+        return -1;
+    }
+    memcpy(matrix->cells, cells, numCells * numOutputs * sizeof(int));
+    matrix->numInputs = numInputs;
+    matrix->numOutputs = numOutputs;
+    matrix->numCells = numCells;
+    matrix->operators = FUZZY_MIN_MAX;
+    return 0;
+}
+
+/**
+ * Frees the memory allocated for a rule matrix.
+ */
+void FuzzyRuleMatrixFree(FuzzyRuleMatrix_t *matrix) {
+    free(matrix->cells);
+    matrix->cells = NULL;
+}
+
+// Visits the cells of the active terms like an odometer, the last input
+// turning fastest. The strength of the first k inputs of the current cell is
+// kept per input, so a step only recombines the inputs that changed. The norms
+// are applied in the order the equivalent rules apply them, so the outputs are
+// the same as aggregating the rules.
+#define DEFINE_MATRIX_KERNEL(_name, _tnorm, _snorm)                            \
+    static void inferMatrix##_name(const FuzzyRuleMatrix_t *matrix) {          \
+        int n = matrix->numInputs;                                             \
+        int position[FUZZY_MATRIX_MAX_INPUTS] = {0};                           \
+        double strength[FUZZY_MATRIX_MAX_INPUTS + 1] = {1.0};                  \
+        int offset[FUZZY_MATRIX_MAX_INPUTS + 1] = {0};                         \
+        int from = 0;                                                          \
+        for (;;) {                                                             \
+            for (int k = from; k < n; k++) {                                   \
+                const FuzzySet_t *set = matrix->inputs[k];                     \
+                int term = set->activeTerms[position[k]];                      \
+                strength[k + 1] =                                              \
+                    _tnorm(strength[k], set->membershipValues[term]);          \
+                offset[k + 1] = offset[k] + term * matrix->strides[k];         \
+            }                                                                  \
+            double membership = _tnorm(1.0, strength[n]);                      \
+            const int *cell = &matrix->cells[offset[n] * matrix->numOutputs];  \
+            for (int o = 0; o < matrix->numOutputs; o++) {                     \
+                if (cell[o] != FUZZY_MATRIX_NONE) {                            \
+                    double *output =                                           \
+                        &matrix->outputs[o]->membershipValues[cell[o]];        \
+                    *output = _snorm(*output, membership);                     \
+                }                                                              \
+            }                                                                  \
+                                                                               \
+            int k = n - 1;                                                     \
+            while (k >= 0 && ++position[k] == matrix->inputs[k]->numActive) {  \
+                position[k--] = 0;                                             \
+            }                                                                  \
+            if (k < 0) {                                                       \
+                return;                                                        \
+            }                                                                  \
+            from = k;                                                          \
+        }                                                                      \
+    }
+
+DEFINE_MATRIX_KERNEL(MinMax, FUZZY_TNORM_MIN_MAX, FUZZY_SNORM_MIN_MAX)
+DEFINE_MATRIX_KERNEL(Product, FUZZY_TNORM_PRODUCT, FUZZY_SNORM_PRODUCT)
+DEFINE_MATRIX_KERNEL(Lukasiewicz, FUZZY_TNORM_LUKASIEWICZ,
+                     FUZZY_SNORM_LUKASIEWICZ)
+
+/**
+ * Performs one inference cycle of a rule matrix.
+ *
+ * Every output set is reset, the cells of the active input terms are
+ * aggregated with the matrix's operator family and every output set is
+ * normalized.
+ *
+ * @param matrix The matrix to evaluate.
+ */
+void FuzzyRuleMatrixInfer(const FuzzyRuleMatrix_t *matrix) {
+    for (int o = 0; o < matrix->numOutputs; o++) {
+        FuzzySet_t *set = matrix->outputs[o];
+        memset(set->membershipValues, 0, set->length * sizeof(double));
+    }
+
+    // the active terms of every input in ascending order, like the cells
+    bool empty = false;
+    for (int k = 0; k < matrix->numInputs; k++) {
+        FuzzySet_t *set = matrix->inputs[k];
+        int *terms = set->activeTerms;
+        for (int i = 1; i < set->numActive; i++) {
+            int term = terms[i];
+            int j = i;
+            for (; j > 0 && terms[j - 1] > term; j--) {
+                terms[j] = terms[j - 1];
+            }
+            terms[j] = term;
+        }
+        empty = empty || set->numActive == 0;
+    }
+
+    if (!empty) {
+        switch (matrix->operators) {
+        case FUZZY_PRODUCT:
+            inferMatrixProduct(matrix);
+            break;
+        case FUZZY_LUKASIEWICZ:
+            inferMatrixLukasiewicz(matrix);
+            break;
+        default:
+            inferMatrixMinMax(matrix);
+            break;
+        }
+    }
+
+    for (int o = 0; o < matrix->numOutputs; o++) {
+        normalizeClass(matrix->outputs[o]);
+    }
+}
@@ -0,0 +1,898 @@
+/**
+ * @file rule_optimizer.c
+ * @brief Fuzzy Logic static rule base optimizer implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "rule_optimizer.h"
+
+#include "class.h"
+#include "inference.h"
+#include "membership_function.h"
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Internally a rule is a conjunction of disjunctions ("conjuncts"): every
+// literal of an ALL_OF group becomes a conjunct of its own, an ANY_OF group
+// becomes one conjunct with several literals. Every rewrite below relies only
+// on min/max identities, so the optimized rule base produces the very same
+// output memberships as the original one.
+
+typedef struct {
+    FuzzyVariable_t *literals;
+    int numLiterals;
+} OptConjunct_t;
+
+typedef struct {
+    OptConjunct_t *conjuncts;
+    int numConjuncts;
+    FuzzyVariable_t consequent;
+    bool removed;
+    // index of the rule this one shares its antecedent with, or -1
+    int fold;
+} OptRule_t;
+
+// ---------------------------------------------------------------------------
+// literal analysis
+// ---------------------------------------------------------------------------
+
+static bool sameLiteral(const FuzzyVariable_t *a, const FuzzyVariable_t *b) {
+    return a->variable == b->variable && a->value == b->value &&
+           a->invert == b->invert;
+}
+
+static bool isPiecewiseLinear(MembershipFunction_t mf) {
+    return mf.type == TRIANGULAR || mf.type == TRAPEZOIDAL ||
+           mf.type == RECTANGULAR;
+}
+
+static double literalValue(const FuzzyVariable_t *literal, double x) {
+    double value = membershipFunction(
+        x, literal->variable->membershipFunctions[literal->value]);
+    return literal->invert ? 1.0 - value : value;
+}
+
+static int addBreakpoints(MembershipFunction_t mf, double *points, int n) {
+    points[n++] = mf.a;
+    points[n++] = mf.b;
+    if (mf.type != RECTANGULAR) {
+        points[n++] = mf.c;
+    }
+    if (mf.type == TRAPEZOIDAL) {
+        points[n++] = mf.d;
+    }
+    return n;
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Collects the points at which two piecewise linear literals have to be
+ * compared: every breakpoint, both one-sided neighbourhoods of it and the
+ * midpoints in between. Between two consecutive breakpoints both literals are
+ * linear, so these points decide any pointwise relation between them.
+ *
+ * @return The number of points, 0 if a literal is not piecewise linear.
+ */
+static int probePoints(const FuzzyVariable_t *a, const FuzzyVariable_t *b,
+                       double *points) {
+    MembershipFunction_t mfA = a->variable->membershipFunctions[a->value];
+    MembershipFunction_t mfB = b->variable->membershipFunctions[b->value];
+    if (!isPiecewiseLinear(mfA) || !isPiecewiseLinear(mfB)) {
+        return 0;
+    }
+
+    double breakpoints[8];
+    int numBreakpoints = addBreakpoints(mfA, breakpoints, 0);
+    numBreakpoints = addBreakpoints(mfB, breakpoints, numBreakpoints);
+    qsort(breakpoints, numBreakpoints, sizeof(double), compareDouble);
+
+    int n = 0;
+    for (int i = 0; i < numBreakpoints; i++) {
+        double p = breakpoints[i];
+        double eps = 1e-9 * fmax(1.0, fabs(p));
+        points[n++] = p - eps;
+        points[n++] = p;
+        points[n++] = p + eps;
+        if (i + 1 < numBreakpoints) {
+            points[n++] = 0.5 * (p + breakpoints[i + 1]);
+        }
+    }
+    return n;
+}
+
+/**
+ * Checks whether one literal is at least as large as another for every input,
+ * i.e. `upper` is a superset of `lower`.
+ */
+static bool literalDominates(const FuzzyVariable_t *upper,
+                             const FuzzyVariable_t *lower) {
+    if (upper->variable != lower->variable ||
+        upper->invert != lower->invert) {
+        return false;
+    }
+    if (upper->value == lower->value) {
+        return true;
+    }
+
+    double points[32];
+    int n = probePoints(upper, lower, points);
+    if (n == 0) {
+        return false;
+    }
+    for (int i = 0; i < n; i++) {
+        if (literalValue(upper, points[i]) <
+            literalValue(lower, points[i]) - 1e-12) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Checks whether two literals can never be non-zero at the same time.
+ */
+static bool literalsDisjoint(const FuzzyVariable_t *a,
+                             const FuzzyVariable_t *b) {
+    if (a->variable != b->variable || a->invert || b->invert) {
+        return false;
+    }
+
+    double points[32];
+    int n = probePoints(a, b, points);
+    if (n == 0) {
+        return false;
+    }
+    for (int i = 0; i < n; i++) {
+        if (literalValue(a, points[i]) > 0.0 &&
+            literalValue(b, points[i]) > 0.0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// ---------------------------------------------------------------------------
+// conjunct and rule rewrites
+// ---------------------------------------------------------------------------
+
+static bool conjunctContains(const OptConjunct_t *conjunct,
+                             const FuzzyVariable_t *literal) {
+    for (int i = 0; i < conjunct->numLiterals; i++) {
+        if (sameLiteral(&conjunct->literals[i], literal)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool conjunctEqual(const OptConjunct_t *a, const OptConjunct_t *b) {
+    if (a->numLiterals != b->numLiterals) {
+        return false;
+    }
+    for (int i = 0; i < a->numLiterals; i++) {
+        if (!conjunctContains(b, &a->literals[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool ruleContainsConjunct(const OptRule_t *rule,
+                                 const OptConjunct_t *conjunct) {
+    for (int i = 0; i < rule->numConjuncts; i++) {
+        if (conjunctEqual(&rule->conjuncts[i], conjunct)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void removeConjunct(OptRule_t *rule, int index) {
+    free(rule->conjuncts[index].literals);
+    rule->conjuncts[index] = rule->conjuncts[--rule->numConjuncts];
+}
+
+/**
+ * Drops literals of a disjunction that are covered by another one:
+ * max(a, b) == b whenever b >= a.
+ *
+ * @return The number of literals dropped.
+ */
+static int pruneDisjunction(OptConjunct_t *conjunct) {
+    int pruned = 0;
+    for (int i = 0; i < conjunct->numLiterals; i++) {
+        for (int j = 0; j < conjunct->numLiterals; j++) {
+            if (i == j) {
+                continue;
+            }
+            const FuzzyVariable_t *a = &conjunct->literals[i];
+            const FuzzyVariable_t *b = &conjunct->literals[j];
+            // keep the first of two equivalent literals
+            if (literalDominates(b, a) &&
+                (j < i || !literalDominates(a, b))) {
+                conjunct->literals[i] =
+                    conjunct->literals[--conjunct->numLiterals];
+                pruned++;
+                i = -1;
+                break;
+            }
+        }
+    }
+    return pruned;
+}
+
+/**
+ * Drops conjuncts that are covered by a single literal conjunct of the same
+ * rule: min(a, max(b, ...)) == a whenever b >= a.
+ *
+ * @return The number of literals dropped.
+ */
+static int pruneRule(OptRule_t *rule) {
+    int pruned = 0;
+    for (int i = 0; i < rule->numConjuncts; i++) {
+        pruned += pruneDisjunction(&rule->conjuncts[i]);
+    }
+
+    // min(a, a) == a
+    for (int i = 0; i < rule->numConjuncts; i++) {
+        for (int j = i + 1; j < rule->numConjuncts; j++) {
+            if (conjunctEqual(&rule->conjuncts[i], &rule->conjuncts[j])) {
+                pruned += rule->conjuncts[j].numLiterals;
+                removeConjunct(rule, j);
+                j = i;
+            }
+        }
+    }
+
+    for (int i = 0; i < rule->numConjuncts; i++) {
+        const OptConjunct_t *single = &rule->conjuncts[i];
+        if (single->numLiterals != 1) {
+            continue;
+        }
+        for (int j = 0; j < rule->numConjuncts; j++) {
+            const OptConjunct_t *other = &rule->conjuncts[j];
+            if (i == j) {
+                continue;
+            }
+
+            bool covered = false;
+            for (int k = 0; k < other->numLiterals && !covered; k++) {
+                covered = literalDominates(&other->literals[k],
+                                           &single->literals[0]);
+            }
+            // keep the first of two equivalent single literals
+            if (covered && other->numLiterals == 1 && j < i &&
+                literalDominates(&single->literals[0], &other->literals[0])) {
+                covered = false;
+            }
+            if (covered) {
+                pruned += other->numLiterals;
+                removeConjunct(rule, j);
+                i = -1;
+                break;
+            }
+        }
+    }
+    return pruned;
+}
+
+/**
+ * Checks whether a rule can never fire: some single literal is disjoint from
+ * every literal of another conjunct.
+ */
+static bool ruleDead(const OptRule_t *rule) {
+    for (int i = 0; i < rule->numConjuncts; i++) {
+        const OptConjunct_t *single = &rule->conjuncts[i];
+        if (single->numLiterals != 1) {
+            continue;
+        }
+        for (int j = 0; j < rule->numConjuncts; j++) {
+            const OptConjunct_t *other = &rule->conjuncts[j];
+            if (i == j) {
+                continue;
+            }
+            bool disjoint = true;
+            for (int k = 0; k < other->numLiterals && disjoint; k++) {
+                disjoint = literalsDisjoint(&single->literals[0],
+                                            &other->literals[k]);
+            }
+            if (disjoint) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static bool sameConsequent(const OptRule_t *a, const OptRule_t *b) {
+    return a->consequent.variable == b->consequent.variable &&
+           a->consequent.value == b->consequent.value;
+}
+
+static bool sameAntecedent(const OptRule_t *a, const OptRule_t *b) {
+    if (a->numConjuncts != b->numConjuncts) {
+        return false;
+    }
+    for (int i = 0; i < a->numConjuncts; i++) {
+        if (!ruleContainsConjunct(b, &a->conjuncts[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Checks whether every conjunct of `weaker` also appears in `stronger`, in
+ * which case `stronger` never fires more than `weaker`.
+ */
+static bool ruleSubsumes(const OptRule_t *weaker, const OptRule_t *stronger) {
+    for (int i = 0; i < weaker->numConjuncts; i++) {
+        if (!ruleContainsConjunct(stronger, &weaker->conjuncts[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Merges two rules with the same consequent that differ in exactly one
+ * conjunct: max(min(x, a), min(x, b)) == min(x, max(a, b)).
+ *
+ * @return true if `from` was merged into `into`.
+ */
+static bool mergeRules(OptRule_t *into, const OptRule_t *from) {
+    if (into->numConjuncts != from->numConjuncts) {
+        return false;
+    }
+
+    int differentInto = -1;
+    for (int i = 0; i < into->numConjuncts; i++) {
+        if (!ruleContainsConjunct(from, &into->conjuncts[i])) {
+            if (differentInto >= 0) {
+                return false;
+            }
+            differentInto = i;
+        }
+    }
+    int differentFrom = -1;
+    for (int i = 0; i < from->numConjuncts; i++) {
+        if (!ruleContainsConjunct(into, &from->conjuncts[i])) {
+            if (differentFrom >= 0) {
+                return false;
+            }
+            differentFrom = i;
+        }
+    }
+    if (differentInto < 0 || differentFrom < 0) {
+        return false;
+    }
+
+    OptConjunct_t *target = &into->conjuncts[differentInto];
+    const OptConjunct_t *source = &from->conjuncts[differentFrom];
+    FuzzyVariable_t *literals =
+        realloc(target->literals, (target->numLiterals + source->numLiterals) *
+                                      sizeof(FuzzyVariable_t));
+    if (literals == NULL) {
+        return false;
+    }
+    target->literals = literals;
+    for (int i = 0; i < source->numLiterals; i++) {
+        if (!conjunctContains(target, &source->literals[i])) {
+            target->literals[target->numLiterals++] = source->literals[i];
+        }
+    }
+    return true;
+}
+
+static void freeRules(OptRule_t *work, int numRules) {
+    for (int i = 0; i < numRules; i++) {
+        for (int j = 0; j < work[i].numConjuncts; j++) {
+            free(work[i].conjuncts[j].literals);
+        }
+        free(work[i].conjuncts);
+    }
+    free(work);
+}
+
+/**
+ * Splits a FuzzyRule_t into its conjuncts.
+ */
+static int splitRule(const FuzzyRule_t *rule, OptRule_t *out) {
+    int numConjuncts = 0;
+    for (int j = 0; j < rule->num_antecedents; j++) {
+        const FuzzyAntecedent_t *antecedent = &rule->antecedent[j];
+        numConjuncts += antecedent->fuzzy_operator == FUZZY_ALL_OF
+                            ? antecedent->num_variables
+                            : 1;
+    }
+
+    out->consequent = rule->consequent;
+    out->removed = false;
+    out->fold = -1;
+    out->numConjuncts = 0;
+    out->conjuncts = calloc(numConjuncts > 0 ? numConjuncts : 1,
+                            sizeof(OptConjunct_t));
+    if (out->conjuncts == NULL) {
+        return -1;
+    }
+
+    for (int j = 0; j < rule->num_antecedents; j++) {
+        const FuzzyAntecedent_t *antecedent = &rule->antecedent[j];
+        bool all = antecedent->fuzzy_operator == FUZZY_ALL_OF;
+        int count = all ? antecedent->num_variables : 1;
+
+        for (int k = 0; k < count; k++) {
+            int numLiterals = all ? 1 : antecedent->num_variables;
+            OptConjunct_t *conjunct = &out->conjuncts[out->numConjuncts++];
+            conjunct->literals =
+                malloc((numLiterals > 0 ? numLiterals : 1) *
+                       sizeof(FuzzyVariable_t));
+            if (conjunct->literals == NULL) {
+                return -1;
+            }
+            for (int l = 0; l < numLiterals; l++) {
+                conjunct->literals[l] = antecedent->variables[all ? k : l];
+            }
+            conjunct->numLiterals = numLiterals;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Builds the output rule base, folded rules right after the rule they share
+ * the antecedent with.
+ */
+static int emitRules(OptRule_t *work, int numRules, FuzzyRuleBase_t *base,
+                     FuzzyRuleOptimizerReport_t *report) {
+    int numOutput = 0, numAntecedents = 0, numVariables = 0;
+    for (int i = 0; i < numRules; i++) {
+        if (work[i].removed) {
+            continue;
+        }
+        numOutput++;
+        if (work[i].fold >= 0) {
+            continue;
+        }
+        numAntecedents += 1;
+        for (int j = 0; j < work[i].numConjuncts; j++) {
+            numAntecedents += work[i].conjuncts[j].numLiterals > 1;
+            numVariables += work[i].conjuncts[j].numLiterals;
+        }
+    }
+
+    base->rules = calloc(numOutput > 0 ? numOutput : 1, sizeof(FuzzyRule_t));
+    base->antecedents = calloc(numAntecedents > 0 ? numAntecedents : 1,
+                               sizeof(FuzzyAntecedent_t));
+    base->variables =
+        calloc(numVariables > 0 ? numVariables : 1, sizeof(FuzzyVariable_t));
+    if (base->rules == NULL || base->antecedents == NULL ||
+        base->variables == NULL) {
+        FuzzyRuleBaseFree(base);
+        return -1;
+    }
+
+    for (int i = 0; i < numRules; i++) {
+        const OptRule_t *rule = &work[i];
+        if (rule->removed || rule->fold >= 0) {
+            continue;
+        }
+
+        // One ALL_OF group for the single literals, one ANY_OF per
+        // disjunction
+        FuzzyAntecedent_t *first = &base->antecedents[base->numAntecedents];
+        FuzzyAntecedent_t *all = NULL;
+        for (int j = 0; j < rule->numConjuncts; j++) {
+            if (rule->conjuncts[j].numLiterals == 1 && all == NULL) {
+                all = &base->antecedents[base->numAntecedents++];
+                all->fuzzy_operator = FUZZY_ALL_OF;
+                all->variables = &base->variables[base->numVariables];
+                for (int k = 0; k < rule->numConjuncts; k++) {
+                    if (rule->conjuncts[k].numLiterals == 1) {
+                        base->variables[base->numVariables++] =
+                            rule->conjuncts[k].literals[0];
+                        all->num_variables++;
+                    }
+                }
+            }
+        }
+        for (int j = 0; j < rule->numConjuncts; j++) {
+            const OptConjunct_t *conjunct = &rule->conjuncts[j];
+            if (conjunct->numLiterals == 1) {
+                continue;
+            }
+            FuzzyAntecedent_t *any =
+                &base->antecedents[base->numAntecedents++];
+            any->fuzzy_operator = FUZZY_ANY_OF;
+            any->variables = &base->variables[base->numVariables];
+            any->num_variables = conjunct->numLiterals;
+            memcpy(any->variables, conjunct->literals,
+                   conjunct->numLiterals * sizeof(FuzzyVariable_t));
+            base->numVariables += conjunct->numLiterals;
+        }
+        int count = (int)(&base->antecedents[base->numAntecedents] - first);
+
+        for (int k = i; k < numRules; k++) {
+            if (work[k].removed || (k != i && work[k].fold != i)) {
+                continue;
+            }
+            FuzzyRule_t *out = &base->rules[base->numRules++];
+            out->antecedent = first;
+            out->num_antecedents = count;
+            out->consequent = work[k].consequent;
+        }
+    }
+
+    report->outputRules = base->numRules;
+    report->outputLiterals = base->numVariables;
+    return 0;
+}
+
+/**
+ * Optimizes a rule base before evaluation.
+ *
+ * The pass drops redundant literals, removes rules that can never fire,
+ * merges rules with the same consequent into ANY_OF groups, removes rules
+ * subsumed by a weaker one and folds rules with identical antecedents so the
+ * antecedent is evaluated once. The result is equivalent to the input under
+ * fuzzyInference() with FUZZY_MIN_MAX; the rewrites rely on idempotent
+ * operators and do not hold for the other operator families. The membership
+ * functions of every referenced FuzzySet_t must be initialized, since the
+ * analysis looks at their shapes.
+ *
+ * @param rules The rule base to optimize.
+ * @param numRules The number of rules.
+ * @param base Receives the optimized rule base, release it with
+ * FuzzyRuleBaseFree().
+ * @param report Receives statistics about the pass, may be NULL.
+ * @return 0 on success, -1 if out of memory.
+ */
+int FuzzyRuleOptimize(const FuzzyRule_t *rules, int numRules,
+                      FuzzyRuleBase_t *base,
+                      FuzzyRuleOptimizerReport_t *report) {
+    FuzzyRuleOptimizerReport_t localReport;
+    if (report == NULL) {
+        report = &localReport;
+    }
+    memset(report, 0, sizeof(*report));
+    memset(base, 0, sizeof(*base));
+    report->inputRules = numRules;
+
+    OptRule_t *work = calloc(numRules > 0 ? numRules : 1, sizeof(OptRule_t));
+    if (work == NULL) {
+        return -1;
+    }
+    for (int i = 0; i < numRules; i++) {
+        if (splitRule(&rules[i], &work[i])) {
+            freeRules(work, numRules);
+            return -1;
+        }
+        for (int j = 0; j < work[i].numConjuncts; j++) {
+            report->inputLiterals += work[i].conjuncts[j].numLiterals;
+        }
+    }
+
+    // Redundant literals and dead rules
+    for (int i = 0; i < numRules; i++) {
+        report->prunedLiterals += pruneRule(&work[i]);
+        if (ruleDead(&work[i])) {
+            work[i].removed = true;
+            report->deadRules++;
+        }
+    }
+
+    // Subsumption and merging of rules with the same consequent, until
+    // nothing changes anymore
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = 0; i < numRules; i++) {
+            for (int j = 0; j < numRules; j++) {
+                if (i == j || work[i].removed || work[j].removed ||
+                    !sameConsequent(&work[i], &work[j])) {
+                    continue;
+                }
+                if (ruleSubsumes(&work[i], &work[j])) {
+                    work[j].removed = true;
+                    report->subsumedRules++;
+                    changed = true;
+                } else if (i < j && mergeRules(&work[i], &work[j])) {
+                    work[j].removed = true;
+                    report->mergedRules++;
+                    report->prunedLiterals += pruneRule(&work[i]);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    // Fold rules with identical antecedents onto the first one
+    for (int i = 0; i < numRules; i++) {
+        for (int j = 0; j < i && !work[i].removed; j++) {
+            if (!work[j].removed && work[j].fold < 0 &&
+                sameAntecedent(&work[i], &work[j])) {
+                work[i].fold = j;
+                report->foldedRules++;
+                break;
+            }
+        }
+    }
+
+    int result = emitRules(work, numRules, base, report);
+    freeRules(work, numRules);
+    return result;
+}
+
+/**
+ * Releases a rule base produced by FuzzyRuleOptimize() or FuzzyRuleReorder().
+ *
+ * @param base The rule base to release.
+ */
+void FuzzyRuleBaseFree(FuzzyRuleBase_t *base) {
+    free(base->rules);
+    free(base->antecedents);
+    free(base->variables);
+    memset(base, 0, sizeof(*base));
+}
+
+// ---------------------------------------------------------------------------
+// profile guided ordering
+// ---------------------------------------------------------------------------
+
+/**
+ * Initializes an empty profile of a rule base.
+ *
+ * @param profile The profile to initialize.
+ * @param rules The rule base to profile.
+ * @param numRules The number of rules.
+ * @return 0 on success, -1 if out of memory.
+ */
+int FuzzyRuleProfileInit(FuzzyRuleProfile_t *profile, const FuzzyRule_t *rules,
+                         int numRules) {
+    memset(profile, 0, sizeof(*profile));
+    int numGroups = 0, numLiterals = 0;
+    for (int i = 0; i < numRules; i++) {
+        numGroups += rules[i].num_antecedents;
+        for (int j = 0; j < rules[i].num_antecedents; j++) {
+            numLiterals += rules[i].antecedent[j].num_variables;
+        }
+    }
+
+    profile->literalZeros = calloc(numLiterals + 1, sizeof(long));
+    profile->literalOnes = calloc(numLiterals + 1, sizeof(long));
+    profile->groupZeros = calloc(numGroups + 1, sizeof(long));
+    profile->ruleZeros = calloc(numRules + 1, sizeof(long));
+    profile->firstGroup = calloc(numRules + 1, sizeof(int));
+    profile->firstLiteral = calloc(numGroups + 1, sizeof(int));
+    if (profile->literalZeros == NULL || profile->literalOnes == NULL ||
+        profile->groupZeros == NULL || profile->ruleZeros == NULL ||
+        profile->firstGroup == NULL || profile->firstLiteral == NULL) {
+        FuzzyRuleProfileFree(profile);
+        return -1;
+    }
+
+    int group = 0, literal = 0;
+    for (int i = 0; i < numRules; i++) {
+        profile->firstGroup[i] = group;
+        for (int j = 0; j < rules[i].num_antecedents; j++) {
+            profile->firstLiteral[group++] = literal;
+            literal += rules[i].antecedent[j].num_variables;
+        }
+    }
+    profile->firstGroup[numRules] = group;
+    profile->firstLiteral[numGroups] = literal;
+    profile->numRules = numRules;
+    profile->numGroups = numGroups;
+    profile->numLiterals = numLiterals;
+    return 0;
+}
+
+/**
+ * Records one sample of a workload: call it after the inputs of a cycle are
+ * classified. Every literal is evaluated, under min/max.
+ *
+ * @param profile The profile of the rule base.
+ * @param rules The rule base the profile was initialized with.
+ * @param numRules The number of rules.
+ */
+void FuzzyRuleProfileRecord(FuzzyRuleProfile_t *profile,
+                            const FuzzyRule_t *rules, int numRules) {
+    for (int i = 0; i < numRules && i < profile->numRules; i++) {
+        const FuzzyRule_t *rule = &rules[i];
+        double membership = 1.0;
+
+        for (int j = 0; j < rule->num_antecedents; j++) {
+            const FuzzyAntecedent_t *antecedent = &rule->antecedent[j];
+            int group = profile->firstGroup[i] + j;
+            bool all = antecedent->fuzzy_operator == FUZZY_ALL_OF;
+            double groupMembership = all ? 1.0 : 0.0;
+
+            for (int k = 0; k < antecedent->num_variables; k++) {
+                const FuzzyVariable_t *variable = &antecedent->variables[k];
+                double value =
+                    variable->variable->membershipValues[variable->value];
+                if (variable->invert) {
+                    value = 1.0 - value;
+                }
+                int literal = profile->firstLiteral[group] + k;
+                profile->literalZeros[literal] += value <= 0.0;
+                profile->literalOnes[literal] += value >= 1.0;
+                groupMembership = all ? fmin(groupMembership, value)
+                                      : fmax(groupMembership, value);
+            }
+            profile->groupZeros[group] += groupMembership <= 0.0;
+            membership = fmin(membership, groupMembership);
+        }
+        profile->ruleZeros[i] += membership <= 0.0;
+    }
+    profile->samples++;
+}
+
+/**
+ * Releases the counters of a profile.
+ */
+void FuzzyRuleProfileFree(FuzzyRuleProfile_t *profile) {
+    free(profile->literalZeros);
+    free(profile->literalOnes);
+    free(profile->groupZeros);
+    free(profile->ruleZeros);
+    free(profile->firstGroup);
+    free(profile->firstLiteral);
+    memset(profile, 0, sizeof(*profile));
+}
+
+/**
+ * Sorts the positions 0..n-1 by descending count, stable.
+ */
+static void sortByCount(int *order, const long *counts, int n) {
+    for (int i = 0; i < n; i++) {
+        order[i] = i;
+    }
+    for (int i = 1; i < n; i++) {
+        int position = order[i];
+        int j = i;
+        for (; j > 0 && counts[order[j - 1]] < counts[position]; j--) {
+            order[j] = order[j - 1];
+        }
+        order[j] = position;
+    }
+}
+
+// A run of rules that share their antecedent
+typedef struct {
+    int first;
+    int count;
+} ReorderUnit_t;
+
+/**
+ * Reorders the antecedents of a rule base by a profile, so the
+ * short-circuiting kernels stop as early as possible.
+ *
+ * Groups that were zero most often come first within an antecedent, literals
+ * that were zero (ALL_OF) or one (ANY_OF) most often come first within a
+ * group. The rules keep their order, a rule may read an output an earlier
+ * rule produced, and rules that share their antecedent keep sharing it. Min
+ * and max are exactly commutative, so the result is identical to the input
+ * under fuzzyInference() with FUZZY_MIN_MAX; the other operator families only
+ * commute up to rounding.
+ *
+ * @param rules The rule base to reorder.
+ * @param numRules The number of rules.
+ * @param profile A profile of the rule base.
+ * @param base Receives the reordered rule base, release it with
+ * FuzzyRuleBaseFree().
+ * @return 0 on success, -1 if the profile does not fit or out of memory.
+ */
+int FuzzyRuleReorder(const FuzzyRule_t *rules, int numRules,
+                     const FuzzyRuleProfile_t *profile, FuzzyRuleBase_t *base) {
+    memset(base, 0, sizeof(*base));
+    if (profile->numRules != numRules) {
+        return -1;
+    }
+
+    ReorderUnit_t *units = malloc((numRules + 1) * sizeof(ReorderUnit_t));
+    int *order = malloc((profile->numGroups + profile->numLiterals + 1) *
+                        sizeof(int));
+    if (units == NULL || order == NULL) {
+        free(units);
+        free(order);
+        return -1;
+    }
+
+    int numUnits = 0, numAntecedents = 0, numVariables = 0;
+    for (int i = 0; i < numRules; i++) {
+        if (i > 0 && rules[i].antecedent == rules[i - 1].antecedent &&
+            rules[i].num_antecedents == rules[i - 1].num_antecedents) {
+            units[numUnits - 1].count++;
+            continue;
+        }
+        units[numUnits++] = (ReorderUnit_t){.first = i, .count = 1};
+        numAntecedents += rules[i].num_antecedents;
+        numVariables += profile->firstLiteral[profile->firstGroup[i + 1]] -
+                        profile->firstLiteral[profile->firstGroup[i]];
+    }
+
+    base->rules = calloc(numRules + 1, sizeof(FuzzyRule_t));
+    base->antecedents = calloc(numAntecedents + 1, sizeof(FuzzyAntecedent_t));
+    base->variables = calloc(numVariables + 1, sizeof(FuzzyVariable_t));
+    if (base->rules == NULL || base->antecedents == NULL ||
+        base->variables == NULL) {
+        free(units);
+        free(order);
+        FuzzyRuleBaseFree(base);
+        return -1;
+    }
+
+    for (int u = 0; u < numUnits; u++) {
+        const FuzzyRule_t *rule = &rules[units[u].first];
+        int firstGroup = profile->firstGroup[units[u].first];
+        FuzzyAntecedent_t *antecedent =
+            &base->antecedents[base->numAntecedents];
+
+        int *groups = order;
+        sortByCount(groups, &profile->groupZeros[firstGroup],
+                    rule->num_antecedents);
+        for (int j = 0; j < rule->num_antecedents; j++) {
+            const FuzzyAntecedent_t *group = &rule->antecedent[groups[j]];
+            int firstLiteral = profile->firstLiteral[firstGroup + groups[j]];
+            const long *counts = group->fuzzy_operator == FUZZY_ALL_OF
+                                     ? &profile->literalZeros[firstLiteral]
+                                     : &profile->literalOnes[firstLiteral];
+
+            FuzzyAntecedent_t *out = &base->antecedents[base->numAntecedents++];
+            out->fuzzy_operator = group->fuzzy_operator;
+            out->num_variables = group->num_variables;
+            out->variables = &base->variables[base->numVariables];
+
+            int *literals = order + rule->num_antecedents;
+            sortByCount(literals, counts, group->num_variables);
+            for (int k = 0; k < group->num_variables; k++) {
+                base->variables[base->numVariables++] =
+                    group->variables[literals[k]];
+            }
+        }
+
+        for (int i = units[u].first; i < units[u].first + units[u].count;
+             i++) {
+            FuzzyRule_t *out = &base->rules[base->numRules++];
+            out->antecedent = antecedent;
+            out->num_antecedents = rules[i].num_antecedents;
+            out->consequent = rules[i].consequent;
+        }
+    }
+
+    free(units);
+    free(order);
+    return 0;
+}
+
+/**
+ * Prints the statistics of an optimizer pass.
+ *
+ * @param report The report to print.
+ */
+void printRuleOptimizerReport(const FuzzyRuleOptimizerReport_t *report) {
+    printf("Rules     %4d -> %4d\n", report->inputRules, report->outputRules);
+    printf("Literals  %4d -> %4d\n", report->inputLiterals,
+           report->outputLiterals);
+    printf("  dead rules removed     %4d\n", report->deadRules);
+    printf("  redundant literals     %4d\n", report->prunedLiterals);
+    printf("  merged into ANY_OF     %4d\n", report->mergedRules);
+    printf("  subsumed rules         %4d\n", report->subsumedRules);
+    printf("  folded antecedents     %4d\n", report->foldedRules);
+    printf("\n");
+}
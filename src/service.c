@@ -0,0 +1,869 @@
+/**
+ * @file service.c
+ * @brief Fuzzy Logic local inference service implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#define _GNU_SOURCE
+#include "service.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SERVER_BACKLOG 16
+#define SERVER_EVENTS 32
+// requests served per client and wakeup, so busy clients take turns
+#define SERVER_BURST 8
+// file descriptors a request can bring along before the rest are discarded
+#define SERVER_MAX_FDS 4
+#define HEADER_SIZE sizeof(FuzzyServiceMessage_t)
+#define MAX_PAYLOAD (FUZZY_SERVICE_MAX_MESSAGE - HEADER_SIZE)
+
+static uint64_t nowNanoseconds(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+}
+
+static int socketAddress(struct sockaddr_un *address, const char *path) {
+    memset(address, 0, sizeof(*address));
+    address->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(address->sun_path)) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    strcpy(address->sun_path, path);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Server
+// ---------------------------------------------------------------------------
+
+/**
+ * Creates the listening socket of a server. A socket file left by an earlier
+ * run is replaced.
+ *
+ * @param server The server to initialize.
+ * @param path The path of the UNIX socket.
+ * @return 0 on success, -1 with errno set otherwise.
+ */
+int FuzzyServerInit(FuzzyServer_t *server, const char *path) {
+    memset(server, 0, sizeof(*server));
+    server->listenFd = -1;
+    server->epollFd = -1;
+
+    struct sockaddr_un address;
+    if (socketAddress(&address, path)) {
+        return -1;
+    }
+    strcpy(server->path, path);
+
+    server->listenFd =
+        socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (server->listenFd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (bind(server->listenFd, (struct sockaddr *)&address,
+             sizeof(address)) != 0 ||
+        listen(server->listenFd, SERVER_BACKLOG) != 0) {
+        FuzzyServerFree(server);
+        return -1;
+    }
+
+    server->epollFd = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event event = {.events = EPOLLIN, .data.ptr = NULL};
+    if (server->epollFd < 0 ||
+        epoll_ctl(server->epollFd, EPOLL_CTL_ADD, server->listenFd,
+                  &event) != 0) {
+        FuzzyServerFree(server);
+        return -1;
+    }
+    return 0;
+}
+
+static void closeClient(FuzzyServer_t *server, FuzzyServerClient_t *client) {
+    for (int i = 0; i < FUZZY_SERVICE_MAX_CLIENTS; i++) {
+        if (server->clients[i] == client) {
+            server->clients[i] = NULL;
+        }
+    }
+    epoll_ctl(server->epollFd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    if (client->ring != NULL) {
+        munmap(client->ring, client->ringSize);
+    }
+    free(client->request);
+    free(client->reply);
+    free(client);
+}
+
+/**
+ * Closes every client and the socket of a server and removes the socket
+ * file. The models stay with the caller.
+ */
+void FuzzyServerFree(FuzzyServer_t *server) {
+    for (int i = 0; i < FUZZY_SERVICE_MAX_CLIENTS; i++) {
+        if (server->clients[i] != NULL) {
+            closeClient(server, server->clients[i]);
+        }
+    }
+    for (int i = 0; i < server->numModels; i++) {
+        FuzzyContextFree(&server->models[i].context);
+    }
+    if (server->listenFd >= 0) {
+        close(server->listenFd);
+        unlink(server->path);
+    }
+    if (server->epollFd >= 0) {
+        close(server->epollFd);
+    }
+    server->numModels = 0;
+    server->listenFd = -1;
+    server->epollFd = -1;
+}
+
+/**
+ * Hosts a model under a name. The model must outlive the server.
+ *
+ * @return 0 on success, -1 if the name is taken or too long, or the server
+ * is full.
+ */
+int FuzzyServerAddModel(FuzzyServer_t *server, const char *name,
+                        const FuzzyModel_t *model) {
+    if (server->numModels == FUZZY_SERVICE_MAX_MODELS ||
+        strlen(name) >= FUZZY_MODEL_NAME_LENGTH) {
+        return -1;
+    }
+    for (int i = 0; i < server->numModels; i++) {
+        if (strcmp(server->models[i].name, name) == 0) {
+            return -1;
+        }
+    }
+    FuzzyServerModel_t *hosted = &server->models[server->numModels];
+    if (FuzzyContextInit(&hosted->context, model)) {
+        return -1;
+    }
+    strcpy(hosted->name, name);
+    hosted->model = model;
+    server->numModels++;
+    return 0;
+}
+
+static void acceptClients(FuzzyServer_t *server) {
+    for (;;) {
+        int fd = accept4(server->listenFd, NULL, NULL,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+        int slot = 0;
+        while (slot < FUZZY_SERVICE_MAX_CLIENTS &&
+               server->clients[slot] != NULL) {
+            slot++;
+        }
+        FuzzyServerClient_t *client = calloc(1, sizeof(*client));
+        if (slot == FUZZY_SERVICE_MAX_CLIENTS || client == NULL ||
+            (client->request = malloc(FUZZY_SERVICE_MAX_MESSAGE)) == NULL ||
+            (client->reply = malloc(FUZZY_SERVICE_MAX_MESSAGE)) == NULL) {
+            if (client != NULL) {
+                free(client->request);
+                free(client);
+            }
+            close(fd);
+            continue;
+        }
+        client->fd = fd;
+        struct epoll_event event = {.events = EPOLLIN, .data.ptr = client};
+        if (epoll_ctl(server->epollFd, EPOLL_CTL_ADD, fd, &event) != 0) {
+            free(client->request);
+            free(client->reply);
+            free(client);
+            close(fd);
+            continue;
+        }
+        server->clients[slot] = client;
+    }
+}
+
+// Whether count rows of the given width fit the ring at a byte offset
+static int fitsRing(const FuzzyServerClient_t *client, uint64_t offset,
+                    uint64_t count, uint32_t width) {
+    if (offset % sizeof(double) != 0 || offset > client->ringSize) {
+        return 0;
+    }
+    uint64_t room = (client->ringSize - offset) / sizeof(double);
+    return width == 0 || count <= room / width;
+}
+
+static int32_t attachRing(FuzzyServerClient_t *client, int fd,
+                          uint64_t size) {
+    struct stat st;
+    if (fd < 0) {
+        return -EBADF;
+    }
+    // a ring that can shrink would fault the server once truncated
+    int seals = fcntl(fd, F_GET_SEALS);
+    if (seals < 0 || !(seals & F_SEAL_SHRINK)) {
+        close(fd);
+        return -EPERM;
+    }
+    if (fstat(fd, &st) != 0 || size == 0 || (uint64_t)st.st_size < size) {
+        close(fd);
+        return -EINVAL;
+    }
+    void *ring = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) {
+        return -ENOMEM;
+    }
+    if (client->ring != NULL) {
+        munmap(client->ring, client->ringSize);
+    }
+    client->ring = ring;
+    client->ringSize = size;
+    return 0;
+}
+
+// Handles one request and builds its reply, returns the size of the reply
+static size_t handle(FuzzyServer_t *server, FuzzyServerClient_t *client,
+                     size_t length, int fd) {
+    const FuzzyServiceMessage_t *request =
+        (const FuzzyServiceMessage_t *)client->request;
+    FuzzyServiceMessage_t *reply = (FuzzyServiceMessage_t *)client->reply;
+    const char *payload = client->request + HEADER_SIZE;
+    char *replyPayload = client->reply + HEADER_SIZE;
+    size_t replyLength = HEADER_SIZE;
+
+    memset(reply, 0, HEADER_SIZE);
+    if (length < HEADER_SIZE) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        reply->status = -EBADMSG;
+        return replyLength;
+    }
+    *reply = *request;
+    reply->status = 0;
+    reply->latency = 0;
+    if (request->type == FUZZY_SERVICE_ATTACH) {
+        reply->status = attachRing(client, fd, request->count);
+        return replyLength;
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+
+    if (request->type == FUZZY_SERVICE_OPEN) {
+        char name[FUZZY_MODEL_NAME_LENGTH] = {0};
+        size_t nameLength = length - HEADER_SIZE;
+        memcpy(name, payload,
+               nameLength < sizeof(name) - 1 ? nameLength : sizeof(name) - 1);
+        reply->status = -ENOENT;
+        for (int i = 0; i < server->numModels; i++) {
+            if (strcmp(server->models[i].name, name) == 0) {
+                const FuzzyModel_t *model = server->models[i].model;
+                FuzzyServiceModel_t info = {.model = i,
+                                            .numInputs = model->numInputs,
+                                            .numOutputs = model->numOutputs,
+                                            .numRules = model->numRules};
+                memcpy(replyPayload, &info, sizeof(info));
+                replyLength += sizeof(info);
+                reply->model = i;
+                reply->status = 0;
+                break;
+            }
+        }
+        return replyLength;
+    }
+
+    if (request->type != FUZZY_SERVICE_EVALUATE &&
+        request->type != FUZZY_SERVICE_EVALUATE_SHARED) {
+        reply->status = -EINVAL;
+        return replyLength;
+    }
+    if (request->model >= (uint32_t)server->numModels) {
+        reply->status = -ENOENT;
+        return replyLength;
+    }
+    FuzzyServerModel_t *hosted = &server->models[request->model];
+    uint32_t numInputs = hosted->model->numInputs;
+    uint32_t numOutputs = hosted->model->numOutputs;
+    const double *inputs;
+    double *outputs;
+
+    if (request->type == FUZZY_SERVICE_EVALUATE) {
+        size_t rows = numInputs > 0
+                          ? (length - HEADER_SIZE) / sizeof(double) / numInputs
+                          : 0;
+        if (rows != request->count ||
+            rows * numInputs * sizeof(double) != length - HEADER_SIZE) {
+            reply->status = -EINVAL;
+            return replyLength;
+        }
+        if (numOutputs > 0 &&
+            rows > MAX_PAYLOAD / sizeof(double) / numOutputs) {
+            reply->status = -EMSGSIZE;
+            return replyLength;
+        }
+        inputs = (const double *)payload;
+        outputs = (double *)replyPayload;
+        replyLength += rows * numOutputs * sizeof(double);
+    } else {
+        if (client->ring == NULL) {
+            reply->status = -ENXIO;
+            return replyLength;
+        }
+        if (!fitsRing(client, request->input, request->count, numInputs) ||
+            !fitsRing(client, request->output, request->count, numOutputs)) {
+            reply->status = -ERANGE;
+            return replyLength;
+        }
+        inputs = (const double *)(client->ring + request->input);
+        outputs = (double *)(client->ring + request->output);
+    }
+
+    for (uint64_t i = 0; i < request->count; i++) {
+        FuzzyModelEvaluate(hosted->model, &hosted->context,
+                           &inputs[i * numInputs], &outputs[i * numOutputs]);
+    }
+    server->stats.rows += request->count;
+    return replyLength;
+}
+
+static int watch(FuzzyServer_t *server, FuzzyServerClient_t *client,
+                 uint32_t events) {
+    struct epoll_event event = {.events = events, .data.ptr = client};
+    return epoll_ctl(server->epollFd, EPOLL_CTL_MOD, client->fd, &event);
+}
+
+static int sendReply(FuzzyServer_t *server, FuzzyServerClient_t *client,
+                     size_t length) {
+    if (send(client->fd, client->reply, length, MSG_NOSIGNAL) ==
+        (ssize_t)length) {
+        return 0;
+    }
+    if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        return -1;
+    }
+    // stop reading until the socket takes the reply
+    client->pending = length;
+    return watch(server, client, EPOLLOUT);
+}
+
+// The one descriptor a request brought along, every other one is closed: a
+// request with none or several yields -1
+static int receivedFd(struct msghdr *msg) {
+    int fd = -1, count = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(msg); cmsg != NULL;
+         cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t numFds = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < numFds; i++) {
+            int received;
+            memcpy(&received, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if (count++ == 0) {
+                fd = received;
+            } else {
+                close(received);
+            }
+        }
+    }
+    if (count > 1) {
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+// Serves a burst of requests of a client, the rest on the next wakeup
+static int serve(FuzzyServer_t *server, FuzzyServerClient_t *client) {
+    for (int served = 0; served < SERVER_BURST && client->pending == 0;
+         served++) {
+        char control[CMSG_SPACE(SERVER_MAX_FDS * sizeof(int))];
+        struct iovec iov = {.iov_base = client->request,
+                            .iov_len = FUZZY_SERVICE_MAX_MESSAGE};
+        struct msghdr msg = {.msg_iov = &iov,
+                             .msg_iovlen = 1,
+                             .msg_control = control,
+                             .msg_controllen = sizeof(control)};
+        ssize_t length = recvmsg(client->fd, &msg, MSG_CMSG_CLOEXEC);
+        if (length < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+        }
+        if (length == 0) {
+            return -1;
+        }
+        uint64_t received = nowNanoseconds();
+
+        int fd = receivedFd(&msg);
+
+        FuzzyServiceMessage_t *reply = (FuzzyServiceMessage_t *)client->reply;
+        size_t replyLength;
+        if (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            memcpy(reply, client->request, HEADER_SIZE);
+            reply->status = -EMSGSIZE;
+            replyLength = HEADER_SIZE;
+        } else {
+            replyLength = handle(server, client, length, fd);
+        }
+
+        reply->latency = nowNanoseconds() - received;
+        FuzzyServerStats_t *stats = &server->stats;
+        stats->requests++;
+        stats->errors += reply->status != 0;
+        stats->totalLatency += reply->latency;
+        if (reply->latency > stats->maxLatency) {
+            stats->maxLatency = reply->latency;
+        }
+        if (server->verbose) {
+            fprintf(stderr, "request %u type %u model %u rows %llu: %d, "
+                            "%.1f us\n",
+                    reply->id, reply->type, reply->model,
+                    (unsigned long long)reply->count, reply->status,
+                    reply->latency * 1e-3);
+        }
+
+        if (sendReply(server, client, replyLength)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int flush(FuzzyServer_t *server, FuzzyServerClient_t *client) {
+    size_t length = client->pending;
+    if (send(client->fd, client->reply, length, MSG_NOSIGNAL) !=
+        (ssize_t)length) {
+        return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -1;
+    }
+    client->pending = 0;
+    return watch(server, client, EPOLLIN);
+}
+
+/**
+ * Serves clients until *stop is set, e.g. by a signal handler.
+ *
+ * The signals that set *stop are blocked while serving and only unblocked
+ * inside epoll_pwait(), so one that arrives between checking *stop and
+ * waiting still ends the wait instead of being missed.
+ *
+ * @param server The server, with its models added.
+ * @param stop Checked after every wakeup.
+ * @param signals The signals whose handlers set *stop, NULL to leave the
+ * signal mask alone.
+ * @return 0 once stopped, -1 if waiting for events failed.
+ */
+int FuzzyServerRun(FuzzyServer_t *server, volatile sig_atomic_t *stop,
+                   const sigset_t *signals) {
+    sigset_t previous, waiting;
+    if (signals != NULL) {
+        if (pthread_sigmask(SIG_BLOCK, signals, &previous) != 0) {
+            return -1;
+        }
+        waiting = previous;
+        for (int s = 1; s < NSIG; s++) {
+            if (sigismember(signals, s) == 1) {
+                sigdelset(&waiting, s);
+            }
+        }
+    }
+
+    struct epoll_event events[SERVER_EVENTS];
+    int result = 0;
+    while (!*stop) {
+        int n = epoll_pwait(server->epollFd, events, SERVER_EVENTS, -1,
+                            signals != NULL ? &waiting : NULL);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            result = -1;
+            break;
+        }
+        for (int i = 0; i < n; i++) {
+            FuzzyServerClient_t *client = events[i].data.ptr;
+            if (client == NULL) {
+                acceptClients(server);
+                continue;
+            }
+            int failed = 0;
+            if (client->pending != 0 &&
+                (events[i].events & (EPOLLOUT | EPOLLHUP))) {
+                failed = flush(server, client);
+            }
+            if (!failed && client->pending == 0 &&
+                (events[i].events & (EPOLLIN | EPOLLHUP))) {
+                failed = serve(server, client);
+            }
+            if (failed || (events[i].events & EPOLLERR)) {
+                closeClient(server, client);
+            }
+        }
+    }
+
+    if (signals != NULL) {
+        pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    }
+    return result;
+}
+
+// ---------------------------------------------------------------------------
+// Client
+// ---------------------------------------------------------------------------
+
+// Sends a request and queues it as pending, returns its id
+static int request(FuzzyServiceClient_t *client, FuzzyServiceMessage_t *message,
+                   size_t payload, int fd, uint64_t end) {
+    if (client->numPending == FUZZY_SERVICE_MAX_PENDING) {
+        errno = EAGAIN;
+        return -1;
+    }
+    message->id = client->nextId & 0x7fffffff;
+
+    char control[CMSG_SPACE(sizeof(int))];
+    struct iovec iov = {.iov_base = message,
+                        .iov_len = HEADER_SIZE + payload};
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1};
+    if (fd >= 0) {
+        memset(control, 0, sizeof(control));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+        memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+    }
+    // never block: the server stops reading while its replies are not read
+    if (sendmsg(client->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT) !=
+        (ssize_t)(HEADER_SIZE + payload)) {
+        return -1;
+    }
+
+    FuzzyServicePending_t *pending =
+        &client->pending[client->nextId % FUZZY_SERVICE_MAX_PENDING];
+    pending->sent = nowNanoseconds();
+    pending->end = end;
+    client->numPending++;
+    client->nextId++;
+    return message->id;
+}
+
+// Receives the next reply, copying at most size bytes of its payload
+static int receive(FuzzyServiceClient_t *client, FuzzyServiceReply_t *reply,
+                   void *payload, size_t size) {
+    memset(reply, 0, sizeof(*reply));
+    if (client->numPending == 0) {
+        errno = EINVAL;
+        return -1;
+    }
+    ssize_t length;
+    do {
+        length = recv(client->fd, client->message, FUZZY_SERVICE_MAX_MESSAGE,
+                      0);
+    } while (length < 0 && errno == EINTR);
+    if (length < (ssize_t)HEADER_SIZE) {
+        if (length >= 0) {
+            errno = ECONNRESET;
+        }
+        return -1;
+    }
+
+    uint32_t id = client->nextId - client->numPending;
+    const FuzzyServicePending_t *pending =
+        &client->pending[id % FUZZY_SERVICE_MAX_PENDING];
+    client->numPending--;
+
+    const FuzzyServiceMessage_t *message =
+        (const FuzzyServiceMessage_t *)client->message;
+    reply->id = message->id;
+    reply->status = message->status;
+    reply->count = message->count;
+    reply->latency = message->latency;
+    reply->roundTrip = nowNanoseconds() - pending->sent;
+    reply->end = pending->end;
+
+    size_t available = length - HEADER_SIZE;
+    if (reply->status == 0 && message->type == FUZZY_SERVICE_EVALUATE_SHARED) {
+        reply->outputs = (const double *)(client->ring + message->output);
+    } else if (reply->status == 0 && available > 0) {
+        if (payload == NULL || available > size) {
+            reply->status = -ENOBUFS;
+        } else {
+            memcpy(payload, client->message + HEADER_SIZE, available);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Connects to a server.
+ *
+ * @param client The client to connect.
+ * @param path The path of the server socket.
+ * @param ringSize The bytes of shared memory for ring batches, 0 for inline
+ * batches only.
+ * @return 0 on success, -1 with errno set otherwise.
+ */
+int FuzzyServiceConnect(FuzzyServiceClient_t *client, const char *path,
+                        size_t ringSize) {
+    memset(client, 0, sizeof(*client));
+    struct sockaddr_un address;
+    if (socketAddress(&address, path)) {
+        return -1;
+    }
+    client->message = malloc(FUZZY_SERVICE_MAX_MESSAGE);
+    client->fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (client->message == NULL || client->fd < 0 ||
+        connect(client->fd, (struct sockaddr *)&address, sizeof(address))) {
+        FuzzyServiceClose(client);
+        return -1;
+    }
+    if (ringSize == 0) {
+        return 0;
+    }
+
+    long page = sysconf(_SC_PAGESIZE);
+    ringSize = (ringSize + page - 1) / page * page;
+    int fd = memfd_create("fuzzy-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (fd < 0 || ftruncate(fd, ringSize) != 0 ||
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) !=
+            0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        FuzzyServiceClose(client);
+        return -1;
+    }
+    void *ring =
+        mmap(NULL, ringSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ring == MAP_FAILED) {
+        close(fd);
+        FuzzyServiceClose(client);
+        return -1;
+    }
+    client->ring = ring;
+    client->ringSize = ringSize;
+
+    FuzzyServiceMessage_t attach = {.type = FUZZY_SERVICE_ATTACH,
+                                    .count = ringSize};
+    FuzzyServiceReply_t reply;
+    int sent = request(client, &attach, 0, fd, 0);
+    close(fd);
+    if (sent < 0 || receive(client, &reply, NULL, 0) != 0 ||
+        reply.status != 0) {
+        if (sent >= 0 && reply.status != 0) {
+            errno = -reply.status;
+        }
+        FuzzyServiceClose(client);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Disconnects from the server and unmaps the ring.
+ */
+void FuzzyServiceClose(FuzzyServiceClient_t *client) {
+    if (client->fd >= 0) {
+        close(client->fd);
+    }
+    if (client->ring != NULL) {
+        munmap(client->ring, client->ringSize);
+    }
+    free(client->message);
+    memset(client, 0, sizeof(*client));
+    client->fd = -1;
+}
+
+/**
+ * Looks a hosted model up by name. No request may be in flight.
+ *
+ * @param client The client.
+ * @param name The name the server hosts the model under.
+ * @param model Receives the model index and its shape.
+ * @return 0 on success, -1 with errno set otherwise, ENOENT if there is no
+ * such model.
+ */
+int FuzzyServiceOpen(FuzzyServiceClient_t *client, const char *name,
+                     FuzzyServiceModel_t *model) {
+    if (client->numPending != 0) {
+        errno = EBUSY;
+        return -1;
+    }
+    size_t length = strlen(name);
+    if (length >= FUZZY_MODEL_NAME_LENGTH) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    FuzzyServiceMessage_t *message = (FuzzyServiceMessage_t *)client->message;
+    memset(message, 0, HEADER_SIZE);
+    message->type = FUZZY_SERVICE_OPEN;
+    memcpy(client->message + HEADER_SIZE, name, length);
+
+    FuzzyServiceReply_t reply;
+    if (request(client, message, length, -1, 0) < 0 ||
+        receive(client, &reply, model, sizeof(*model)) != 0) {
+        return -1;
+    }
+    if (reply.status != 0) {
+        errno = -reply.status;
+        return -1;
+    }
+    if (model->model < FUZZY_SERVICE_MAX_MODELS) {
+        client->models[model->model] = *model;
+    }
+    return 0;
+}
+
+/**
+ * Sends an inline batch, the inputs are copied into the request.
+ *
+ * @param client The client.
+ * @param model The index of an opened model.
+ * @param inputs count rows of inputs.
+ * @param count The number of rows, limited by FUZZY_SERVICE_MAX_MESSAGE.
+ * @return The id of the request, -1 with errno EAGAIN if too many requests
+ * are in flight: receive a reply and try again.
+ */
+int FuzzyServiceEvaluate(FuzzyServiceClient_t *client, uint32_t model,
+                         const double *inputs, size_t count) {
+    if (model >= FUZZY_SERVICE_MAX_MODELS ||
+        client->models[model].numInputs == 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    const FuzzyServiceModel_t *info = &client->models[model];
+    uint32_t width = info->numInputs > info->numOutputs ? info->numInputs
+                                                        : info->numOutputs;
+    if (count > MAX_PAYLOAD / sizeof(double) / width) {
+        errno = EMSGSIZE;
+        return -1;
+    }
+
+    FuzzyServiceMessage_t *message = (FuzzyServiceMessage_t *)client->message;
+    memset(message, 0, HEADER_SIZE);
+    message->type = FUZZY_SERVICE_EVALUATE;
+    message->model = model;
+    message->count = count;
+    size_t payload = count * info->numInputs * sizeof(double);
+    memcpy(client->message + HEADER_SIZE, inputs, payload);
+    return request(client, message, payload, -1, 0);
+}
+
+/**
+ * Reserves a batch in the ring. The caller writes the inputs straight into
+ * batch->inputs and then submits it; every begun batch must be submitted.
+ *
+ * @param client The client, connected with a ring.
+ * @param model The index of an opened model.
+ * @param count The number of rows.
+ * @param batch Receives the reservation.
+ * @return 0 on success, -1 with errno EAGAIN if the ring is full: receive
+ * and release a reply and try again.
+ */
+int FuzzyServiceBegin(FuzzyServiceClient_t *client, uint32_t model,
+                      size_t count, FuzzyServiceBatch_t *batch) {
+    if (model >= FUZZY_SERVICE_MAX_MODELS ||
+        client->models[model].numInputs == 0) {
+        errno = ENOENT;
+        return -1;
+    }
+    const FuzzyServiceModel_t *info = &client->models[model];
+    uint32_t width = info->numInputs + info->numOutputs;
+    if (client->ring == NULL ||
+        count > client->ringSize / sizeof(double) / width) {
+        errno = ENOBUFS;
+        return -1;
+    }
+
+    // a batch never wraps around the end of the ring
+    uint64_t size = count * width * sizeof(double);
+    uint64_t start = client->head;
+    uint64_t offset = start % client->ringSize;
+    if (offset + size > client->ringSize) {
+        start += client->ringSize - offset;
+        offset = 0;
+    }
+    if (start + size - client->tail > client->ringSize) {
+        errno = EAGAIN;
+        return -1;
+    }
+    client->head = start + size;
+
+    batch->model = model;
+    batch->count = count;
+    batch->inputs = (double *)(client->ring + offset);
+    batch->outputs = batch->inputs + count * info->numInputs;
+    batch->end = client->head;
+    return 0;
+}
+
+/**
+ * Sends a ring batch.
+ *
+ * @return The id of the request, -1 with errno EAGAIN if too many requests
+ * are in flight: receive a reply and try again.
+ */
+int FuzzyServiceSubmit(FuzzyServiceClient_t *client,
+                       const FuzzyServiceBatch_t *batch) {
+    FuzzyServiceMessage_t *message = (FuzzyServiceMessage_t *)client->message;
+    memset(message, 0, HEADER_SIZE);
+    message->type = FUZZY_SERVICE_EVALUATE_SHARED;
+    message->model = batch->model;
+    message->count = batch->count;
+    message->input = (char *)batch->inputs - client->ring;
+    message->output = (char *)batch->outputs - client->ring;
+    return request(client, message, 0, -1, batch->end);
+}
+
+/**
+ * Waits for the reply to the oldest request in flight.
+ *
+ * @param client The client.
+ * @param reply Receives the reply; its status is 0 or a negative errno.
+ * @param outputs Receives the outputs of an inline batch, may be NULL for
+ * ring batches.
+ * @param maxOutputs The number of values outputs can hold.
+ * @return 0 on success, -1 if the connection failed.
+ */
+int FuzzyServiceReceive(FuzzyServiceClient_t *client,
+                        FuzzyServiceReply_t *reply, double *outputs,
+                        size_t maxOutputs) {
+    return receive(client, reply, outputs, maxOutputs * sizeof(double));
+}
+
+/**
+ * Hands the ring space of a received batch, and of every batch before it,
+ * back for new batches.
+ */
+void FuzzyServiceRelease(FuzzyServiceClient_t *client,
+                         const FuzzyServiceReply_t *reply) {
+    if (reply->end > client->tail) {
+        client->tail = reply->end;
+    }
+}
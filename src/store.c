@@ -0,0 +1,544 @@
+/**
+ * @file store.c
+ * @brief Fuzzy Logic time indexed telemetry store implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "store.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+_Static_assert(sizeof(FuzzyStoreSegmentHeader_t) <= FUZZY_STORE_HEADER_SIZE,
+               "the segment header must fit its page");
+
+#define SERIES_FILE "series.txt"
+#define MAX_CAPACITY (FUZZY_STORE_INDEX_LENGTH * FUZZY_STORE_INDEX_STRIDE)
+
+static size_t segmentSize(uint32_t capacity) {
+    return FUZZY_STORE_HEADER_SIZE +
+           (size_t)capacity * sizeof(FuzzyStoreRecord_t);
+}
+
+static void segmentPath(const FuzzyStore_t *store, int segment, char *path) {
+    snprintf(path, FUZZY_STORE_PATH_LENGTH + 32, "%s/segment-%08d.fzs",
+             store->path, segment);
+}
+
+static const FuzzyStoreRecord_t *
+segmentRecords(const FuzzyStoreSegmentHeader_t *header) {
+    return (const FuzzyStoreRecord_t *)((const char *)header +
+                                        FUZZY_STORE_HEADER_SIZE);
+}
+
+static int validHeader(const FuzzyStoreSegmentHeader_t *header) {
+    return memcmp(header->magic, FUZZY_STORE_MAGIC, 4) == 0 &&
+           header->version == FUZZY_STORE_VERSION && header->capacity > 0 &&
+           header->capacity <= MAX_CAPACITY;
+}
+
+// Reads the names of the series, the line number is the series number
+static int loadSeries(FuzzyStore_t *store) {
+    char path[FUZZY_STORE_PATH_LENGTH + 32];
+    snprintf(path, sizeof(path), "%s/" SERIES_FILE, store->path);
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        return errno == ENOENT ? 0 : -1;
+    }
+    // a longer line does not fit the buffer and is rejected as a whole
+    char line[FUZZY_STORE_NAME_LENGTH + 2];
+    int failed = 0;
+    store->numSeries = 0;
+    while (store->numSeries < FUZZY_STORE_MAX_SERIES &&
+           fgets(line, sizeof(line), f) != NULL) {
+        line[strcspn(line, "\n")] = '\0';
+        if (strlen(line) >= FUZZY_STORE_NAME_LENGTH) {
+            failed = 1;
+            break;
+        }
+        strcpy(store->series[store->numSeries++], line);
+    }
+    fclose(f);
+    return failed ? -1 : 0;
+}
+
+// Maps a segment file, failing if it is shorter than its records
+static void *mapSegment(int fd, size_t size, int protection) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (uint64_t)st.st_size < size) {
+        return MAP_FAILED;
+    }
+    return mmap(NULL, size, protection, MAP_SHARED, fd, 0);
+}
+
+static int addSegment(FuzzyStore_t *store, const FuzzyStoreSegment_t *info) {
+    if (store->numSegments == store->maxSegments) {
+        int maxSegments = store->maxSegments ? 2 * store->maxSegments : 64;
+        FuzzyStoreSegment_t *segments =
+            realloc(store->segments, maxSegments * sizeof(*segments));
+        if (segments == NULL) {
+            return -1;
+        }
+        store->segments = segments;
+        store->maxSegments = maxSegments;
+    }
+    store->segments[store->numSegments++] = *info;
+    return 0;
+}
+
+/**
+ * Opens a store, creating its directory if it is opened for appending.
+ *
+ * @param store The store to open.
+ * @param path The directory of the store.
+ * @param writable Whether this process appends to the store, only one may.
+ * @param segmentSize The bytes of new segments, 0 for
+ * FUZZY_STORE_SEGMENT_SIZE; at most 76800 records.
+ * @return 0 on success, -1 otherwise.
+ */
+int FuzzyStoreOpen(FuzzyStore_t *store, const char *path, int writable,
+                   size_t segmentSize) {
+    memset(store, 0, sizeof(*store));
+    if (strlen(path) >= FUZZY_STORE_PATH_LENGTH) {
+        return -1;
+    }
+    strcpy(store->path, path);
+    store->writable = writable;
+
+    if (segmentSize == 0) {
+        segmentSize = FUZZY_STORE_SEGMENT_SIZE;
+    }
+    if (segmentSize < FUZZY_STORE_HEADER_SIZE + sizeof(FuzzyStoreRecord_t)) {
+        return -1;
+    }
+    size_t capacity = (segmentSize - FUZZY_STORE_HEADER_SIZE) /
+                      sizeof(FuzzyStoreRecord_t);
+    store->capacity = capacity < MAX_CAPACITY ? capacity : MAX_CAPACITY;
+
+    struct stat st;
+    if (writable && mkdir(path, 0755) != 0 && errno != EEXIST) {
+        return -1;
+    }
+    if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode) ||
+        FuzzyStoreRefresh(store) != 0) {
+        FuzzyStoreClose(store);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Unmaps the segment being appended to and releases the store.
+ */
+void FuzzyStoreClose(FuzzyStore_t *store) {
+    if (store->current != NULL) {
+        munmap(store->current, store->currentSize);
+    }
+    free(store->segments);
+    memset(store, 0, sizeof(*store));
+}
+
+/**
+ * Picks up the series and segments another process appended since the
+ * store was opened. Queries refresh a read-only store themselves.
+ *
+ * @return 0 on success, -1 if a segment or the series list is damaged.
+ */
+int FuzzyStoreRefresh(FuzzyStore_t *store) {
+    if (loadSeries(store) != 0) {
+        return -1;
+    }
+    // the last known segment may have grown
+    int segment = store->numSegments > 0 ? store->numSegments - 1 : 0;
+    store->numSegments = segment;
+    for (;; segment++) {
+        char path[FUZZY_STORE_PATH_LENGTH + 32];
+        segmentPath(store, segment, path);
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return errno == ENOENT ? 0 : -1;
+        }
+        FuzzyStoreSegmentHeader_t header;
+        ssize_t length = pread(fd, &header, sizeof(header), 0);
+        close(fd);
+        if (length != (ssize_t)sizeof(header) || !validHeader(&header)) {
+            return -1;
+        }
+        FuzzyStoreSegment_t info = {
+            .first = header.first,
+            .last = header.last,
+            .count = atomic_load(&header.count),
+            .capacity = header.capacity};
+        if (addSegment(store, &info) != 0) {
+            return -1;
+        }
+    }
+}
+
+/**
+ * Schedules the writeback of the segment being appended to.
+ */
+int FuzzyStoreSync(FuzzyStore_t *store) {
+    if (store->current == NULL) {
+        return 0;
+    }
+    return msync(store->current, store->currentSize, MS_ASYNC);
+}
+
+/**
+ * Returns the number of a series, adding it to a writable store.
+ *
+ * @param store The store.
+ * @param name The name of the series, e.g. a log label.
+ * @return The series, -1 if there is none or no more can be added.
+ */
+int FuzzyStoreSeries(FuzzyStore_t *store, const char *name) {
+    for (int i = 0; i < store->numSeries; i++) {
+        if (strcmp(store->series[i], name) == 0) {
+            return i;
+        }
+    }
+    if (!store->writable || store->numSeries == FUZZY_STORE_MAX_SERIES ||
+        strlen(name) >= FUZZY_STORE_NAME_LENGTH || strchr(name, '\n')) {
+        return -1;
+    }
+
+    char path[FUZZY_STORE_PATH_LENGTH + 32];
+    snprintf(path, sizeof(path), "%s/" SERIES_FILE, store->path);
+    FILE *f = fopen(path, "a");
+    if (f == NULL) {
+        return -1;
+    }
+    int failed = fprintf(f, "%s\n", name) < 0;
+    failed |= fclose(f) != 0;
+    if (failed) {
+        return -1;
+    }
+    strcpy(store->series[store->numSeries], name);
+    return store->numSeries++;
+}
+
+// Maps the last segment for appending, creating a new one if it is full
+static int openCurrent(FuzzyStore_t *store) {
+    int segment = store->numSegments - 1;
+    int create = segment < 0 || store->segments[segment].count ==
+                                    store->segments[segment].capacity;
+    if (create) {
+        segment++;
+    }
+    uint32_t capacity =
+        create ? store->capacity : store->segments[segment].capacity;
+    size_t size = segmentSize(capacity);
+
+    // a new segment is set up under a temporary name, readers only ever see
+    // it with its header written
+    char path[FUZZY_STORE_PATH_LENGTH + 32];
+    char temporary[FUZZY_STORE_PATH_LENGTH + 32];
+    segmentPath(store, segment, path);
+    snprintf(temporary, sizeof(temporary), "%s/segment.tmp", store->path);
+    const char *opened = create ? temporary : path;
+    int fd = open(opened, create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    if (create && ftruncate(fd, size) != 0) {
+        close(fd);
+        unlink(temporary);
+        return -1;
+    }
+    FuzzyStoreSegmentHeader_t *header =
+        mapSegment(fd, size, PROT_READ | PROT_WRITE);
+    close(fd);
+    if (header == MAP_FAILED) {
+        if (create) {
+            unlink(temporary);
+        }
+        return -1;
+    }
+
+    if (create) {
+        FuzzyStoreSegment_t info = {.capacity = capacity};
+        header->version = FUZZY_STORE_VERSION;
+        header->capacity = capacity;
+        memcpy(header->magic, FUZZY_STORE_MAGIC, 4);
+        // link() fails rather than replace a segment another writer added
+        int failed = link(temporary, path) != 0;
+        unlink(temporary);
+        if (failed || addSegment(store, &info) != 0) {
+            munmap(header, size);
+            if (!failed) {
+                unlink(path);
+            }
+            return -1;
+        }
+    } else if (!validHeader(header)) {
+        munmap(header, size);
+        return -1;
+    }
+    store->current = header;
+    store->currentSize = size;
+    return 0;
+}
+
+/**
+ * Appends a record. Records must come in time order.
+ *
+ * @param store A writable store.
+ * @param series A series of the store.
+ * @param time Seconds since the epoch, not before the last record.
+ * @param value The value.
+ * @return 0 on success, -1 if the record is out of order or can not be
+ * written.
+ */
+int FuzzyStoreAppend(FuzzyStore_t *store, int series, double time,
+                     double value) {
+    if (!store->writable || series < 0 || series >= store->numSeries ||
+        !isfinite(time)) {
+        return -1;
+    }
+    FuzzyStoreSegment_t *last =
+        store->numSegments > 0 ? &store->segments[store->numSegments - 1]
+                               : NULL;
+    // only the last segment can be empty, the record before is then the last
+    // one of the segment before
+    const FuzzyStoreSegment_t *previous = last;
+    if (last != NULL && last->count == 0 && store->numSegments > 1) {
+        previous = &store->segments[store->numSegments - 2];
+    }
+    if (previous != NULL && previous->count > 0 && time < previous->last) {
+        return -1;
+    }
+    if (store->current != NULL && last->count == last->capacity) {
+        munmap(store->current, store->currentSize);
+        store->current = NULL;
+    }
+    if (store->current == NULL && openCurrent(store) != 0) {
+        return -1;
+    }
+    last = &store->segments[store->numSegments - 1];
+
+    FuzzyStoreSegmentHeader_t *header = store->current;
+    uint32_t n = atomic_load_explicit(&header->count, memory_order_relaxed);
+    FuzzyStoreRecord_t *record = (FuzzyStoreRecord_t *)segmentRecords(header);
+    record[n] = (FuzzyStoreRecord_t){
+        .time = time, .series = series, .value = value};
+
+    FuzzyStoreSummary_t *summary = &header->series[series];
+    summary->min = summary->count ? fmin(summary->min, value) : value;
+    summary->max = summary->count ? fmax(summary->max, value) : value;
+    summary->count++;
+    if (n % FUZZY_STORE_INDEX_STRIDE == 0) {
+        header->index[n / FUZZY_STORE_INDEX_STRIDE] = time;
+    }
+    if (n == 0) {
+        header->first = time;
+        last->first = time;
+    }
+    header->last = time;
+    last->last = time;
+    last->count = n + 1;
+
+    // the record and its summary are visible to readers from here on
+    atomic_store_explicit(&header->count, n + 1, memory_order_release);
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Queries
+// ---------------------------------------------------------------------------
+
+/**
+ * Sets a filter that matches every record.
+ */
+void FuzzyStoreFilterAll(FuzzyStoreFilter_t *filter) {
+    filter->from = -INFINITY;
+    filter->to = INFINITY;
+    filter->series = -1;
+    filter->lower = -INFINITY;
+    filter->upper = INFINITY;
+}
+
+static int thresholded(const FuzzyStoreFilter_t *filter) {
+    return filter->lower != -INFINITY || filter->upper != INFINITY;
+}
+
+// Whether the summaries of a segment admit a matching record
+static int summaryMatches(const FuzzyStoreSegmentHeader_t *header,
+                          const FuzzyStoreFilter_t *filter) {
+    int first = filter->series >= 0 ? filter->series : 0;
+    int last = filter->series >= 0 ? filter->series + 1
+                                   : FUZZY_STORE_MAX_SERIES;
+    for (int i = first; i < last; i++) {
+        const FuzzyStoreSummary_t *summary = &header->series[i];
+        if (summary->count > 0 &&
+            (!thresholded(filter) || (summary->max >= filter->lower &&
+                                      summary->min <= filter->upper))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Starts a query. The segments before the time range are skipped without
+ * touching them.
+ *
+ * @param query The query to start.
+ * @param store The store to query, refreshed first unless it is writable.
+ * @param filter The records to return.
+ * @return 0 on success, -1 if the store can not be refreshed.
+ */
+int FuzzyStoreQueryInit(FuzzyStoreQuery_t *query, FuzzyStore_t *store,
+                        const FuzzyStoreFilter_t *filter) {
+    memset(query, 0, sizeof(*query));
+    query->store = store;
+    query->filter = *filter;
+    if (!store->writable && FuzzyStoreRefresh(store) != 0) {
+        return -1;
+    }
+
+    // the first segment that ends at or after the start of the range
+    int low = 0, high = store->numSegments;
+    while (low < high) {
+        int middle = (low + high) / 2;
+        if (store->segments[middle].last < filter->from) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    query->segment = low;
+    query->segmentsSkipped = low;
+    return 0;
+}
+
+// Maps the next segment that can match, returns 0 once there is none
+static int nextSegment(FuzzyStoreQuery_t *query) {
+    const FuzzyStore_t *store = query->store;
+    const FuzzyStoreFilter_t *filter = &query->filter;
+    for (; query->segment < store->numSegments; query->segment++) {
+        const FuzzyStoreSegment_t *info = &store->segments[query->segment];
+        if (info->count > 0 && info->first >= filter->to) {
+            return 0;
+        }
+
+        char path[FUZZY_STORE_PATH_LENGTH + 32];
+        segmentPath(store, query->segment, path);
+        int fd = open(path, O_RDONLY);
+        if (fd < 0) {
+            return -1;
+        }
+        size_t size = segmentSize(info->capacity);
+        const FuzzyStoreSegmentHeader_t *header =
+            mapSegment(fd, size, PROT_READ);
+        close(fd);
+        if (header == MAP_FAILED) {
+            return -1;
+        }
+        uint32_t count = atomic_load_explicit(
+            (_Atomic uint32_t *)&header->count, memory_order_acquire);
+        if (!validHeader(header) || count > header->capacity) {
+            munmap((void *)header, size);
+            return -1;
+        }
+        if (count == 0 || !summaryMatches(header, filter)) {
+            munmap((void *)header, size);
+            query->segmentsSkipped++;
+            continue;
+        }
+
+        // start at the last index entry before the range
+        uint32_t position = 0;
+        if (header->first < filter->from) {
+            uint32_t low = 0, high = (count - 1) / FUZZY_STORE_INDEX_STRIDE;
+            while (low < high) {
+                uint32_t middle = (low + high + 1) / 2;
+                if (header->index[middle] < filter->from) {
+                    low = middle;
+                } else {
+                    high = middle - 1;
+                }
+            }
+            position = low * FUZZY_STORE_INDEX_STRIDE;
+        }
+
+        query->mapping = header;
+        query->mappingSize = size;
+        query->position = position;
+        query->count = count;
+        query->segmentsVisited++;
+        return 1;
+    }
+    return 0;
+}
+
+static void unmapSegment(FuzzyStoreQuery_t *query) {
+    if (query->mapping != NULL) {
+        munmap((void *)query->mapping, query->mappingSize);
+        query->mapping = NULL;
+    }
+}
+
+/**
+ * Returns the next matching record, in time order.
+ *
+ * @param query The query.
+ * @param record Receives the record.
+ * @return 1 if a record was found, 0 at the end, -1 if a segment can not be
+ * read.
+ */
+int FuzzyStoreNext(FuzzyStoreQuery_t *query, FuzzyStoreRecord_t *record) {
+    const FuzzyStoreFilter_t *filter = &query->filter;
+    for (;;) {
+        if (query->mapping == NULL) {
+            int found = nextSegment(query);
+            if (found <= 0) {
+                query->segment = query->store->numSegments;
+                return found;
+            }
+        }
+
+        const FuzzyStoreRecord_t *records = segmentRecords(query->mapping);
+        while (query->position < query->count) {
+            const FuzzyStoreRecord_t *r = &records[query->position++];
+            query->recordsScanned++;
+            if (r->time < filter->from) {
+                continue;
+            }
+            if (r->time >= filter->to) {
+                unmapSegment(query);
+                query->segment = query->store->numSegments;
+                return 0;
+            }
+            if ((filter->series >= 0 &&
+                 r->series != (uint32_t)filter->series) ||
+                (thresholded(filter) &&
+                 !(r->value >= filter->lower && r->value <= filter->upper))) {
+                continue;
+            }
+            *record = *r;
+            return 1;
+        }
+        unmapSegment(query);
+        query->segment++;
+    }
+}
+
+/**
+ * Ends a query early, unmapping its segment.
+ */
+void FuzzyStoreQueryFree(FuzzyStoreQuery_t *query) {
+    unmapSegment(query);
+}
@@ -0,0 +1,375 @@
+/**
+ * @file telemetry.c
+ * @brief Fuzzy Logic telemetry serializer implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "telemetry.h"
+
+#include <float.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define MEMBERSHIP_DECIMALS 3
+#define TIME_DECIMALS 3
+
+// CBOR major types
+#define CBOR_TEXT 3
+#define CBOR_MAP 5
+#define CBOR_FLOAT64 0xfb
+
+static const double powers[FUZZY_FIXED_MAX_DECIMALS + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9};
+
+/**
+ * Formats a double with a fixed number of decimals, like "%.*f" but without
+ * printf.
+ *
+ * The value is scaled and rounded to the nearest output. Scaling is inexact,
+ * so values within a few ulps of a tie between two outputs, like 81.565
+ * stored as 81.564999999999997726, and values beyond 2^52 once scaled are
+ * left to snprintf(), which rounds the exact binary value. The digits match
+ * "%.*f" except that negative values that round to zero lose their sign.
+ * Values too large to scale into 64 bits are written as "%.17g", non-finite
+ * values as null, the output is meant for JSON.
+ *
+ * @param buffer Receives the text and a terminating zero, at least
+ * FUZZY_FIXED_LENGTH bytes.
+ * @param value The value to format.
+ * @param decimals The number of decimals, 0 to FUZZY_FIXED_MAX_DECIMALS.
+ * @return The length of the text.
+ */
+int FuzzyFormatFixed(char *buffer, double value, int decimals) {
+    if (decimals < 0) {
+        decimals = 0;
+    } else if (decimals > FUZZY_FIXED_MAX_DECIMALS) {
+        decimals = FUZZY_FIXED_MAX_DECIMALS;
+    }
+    if (!isfinite(value)) {
+        memcpy(buffer, "null", 5);
+        return 4;
+    }
+
+    double scaled = fabs(value) * powers[decimals];
+    if (scaled >= 9e18) {
+        return snprintf(buffer, FUZZY_FIXED_LENGTH, "%.17g", value);
+    }
+    // the fraction is off by at most an ulp of scaled, too close to call
+    double fraction = scaled - floor(scaled);
+    if (scaled >= 0x1p52 ||
+        fabs(fraction - 0.5) <= 4.0 * DBL_EPSILON * fmax(scaled, 1.0)) {
+        int length = snprintf(buffer, FUZZY_FIXED_LENGTH, "%.*f", decimals,
+                              value);
+        // like the digits below, zero has no sign
+        if (buffer[0] == '-' &&
+            strspn(buffer + 1, "0.") == (size_t)(length - 1)) {
+            memmove(buffer, buffer + 1, length--);
+        }
+        return length;
+    }
+
+    // the digits last to first, at least one before the decimal point
+    uint64_t digits = (uint64_t)(scaled + 0.5);
+    char reversed[24];
+    int numDigits = 0;
+    bool zero = digits == 0;
+    do {
+        reversed[numDigits++] = (char)('0' + digits % 10);
+        digits /= 10;
+    } while (digits > 0 || numDigits <= decimals);
+
+    char *p = buffer;
+    if (value < 0.0 && !zero) {
+        *p++ = '-';
+    }
+    while (numDigits > decimals) {
+        *p++ = reversed[--numDigits];
+    }
+    if (decimals > 0) {
+        *p++ = '.';
+        while (numDigits > 0) {
+            *p++ = reversed[--numDigits];
+        }
+    }
+    *p = '\0';
+    return (int)(p - buffer);
+}
+
+// ---------------------------------------------------------------------------
+// Appending to the buffer, every append fails instead of overflowing
+// ---------------------------------------------------------------------------
+
+static int append(FuzzyTelemetry_t *telemetry, const void *data,
+                  size_t length) {
+    if (telemetry->length + length > telemetry->size) {
+        return -1;
+    }
+    memcpy(&telemetry->buffer[telemetry->length], data, length);
+    telemetry->length += length;
+    return 0;
+}
+
+static int appendJsonKey(FuzzyTelemetry_t *telemetry, const char *name) {
+    if (append(telemetry, "\"", 1)) {
+        return -1;
+    }
+    for (const char *c = name; *c != '\0'; c++) {
+        // names are identifiers, escape just enough to stay valid JSON
+        if ((*c == '"' || *c == '\\') && append(telemetry, "\\", 1)) {
+            return -1;
+        }
+        if (append(telemetry, (unsigned char)*c < 0x20 ? "?" : c, 1)) {
+            return -1;
+        }
+    }
+    return append(telemetry, "\":", 2);
+}
+
+static int appendJsonNumber(FuzzyTelemetry_t *telemetry, double value,
+                            int decimals) {
+    char text[FUZZY_FIXED_LENGTH];
+    return append(telemetry, text, FuzzyFormatFixed(text, value, decimals));
+}
+
+// A CBOR head, the major type and an argument in the shortest form
+static int appendCborHead(FuzzyTelemetry_t *telemetry, int major,
+                          uint32_t argument) {
+    uint8_t head[5];
+    size_t length;
+    head[0] = (uint8_t)(major << 5);
+    if (argument < 24) {
+        head[0] |= (uint8_t)argument;
+        length = 1;
+    } else if (argument <= 0xff) {
+        head[0] |= 24;
+        head[1] = (uint8_t)argument;
+        length = 2;
+    } else if (argument <= 0xffff) {
+        head[0] |= 25;
+        head[1] = (uint8_t)(argument >> 8);
+        head[2] = (uint8_t)argument;
+        length = 3;
+    } else {
+        head[0] |= 26;
+        for (int i = 0; i < 4; i++) {
+            head[1 + i] = (uint8_t)(argument >> (24 - 8 * i));
+        }
+        length = 5;
+    }
+    return append(telemetry, head, length);
+}
+
+static int appendCborText(FuzzyTelemetry_t *telemetry, const char *text) {
+    size_t length = strlen(text);
+    return appendCborHead(telemetry, CBOR_TEXT, (uint32_t)length) ||
+           append(telemetry, text, length);
+}
+
+static int appendCborNumber(FuzzyTelemetry_t *telemetry, double value) {
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    uint8_t number[9] = {CBOR_FLOAT64};
+    for (int i = 0; i < 8; i++) {
+        number[1 + i] = (uint8_t)(bits >> (56 - 8 * i));
+    }
+    return append(telemetry, number, sizeof(number));
+}
+
+// ---------------------------------------------------------------------------
+// Documents
+// ---------------------------------------------------------------------------
+
+static double variableValue(const FuzzyModel_t *model,
+                            const FuzzyContext_t *context,
+                            const double *inputs, int variable, int *input,
+                            int *output) {
+    if (model->variables[variable].kind == FUZZY_MODEL_INPUT) {
+        return inputs[(*input)++];
+    }
+    return context->outputs[(*output)++];
+}
+
+static int encodeJson(FuzzyTelemetry_t *telemetry, const FuzzyModel_t *model,
+                      const FuzzyContext_t *context, const double *inputs,
+                      double time) {
+    if (append(telemetry, "{", 1) || appendJsonKey(telemetry, "time") ||
+        appendJsonNumber(telemetry, time, TIME_DECIMALS)) {
+        return -1;
+    }
+
+    // the inputs, then the outputs
+    const char *sections[2] = {",\"inputs\":{", "},\"outputs\":{"};
+    for (int kind = FUZZY_MODEL_INPUT; kind <= FUZZY_MODEL_OUTPUT; kind++) {
+        if (append(telemetry, sections[kind], strlen(sections[kind]))) {
+            return -1;
+        }
+        int input = 0;
+        int output = 0;
+        int numShown = 0;
+        for (int i = 0; i < model->numVariables; i++) {
+            double value =
+                variableValue(model, context, inputs, i, &input, &output);
+            if (model->variables[i].kind != (uint32_t)kind) {
+                continue;
+            }
+            if ((numShown++ > 0 && append(telemetry, ",", 1)) ||
+                appendJsonKey(telemetry, model->variables[i].name) ||
+                appendJsonNumber(telemetry, value, telemetry->decimals)) {
+                return -1;
+            }
+        }
+    }
+
+    if (append(telemetry, "},\"active\":{", 12)) {
+        return -1;
+    }
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *variable = &model->variables[i];
+        if ((i > 0 && append(telemetry, ",", 1)) ||
+            appendJsonKey(telemetry, variable->name) ||
+            append(telemetry, "{", 1)) {
+            return -1;
+        }
+        int numShown = 0;
+        for (uint32_t t = 0; t < variable->numTerms; t++) {
+            double membership =
+                context->memberships[variable->firstTerm + t];
+            if (membership <= 0.0) {
+                continue;
+            }
+            if ((numShown++ > 0 && append(telemetry, ",", 1)) ||
+                appendJsonKey(telemetry,
+                              model->terms[variable->firstTerm + t].name) ||
+                appendJsonNumber(telemetry, membership,
+                                 MEMBERSHIP_DECIMALS)) {
+                return -1;
+            }
+        }
+        if (append(telemetry, "}", 1)) {
+            return -1;
+        }
+    }
+    return append(telemetry, "}}\n", 3);
+}
+
+static int encodeCbor(FuzzyTelemetry_t *telemetry, const FuzzyModel_t *model,
+                      const FuzzyContext_t *context, const double *inputs,
+                      double time) {
+    if (appendCborHead(telemetry, CBOR_MAP, 4) ||
+        appendCborText(telemetry, "time") ||
+        appendCborNumber(telemetry, time)) {
+        return -1;
+    }
+
+    const char *sections[2] = {"inputs", "outputs"};
+    const int counts[2] = {model->numInputs, model->numOutputs};
+    for (int kind = FUZZY_MODEL_INPUT; kind <= FUZZY_MODEL_OUTPUT; kind++) {
+        if (appendCborText(telemetry, sections[kind]) ||
+            appendCborHead(telemetry, CBOR_MAP, counts[kind])) {
+            return -1;
+        }
+        int input = 0;
+        int output = 0;
+        for (int i = 0; i < model->numVariables; i++) {
+            double value =
+                variableValue(model, context, inputs, i, &input, &output);
+            if (model->variables[i].kind != (uint32_t)kind) {
+                continue;
+            }
+            if (appendCborText(telemetry, model->variables[i].name) ||
+                appendCborNumber(telemetry, value)) {
+                return -1;
+            }
+        }
+    }
+
+    if (appendCborText(telemetry, "active") ||
+        appendCborHead(telemetry, CBOR_MAP, model->numVariables)) {
+        return -1;
+    }
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *variable = &model->variables[i];
+        const double *memberships = &context->memberships[variable->firstTerm];
+        uint32_t numActive = 0;
+        for (uint32_t t = 0; t < variable->numTerms; t++) {
+            numActive += memberships[t] > 0.0;
+        }
+        if (appendCborText(telemetry, variable->name) ||
+            appendCborHead(telemetry, CBOR_MAP, numActive)) {
+            return -1;
+        }
+        for (uint32_t t = 0; t < variable->numTerms; t++) {
+            if (memberships[t] > 0.0 &&
+                (appendCborText(telemetry,
+                                model->terms[variable->firstTerm + t].name) ||
+                 appendCborNumber(telemetry, memberships[t]))) {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+// ---------------------------------------------------------------------------
+// Public interface
+// ---------------------------------------------------------------------------
+
+/**
+ * Initializes a telemetry serializer on a caller-provided buffer.
+ *
+ * @param telemetry The serializer to initialize.
+ * @param buffer The buffer a cycle is encoded into.
+ * @param size The size of the buffer in bytes.
+ * @param format JSON or CBOR.
+ * @param decimals The decimals of the inputs and outputs in JSON, 0 to
+ * FUZZY_FIXED_MAX_DECIMALS.
+ * @return 0 on success, -1 if the arguments are invalid.
+ */
+int FuzzyTelemetryInit(FuzzyTelemetry_t *telemetry, char *buffer, size_t size,
+                       FuzzyTelemetryFormat_e format, int decimals) {
+    memset(telemetry, 0, sizeof(*telemetry));
+    if (buffer == NULL || decimals < 0 ||
+        decimals > FUZZY_FIXED_MAX_DECIMALS) {
+        return -1;
+    }
+    telemetry->buffer = buffer;
+    telemetry->size = size;
+    telemetry->format = format;
+    telemetry->decimals = decimals;
+    return 0;
+}
+
+/**
+ * Encodes the telemetry document of an evaluated cycle, replacing the
+ * previous one. The document is in buffer[0, length); JSON documents end with
+ * a newline, so they can be appended to a log as they are.
+ *
+ * @param telemetry The serializer.
+ * @param model The model.
+ * @param context The context the model was evaluated with.
+ * @param inputs The inputs of the evaluation.
+ * @param time The time of the cycle, e.g. seconds since the epoch.
+ * @return 0 on success, -1 if the document does not fit, the length is then 0.
+ */
+int FuzzyTelemetryEncode(FuzzyTelemetry_t *telemetry,
+                         const FuzzyModel_t *model,
+                         const FuzzyContext_t *context, const double *inputs,
+                         double time) {
+    telemetry->length = 0;
+    int failed = telemetry->format == FUZZY_TELEMETRY_CBOR
+                     ? encodeCbor(telemetry, model, context, inputs, time)
+                     : encodeJson(telemetry, model, context, inputs, time);
+    if (failed) {
+        telemetry->length = 0;
+        return -1;
+    }
+    return 0;
+}
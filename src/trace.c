@@ -0,0 +1,243 @@
+/**
+ * @file trace.c
+ * @brief Fuzzy Logic evaluation trace implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "trace.h"
+
+#include "model.h"
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TRACE_MAGIC "FZTR"
+#define TRACE_VERSION 1
+
+// The header of a dump, followed by count records, the oldest first
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+} TraceHeader_t;
+
+/**
+ * Initializes a trace.
+ *
+ * @param trace The trace to initialize.
+ * @param capacity The number of records to keep, rounded up to a power of
+ * two.
+ * @return 0 on success, -1 if out of memory.
+ */
+int FuzzyTraceInit(FuzzyTrace_t *trace, int capacity) {
+    memset(trace, 0, sizeof(*trace));
+    uint64_t size = 1;
+    while (size < (uint64_t)capacity) {
+        size <<= 1;
+    }
+
+    trace->records = calloc(size, sizeof(FuzzyTraceRecord_t));
+    if (trace->records == NULL) {
+        return -1;
+    }
+    trace->mask = size - 1;
+    return 0;
+}
+
+/**
+ * Releases the records of a trace.
+ */
+void FuzzyTraceFree(FuzzyTrace_t *trace) {
+    free(trace->records);
+    memset(trace, 0, sizeof(*trace));
+}
+
+/**
+ * Starts a new cycle in a trace, stamped with the wall clock.
+ */
+void FuzzyTraceCycle(FuzzyTrace_t *trace) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    fuzzyTraceRecord(trace, FUZZY_TRACE_CYCLE, (uint32_t)trace->cycles++,
+                     now.tv_sec + now.tv_nsec * 1e-9);
+}
+
+/**
+ * Writes a buffer completely.
+ */
+static int writeAll(int fd, const void *data, size_t size) {
+    const char *p = data;
+    while (size > 0) {
+        ssize_t written = write(fd, p, size);
+        if (written <= 0) {
+            return -1;
+        }
+        p += written;
+        size -= written;
+    }
+    return 0;
+}
+
+/**
+ * Writes the records of a trace to a file descriptor, the oldest first.
+ *
+ * Only write() is called, so a signal handler can dump the trace of the
+ * thread it interrupted; the cycle in progress may be cut short.
+ *
+ * @param trace The trace to dump.
+ * @param fd The file descriptor to write to.
+ * @return 0 on success, -1 if a write failed.
+ */
+int FuzzyTraceDumpFd(const FuzzyTrace_t *trace, int fd) {
+    uint64_t head = trace->head;
+    uint64_t capacity = trace->mask + 1;
+    uint64_t count = head < capacity ? head : capacity;
+
+    TraceHeader_t header = {.version = TRACE_VERSION, .count = count};
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    if (writeAll(fd, &header, sizeof(header))) {
+        return -1;
+    }
+
+    // the oldest record up to the end of the ring, then from its start
+    uint64_t first = (head - count) & trace->mask;
+    uint64_t tail = count < capacity - first ? count : capacity - first;
+    if (writeAll(fd, &trace->records[first],
+                 tail * sizeof(FuzzyTraceRecord_t)) ||
+        writeAll(fd, trace->records,
+                 (count - tail) * sizeof(FuzzyTraceRecord_t))) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Writes the records of a trace to a file, see FuzzyTraceDumpFd().
+ *
+ * @param trace The trace to dump.
+ * @param path The file to write.
+ * @return 0 on success, -1 on failure.
+ */
+int FuzzyTraceDump(const FuzzyTrace_t *trace, const char *path) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    int result = FuzzyTraceDumpFd(trace, fd);
+    if (close(fd) != 0) {
+        result = -1;
+    }
+    return result;
+}
+
+/**
+ * Reads the records of a dumped trace.
+ *
+ * @param path The dump to read.
+ * @param records Receives the records, free() them.
+ * @param numRecords Receives the number of records.
+ * @return 0 on success, -1 if the file is not a trace or can not be read.
+ */
+int FuzzyTraceLoad(const char *path, FuzzyTraceRecord_t **records,
+                   int *numRecords) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        return -1;
+    }
+
+    TraceHeader_t header;
+    if (fread(&header, sizeof(header), 1, f) != 1 ||
+        memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != TRACE_VERSION || header.count > INT32_MAX) {
+        fclose(f);
+        return -1;
+    }
+
+    FuzzyTraceRecord_t *data =
+        malloc((header.count + 1) * sizeof(FuzzyTraceRecord_t));
+    if (data == NULL) {
+        fclose(f);
+        return -1;
+    }
+    size_t count = fread(data, sizeof(FuzzyTraceRecord_t), header.count, f);
+    fclose(f);
+
+    *records = data;
+    *numRecords = (int)count;
+    return 0;
+}
+
+/**
+ * Prints trace records as text, the fired rules with their rule text.
+ *
+ * Records before the first complete cycle are skipped, records that do not
+ * fit the model are printed as such.
+ *
+ * @param f The stream to print to.
+ * @param model The model the trace was recorded with.
+ * @param records The records, e.g. from FuzzyTraceLoad().
+ * @param numRecords The number of records.
+ */
+void FuzzyTracePrint(FILE *f, const FuzzyModel_t *model,
+                     const FuzzyTraceRecord_t *records, int numRecords) {
+    int i = 0;
+    while (i < numRecords && records[i].kind != FUZZY_TRACE_CYCLE) {
+        i++;
+    }
+
+    for (; i < numRecords; i++) {
+        const FuzzyTraceRecord_t *r = &records[i];
+        switch (r->kind) {
+        case FUZZY_TRACE_CYCLE: {
+            time_t seconds = (time_t)r->value;
+            struct tm tm;
+            char stamp[32];
+            localtime_r(&seconds, &tm);
+            strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", &tm);
+            fprintf(f, "\ncycle %u [%s]\n", r->index, stamp);
+            break;
+        }
+        case FUZZY_TRACE_INPUT:
+        case FUZZY_TRACE_OUTPUT:
+            if (r->index < (uint32_t)model->numVariables) {
+                fprintf(f, "  %-6s %s = %g\n",
+                        r->kind == FUZZY_TRACE_INPUT ? "input" : "output",
+                        model->variables[r->index].name, r->value);
+            } else {
+                fprintf(f, "  unknown variable %u = %g\n", r->index,
+                        r->value);
+            }
+            break;
+        case FUZZY_TRACE_MEMBERSHIP:
+            if (r->index < (uint32_t)model->numTerms) {
+                const FuzzyModelTerm_t *term = &model->terms[r->index];
+                fprintf(f, "    %s is %s %.4f\n",
+                        model->variables[term->variable].name, term->name,
+                        r->value);
+            } else {
+                fprintf(f, "    unknown term %u %.4f\n", r->index, r->value);
+            }
+            break;
+        case FUZZY_TRACE_RULE:
+            if (r->index < (uint32_t)model->numRules) {
+                fprintf(f, "  rule %u %.4f ", r->index, r->value);
+                FuzzyModelPrintRule(f, model, r->index);
+                fprintf(f, "\n");
+            } else {
+                fprintf(f, "  unknown rule %u %.4f\n", r->index, r->value);
+            }
+            break;
+        default:
+            fprintf(f, "  unknown record %u\n", r->kind);
+            break;
+        }
+    }
+}
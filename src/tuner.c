@@ -0,0 +1,545 @@
+/**
+ * @file tuner.c
+ * @brief Fuzzy Logic membership function tuner implementation.
+ * @author Robin Prilliwtz
+ * @date 2024
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * See LICENSE.txt file for details.
+ *
+ */
+
+#include "tuner.h"
+
+#include "context.h"
+#include "membership_function.h"
+#include "model.h"
+
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TUNER_MAX_THREADS 64
+
+typedef struct {
+    int term;
+    // 0 to 3 for a to d
+    int index;
+    bool position;
+    double lo;
+    double hi;
+} TunerParameter_t;
+
+typedef struct {
+    FuzzyTunerCost_t cost;
+    void *user;
+    TunerParameter_t *parameters;
+    int numParameters;
+    int populationSize;
+    // one private model copy and parameter vector per candidate
+    FuzzyModel_t *candidates;
+    double *trials;
+    double *trialCosts;
+    atomic_int next;
+    // workers wait for a new round, the caller waits until none is pending
+    pthread_mutex_t lock;
+    pthread_cond_t start;
+    pthread_cond_t done;
+    long round;
+    int pending;
+    bool running;
+} Tuner_t;
+
+typedef struct {
+    Tuner_t *tuner;
+    FuzzyContext_t context;
+    pthread_t thread;
+} TunerWorker_t;
+
+// ---------------------------------------------------------------------------
+// random numbers
+// ---------------------------------------------------------------------------
+
+static uint64_t nextRandom(uint64_t *state) {
+    // xorshift64*
+    uint64_t x = *state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    *state = x;
+    return x * 0x2545f4914f6cdd1dULL;
+}
+
+static double uniform(uint64_t *state) {
+    return (nextRandom(state) >> 11) * 0x1.0p-53;
+}
+
+static int randomIndex(uint64_t *state, int n) {
+    return (int)(uniform(state) * n);
+}
+
+// ---------------------------------------------------------------------------
+// parameters
+// ---------------------------------------------------------------------------
+
+static double termParameter(const FuzzyModelTerm_t *term, int index) {
+    const double parameters[] = {term->a, term->b, term->c, term->d};
+    return parameters[index];
+}
+
+/**
+ * Tells whether a parameter of a membership function type is a position on
+ * the input axis, rather than a width or slope.
+ */
+static bool isPosition(MembershipFunctionType_e type, int index) {
+    switch (type) {
+    case GAUSSIAN:
+        return index == 0;
+    case SIGMOID:
+        return index == 1;
+    case GENERALIZED_BELL:
+        return index == 2;
+    default:
+        return true;
+    }
+}
+
+static bool isPiecewiseLinear(MembershipFunctionType_e type) {
+    return type == TRIANGULAR || type == TRAPEZOIDAL || type == RECTANGULAR;
+}
+
+/**
+ * Lists every tunable parameter of a model together with its bounds.
+ *
+ * @return The number of parameters, -1 if out of memory.
+ */
+static int collectParameters(const FuzzyModel_t *model, double margin,
+                             TunerParameter_t **parameters) {
+    *parameters = malloc(4 * model->numTerms * sizeof(TunerParameter_t) + 1);
+    if (*parameters == NULL) {
+        return -1;
+    }
+
+    int n = 0;
+    for (int i = 0; i < model->numVariables; i++) {
+        const FuzzyModelVariable_t *v = &model->variables[i];
+
+        // the range of the variable is spanned by the positions of its terms
+        double lo = INFINITY, hi = -INFINITY;
+        for (uint32_t j = 0; j < v->numTerms; j++) {
+            const FuzzyModelTerm_t *t = &model->terms[v->firstTerm + j];
+            MembershipFunctionType_e type = (MembershipFunctionType_e)t->type;
+            for (int k = 0; k < membershipFunctionParameters(type); k++) {
+                if (isPosition(type, k)) {
+                    lo = fmin(lo, termParameter(t, k));
+                    hi = fmax(hi, termParameter(t, k));
+                }
+            }
+        }
+        double span = hi > lo ? hi - lo : 1.0;
+        lo -= margin * span;
+        hi += margin * span;
+
+        for (uint32_t j = 0; j < v->numTerms; j++) {
+            const FuzzyModelTerm_t *t = &model->terms[v->firstTerm + j];
+            MembershipFunctionType_e type = (MembershipFunctionType_e)t->type;
+            for (int k = 0; k < membershipFunctionParameters(type); k++) {
+                TunerParameter_t *p = &(*parameters)[n++];
+                double value = termParameter(t, k);
+                p->term = (int)(v->firstTerm + j);
+                p->index = k;
+                p->position = isPosition(type, k);
+                if (p->position) {
+                    p->lo = lo;
+                    p->hi = hi;
+                } else {
+                    p->lo = fmin(value * 0.1, value * 10.0);
+                    p->hi = fmax(value * 0.1, value * 10.0);
+                }
+            }
+        }
+    }
+    return n;
+}
+
+/**
+ * Clamps a parameter vector into its bounds and sorts the breakpoints of
+ * every piecewise linear term, so every candidate is a valid model.
+ */
+static void repairParameters(const Tuner_t *tuner, const FuzzyModel_t *model,
+                             double *x) {
+    for (int j = 0; j < tuner->numParameters; j++) {
+        const TunerParameter_t *p = &tuner->parameters[j];
+        x[j] = fmin(fmax(x[j], p->lo), p->hi);
+    }
+
+    // the parameters of a term are adjacent and in order
+    for (int j = 0; j < tuner->numParameters;) {
+        const TunerParameter_t *p = &tuner->parameters[j];
+        const FuzzyModelTerm_t *t = &model->terms[p->term];
+        int count = membershipFunctionParameters(t->type);
+        if (isPiecewiseLinear(t->type)) {
+            // insertion sort, there are at most four
+            for (int k = j + 1; k < j + count; k++) {
+                double value = x[k];
+                int m = k;
+                while (m > j && x[m - 1] > value) {
+                    x[m] = x[m - 1];
+                    m--;
+                }
+                x[m] = value;
+            }
+        }
+        j += count;
+    }
+}
+
+/**
+ * Writes a parameter vector into a candidate's private image.
+ */
+static void applyParameters(const Tuner_t *tuner, FuzzyModel_t *candidate,
+                            const double *x) {
+    // candidates own their heap images, writing them is fine
+    FuzzyModelTerm_t *terms = (FuzzyModelTerm_t *)candidate->terms;
+    for (int j = 0; j < tuner->numParameters; j++) {
+        const TunerParameter_t *p = &tuner->parameters[j];
+        FuzzyModelTerm_t *t = &terms[p->term];
+        double *parameters[] = {&t->a, &t->b, &t->c, &t->d};
+        *parameters[p->index] = x[j];
+    }
+}
+
+// ---------------------------------------------------------------------------
+// parallel evaluation
+// ---------------------------------------------------------------------------
+
+static void evaluateCandidates(Tuner_t *tuner, FuzzyContext_t *context) {
+    int i;
+    while ((i = atomic_fetch_add(&tuner->next, 1)) < tuner->populationSize) {
+        FuzzyModel_t *candidate = &tuner->candidates[i];
+        applyParameters(tuner, candidate,
+                        &tuner->trials[i * tuner->numParameters]);
+        tuner->trialCosts[i] = tuner->cost(candidate, context, tuner->user);
+    }
+}
+
+static void *tunerWorker(void *arg) {
+    TunerWorker_t *worker = arg;
+    Tuner_t *tuner = worker->tuner;
+    long round = 0;
+
+    pthread_mutex_lock(&tuner->lock);
+    for (;;) {
+        while (tuner->round == round) {
+            pthread_cond_wait(&tuner->start, &tuner->lock);
+        }
+        round = tuner->round;
+        if (!tuner->running) {
+            break;
+        }
+        pthread_mutex_unlock(&tuner->lock);
+
+        evaluateCandidates(tuner, &worker->context);
+
+        pthread_mutex_lock(&tuner->lock);
+        if (--tuner->pending == 0) {
+            pthread_cond_signal(&tuner->done);
+        }
+    }
+    pthread_mutex_unlock(&tuner->lock);
+    return NULL;
+}
+
+/**
+ * Starts a round on every worker and waits until all of them are done. With
+ * running cleared the workers exit instead.
+ */
+static void startRound(Tuner_t *tuner, int numWorkers,
+                       FuzzyContext_t *context) {
+    atomic_store(&tuner->next, 0);
+    pthread_mutex_lock(&tuner->lock);
+    tuner->round++;
+    tuner->pending = numWorkers;
+    pthread_cond_broadcast(&tuner->start);
+    pthread_mutex_unlock(&tuner->lock);
+
+    if (!tuner->running) {
+        return;
+    }
+
+    // the calling thread takes part
+    evaluateCandidates(tuner, context);
+
+    pthread_mutex_lock(&tuner->lock);
+    while (tuner->pending > 0) {
+        pthread_cond_wait(&tuner->done, &tuner->lock);
+    }
+    pthread_mutex_unlock(&tuner->lock);
+}
+
+static double nowSeconds(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// ---------------------------------------------------------------------------
+// public API
+// ---------------------------------------------------------------------------
+
+/**
+ * Fills in the default tuner options.
+ *
+ * @param options The options to initialize.
+ */
+void FuzzyTunerDefaultOptions(FuzzyTunerOptions_t *options) {
+    memset(options, 0, sizeof(*options));
+    options->generations = 100;
+    options->weight = 0.6;
+    options->crossover = 0.9;
+    options->margin = 0.1;
+    options->seed = 1;
+}
+
+/**
+ * Tunes the membership function parameters of a model to minimize a cost.
+ *
+ * The model starts as the first candidate, so the result is never worse than
+ * the model passed in. On success the best parameters are written back into
+ * the model.
+ *
+ * @param model The model to tune, it must own a heap image (see
+ * FuzzyModelCopy()).
+ * @param cost The cost function, called concurrently from several threads.
+ * @param user Passed to the cost function.
+ * @param options The tuner options, NULL for the defaults.
+ * @param report Receives statistics about the run, may be NULL.
+ * @return 0 on success, -1 if the model can not be changed or out of memory.
+ */
+int FuzzyTune(FuzzyModel_t *model, FuzzyTunerCost_t cost, void *user,
+              const FuzzyTunerOptions_t *options, FuzzyTunerReport_t *report) {
+    FuzzyTunerOptions_t defaults;
+    if (options == NULL) {
+        FuzzyTunerDefaultOptions(&defaults);
+        options = &defaults;
+    }
+    if (model->storage != FUZZY_MODEL_HEAP) {
+        return -1;
+    }
+
+    Tuner_t tuner = {.cost = cost, .user = user};
+    tuner.numParameters =
+        collectParameters(model, options->margin, &tuner.parameters);
+    if (tuner.numParameters < 0) {
+        return -1;
+    }
+    int d = tuner.numParameters;
+    int n = options->populationSize;
+    if (n <= 0) {
+        n = 10 * d;
+    }
+    if (n < 16) {
+        n = 16;
+    }
+    tuner.populationSize = n;
+
+    int numThreads = options->numThreads;
+    if (numThreads <= 0) {
+        numThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (numThreads < 1) {
+        numThreads = 1;
+    }
+    if (numThreads > TUNER_MAX_THREADS) {
+        numThreads = TUNER_MAX_THREADS;
+    }
+
+    int result = -1;
+    double *population = malloc(n * d * sizeof(double));
+    double *costs = malloc(n * sizeof(double));
+    tuner.trials = malloc(n * d * sizeof(double));
+    tuner.trialCosts = malloc(n * sizeof(double));
+    tuner.candidates = calloc(n, sizeof(FuzzyModel_t));
+    TunerWorker_t *workers = calloc(numThreads, sizeof(TunerWorker_t));
+    int numCandidates = 0, numContexts = 0, numWorkers = 0;
+    if (population == NULL || costs == NULL || tuner.trials == NULL ||
+        tuner.trialCosts == NULL || tuner.candidates == NULL ||
+        workers == NULL) {
+        goto cleanup;
+    }
+    for (; numCandidates < n; numCandidates++) {
+        if (FuzzyModelCopy(&tuner.candidates[numCandidates], model, NULL)) {
+            goto cleanup;
+        }
+    }
+    for (; numContexts < numThreads; numContexts++) {
+        workers[numContexts].tuner = &tuner;
+        if (FuzzyContextInit(&workers[numContexts].context, model)) {
+            goto cleanup;
+        }
+    }
+
+    // The first candidate is the model itself, the others are scattered
+    // around it
+    uint64_t state = options->seed ? options->seed : 1;
+    for (int i = 0; i < n; i++) {
+        double *x = &tuner.trials[i * d];
+        for (int j = 0; j < d; j++) {
+            const TunerParameter_t *p = &tuner.parameters[j];
+            x[j] = termParameter(&model->terms[p->term], p->index);
+            if (i > 0) {
+                double r = 2.0 * uniform(&state) - 1.0;
+                x[j] = p->position ? x[j] + 0.1 * r * (p->hi - p->lo)
+                                   : x[j] * exp(0.5 * r);
+            }
+        }
+        repairParameters(&tuner, model, x);
+    }
+
+    // Threads that can not be started are simply left out
+    pthread_mutex_init(&tuner.lock, NULL);
+    pthread_cond_init(&tuner.start, NULL);
+    pthread_cond_init(&tuner.done, NULL);
+    tuner.running = true;
+    for (numWorkers = 1; numWorkers < numThreads; numWorkers++) {
+        if (pthread_create(&workers[numWorkers].thread, NULL, tunerWorker,
+                           &workers[numWorkers]) != 0) {
+            break;
+        }
+    }
+    numThreads = numWorkers;
+
+    double started = nowSeconds();
+    long evaluations = 0;
+
+    startRound(&tuner, numWorkers - 1, &workers[0].context);
+    evaluations += n;
+    memcpy(population, tuner.trials, n * d * sizeof(double));
+    memcpy(costs, tuner.trialCosts, n * sizeof(double));
+    double initialCost = costs[0];
+
+    for (int g = 0; g < options->generations; g++) {
+        // DE/rand/1/bin
+        for (int i = 0; i < n; i++) {
+            int r1, r2, r3;
+            do {
+                r1 = randomIndex(&state, n);
+            } while (r1 == i);
+            do {
+                r2 = randomIndex(&state, n);
+            } while (r2 == i || r2 == r1);
+            do {
+                r3 = randomIndex(&state, n);
+            } while (r3 == i || r3 == r1 || r3 == r2);
+
+            const double *x = &population[i * d];
+            const double *a = &population[r1 * d];
+            const double *b = &population[r2 * d];
+            const double *c = &population[r3 * d];
+            double *trial = &tuner.trials[i * d];
+            int forced = randomIndex(&state, d);
+            for (int j = 0; j < d; j++) {
+                if (j == forced || uniform(&state) < options->crossover) {
+                    trial[j] = a[j] + options->weight * (b[j] - c[j]);
+                } else {
+                    trial[j] = x[j];
+                }
+            }
+            repairParameters(&tuner, model, trial);
+        }
+
+        startRound(&tuner, numWorkers - 1, &workers[0].context);
+        evaluations += n;
+
+        // A NaN cost never replaces a candidate
+        for (int i = 0; i < n; i++) {
+            if (tuner.trialCosts[i] <= costs[i]) {
+                costs[i] = tuner.trialCosts[i];
+                memcpy(&population[i * d], &tuner.trials[i * d],
+                       d * sizeof(double));
+            }
+        }
+    }
+
+    double elapsed = nowSeconds() - started;
+
+    tuner.running = false;
+    startRound(&tuner, numWorkers - 1, NULL);
+    for (int i = 1; i < numWorkers; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+    pthread_cond_destroy(&tuner.done);
+    pthread_cond_destroy(&tuner.start);
+    pthread_mutex_destroy(&tuner.lock);
+
+    int best = 0;
+    for (int i = 1; i < n; i++) {
+        if (costs[i] < costs[best]) {
+            best = i;
+        }
+    }
+    for (int j = 0; j < d;) {
+        const TunerParameter_t *p = &tuner.parameters[j];
+        MembershipFunction_t mf = FuzzyModelMembershipFunction(model, p->term);
+        double *parameters[] = {&mf.a, &mf.b, &mf.c, &mf.d};
+        int count = membershipFunctionParameters(mf.type);
+        for (int k = 0; k < count; k++) {
+            *parameters[k] = population[best * d + j + k];
+        }
+        FuzzyModelSetMembershipFunction(model, p->term, mf);
+        j += count;
+    }
+
+    if (report != NULL) {
+        report->parameters = d;
+        report->populationSize = n;
+        report->numThreads = numThreads;
+        report->generations = options->generations;
+        report->evaluations = evaluations;
+        report->initialCost = initialCost;
+        report->bestCost = costs[best];
+        report->seconds = elapsed;
+        report->evaluationsPerSecond = elapsed > 0.0 ? evaluations / elapsed
+                                                     : 0.0;
+    }
+    result = 0;
+
+cleanup:
+    for (int i = 0; i < numContexts; i++) {
+        FuzzyContextFree(&workers[i].context);
+    }
+    for (int i = 0; i < numCandidates; i++) {
+        FuzzyModelFree(&tuner.candidates[i]);
+    }
+    free(workers);
+    free(tuner.candidates);
+    free(tuner.trialCosts);
+    free(tuner.trials);
+    free(costs);
+    free(population);
+    free(tuner.parameters);
+    return result;
+}
+
+/**
+ * Prints the statistics of a tuner run.
+ *
+ * @param report The report to print.
+ */
+void printTunerReport(const FuzzyTunerReport_t *report) {
+    printf("Parameters    %8d\n", report->parameters);
+    printf("Population    %8d\n", report->populationSize);
+    printf("Threads       %8d\n", report->numThreads);
+    printf("Generations   %8d\n", report->generations);
+    printf("Evaluations   %8ld (%.0f per second)\n", report->evaluations,
+           report->evaluationsPerSecond);
+    printf("Cost          %12.6g -> %12.6g\n", report->initialCost,
+           report->bestCost);
+    printf("\n");
+}